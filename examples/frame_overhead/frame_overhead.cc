@@ -0,0 +1,155 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Fixed cost of one frame on its way through the library, without a device: taking a frame from the
+// sensor's archive, giving it its stream profile, reading the profile and sensor back the way the
+// syncer and aggregator do, handing it to a second owner, deriving a processed frame from it and
+// returning everything. The payload is a few bytes, so what is left is the per-frame bookkeeping.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "sensor/sensor.h"
+#include "core/frame_data.h"
+#include "core/frame_source.h"
+#include "proc/processing.h"
+#include "proc/synthetic_stream.h"
+#include "streaming/stream_profile.h"
+
+using namespace libsmartereye2;
+
+namespace {
+
+const int kWidth = 16;
+const int kRuns = 5;
+
+class BenchmarkSensor : public SensorBase {
+ public:
+  BenchmarkSensor() : SensorBase("Benchmark Sensor", nullptr) {}
+
+  void init() {
+    frame_source_->init(metadata_parsers_);
+    frame_source_->set_sensor(shared_from_this());
+  }
+
+  StreamProfiles initStreamProfiles() override { return {}; }
+  void open(const StreamProfiles &) override {}
+  void close() override {}
+  void start(FrameCallbackPtr) override {}
+  void stop() override {}
+
+  FrameSource &source() { return *frame_source_; }
+};
+
+struct Bench {
+  std::shared_ptr<BenchmarkSensor> sensor;
+  std::shared_ptr<StreamProfileInterface> profile;
+  ProcessingBlock block;
+  FrameHolder held;      // the frame before, as a latest-frame buffer would keep it
+  uint64_t sink;         // keeps the reads from being optimised away
+
+  Bench() : block("Benchmark Block"), sink(0) {}
+
+  FrameHolder sensorFrame() {
+    FrameExtension extension{};
+    FrameHolder frame(sensor->source().alloc_frame(SeExtension::EXTENSION_VIDEO_FRAME, kWidth, extension, true));
+    if (!frame) {
+      std::fprintf(stderr, "frame_overhead: the archive ran out of frames\n");
+      std::exit(1);
+    }
+    static_cast<VideoFrameData *>(frame.frame)->assign(kWidth, 1, kWidth, 8);
+    frame->setStreamProfile(profile);
+    return frame;
+  }
+
+  void consume(const FrameHolder &frame) {
+    auto sensor_handle = frame->getSensor();
+    sink += frame->getStreamProfile()->uniqueId() + (sensor_handle ? 1 : 0);
+  }
+};
+
+// the frame alone, released before the next one is taken
+void sensorFrame(Bench &bench) {
+  auto frame = bench.sensorFrame();
+  bench.consume(frame);
+}
+
+// the frame taken while the one before is still held
+void heldSensorFrame(Bench &bench) {
+  auto frame = bench.sensorFrame();
+  bench.consume(frame);
+  bench.held = std::move(frame);
+}
+
+// a second owner, as the pipeline's latest-frame buffer next to the user callback
+void sharedSensorFrame(Bench &bench) {
+  auto frame = bench.sensorFrame();
+  auto copy = frame.clone();
+  bench.consume(copy);
+}
+
+// a processing block's frame made from the sensor's, inheriting its profile and sensor
+void derivedFrame(Bench &bench) {
+  auto frame = bench.sensorFrame();
+  FrameHolder derived(bench.block.getSource().allocateVideoFrame(nullptr, frame.frame));
+  bench.consume(derived);
+  bench.held = std::move(frame);
+}
+
+double nsPerFrame(Bench &bench, void (*scenario)(Bench &), int frames) {
+  double best = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) scenario(bench);
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    bench.held = FrameHolder();
+    auto ns = elapsed / frames;
+    if (run == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1000000;
+
+  Bench bench;
+  bench.sensor = std::make_shared<BenchmarkSensor>();
+  bench.sensor->init();
+  auto profile = std::make_shared<VideoStreamProfilePrivate>();
+  profile->setFrameId(FrameId::LeftCamera);
+  profile->setFormat(FrameFormat::Gray);
+  profile->setDims(kWidth, 1);
+  profile->setUniqueId(1);
+  bench.profile = profile;
+
+  struct {
+    const char *name;
+    void (*scenario)(Bench &);
+  } scenarios[] = {
+      {"sensor frame, released before the next", sensorFrame},
+      {"sensor frame, the one before still held", heldSensorFrame},
+      {"sensor frame with a second owner", sharedSensorFrame},
+      {"sensor frame and a frame derived from it", derivedFrame},
+  };
+
+  std::printf("ns per frame, best of %d runs of %d frames\n", kRuns, frames);
+  for (const auto &s : scenarios) {
+    std::printf("  %-44s %8.1f\n", s.name, nsPerFrame(bench, s.scenario, frames));
+  }
+  return bench.sink == 0 ? 1 : 0;
+}
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <smartereye2/pipeline/pipeline.hpp>
+#include <smartereye2/proc/filter.hpp>
 #include <opencv2/opencv.hpp>
 #include <utility>
 
@@ -20,6 +21,20 @@
 
 using namespace se2;
 
+// colours disparity into BGR for display
+se2::VideoFrame colorize(const se2::Frame &disparity) {
+  static se2::Colorizer colorizer(static_cast<float>(ColorScheme::JET));
+  return colorizer.colorize(disparity);
+}
+
+// the colorizer hands back the input itself when it cannot colour a frame, which is no BGR image
+void showColorized(const char *window, const se2::VideoFrame &colored) {
+  if (!colored || colored.getProfile().format() != FrameFormat::Color) return;
+  cv::Mat colored_mat(colored.height(), colored.width(), CV_8UC3, (void *) colored.data(),
+                      static_cast<size_t>(colored.strideInBytes()));
+  cv::imshow(window, colored_mat);
+}
+
 #ifndef GET_SYNCED_FRAME
 void handleCurrentFrame(const se2::Frame &current_frame) {
   auto frameId = current_frame.getProfile().frameId();
@@ -40,13 +55,11 @@ void handleCurrentFrame(const se2::Frame &current_frame) {
     }
       break;
     case FrameId::Disparity: {
-      auto disparity = se2::VideoFrame(current_frame);  // 4
+      auto disparity = colorize(current_frame);  // 4
 //      se2::VideoStreamProfile profile = static_cast<VideoStreamProfile>(disparity.getProfile());
 //      std::cout << "Intrinsics: " << profile.getIntrinsics().lens_focus << " : " << profile.getIntrinsics().base_line << "..." << std::endl;
 //      std::cout << "Extrinsics: " << profile.getExtrinsics().translation.x << " : " << profile.getExtrinsics().translation.z << "..." << std::endl;
-      cv::Mat disparity_mat(disparity.height(), disparity.width(), CV_16U, (void *) disparity.data());
-      cv::normalize(disparity_mat, disparity_mat, 0, 255, cv::NORM_MINMAX, CV_8U);
-      cv::imshow("disparity", disparity_mat);
+      showColorized("disparity", disparity);
     }
       break;
     case FrameId::J2Perception: {
@@ -135,13 +148,10 @@ int main(int argc, char *argv[]) {
     // ori right
     cv::Mat ori_right_mat(ori_right_gray.height(), ori_right_gray.width(), CV_8UC1, (void *) ori_right_gray.data());
 
-    // disparity
-    cv::Mat disparity_mat(disparity.height(), disparity.width(), CV_16U, (void *) disparity.data());
-    cv::normalize(disparity_mat, disparity_mat, 0, 255, cv::NORM_MINMAX, CV_8U);
-
     cv::imshow("ori_left", ori_left_bgr);
     cv::imshow("ori_right", ori_right_mat);
-    cv::imshow("disparity", disparity_mat);
+    // disparity
+    showColorized("disparity", colorize(disparity));
 #endif
 
     k = cv::waitKey(1);
@@ -0,0 +1,48 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <smartereye2/device/context.hpp>
+#include <smartereye2/device/shared_device.hpp>
+#include <csignal>
+#include <iostream>
+#include <thread>
+
+// Owns the first camera found and shares it, clients use se2::SharedContext(endpoint).
+static volatile std::sig_atomic_t g_running = 1;
+
+int main(int argc, char *argv[]) {
+  std::string endpoint = argc > 1 ? argv[1] : se2::kDefaultSharedEndpoint;
+
+  std::signal(SIGINT, [](int) { g_running = 0; });
+  std::signal(SIGTERM, [](int) { g_running = 0; });
+
+  se2::Context ctx;
+  auto devices = ctx.queryDevices();
+  if (devices.size() == 0) {
+    std::cerr << "No device connected" << std::endl;
+    return 1;
+  }
+
+  se2::SharedDeviceServer server(devices[0], endpoint);
+  server.start();
+  std::cout << "Sharing device on " << endpoint << ", Ctrl+C to quit" << std::endl;
+
+  while (g_running) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+
+  server.stop();
+  std::cout << "Dropped " << server.droppedFrames() << " frames" << std::endl;
+  return 0;
+}
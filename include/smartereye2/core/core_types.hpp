@@ -23,7 +23,7 @@ namespace se2 {
 enum class TimestampDomain {
   HARDWARE_CLOCK, /**< Frame timestamp was measured in relation to the camera clock */
   SYSTEM_TIME,    /**< Frame timestamp was measured in relation to the OS system clock */
-  GLOBAL_TIME,    /**< Frame timestamp was measured in relation to the camera clock and converted to OS system clock by constantly measure the difference*/
+  GLOBAL_TIME,    /**< Frame timestamp was measured in relation to the camera clock and converted to the OS monotonic clock by constantly measuring the difference*/
   COUNT
 };
 
@@ -38,9 +38,56 @@ enum class OptionKey {
   MOTION_MODULE_TEMPERATURE,
   MOTION_RANGE,
   LASER_POWER,
+  CALLBACK_WORKERS,
+  ADAPTIVE_SHEDDING,    /**< 1 drops queued image frames first while callbacks fall behind */
+  PACKET_FRAMESETS,     /**< 1 delivers the images the device sent together as one frameset */
+  OUTPUT_FORMAT,        /**< FrameFormat a processing block converts into */
+  PROCESSING_THREADS,   /**< threads a processing block splits one large frame across, 0 for every core */
+  DECIMATION,           /**< a processing block keeps every n-th pixel of every n-th row */
+  HISTOGRAM_EQUALIZATION, /**< 1 spreads colours by the rank of values instead of linearly */
+  PYRAMID_LEVEL,        /**< times a processing block halves frames in width and height */
+  PYRAMID_FILTER,       /**< a PyramidFilter */
   // TODO
 };
 
+enum class ThreadRole {
+  STREAM,         /**< USB frame reader */
+  CONTROL,        /**< USB control requests */
+  SERIAL,         /**< serial port reader and writer */
+  CALLBACK,       /**< frame callback workers */
+  DISPATCHER,     /**< other internal task queues */
+  TIMER,          /**< timeouts and retries */
+  WATCHDOG,       /**< connection watchdogs */
+  DEVICE_WATCHER, /**< device hot-plug polling */
+  USB_EVENTS,     /**< libusb event handling */
+  IPC,            /**< shared device server and clients */
+  PROCESSING,     /**< row stripes of image processing blocks */
+  COUNT
+};
+
+enum class SchedulingPolicy {
+  OTHER, /**< default time-sharing scheduler */
+  FIFO   /**< real-time first-in first-out, needs CAP_SYS_NICE */
+};
+
+struct ThreadPolicy {
+  ThreadPolicy() : cpu_mask(0), scheduling(SchedulingPolicy::OTHER), priority(0) {}
+  ThreadPolicy(uint64_t cpu_mask, SchedulingPolicy scheduling, int priority = 0)
+      : cpu_mask(cpu_mask), scheduling(scheduling), priority(priority) {}
+
+  uint64_t cpu_mask;            /**< bit n allows CPU n, 0 keeps the inherited affinity */
+  SchedulingPolicy scheduling;
+  int priority;                 /**< SCHED_FIFO priority 1..99, ignored for OTHER */
+};
+
+struct ClockSyncStatistics {
+  bool converged = false;     /**< frames carry GLOBAL_TIME timestamps once true */
+  uint32_t samples = 0;       /**< round trips in the current fit */
+  double drift_ppm = 0;       /**< device clock rate relative to the host's */
+  double jitter_us = 0;       /**< RMS residual of the fit */
+  double round_trip_us = 0;   /**< fastest recent round trip */
+};
+
 struct OptionRange {
   float min;
   float max;
@@ -73,6 +120,8 @@ struct FrameExtension {
   bool is_blocking = false; // when running from recording, this bit indicates
   FrameMetadataValue metadata_value = FrameMetadataValue::None;
   std::vector<uint8_t> metadata_blob;
+  uint32_t missing_streams = 0;  // FrameId bits a frameset was expected to hold but went out without
+  int64_t global_timestamp_ns = 0;  // host monotonic clock, 0 while the device clock is not mapped yet
 };
 
 }  // namespace se2
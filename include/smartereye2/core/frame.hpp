@@ -61,10 +61,12 @@ class SMARTEREYE2_API Frame {
   virtual ~Frame();
 
   void keep();
-  SeSensor *getSensor() const;
   StreamProfile getProfile() const;
 
   double timestamp() const;
+  TimestampDomain timestampDomain() const;
+  // host steady clock in ns, 0 until the sensor's clock mapping has converged
+  int64_t globalTimestamp() const;
   const char *getFrameMetadata(FrameMetadataValue frame_metadata) const;
   size_t getFrameMetadataSize() const;
   bool supportsFrameMetadata(FrameMetadataValue frame_metadata) const;
@@ -94,6 +96,7 @@ class SMARTEREYE2_API Frame {
  private:
   friend class Points;
   friend class ProcessingBlock;
+  friend class ProcessingGraph;
   friend class FrameQueue;
 
   SeFrame *frame_ref_;
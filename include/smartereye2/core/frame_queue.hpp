@@ -22,12 +22,9 @@ namespace se2 {
 
 class Frame;
 
-// TODO
 class SMARTEREYE2_API FrameQueue {
  public:
-  explicit FrameQueue(uint32_t capacity, bool keep_frames = false)
-      : capacity_(capacity), keep_(keep_frames) {
-  }
+  explicit FrameQueue(uint32_t capacity, bool keep_frames = false);
 
   FrameQueue() : FrameQueue(1) {}
 
@@ -37,14 +34,23 @@ class SMARTEREYE2_API FrameQueue {
 
   Frame waitForFrame(int32_t timeout_ms = 5000) const;
 
+  bool pollForFrame(Frame *output) const;
+  bool tryWaitForFrame(Frame *output, uint32_t timeout_ms = 5000) const;
+
   template<typename T>
   bool pollForFrame(T *output) const {
-    return false;
+    Frame frame;
+    if (!pollForFrame(&frame)) return false;
+    *output = T(frame);
+    return true;
   }
 
   template<typename T>
   bool tryWaitForFrame(T *output, uint32_t timeout_ms = 5000) const {
-    return false;
+    Frame frame;
+    if (!tryWaitForFrame(&frame, timeout_ms)) return false;
+    *output = T(frame);
+    return true;
   }
 
   size_t capacity() const { return capacity_; }
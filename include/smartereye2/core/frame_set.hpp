@@ -61,6 +61,11 @@ class SMARTEREYE2_API FrameSet : public Frame {
 
   size_t size() const { return size_; }
 
+  // false when the set was emitted without waiting any longer for some of its streams
+  bool isComplete() const { return missingStreams() == 0; }
+  bool isMissing(FrameId frame_id) const { return (missingStreams() & static_cast<uint32_t>(frame_id)) != 0; }
+  uint32_t missingStreams() const;
+
   class iterator : public std::iterator<std::forward_iterator_tag, Frame> {
    public:
     explicit iterator(const FrameSet *owner, size_t index = 0) : index_(index), owner_(owner) {}
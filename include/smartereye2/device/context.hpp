@@ -24,6 +24,7 @@
 
 #include "smartereye2/se_types.hpp"
 #include "smartereye2/se_global.hpp"
+#include "smartereye2/core/core_types.hpp"
 #include "smartereye2/proc/filter.hpp"
 #include "smartereye2/device/device_list.hpp"
 
@@ -73,6 +74,14 @@ class SMARTEREYE2_API Context : public std::enable_shared_from_this<Context> {
   template<typename T>
   void setDevicesCahngedCallback(T callback) {}
 
+  // Thread placement is process wide: it covers the threads of every context, including running ones.
+  void setThreadPolicy(ThreadRole role, const ThreadPolicy &policy);
+  // mlockall() and prefault thread stacks, for deployments judged on worst-case latency
+  void setRealtimeMode(bool enabled);
+  // Bytes the outputs of filters may take while cached on the frames they were made from, process wide,
+  // 64 MiB by default. Filters of one kind with the same options share the cached output; 0 turns it off.
+  void setDerivedFrameMemory(size_t bytes);
+
  protected:
   friend class Pipeline;
   friend class DeviceHub;
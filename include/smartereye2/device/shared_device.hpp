@@ -0,0 +1,57 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHARED_DEVICE_HPP
+#define LIBSMARTEREYE2_SHARED_DEVICE_HPP
+
+#include <memory>
+#include <string>
+
+#include "smartereye2/se_types.hpp"
+#include "smartereye2/se_global.hpp"
+#include "smartereye2/device/context.hpp"
+#include "smartereye2/device/device.hpp"
+
+// Device sharing between processes, available on POSIX platforms only.
+namespace se2 {
+
+static const char *const kDefaultSharedEndpoint = "/tmp/smartereye2.sock";
+
+// Owns the device and publishes its frames to up to 32 SharedContext clients. The slots a client
+// holds are taken back as soon as it disconnects, crashed or not.
+class SMARTEREYE2_API SharedDeviceServer {
+ public:
+  explicit SharedDeviceServer(const Device &device,
+                              const std::string &endpoint = kDefaultSharedEndpoint,
+                              uint32_t slot_count = 32);
+
+  void start();
+  void stop();
+
+  // frames lost because clients were holding every slot
+  uint64_t droppedFrames() const;
+
+ private:
+  std::shared_ptr<SeSharedDeviceServer> server_;
+};
+
+// Context whose only device is the one served on endpoint by a SharedDeviceServer.
+class SMARTEREYE2_API SharedContext : public Context {
+ public:
+  explicit SharedContext(const std::string &endpoint = kDefaultSharedEndpoint);
+};
+
+}  // namespace se2
+
+#endif  // LIBSMARTEREYE2_SHARED_DEVICE_HPP
@@ -16,6 +16,7 @@
 #define LIBSMARTEREYE2_PIPELINE_HPP
 
 #include "pipeline_profile.hpp"
+#include "subscription.hpp"
 #include "smartereye2/se_types.hpp"
 #include "smartereye2/device/context.hpp"
 
@@ -31,6 +32,8 @@ class SMARTEREYE2_API Pipeline {
   PipelineProfile start();
   PipelineProfile start(const PipelineConfig &config);
 
+  // callback runs on the sensors' delivery threads: frames of one stream in order, frames of different
+  // streams possibly at the same time (see Sensor::start)
   PipelineProfile start(FrameCallbackPtr callback);
   PipelineProfile start(const PipelineConfig &config, FrameCallbackPtr callback);
 
@@ -40,10 +43,32 @@ class SMARTEREYE2_API Pipeline {
   FrameSet waitForFrames(uint32_t timeout_ms = 1000) const;
   bool pollForFrames(FrameSet *frame_set) const;
   bool tryWaitForFrames(FrameSet *frame_set, uint32_t timeout_ms = 1000) const;
+  // The newest frame of a stream, or the newest frameset, returned at once and without queueing; the
+  // camera is never held up by these readers. generation grows by one per new frame, an unchanged
+  // value means nothing new. A stream, and the framesets, are kept from their first call on, so that
+  // call returns an empty frame; stop() releases everything kept. With start(callback), framesets
+  // are built from the first latestFrameSet() on.
+  Frame latest(FrameId frame_id, uint64_t *generation = nullptr) const;
+  FrameSet latestFrameSet(uint64_t *generation = nullptr) const;
   PipelineProfile getActiveProfile();
   int64_t registerInternalDeviceCallback(DevicesChangedCallbackPtr callback);
   void unregisterDevicesChangedCallback(int64_t cb_id);
 
+  // see Context::setThreadPolicy and Context::setRealtimeMode
+  void setThreadPolicy(ThreadRole role, const ThreadPolicy &policy);
+  void setRealtimeMode(bool enabled);
+
+  // How long a frameset waits for the perception results computed from its images before it is
+  // delivered without them; see FrameSet::isComplete()
+  void setPerceptionWait(uint32_t max_wait_ms);
+  // When a frameset is delivered, FramesetTrigger::MATCHED by default. Framesets being assembled
+  // are dropped on a change.
+  void setFramesetTrigger(FramesetTrigger trigger, FrameId leader = FrameId::LeftCamera, uint32_t period_ms = 40);
+
+  // Attaches a consumer with its own stream filter, queue and delivery, alongside any other. A
+  // CALLBACK subscription needs callback, which receives framesets. Subscriptions outlive stop().
+  Subscription subscribe(const SubscriptionConfig &config, FrameCallbackPtr callback = nullptr);
+
   explicit operator std::shared_ptr<SePipeline>() const { return pipeline_; }
   explicit Pipeline(std::shared_ptr<SePipeline> pipeline) : pipeline_(std::move(pipeline)) {}
 
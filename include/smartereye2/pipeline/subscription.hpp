@@ -0,0 +1,74 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SUBSCRIPTION_HPP
+#define LIBSMARTEREYE2_SUBSCRIPTION_HPP
+
+#include "smartereye2/se_types.hpp"
+#include "smartereye2/se_global.hpp"
+#include "smartereye2/streaming/stream_types.hpp"
+
+namespace se2 {
+
+class FrameSet;
+
+enum class DeliveryMode {
+  CALLBACK,     /**< the callback runs on a thread of the subscription's own */
+  BLOCKING,     /**< framesets are pulled with waitForFrames() or pollForFrames() */
+  LATEST_ONLY,  /**< pulled like BLOCKING, only the newest frameset is kept */
+};
+
+struct SubscriptionConfig {
+  SubscriptionConfig()
+      : streams(0), mode(DeliveryMode::BLOCKING), queue_size(8), policy(BackpressurePolicy::DROP_OLDEST) {}
+  SubscriptionConfig(uint32_t streams, DeliveryMode mode, uint32_t queue_size = 8,
+                     BackpressurePolicy policy = BackpressurePolicy::DROP_OLDEST)
+      : streams(streams), mode(mode), queue_size(queue_size), policy(policy) {}
+
+  uint32_t streams;              /**< FrameId bits, 0 for every stream */
+  DeliveryMode mode;
+  uint32_t queue_size;
+  /** BLOCK_PRODUCER stalls the delivery to every other subscriber as well */
+  BackpressurePolicy policy;
+};
+
+struct SubscriptionStatistics {
+  uint64_t delivered;
+  uint64_t dropped;   /**< by the overflow policy */
+  uint32_t depth;     /**< framesets waiting right now */
+};
+
+// One consumer of a pipeline, see Pipeline::subscribe(). Copies share the subscription, which ends
+// with unsubscribe() or when the last copy is gone.
+class SMARTEREYE2_API Subscription {
+ public:
+  Subscription() = default;
+  explicit Subscription(std::shared_ptr<SeSubscription> subscription) : subscription_(std::move(subscription)) {}
+
+  explicit operator bool() const { return subscription_ != nullptr; }
+
+  FrameSet waitForFrames(uint32_t timeout_ms = 1000) const;
+  bool pollForFrames(FrameSet *frame_set) const;
+  bool tryWaitForFrames(FrameSet *frame_set, uint32_t timeout_ms = 1000) const;
+
+  SubscriptionStatistics statistics() const;
+  void unsubscribe();
+
+ private:
+  std::shared_ptr<SeSubscription> subscription_;
+};
+
+}  // namespace se2
+
+#endif //LIBSMARTEREYE2_SUBSCRIPTION_HPP
@@ -63,9 +63,14 @@ class SMARTEREYE2_API Filter : public ProcessingBlock, public FilterInterface {
   FrameQueue queue_;
 };
 
+// Disparity frames, alone or in a frameset, into Points reprojected with the stream's intrinsics; a
+// frameset comes back with the points added. OptionKey::DECIMATION thins the cloud, MIN_DISTANCE and
+// MAX_DISTANCE zero the points out of range. mapTo() textures the points from a stream registered to the
+// disparity, i.e. the left camera.
 class SMARTEREYE2_API PointCloud : public Filter {
  public:
   PointCloud();
+  // textures from frame_id; index is ignored, there is one stream per FrameId
   explicit PointCloud(FrameId frame_id, int index = 0);
   explicit PointCloud(const std::shared_ptr<SeProcessingBlock> &block);
 
@@ -78,15 +83,22 @@ class SMARTEREYE2_API PointCloud : public Filter {
   std::shared_ptr<SeProcessingBlock> init();
 };
 
+// YUV422, YUV422Planar and RGB565 frames into FrameFormat::Color (BGR) by default, or RGB, RGBA or
+// Gray; other frames pass through. Pick SIMD kernels for the running CPU and split large frames across
+// cores (OptionKey::PROCESSING_THREADS).
 class SMARTEREYE2_API YuvDecoder : public Filter {
  public:
   YuvDecoder();
+  explicit YuvDecoder(FrameFormat output_format);
   explicit YuvDecoder(const std::shared_ptr<SeProcessingBlock> &block);
 
+  VideoFrame decode(Frame frame) const;
+
  private:
   std::shared_ptr<SeProcessingBlock> init();
 };
 
+// Depth16 frames (millimetres) into DepthFloat (metres); other frames pass through.
 class SMARTEREYE2_API UnitsTransform : public Filter {
  public:
   UnitsTransform();
@@ -96,6 +108,16 @@ class SMARTEREYE2_API UnitsTransform : public Filter {
   std::shared_ptr<SeProcessingBlock> init();
 };
 
+enum class ColorScheme {
+  JET,
+  TURBO,
+  GRAYSCALE,
+};
+
+// Disparity frames of any format and depth frames into FrameFormat::Color (BGR) by default, or RGB or
+// RGBA, through a ColorScheme (OptionKey::COLOR_SCHEME) with near at its hot end. The colour range is
+// MIN_DISTANCE..MAX_DISTANCE, fitted to each frame while MAX_DISTANCE is 0, or follows the rank of values
+// with OptionKey::HISTOGRAM_EQUALIZATION.
 class SMARTEREYE2_API Colorizer : public Filter {
  public:
   Colorizer();
@@ -108,6 +130,8 @@ class SMARTEREYE2_API Colorizer : public Filter {
   std::shared_ptr<SeProcessingBlock> init();
 };
 
+// Depth frames into Disparity16, or disparity frames of any format into depth written as Depth16 or DepthFloat
+// (OptionKey::OUTPUT_FORMAT), using bf from the intrinsics of the stream.
 class SMARTEREYE2_API DisparityTransform : public Filter {
  public:
   explicit DisparityTransform(bool transform_to_disparity = true);
@@ -119,6 +143,45 @@ class SMARTEREYE2_API DisparityTransform : public Filter {
   std::shared_ptr<SeProcessingBlock> init(bool transform_to_disparity);
 };
 
+// Raw LeftCamera and RightCamera frames of Gray, Color, RGB or RGBA into an ideal pinhole camera centred in
+// the image and turned to the vehicle's axes by the rotation of the stream's extrinsics (radians; x pitch,
+// y yaw, z roll). The remap tables are fixed-point, built once per calibration. Their profile carries the
+// rectified intrinsics and extrinsics.
+class SMARTEREYE2_API Rectifier : public Filter {
+ public:
+  Rectifier();
+  explicit Rectifier(const std::shared_ptr<SeProcessingBlock> &block);
+
+  VideoFrame rectify(Frame frame) const;
+
+ private:
+  std::shared_ptr<SeProcessingBlock> init();
+};
+
+enum class PyramidFilter {
+  BOX,       /**< mean of each 2x2 block */
+  GAUSSIAN,  /**< 5x5 binomial, like cv::pyrDown */
+};
+
+// Gray, Color, RGB and RGBA frames halved OptionKey::PYRAMID_LEVEL times with a PyramidFilter
+// (OptionKey::PYRAMID_FILTER). A level is computed the first time any Pyramid asks for it and cached on
+// the frame it comes from, so consumers of the same frame share it; it is released with that frame.
+class SMARTEREYE2_API Pyramid : public Filter {
+ public:
+  Pyramid();
+  explicit Pyramid(int level, PyramidFilter filter = PyramidFilter::BOX);
+  explicit Pyramid(const std::shared_ptr<SeProcessingBlock> &block);
+
+  VideoFrame downsample(Frame frame) const;
+
+  // The width x height region at (x, y) of frame, sharing its pixels and stride instead of copying them.
+  // frame stays alive until the crop is released.
+  VideoFrame crop(const VideoFrame &frame, int x, int y, int width, int height) const;
+
+ private:
+  std::shared_ptr<SeProcessingBlock> init();
+};
+
 }
 
 #endif //LIBSMARTEREYE2_FILTER_HPP
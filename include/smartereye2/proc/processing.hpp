@@ -57,6 +57,8 @@ class SMARTEREYE2_API ProcessingBlock : public Options {
   std::string getInfo(CameraInfo info) const;
 
  protected:
+  friend class ProcessingGraph;
+
   void registerSimpleOption(OptionKey option_key, OptionRange range);
 
   std::shared_ptr<SeProcessingBlock> block_;
@@ -0,0 +1,73 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_PROCESSING_GRAPH_HPP
+#define LIBSMARTEREYE2_PROCESSING_GRAPH_HPP
+
+#include <string>
+#include <vector>
+
+#include "processing.hpp"
+#include "smartereye2/se_callbacks.hpp"
+#include "smartereye2/streaming/stream_types.hpp"
+
+namespace se2 {
+
+// frames of one stream, FrameFormat::Any matches every format
+struct StreamType {
+  StreamType(FrameId frame_id, FrameFormat format = FrameFormat::Any) : frame_id(frame_id), format(format) {}
+
+  FrameId frame_id;
+  FrameFormat format;
+};
+
+struct ProcessingNodeStatistics {
+  std::string name;
+  uint32_t depth;         /**< frames waiting for the node right now */
+  uint64_t processed;
+  uint64_t dropped;       /**< queue overflow, the oldest frame goes */
+  double mean_wait_ms;    /**< from queueing until the node picked the frame up */
+  double max_wait_ms;
+  double mean_run_ms;     /**< inside the block */
+  double max_run_ms;
+};
+
+// Runs processing blocks as a dataflow graph on a worker pool. Every frame goes to each node with a
+// matching input, the frames a node outputs go on to the nodes they match in turn. Each node handles
+// one frame at a time, different nodes and different stages of consecutive frames run in parallel.
+// Frames no node takes reach the callback, on a worker thread. Framesets are split into their frames.
+class SMARTEREYE2_API ProcessingGraph {
+ public:
+  // 0 workers for one per hardware thread
+  explicit ProcessingGraph(size_t workers = 0);
+
+  // Returns the node's index. Throws when the node would close a cycle or the graph is running.
+  size_t addNode(const ProcessingBlock &block, const std::vector<StreamType> &inputs,
+                 const std::vector<StreamType> &outputs, uint32_t queue_size = 2);
+
+  void start(FrameCallbackPtr callback);
+  void invoke(Frame frame) const;
+  // waits until every node has drained, false on timeout
+  bool flush(uint32_t timeout_ms = 10000) const;
+  void stop();
+
+  std::vector<ProcessingNodeStatistics> statistics() const;
+
+ private:
+  std::shared_ptr<SeProcessingGraph> graph_;
+};
+
+}  // namespace se2
+
+#endif //LIBSMARTEREYE2_PROCESSING_GRAPH_HPP
@@ -75,6 +75,7 @@ typedef struct SeNotification SeNotification;
 
 typedef struct SeContext SeContext;
 typedef struct SeOptions SeOptions;
+typedef struct SeSharedDeviceServer SeSharedDeviceServer;
 
 namespace libsmartereye2 { class FrameInterface; }
 typedef class libsmartereye2::FrameInterface SeFrame;
@@ -86,9 +87,11 @@ typedef struct SeStreamProfile SeStreamProfile;
 
 typedef struct SePipeline SePipeline;
 typedef struct SePipelineProfile SePipelineProfile;
+typedef struct SeSubscription SeSubscription;
 typedef struct SePipelineConfig SePipelineConfig;
 
 typedef struct SeProcessingBlock SeProcessingBlock;
+typedef struct SeProcessingGraph SeProcessingGraph;
 
 template<class T, int C>
 class SmallHeap {
@@ -22,6 +22,7 @@
 #include "smartereye2/se_global.hpp"
 #include "smartereye2/se_types.hpp"
 #include "smartereye2/core/options.hpp"
+#include "smartereye2/streaming/stream_types.hpp"
 
 namespace se2 {
 
@@ -67,12 +68,22 @@ class SMARTEREYE2_API Sensor : public Options {
   template<typename T>
   void setNotificationCallback(T callback) const {}
 
+  // Frames of one stream reach callback one at a time and in order. Frames of different streams are
+  // delivered by several threads and may reach callback concurrently; OptionKey::CALLBACK_WORKERS set
+  // to 1 serialises all of them.
   template<typename T>
   void start(T callback) const {}
   void stop() const {}
 
   std::vector<StreamProfile> getStreamProfiles() const;
   std::vector<StreamProfile> getActiveStreams() const;
+  // what a full queue between the device and the frame callback does with frames of one stream;
+  // FrameId::NotUsed sets the default and clears every per-stream setting
+  void setBackpressure(FrameId stream, BackpressurePolicy policy, uint32_t queue_size) const;
+  // queueing between the device and the frame callback, one entry per stream delivered so far
+  std::vector<StreamStatistics> getStreamStatistics() const;
+  // how well device timestamps are mapped onto the host clock for GLOBAL_TIME
+  ClockSyncStatistics getClockSyncStatistics() const;
 
  private:
   std::shared_ptr<SeSensor> sensor_;
@@ -68,28 +68,46 @@ constexpr uint32_t operator&(const enum FrameId self_value, const enum FrameId i
 enum class FrameFormat : int {
   Any = -1,
   Gray = 0,
-  Color = 1,
-  YUV422 = 2,
+  Color = 1,          /**< 8-bit BGR */
+  YUV422 = 2,         /**< YUYV */
   RGB565 = 3,
-  YUV422Planar = 4,
+  YUV422Planar = 4,   /**< Y plane, then U and V planes of half width */
+  RGB = 5,
+  RGBA = 6,
   Custom = 65,
-  Disparity7 = 512,
-  Disparity8,
-  Disparity10,
-  Disparity12,
-  DisparitySparse,
-  Disparity16,
+  Disparity7 = 512,   /**< whole pixels, 7 bits per value packed LSB first, rows padded to bytes */
+  Disparity8,         /**< whole pixels, one byte per value */
+  Disparity10,        /**< 2 fractional bits, 10 bits per value packed LSB first, rows padded to bytes */
+  Disparity12,        /**< 4 fractional bits, 12 bits per value packed LSB first, rows padded to bytes */
+  DisparitySparse,    /**< laid out as Disparity16, with disparity only where matching succeeded */
+  Disparity16,        /**< unsigned, 5 fractional bits */
+  Depth16 = 1024,     /**< unsigned millimetres, 0 where unknown */
+  DepthFloat,         /**< float metres, 0 where unknown */
   DefaultFormat = Gray,
 };
 
+// bits per pixel
 static const std::map<FrameFormat, int> kFrameFormat2bpp = {
-    {FrameFormat::Gray, 1},
-    {FrameFormat::Color, 3},
-    {FrameFormat::YUV422, 2},
-    {FrameFormat::YUV422Planar, 2},
-    {FrameFormat::Disparity16, 2}
+    {FrameFormat::Gray, 8},
+    {FrameFormat::Color, 24},
+    {FrameFormat::RGB, 24},
+    {FrameFormat::RGBA, 32},
+    {FrameFormat::YUV422, 16},
+    {FrameFormat::RGB565, 16},
+    {FrameFormat::YUV422Planar, 16},
+    {FrameFormat::Disparity7, 7},
+    {FrameFormat::Disparity8, 8},
+    {FrameFormat::Disparity10, 10},
+    {FrameFormat::Disparity12, 12},
+    {FrameFormat::DisparitySparse, 16},
+    {FrameFormat::Disparity16, 16},
+    {FrameFormat::Depth16, 16},
+    {FrameFormat::DepthFloat, 32}
 };
 
+// a Disparity16 value is the disparity in pixels times 2^kDisparity16FractionBits
+static const int kDisparity16FractionBits = 5;
+
 static int getBppByFormat(FrameFormat format) {
   if (kFrameFormat2bpp.find(format) != kFrameFormat2bpp.end()) {
     return kFrameFormat2bpp.at(format);
@@ -97,6 +115,40 @@ static int getBppByFormat(FrameFormat format) {
   return 0;
 }
 
+// bytes of one unpadded row
+static int getStrideByFormat(FrameFormat format, int width) {
+  return (width * getBppByFormat(format) + 7) / 8;
+}
+
+enum class BackpressurePolicy {
+  LATEST_ONLY,    /**< only the newest undelivered frame is kept, lowest latency */
+  DROP_OLDEST,    /**< a full queue discards its oldest frame */
+  DROP_NEWEST,    /**< a full queue rejects the incoming frame */
+  BLOCK_PRODUCER, /**< a full queue stalls the device reader, which may lose frames on the USB side instead */
+  COUNT
+};
+
+struct StreamStatistics {
+  FrameId frame_id;
+  BackpressurePolicy policy;
+  uint32_t queue_size;
+  uint32_t depth;            /**< frames waiting for the callback right now */
+  uint64_t delivered;
+  uint64_t dropped;          /**< by the backpressure policy */
+  uint64_t shed;             /**< by adaptive shedding */
+  double mean_latency_ms;    /**< from arrival to the start of the callback */
+  double max_latency_ms;
+};
+
+enum class FramesetTrigger {
+  MATCHED,   /**< images of one capture joined by the perception computed from them */
+  LEADER,    /**< one set per frame of the leader stream, with the latest of every other stream */
+  ALL_NEW,   /**< once every stream has delivered since the last set; waits forever on a silent stream */
+  ANY_NEW,   /**< one set per arrival, with the latest of every other stream */
+  PERIODIC,  /**< every period, when anything arrived since the last set */
+  COUNT
+};
+
 #endif
 
 #ifndef FRAMEID_Q_ENUM
@@ -17,6 +17,9 @@
 
 #include "consumer_queue.h"
 #include "dispatcher.h"
+#include "strand_executor.h"
+#include "thread_placement.h"
+#include "timer_queue.h"
 #include "watchdog.h"
 
 #endif //LIBSMARTEREYE2_CONCURRENCY_H
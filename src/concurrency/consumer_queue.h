@@ -15,127 +15,316 @@
 #ifndef LIBSMARTEREYE2_CONSUMER_QUEUE_H
 #define LIBSMARTEREYE2_CONSUMER_QUEUE_H
 
-#include <queue>
-#include <mutex>
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "event_count.h"
 
 namespace libsmartereye2 {
 
 const uint32_t kQueueMaxSize = 256;
 
-template<class T>
+enum class OverflowPolicy {
+  DROP_OLDEST,  // make room by discarding the head, the consumer always sees the freshest items
+  DROP_NEWEST,  // reject the incoming item
+  BLOCK,        // wait for the consumer to make room
+  LATEST_ONLY,  // discard everything still queued, the consumer only ever sees the newest item
+};
+
+enum class ProducerMode {
+  SINGLE,
+  MULTI,
+};
+
+// Bounded ring (Vyukov-style per-cell sequence numbers). Producers never take a lock; with
+// ProducerMode::SINGLE the tail is advanced with a plain store. The head is claimed with a CAS so
+// that clear() and DROP_OLDEST overflow may discard items from any thread, but in steady state only
+// the consumer touches it. Sleeping on either side goes through an EventCount, so hand-offs cost no
+// syscall unless the other side is actually parked.
+template<class T, ProducerMode Mode = ProducerMode::MULTI>
 class ConsumerQueue {
  public:
-  explicit ConsumerQueue(uint32_t capacity = kQueueMaxSize)
-      : queue_(), mutex_(), deq_cv_(), enq_cv_(),
-        capacity_(capacity), need_to_flush_(false), was_flushed_(false), accepting_(true) {
+  explicit ConsumerQueue(uint32_t capacity = kQueueMaxSize, OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+      : capacity_(capacity ? capacity : 1), limit_(capacity_), policy_(policy), head_(0), tail_(0),
+        accepting_(true), need_to_flush_(false), dropped_(0) {
+    size_t cells = 1;
+    while (cells < capacity_) cells <<= 1;
+    mask_ = cells - 1;
+    cells_.reset(new Cell[cells]);
+    for (size_t i = 0; i < cells; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
   }
 
-  void enqueue(T &&item) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (accepting_) {
-      queue_.push_back(std::move(item));
-      if (queue_.size() > capacity_) {
-        queue_.pop_front();
+  ~ConsumerQueue() {
+    T item;
+    while (tryPop(&item)) {}
+  }
+
+  ConsumerQueue(const ConsumerQueue &) = delete;
+  ConsumerQueue &operator=(const ConsumerQueue &) = delete;
+
+  bool enqueue(T &&item) {
+    return enqueue(std::move(item), policy_.load(std::memory_order_relaxed));
+  }
+
+  bool enqueue(T &&item, OverflowPolicy policy) {
+    if (!accepting_.load(std::memory_order_relaxed)) return false;
+
+    if (policy == OverflowPolicy::LATEST_ONLY) {
+      T stale;
+      while (tryPop(&stale)) dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    while (!tryPush(item)) {
+      if (policy == OverflowPolicy::BLOCK) return blockingEnqueue(std::move(item));
+      if (policy == OverflowPolicy::DROP_NEWEST) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
       }
+      T oldest;
+      if (tryPop(&oldest)) dropped_.fetch_add(1, std::memory_order_relaxed);
     }
-    lock.unlock();
-    deq_cv_.notify_one();
+    not_empty_.notifyAll();
+    return true;
   }
 
-  void blockingEnqueue(T &&item) {
-    auto pred = [this]() -> bool { return (queue_.size() < capacity_ || need_to_flush_); };
+  bool blockingEnqueue(T &&item) {
+    if (!accepting_.load(std::memory_order_relaxed)) return false;
 
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (accepting_) {
-      enq_cv_.wait(lock, pred);
-      queue_.push_back(std::move(item));
+    while (!tryPush(item)) {
+      auto key = not_full_.prepareWait();
+      if (tryPush(item)) {
+        not_full_.cancelWait();
+        break;
+      }
+      if (need_to_flush_.load(std::memory_order_relaxed)) {
+        not_full_.cancelWait();
+        return false;
+      }
+      not_full_.wait(key, kParkSliceMs);
     }
-    lock.unlock();
-    deq_cv_.notify_one();
+    not_empty_.notifyAll();
+    return true;
   }
 
   bool dequeue(T *item, uint32_t timeout_ms) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    accepting_ = true;
-    was_flushed_ = true;
-    const auto ready = [this]() -> bool { return queue_.size() > 0 || need_to_flush_; };
-    if (!ready() && !deq_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
-      return false;
+    reopen();
+    if (tryPop(item)) {
+      not_full_.notifyAll();
+      return true;
     }
 
-    if (queue_.size() <= 0) return false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!need_to_flush_.load(std::memory_order_relaxed)) {
+      auto key = not_empty_.prepareWait();
+      if (tryPop(item)) {
+        not_empty_.cancelWait();
+        not_full_.notifyAll();
+        return true;
+      }
+      if (need_to_flush_.load(std::memory_order_relaxed)) {
+        not_empty_.cancelWait();
+        break;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        not_empty_.cancelWait();
+        break;
+      }
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+      not_empty_.wait(key, static_cast<uint32_t>(left > 0 ? left : 1));
+    }
 
-    *item = std::move(queue_.front());
-    queue_.pop_front();
-    enq_cv_.notify_one();
+    if (!tryPop(item)) return false;
+    not_full_.notifyAll();
     return true;
   }
 
-  bool tryDequeue(T *item) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    accepting_ = true;
-    if (!queue_.empty()) {
-      auto val = std::move(queue_.front());
-      queue_.pop_front();
-      *item = std::move(val);
-      enq_cv_.notify_one();
-      return true;
+  // Moves up to max_count items into items[] with a single claim on the head.
+  size_t dequeueBatch(T *items, size_t max_count, uint32_t timeout_ms) {
+    auto count = tryDequeueBatch(items, max_count);
+    if (count > 0 || max_count == 0) return count;
+    if (!dequeue(items, timeout_ms)) return 0;
+    return 1 + tryDequeueBatch(items + 1, max_count - 1);
+  }
+
+  size_t tryDequeueBatch(T *items, size_t max_count) {
+    reopen();
+    auto pos = head_.load(std::memory_order_relaxed);
+    size_t count;
+    for (;;) {
+      count = 0;
+      while (count < max_count
+          && cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire) == pos + count + 1) {
+        ++count;
+      }
+      if (count == 0) return 0;
+      if (head_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      auto &cell = cells_[(pos + i) & mask_];
+      items[i] = std::move(*cell.item());
+      cell.item()->~T();
+      cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
     }
-    return false;
+    not_full_.notifyAll();
+    return count;
+  }
+
+  bool tryDequeue(T *item) {
+    reopen();
+    if (!tryPop(item)) return false;
+    not_full_.notifyAll();
+    return true;
   }
 
   void popFront() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (!queue_.empty()) queue_.pop_front();
+    T item;
+    if (tryPop(&item)) not_full_.notifyAll();
   }
 
+  // The pointer stays valid only while no other thread pops, i.e. callers must serialize with their
+  // producers when DROP_OLDEST may kick in.
   bool peek(T **item) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (queue_.empty()) return false;
-    *item = &queue_.front();
+    auto pos = head_.load(std::memory_order_relaxed);
+    auto &cell = cells_[pos & mask_];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+    *item = cell.item();
     return true;
   }
 
   void clear() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    accepting_ = false;
-    need_to_flush_ = true;
-    enq_cv_.notify_all();
-    while (!queue_.empty()) {
-      auto item = std::move(queue_.front());
-      queue_.pop_front();
-    }
-    deq_cv_.notify_all();
+    accepting_.store(false, std::memory_order_relaxed);
+    need_to_flush_.store(true, std::memory_order_relaxed);
+    not_full_.notifyAll();
+    T item;
+    while (tryPop(&item)) {}
+    not_empty_.notifyAll();
   }
 
   void start() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    need_to_flush_ = false;
-    accepting_ = true;
+    need_to_flush_.store(false, std::memory_order_relaxed);
+    accepting_.store(true, std::memory_order_relaxed);
   }
 
   size_t size() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return queue_.size();
+    auto head = head_.load(std::memory_order_acquire);
+    auto tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? static_cast<size_t>(tail - head) : 0;
+  }
+
+  uint32_t capacity() const { return capacity_; }
+
+  // how many of the capacity() cells producers may fill, adjustable while running
+  uint32_t limit() const { return limit_.load(std::memory_order_relaxed); }
+  void setLimit(uint32_t limit) {
+    limit_.store(limit == 0 ? 1 : (limit < capacity_ ? limit : capacity_), std::memory_order_relaxed);
   }
 
+  OverflowPolicy policy() const { return policy_.load(std::memory_order_relaxed); }
+
+  void setPolicy(OverflowPolicy policy) { policy_.store(policy, std::memory_order_relaxed); }
+
+  // items discarded by the overflow policy since construction
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
  private:
-  std::deque<T> queue_;
-  mutable std::mutex mutex_;
-  std::condition_variable deq_cv_; // not empty signal
-  std::condition_variable enq_cv_; // not full signal
+  static const uint32_t kParkSliceMs = 100;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
 
-  uint32_t capacity_;
-  bool accepting_;
+    T *item() { return reinterpret_cast<T *>(&storage); }
+  };
 
-  // flush mechanism is required to abort wait on cv
-  // when need to stop
+  bool tryPush(T &item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      auto used = static_cast<intptr_t>(pos - head_.load(std::memory_order_acquire));
+      if (used >= static_cast<intptr_t>(limit_.load(std::memory_order_relaxed))) return false;
+      cell = &cells_[pos & mask_];
+      auto seq = cell->sequence.load(std::memory_order_acquire);
+      auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (dif == 0) {
+        if (Mode == ProducerMode::SINGLE) {
+          tail_.store(pos + 1, std::memory_order_relaxed);
+          break;
+        }
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (dif < 0) {
+        // below the limit, so a consumer has claimed the cell's previous item and is still moving it out;
+        // the queue is not full, and DROP_OLDEST must not discard anything for it
+        std::this_thread::yield();
+        pos = tail_.load(std::memory_order_relaxed);
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    new(cell->item()) T(std::move(item));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T *item) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      auto seq = cell->sequence.load(std::memory_order_acquire);
+      auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (dif == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    *item = std::move(*cell->item());
+    cell->item()->~T();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // a cleared queue starts accepting again once its consumer comes back, as it always did
+  void reopen() {
+    if (!accepting_.load(std::memory_order_relaxed)) accepting_.store(true, std::memory_order_relaxed);
+  }
+
+  const uint32_t capacity_;
+  std::atomic<uint32_t> limit_;
+  std::atomic<OverflowPolicy> policy_;
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // head and tail are written by different threads, keep them off each other's cache line
+  char pad0_[64];
+  std::atomic<size_t> head_;
+  char pad1_[64];
+  std::atomic<size_t> tail_;
+  char pad2_[64];
+
+  std::atomic<bool> accepting_;
+  // flush mechanism is required to abort waits when need to stop
   std::atomic<bool> need_to_flush_;
-  std::atomic<bool> was_flushed_;
+  std::atomic<uint64_t> dropped_;
+
+  EventCount not_empty_;
+  EventCount not_full_;
 };
 
+template<class T>
+using SpscQueue = ConsumerQueue<T, ProducerMode::SINGLE>;
+
 }  // namespace libsmartereye2
 
 #endif //LIBSMARTEREYE2_CONSUMER_QUEUE_H
@@ -14,19 +14,42 @@
 
 #include "dispatcher.h"
 
+#include <limits>
+
 namespace libsmartereye2 {
 
-Dispatcher::Dispatcher(unsigned int cap)
+Dispatcher::Dispatcher(unsigned int cap, ThreadRole role, const char *name)
     : queue_(cap),
+      heap_tasks_(0),
       was_stopped_(true),
       was_flushed_(false),
       is_alive_(true) {
-  thread_ = std::thread([&]() {
-    int timeout_ms = 5000;
+  thread_ = std::thread([this, role, name]() {
+    ThreadPlacement::Scope placement(role, name);
+    Task items[kDispatchBatch];
     while (is_alive_) {
-      std::function<void(CancellableTimer)> item;
+      // a stopped dispatcher parks here instead of spinning on its flushed queue
+      {
+        std::unique_lock<std::mutex> lock(was_stopped_mutex_);
+        if (was_stopped_ && is_alive_) {
+          {
+            std::lock_guard<std::mutex> flushed(was_flushed_mutex_);
+            was_flushed_ = true;
+            was_flushed_cv_.notify_all();
+          }
+          was_stopped_cv_.wait(lock, [this]() { return !was_stopped_ || !is_alive_; });
+        }
+      }
+      if (!is_alive_) break;
+
+      // stop() and the destructor wake the wait, there is nothing to poll for
+      auto count = queue_.dequeueBatch(items, kDispatchBatch, std::numeric_limits<uint32_t>::max());
+      for (size_t i = 0; i < count; ++i) {
+        // the whole batch runs, as each task would have had it been taken alone; stop() only drops what
+        // is still queued
+        auto item = std::move(items[i]);
+        items[i] = nullptr;
 
-      if (queue_.dequeue(&item, timeout_ms)) {
         CancellableTimer time(this);
 
         try {
@@ -48,30 +71,35 @@ void Dispatcher::start() {
   was_stopped_ = false;
 
   queue_.start();
+  was_stopped_cv_.notify_all();
 }
 
 void Dispatcher::stop() {
   {
     std::unique_lock<std::mutex> lock(was_stopped_mutex_);
+    // the worker is already parked
+    if (was_stopped_) return;
     was_stopped_ = true;
     was_stopped_cv_.notify_all();
-  }
-
-  queue_.clear();
 
-  {
-    std::unique_lock<std::mutex> lock(was_flushed_mutex_);
+    std::lock_guard<std::mutex> flushed(was_flushed_mutex_);
     was_flushed_ = false;
   }
 
+  queue_.clear();
+
   std::unique_lock<std::mutex> lock_was_flushed(was_flushed_mutex_);
   was_flushed_cv_.wait_for(lock_was_flushed, std::chrono::hours(999999), [&]() { return was_flushed_.load(); });
 }
 
 Dispatcher::~Dispatcher() {
   stop();
+  {
+    std::lock_guard<std::mutex> lock(was_stopped_mutex_);
+    is_alive_ = false;
+    was_stopped_cv_.notify_all();
+  }
   queue_.clear();
-  is_alive_ = false;
   thread_.join();
 }
 
@@ -21,8 +21,11 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
 
 #include "consumer_queue.h"
+#include "task.h"
+#include "thread_placement.h"
 
 namespace libsmartereye2 {
 
@@ -45,35 +48,31 @@ class Dispatcher {
     Dispatcher *owner_;
   };
 
-  explicit Dispatcher(unsigned int cap);
+  using Task = InlineTask<void(CancellableTimer)>;
+
+  explicit Dispatcher(unsigned int cap, ThreadRole role = ThreadRole::DISPATCHER, const char *name = "se2-dispatch");
 
   template<class T>
   void invoke(T item, bool is_blocking = false) {
     if (!was_stopped_) {
+      Task task(std::move(item));
+      if (!task.isInline()) heap_tasks_.fetch_add(1, std::memory_order_relaxed);
       if (is_blocking)
-        queue_.blockingEnqueue(std::move(item));
+        queue_.blockingEnqueue(std::move(task));
       else
-        queue_.enqueue(std::move(item));
+        queue_.enqueue(std::move(task));
     }
   }
 
+  // never waits and never evicts a queued task: false when the queue is full or the dispatcher stopped
   template<class T>
-  void invoke_and_wait(T item, std::function<bool()> exit_condition, bool is_blocking = false) {
-    bool done = false;
-
-    //action
-    auto func = std::move(item);
-    invoke([&, func](Dispatcher::CancellableTimer c) {
-      func(c);
-      done = true;
-      blocking_invoke_cv_.notify_one();
-    }, is_blocking);
-
-    //wait
-    std::unique_lock<std::mutex> lk(blocking_invoke_mutex_);
-    while (blocking_invoke_cv_.wait_for(lk,
-                                        std::chrono::milliseconds(10),
-                                        [&]() { return !done && !exit_condition(); }));
+  bool tryInvoke(T item) {
+    if (was_stopped_) return false;
+    Task task(std::move(item));
+    auto on_heap = !task.isInline();
+    if (!queue_.enqueue(std::move(task), OverflowPolicy::DROP_NEWEST)) return false;
+    if (on_heap) heap_tasks_.fetch_add(1, std::memory_order_relaxed);
+    return true;
   }
 
   void start();
@@ -84,11 +83,17 @@ class Dispatcher {
   bool flush();
   bool empty() const { return queue_.size() == 0; }
 
+  // tasks whose captures did not fit inline and had to be heap allocated
+  uint64_t heapAllocations() const { return heap_tasks_.load(std::memory_order_relaxed); }
+
  private:
   friend CancellableTimer;
 
-  ConsumerQueue<std::function<void(CancellableTimer)>> queue_;
+  static const size_t kDispatchBatch = 16;
+
+  ConsumerQueue<Task> queue_;
   std::thread thread_;
+  std::atomic<uint64_t> heap_tasks_;
 
   std::atomic<bool> was_stopped_;
   std::condition_variable was_stopped_cv_;
@@ -98,50 +103,9 @@ class Dispatcher {
   std::condition_variable was_flushed_cv_;
   std::mutex was_flushed_mutex_;
 
-  std::condition_variable blocking_invoke_cv_;
-  std::mutex blocking_invoke_mutex_;
-
   std::atomic<bool> is_alive_;
 };
 
-template<class T = std::function<void(Dispatcher::CancellableTimer)>>
-class RepeatOperation {
- public:
-  explicit RepeatOperation(T operation)
-      : operation_(std::move(operation)), dispatcher_(1), stopped_(true) {
-  }
-
-  void start() {
-    stopped_ = false;
-    dispatcher_.start();
-
-    loop();
-  }
-
-  void stop() {
-    stopped_ = true;
-    dispatcher_.stop();
-  }
-
-  ~RepeatOperation() {
-    stop();
-  }
-
- private:
-  void loop() {
-    dispatcher_.invoke([this](Dispatcher::CancellableTimer ct) {
-      operation_(ct);
-      if (!stopped_) {
-        loop();
-      }
-    });
-  }
-
-  T operation_;
-  Dispatcher dispatcher_;
-  std::atomic<bool> stopped_;
-};
-
 }  // namespace libsmartereye2
 
 #endif //LIBSMARTEREYE2_DISPATCHER_H
@@ -0,0 +1,68 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_EVENT_COUNT_H
+#define LIBSMARTEREYE2_EVENT_COUNT_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+namespace libsmartereye2 {
+
+// Lets a thread sleep until some lock-free condition may have changed. The low bit of epoch_ says
+// somebody armed a wait since the last notification: notifiers only pay an atomic load unless it is
+// set, and at most one of them issues the wake. On Linux the sleep itself is a futex on epoch_.
+//
+//   auto key = ec.prepareWait();
+//   if (condition()) { ec.cancelWait(); ... } else { ec.wait(key, timeout_ms); }
+class EventCount {
+ public:
+  EventCount() : epoch_(0) {}
+
+  uint32_t prepareWait() {
+    return epoch_.fetch_or(1, std::memory_order_seq_cst) | 1;
+  }
+
+  // an armed epoch only costs the next notifier one wake call, nothing to undo
+  void cancelWait() {}
+
+  // false on timeout
+  bool wait(uint32_t key, uint32_t timeout_ms);
+
+  void notifyAll() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto epoch = epoch_.load(std::memory_order_relaxed);
+    while (epoch & 1) {
+      if (epoch_.compare_exchange_weak(epoch, epoch + 1, std::memory_order_seq_cst)) {
+        wake();
+        return;
+      }
+    }
+  }
+
+ private:
+  void wake();
+
+  std::atomic<uint32_t> epoch_;
+#ifndef __linux__
+  std::mutex mutex_;
+  std::condition_variable cv_;
+#endif
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_EVENT_COUNT_H
@@ -0,0 +1,119 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "row_workers.h"
+
+#include <algorithm>
+
+#include "thread_placement.h"
+
+namespace libsmartereye2 {
+
+RowWorkers &RowWorkers::shared() {
+  static RowWorkers workers;
+  return workers;
+}
+
+RowWorkers::RowWorkers()
+    : stopping_(false) {
+  auto cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < cores; ++i) {
+    workers_.emplace_back(&RowWorkers::work, this);
+  }
+}
+
+RowWorkers::~RowWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) worker.join();
+  }
+}
+
+void RowWorkers::run(int rows, int min_rows, size_t threads, const std::function<void(int, int)> &fn) {
+  if (rows <= 0) return;
+  auto limit = threads ? std::min(threads, concurrency()) : concurrency();
+  auto stripes = static_cast<int>(std::min<size_t>(limit, static_cast<size_t>(rows / std::max(min_rows, 1))));
+  if (stripes <= 1) {
+    fn(0, rows);
+    return;
+  }
+
+  Job job;
+  job.fn = &fn;
+  job.rows = rows;
+  job.stripes = stripes;
+  job.next = 0;
+  job.done = 0;
+  job.helpers = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(&job);
+  }
+  work_cv_.notify_all();
+
+  runStripes(&job);
+
+  // the job lives on this stack, so wait for every worker to let go of it as well
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&job] { return job.done == job.stripes && job.helpers == 0; });
+  auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+  if (it != jobs_.end()) jobs_.erase(it);
+}
+
+void RowWorkers::runStripes(Job *job) {
+  int finished = 0;
+  for (;;) {
+    auto stripe = job->next.fetch_add(1, std::memory_order_relaxed);
+    if (stripe >= job->stripes) break;
+    auto begin = static_cast<int>(static_cast<int64_t>(job->rows) * stripe / job->stripes);
+    auto end = static_cast<int>(static_cast<int64_t>(job->rows) * (stripe + 1) / job->stripes);
+    (*job->fn)(begin, end);
+    ++finished;
+  }
+  if (finished) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->done += finished;
+  }
+}
+
+void RowWorkers::work() {
+  ThreadPlacement::Scope placement(ThreadRole::PROCESSING, "se2-rows");
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // jobs whose stripes are all claimed leave the queue, their callers finish them
+    while (!jobs_.empty() && jobs_.front()->next.load(std::memory_order_relaxed) >= jobs_.front()->stripes) {
+      jobs_.pop_front();
+    }
+    if (stopping_) return;
+    if (jobs_.empty()) {
+      work_cv_.wait(lock);
+      continue;
+    }
+
+    auto job = jobs_.front();
+    ++job->helpers;
+    lock.unlock();
+    runStripes(job);
+    lock.lock();
+    --job->helpers;
+    if (job->done == job->stripes && job->helpers == 0) done_cv_.notify_all();
+  }
+}
+
+}  // namespace libsmartereye2
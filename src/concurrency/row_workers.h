@@ -0,0 +1,68 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_ROW_WORKERS_H
+#define LIBSMARTEREYE2_ROW_WORKERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libsmartereye2 {
+
+// A process-wide pool that splits one image operation into horizontal stripes. The calling thread
+// works on stripes of its own job as well, so small images or a single core cost no hand-off, and
+// several callers (e.g. nodes of a processing graph) may run jobs at the same time.
+class RowWorkers {
+ public:
+  static RowWorkers &shared();
+
+  // Runs fn(begin, end) over [0, rows) in stripes of at least min_rows rows, on at most threads
+  // threads (0 for every core), and returns when all stripes are done. fn must not throw.
+  void run(int rows, int min_rows, size_t threads, const std::function<void(int, int)> &fn);
+
+  // threads a job can use, the caller included
+  size_t concurrency() const { return workers_.size() + 1; }
+
+ private:
+  struct Job {
+    const std::function<void(int, int)> *fn;
+    int rows;
+    int stripes;
+    std::atomic<int> next;
+    int done;     // under mutex_
+    int helpers;  // workers inside runStripes(), under mutex_
+  };
+
+  RowWorkers();
+  ~RowWorkers();
+
+  void work();
+  void runStripes(Job *job);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::deque<Job *> jobs_;
+  bool stopping_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_ROW_WORKERS_H
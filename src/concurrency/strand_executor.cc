@@ -0,0 +1,253 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "strand_executor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+// tasks a worker takes from one strand before it gives the other strands a turn
+static const size_t kStrandBatch = 8;
+
+static int64_t steadyNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StrandExecutor::StrandExecutor(size_t workers, uint32_t strand_capacity, ThreadRole role, const char *name)
+    : strand_capacity_(std::min<uint32_t>(strand_capacity, uint32_t(kMaxStrandCapacity))),
+      default_policy_(OverflowPolicy::DROP_OLDEST),
+      adaptive_shedding_(false),
+      ready_(kMaxStrands + static_cast<uint32_t>(workers), OverflowPolicy::BLOCK),
+      is_alive_(true),
+      accepting_(false),
+      running_(0),
+      heap_tasks_(0),
+      idle_waiters_(0) {
+  for (auto &key : keys_) {
+    key.store(0, std::memory_order_relaxed);
+  }
+
+  workers = workers ? workers : 1;
+  for (size_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this, role, name]() {
+      ThreadPlacement::Scope placement(role, name);
+      while (is_alive_) {
+        Strand *strand = nullptr;
+        // the destructor wakes every worker with a nullptr, there is nothing to poll for
+        if (ready_.dequeue(&strand, std::numeric_limits<uint32_t>::max()) && strand) {
+          run(strand);
+        }
+      }
+    });
+  }
+}
+
+StrandExecutor::~StrandExecutor() {
+  stop();
+  is_alive_ = false;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    ready_.blockingEnqueue(nullptr);
+  }
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+bool StrandExecutor::post(uint32_t key, Task task, bool is_blocking) {
+  if (!accepting_.load(std::memory_order_relaxed)) return false;
+
+  auto s = strand(key);
+  if (!s) return false;
+  if (!task.isInline()) heap_tasks_.fetch_add(1, std::memory_order_relaxed);
+
+  if (adaptive_shedding_.load(std::memory_order_relaxed) && s->sheddable.load(std::memory_order_relaxed)
+      && s->tasks.size() > 0 && fallingBehind()) {
+    Queued stale;
+    while (s->tasks.tryDequeue(&stale)) s->shed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Queued item{std::move(task), steadyNowNs()};
+  auto queued = is_blocking ? s->tasks.blockingEnqueue(std::move(item)) : s->tasks.enqueue(std::move(item));
+  schedule(s);
+  return queued;
+}
+
+void StrandExecutor::configure(uint32_t key, OverflowPolicy policy, uint32_t limit) {
+  auto s = strand(key);
+  if (!s) return;
+  s->tasks.setPolicy(policy);
+  s->tasks.setLimit(limit);
+}
+
+void StrandExecutor::setDefaults(OverflowPolicy policy, uint32_t limit) {
+  {
+    std::lock_guard<std::mutex> lock(strands_mutex_);
+    default_policy_ = policy;
+    strand_capacity_ = std::min<uint32_t>(std::max(limit, 1u), uint32_t(kMaxStrandCapacity));
+  }
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    if (!keys_[i].load(std::memory_order_acquire)) continue;
+    strands_[i]->tasks.setPolicy(policy);
+    strands_[i]->tasks.setLimit(limit);
+  }
+}
+
+void StrandExecutor::setSheddable(uint32_t key, bool sheddable) {
+  auto s = strand(key);
+  if (s) s->sheddable = sheddable;
+}
+
+bool StrandExecutor::fallingBehind() const {
+  size_t queued = 0;
+  const size_t threshold = 2 * workers_.size();
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    if (!keys_[i].load(std::memory_order_acquire)) continue;
+    queued += strands_[i]->tasks.size();
+    if (queued > threshold) return true;
+  }
+  return false;
+}
+
+void StrandExecutor::start() {
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    if (keys_[i].load(std::memory_order_acquire)) strands_[i]->tasks.start();
+  }
+  accepting_ = true;
+}
+
+void StrandExecutor::stop() {
+  accepting_ = false;
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    if (!keys_[i].load(std::memory_order_acquire)) continue;
+    auto &tasks = strands_[i]->tasks;
+    if (tasks.dropped() > 0) {
+      LOG(DEBUG) << "strand " << strands_[i]->key << " dropped " << tasks.dropped() << " tasks";
+    }
+    tasks.clear();
+  }
+
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  ++idle_waiters_;
+  idle_cv_.wait(lock, [this]() { return running_.load() == 0; });
+  --idle_waiters_;
+}
+
+bool StrandExecutor::flush(uint32_t timeout_ms) {
+  auto drained = [this]() {
+    if (running_.load() != 0) return false;
+    for (size_t i = 0; i < kMaxStrands; ++i) {
+      if (keys_[i].load(std::memory_order_acquire) && strands_[i]->tasks.size() > 0) return false;
+    }
+    return true;
+  };
+
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  ++idle_waiters_;
+  auto ok = idle_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), drained);
+  --idle_waiters_;
+  return ok;
+}
+
+std::vector<StrandExecutor::StrandStats> StrandExecutor::stats() const {
+  std::vector<StrandStats> results;
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    if (!keys_[i].load(std::memory_order_acquire)) continue;
+    auto &s = strands_[i];
+    results.push_back({s->key, s->tasks.policy(), s->tasks.limit(), s->tasks.size(),
+                       s->delivered.load(), s->tasks.dropped(), s->shed.load(),
+                       s->latency_total_ns.load(), s->latency_max_ns.load()});
+  }
+  return results;
+}
+
+StrandExecutor::Strand *StrandExecutor::strand(uint32_t key) {
+  const uint64_t tagged = static_cast<uint64_t>(key) + 1;
+  auto start = static_cast<size_t>(key * 2654435761u) % kMaxStrands;
+
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    auto slot = (start + i) % kMaxStrands;
+    auto k = keys_[slot].load(std::memory_order_acquire);
+    if (k == tagged) return strands_[slot].get();
+    if (k == 0) break;
+  }
+
+  std::lock_guard<std::mutex> lock(strands_mutex_);
+  for (size_t i = 0; i < kMaxStrands; ++i) {
+    auto slot = (start + i) % kMaxStrands;
+    auto k = keys_[slot].load(std::memory_order_relaxed);
+    if (k == tagged) return strands_[slot].get();
+    if (k == 0) {
+      strands_[slot].reset(new Strand(key, default_policy_, strand_capacity_));
+      keys_[slot].store(tagged, std::memory_order_release);
+      return strands_[slot].get();
+    }
+  }
+
+  LOG(ERROR) << "StrandExecutor ran out of strands, dropping task for key " << key;
+  return nullptr;
+}
+
+void StrandExecutor::schedule(Strand *strand) {
+  if (!strand->scheduled.exchange(true, std::memory_order_acq_rel)) {
+    ready_.blockingEnqueue(std::move(strand));
+  }
+}
+
+void StrandExecutor::run(Strand *strand) {
+  running_.fetch_add(1);
+
+  Queued batch[kStrandBatch];
+  auto count = strand->tasks.tryDequeueBatch(batch, kStrandBatch);
+  for (size_t i = 0; i < count; ++i) {
+    auto task = std::move(batch[i].task);
+    batch[i].task = nullptr;
+    if (!accepting_.load(std::memory_order_relaxed)) continue;
+
+    auto latency = static_cast<uint64_t>(std::max<int64_t>(0, steadyNowNs() - batch[i].enqueued_ns));
+    strand->delivered.fetch_add(1, std::memory_order_relaxed);
+    strand->latency_total_ns.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > strand->latency_max_ns.load(std::memory_order_relaxed)) {
+      strand->latency_max_ns.store(latency, std::memory_order_relaxed);
+    }
+    try {
+      task();
+    }
+    catch (const std::exception &e) {
+      LOG(ERROR) << "strand " << strand->key << " task threw: " << e.what();
+    }
+    catch (...) {}
+  }
+
+  // an exchange rather than a store: a producer that still saw scheduled == true published its task
+  // before our read, so the size() check below cannot miss it
+  strand->scheduled.exchange(false, std::memory_order_acq_rel);
+  if (strand->tasks.size() > 0) schedule(strand);
+
+  running_.fetch_sub(1);
+  notifyIdle();
+}
+
+void StrandExecutor::notifyIdle() {
+  if (idle_waiters_.load() == 0) return;
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  idle_cv_.notify_all();
+}
+
+}  // namespace libsmartereye2
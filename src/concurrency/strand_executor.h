@@ -0,0 +1,137 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_STRAND_EXECUTOR_H
+#define LIBSMARTEREYE2_STRAND_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "consumer_queue.h"
+#include "task.h"
+#include "thread_placement.h"
+
+namespace libsmartereye2 {
+
+// Worker pool where every key (typically a stream) is a strand: tasks posted to the same strand run
+// one at a time and in order, tasks of different strands run in parallel. A slow consumer of one
+// stream therefore only backs up its own strand.
+class StrandExecutor {
+ public:
+  using Task = InlineTask<void()>;
+
+  struct StrandStats {
+    uint32_t key;
+    OverflowPolicy policy;
+    uint32_t limit;
+    size_t depth;
+    uint64_t delivered;
+    uint64_t dropped;  // by the overflow policy
+    uint64_t shed;     // by adaptive shedding
+    uint64_t latency_total_ns;  // queued until the task started, summed over delivered tasks
+    uint64_t latency_max_ns;
+  };
+
+  explicit StrandExecutor(size_t workers, uint32_t strand_capacity = kDefaultStrandCapacity,
+                          ThreadRole role = ThreadRole::CALLBACK, const char *name = "se2-callback");
+  ~StrandExecutor();
+
+  StrandExecutor(const StrandExecutor &) = delete;
+  StrandExecutor &operator=(const StrandExecutor &) = delete;
+
+  // false when the strand's policy rejected the task or the executor is stopped; is_blocking waits
+  // for room whatever the policy
+  bool post(uint32_t key, Task task, bool is_blocking = false);
+
+  // policy and queue limit of one strand, or with setDefaults() of every strand present and future
+  void configure(uint32_t key, OverflowPolicy policy, uint32_t limit);
+  void setDefaults(OverflowPolicy policy, uint32_t limit);
+  // While the workers fall behind (more tasks queued than twice the workers), a sheddable strand keeps
+  // only its newest task, so that the other strands get the workers first.
+  void setSheddable(uint32_t key, bool sheddable);
+  void setAdaptiveShedding(bool enabled) { adaptive_shedding_ = enabled; }
+
+  void start();
+  // drops whatever is still queued and waits for running tasks to return
+  void stop();
+  // waits until every strand has drained, false on timeout
+  bool flush(uint32_t timeout_ms = 10000);
+
+  size_t workerCount() const { return workers_.size(); }
+  // tasks whose captures did not fit inline and had to be heap allocated
+  uint64_t heapAllocations() const { return heap_tasks_.load(std::memory_order_relaxed); }
+  std::vector<StrandStats> stats() const;
+
+  static const uint32_t kDefaultStrandCapacity = 32;
+  static const uint32_t kMaxStrandCapacity = 256;
+  static const size_t kMaxStrands = 64;
+
+ private:
+  struct Queued {
+    Task task;
+    int64_t enqueued_ns;
+  };
+
+  struct Strand {
+    Strand(uint32_t key, OverflowPolicy policy, uint32_t limit)
+        : key(key), tasks(kMaxStrandCapacity, policy), scheduled(false), sheddable(false),
+          delivered(0), shed(0), latency_total_ns(0), latency_max_ns(0) {
+      tasks.setLimit(limit);
+    }
+
+    uint32_t key;
+    ConsumerQueue<Queued> tasks;
+    std::atomic<bool> scheduled;
+    std::atomic<bool> sheddable;
+    // written by whichever worker holds the strand, one at a time
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> shed;
+    std::atomic<uint64_t> latency_total_ns;
+    std::atomic<uint64_t> latency_max_ns;
+  };
+
+  Strand *strand(uint32_t key);
+  bool fallingBehind() const;
+  void schedule(Strand *strand);
+  void run(Strand *strand);
+  void notifyIdle();
+
+  std::atomic<uint32_t> strand_capacity_;
+  std::atomic<OverflowPolicy> default_policy_;
+  std::atomic<bool> adaptive_shedding_;
+  std::vector<std::thread> workers_;
+  ConsumerQueue<Strand *> ready_;
+  std::atomic<bool> is_alive_;
+  std::atomic<bool> accepting_;
+  std::atomic<int> running_;
+  std::atomic<uint64_t> heap_tasks_;
+
+  // open addressing, written under strands_mutex_ and read without it; strands live as long as the executor
+  std::atomic<uint64_t> keys_[kMaxStrands];
+  std::unique_ptr<Strand> strands_[kMaxStrands];
+  std::mutex strands_mutex_;
+
+  std::atomic<int> idle_waiters_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_STRAND_EXECUTOR_H
@@ -0,0 +1,143 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_TASK_H
+#define LIBSMARTEREYE2_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace libsmartereye2 {
+
+// enough for `this` plus a FrameHolder, or a serial command with a small payload
+const size_t kTaskInlineSize = 64;
+
+template<class Signature, size_t InlineSize = kTaskInlineSize>
+class InlineTask;
+
+// Move-only replacement for std::function on the dispatch paths. Callables that fit InlineSize and
+// are nothrow-movable live inside the task; anything else is heap allocated, which isInline() reports
+// so that the owning queue can count it.
+template<class R, class... Args, size_t InlineSize>
+class InlineTask<R(Args...), InlineSize> {
+ public:
+  InlineTask() : ops_(nullptr) {}
+  InlineTask(std::nullptr_t) : ops_(nullptr) {}
+
+  template<class F, class = typename std::enable_if<
+      !std::is_same<typename std::decay<F>::type, InlineTask>::value>::type>
+  InlineTask(F &&f) : ops_(nullptr) {
+    using Callable = typename std::decay<F>::type;
+    emplace<Callable>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Callable>()>());
+  }
+
+  InlineTask(InlineTask &&other) noexcept : ops_(nullptr) {
+    moveFrom(other);
+  }
+
+  InlineTask &operator=(InlineTask &&other) noexcept {
+    if (this != &other) {
+      reset();
+      moveFrom(other);
+    }
+    return *this;
+  }
+
+  InlineTask &operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+
+  ~InlineTask() { reset(); }
+
+  R operator()(Args... args) {
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  bool isInline() const { return ops_ == nullptr || ops_->is_inline; }
+
+ private:
+  struct Ops {
+    R (*invoke)(void *, Args &&...);
+    void (*move)(void *dst, void *src);
+    void (*destroy)(void *);
+    bool is_inline;
+  };
+
+  template<class F>
+  static constexpr bool fitsInline() {
+    return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible<F>::value;
+  }
+
+  template<class F>
+  struct InlineOps {
+    static R invoke(void *s, Args &&... args) { return (*static_cast<F *>(s))(std::forward<Args>(args)...); }
+    static void move(void *dst, void *src) {
+      new(dst) F(std::move(*static_cast<F *>(src)));
+      static_cast<F *>(src)->~F();
+    }
+    static void destroy(void *s) { static_cast<F *>(s)->~F(); }
+  };
+
+  template<class F>
+  struct HeapOps {
+    static R invoke(void *s, Args &&... args) { return (**static_cast<F **>(s))(std::forward<Args>(args)...); }
+    static void move(void *dst, void *src) { *static_cast<F **>(dst) = *static_cast<F **>(src); }
+    static void destroy(void *s) { delete *static_cast<F **>(s); }
+  };
+
+  template<class F, class G>
+  void emplace(G &&f, std::true_type) {
+    static const Ops ops = {&InlineOps<F>::invoke, &InlineOps<F>::move, &InlineOps<F>::destroy, true};
+    new(&storage_) F(std::forward<G>(f));
+    ops_ = &ops;
+  }
+
+  template<class F, class G>
+  void emplace(G &&f, std::false_type) {
+    static const Ops ops = {&HeapOps<F>::invoke, &HeapOps<F>::move, &HeapOps<F>::destroy, false};
+    *reinterpret_cast<F **>(&storage_) = new F(std::forward<G>(f));
+    ops_ = &ops;
+  }
+
+  void moveFrom(InlineTask &other) {
+    if (other.ops_) {
+      other.ops_->move(&storage_, &other.storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  void reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  const Ops *ops_;
+  typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type storage_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_TASK_H
@@ -0,0 +1,166 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "thread_placement.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+namespace {
+
+const size_t kStackPrefaultSize = 256 * 1024;
+
+bool isDefault(const ThreadPolicy &policy) {
+  return policy.cpu_mask == 0 && policy.scheduling == SchedulingPolicy::OTHER;
+}
+
+#ifdef __linux__
+void applyPolicy(pthread_t handle, ThreadRole role, const cpu_set_t &inherited, const ThreadPolicy &policy) {
+  cpu_set_t cpus = inherited;
+  if (policy.cpu_mask != 0) {
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+      if (policy.cpu_mask & (uint64_t(1) << cpu)) CPU_SET(cpu, &cpus);
+    }
+  }
+  int e = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+  if (e != 0) {
+    LOG(WARNING) << "thread role " << static_cast<int>(role) << ": setting affinity failed, " << strerror(e);
+  }
+
+  sched_param param{};
+  int sched = SCHED_OTHER;
+  if (policy.scheduling == SchedulingPolicy::FIFO) {
+    sched = SCHED_FIFO;
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+                                    std::min(policy.priority, sched_get_priority_max(SCHED_FIFO)));
+  }
+  e = pthread_setschedparam(handle, sched, &param);
+  if (e != 0) {
+    LOG(WARNING) << "thread role " << static_cast<int>(role) << ": setting scheduling failed, " << strerror(e);
+  }
+}
+
+void prefaultStack() {
+  // touch the pages a deep call chain would fault in later, mlockall keeps them resident
+  char stack[kStackPrefaultSize];
+  for (size_t i = 0; i < kStackPrefaultSize; i += 4096) stack[i] = 0;
+  // the stores must reach memory although nothing reads them back
+  __asm__ __volatile__("" : : "r"(stack) : "memory");
+}
+#endif
+
+}  // namespace
+
+ThreadPlacement &ThreadPlacement::instance() {
+  static ThreadPlacement placement;
+  return placement;
+}
+
+ThreadPlacement::ThreadPlacement()
+    : realtime_(false) {
+}
+
+void ThreadPlacement::setPolicy(ThreadRole role, const ThreadPolicy &policy) {
+  if (role >= ThreadRole::COUNT) {
+    throw std::invalid_argument("invalid thread role");
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  policies_[static_cast<size_t>(role)] = policy;
+#ifdef __linux__
+  for (auto &thread : threads_) {
+    if (thread.role == role) applyPolicy(thread.handle, role, thread.inherited_affinity, policy);
+  }
+#endif
+}
+
+ThreadPolicy ThreadPlacement::policy(ThreadRole role) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return policies_.at(static_cast<size_t>(role));
+}
+
+void ThreadPlacement::setRealtimeMode(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (enabled == realtime_) return;
+#ifdef __linux__
+  if (enabled ? mlockall(MCL_CURRENT | MCL_FUTURE) : munlockall()) {
+    LOG(WARNING) << (enabled ? "mlockall" : "munlockall") << " failed: " << strerror(errno);
+    return;
+  }
+#endif
+  realtime_ = enabled;
+}
+
+bool ThreadPlacement::realtimeMode() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return realtime_;
+}
+
+void ThreadPlacement::enter(ThreadRole role, const char *name) {
+#ifdef __linux__
+  char short_name[16];
+  strncpy(short_name, name, sizeof(short_name) - 1);
+  short_name[sizeof(short_name) - 1] = '\0';
+  pthread_setname_np(pthread_self(), short_name);
+
+  bool realtime;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Registered thread{};
+    thread.role = role;
+    thread.handle = pthread_self();
+    if (pthread_getaffinity_np(thread.handle, sizeof(thread.inherited_affinity), &thread.inherited_affinity) != 0) {
+      CPU_ZERO(&thread.inherited_affinity);
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &thread.inherited_affinity);
+    }
+    threads_.push_back(thread);
+    // an untouched role keeps whatever the thread inherited from its creator
+    auto &policy = policies_[static_cast<size_t>(role)];
+    if (!isDefault(policy)) applyPolicy(thread.handle, role, thread.inherited_affinity, policy);
+    realtime = realtime_;
+  }
+  if (realtime) prefaultStack();
+#endif
+}
+
+void ThreadPlacement::leave() {
+#ifdef __linux__
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto self = pthread_self();
+  auto it = std::find_if(threads_.begin(), threads_.end(),
+                         [self](const Registered &thread) { return pthread_equal(thread.handle, self); });
+  if (it != threads_.end()) threads_.erase(it);
+#endif
+}
+
+ThreadPlacement::Scope::Scope(ThreadRole role, const char *name) {
+  ThreadPlacement::instance().enter(role, name);
+}
+
+ThreadPlacement::Scope::~Scope() {
+  ThreadPlacement::instance().leave();
+}
+
+}  // namespace libsmartereye2
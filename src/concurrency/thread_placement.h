@@ -0,0 +1,79 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef LIBSMARTEREYE2_THREAD_PLACEMENT_H
+#define LIBSMARTEREYE2_THREAD_PLACEMENT_H
+
+#include <array>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "core/core_types.hpp"
+
+namespace libsmartereye2 {
+
+using se2::ThreadRole;
+using se2::ThreadPolicy;
+using se2::SchedulingPolicy;
+
+// Process-wide names, CPU affinity and scheduling for the library's threads, by role. Every thread the
+// library starts opens a Scope first; policies set later are applied to the threads already running.
+class ThreadPlacement {
+ public:
+  static ThreadPlacement &instance();
+
+  void setPolicy(ThreadRole role, const ThreadPolicy &policy);
+  ThreadPolicy policy(ThreadRole role) const;
+
+  // locks current and future pages in memory; threads started afterwards prefault their stacks
+  void setRealtimeMode(bool enabled);
+  bool realtimeMode() const;
+
+  class Scope {
+   public:
+    // name is cut to the 15 characters the kernel keeps
+    Scope(ThreadRole role, const char *name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+ private:
+  ThreadPlacement();
+
+  struct Registered {
+    ThreadRole role;
+    std::thread::native_handle_type handle;
+#ifdef __linux__
+    cpu_set_t inherited_affinity;  // put back when the role's cpu_mask returns to 0
+#endif
+  };
+
+  void enter(ThreadRole role, const char *name);
+  void leave();
+
+  mutable std::mutex mutex_;
+  std::array<ThreadPolicy, static_cast<size_t>(ThreadRole::COUNT)> policies_;
+  std::vector<Registered> threads_;
+  bool realtime_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_THREAD_PLACEMENT_H
@@ -0,0 +1,376 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "timer_queue.h"
+
+#include <limits>
+
+#include "thread_placement.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+static const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+static inline uint32_t levelShift(int level) {
+  return level == 0 ? 0 : 8 + 6 * (level - 1);
+}
+
+static inline uint32_t levelBase(int level) {
+  return level == 0 ? 0 : 256 + 64 * (level - 1);
+}
+
+static inline int levelOf(uint32_t slot) {
+  return slot < 256 ? 0 : 1 + static_cast<int>((slot - 256) / 64);
+}
+
+static inline TimerQueue::TimerId makeId(int32_t index, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(index);
+}
+
+TimerQueue &TimerQueue::shared() {
+  // never destroyed: owners of timers may themselves be static and outlive any destruction order
+  static TimerQueue *timer_queue = new TimerQueue;
+  return *timer_queue;
+}
+
+TimerQueue::TimerQueue()
+    : origin_(Clock::now()),
+      size_(0),
+      current_(0),
+      wake_tick_(kNever),
+      running_(-1),
+      is_alive_(true) {
+  slots_.fill(-1);
+  level_size_.fill(0);
+  thread_ = std::thread([this]() {
+    ThreadPlacement::Scope placement(ThreadRole::TIMER, "se2-timer");
+    run();
+  });
+}
+
+TimerQueue::~TimerQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_alive_ = false;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+TimerQueue::TimerId TimerQueue::schedule(uint32_t delay_ms, Task task) {
+  return add(delay_ms, 0, std::move(task));
+}
+
+TimerQueue::TimerId TimerQueue::schedulePeriodic(uint32_t period_ms, Task task) {
+  return add(period_ms, period_ms ? period_ms : 1, std::move(task));
+}
+
+TimerQueue::TimerId TimerQueue::add(uint32_t delay_ms, uint32_t period_ms, Task task) {
+  TimerId id;
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int32_t index;
+    if (free_.empty()) {
+      index = static_cast<int32_t>(nodes_.size());
+      nodes_.emplace_back();
+      nodes_.back().generation = 1;
+    } else {
+      index = free_.back();
+      free_.pop_back();
+    }
+
+    auto &node = nodes_[index];
+    // the current tick is partly gone already, round up so that a timeout never fires early
+    node.expires = std::max(nowTick() + delay_ms + 1, current_ + 1);
+    node.period_ms = period_ms;
+    node.cancelled = false;
+    node.task = std::move(task);
+    insert(index);
+    ++size_;
+
+    id = makeId(index, node.generation);
+    wake = node.expires < wake_tick_;
+  }
+  if (wake) cv_.notify_one();
+  return id;
+}
+
+bool TimerQueue::cancel(TimerId id) {
+  auto index = static_cast<int32_t>(id & 0xffffffffu);
+  auto generation = static_cast<uint32_t>(id >> 32);
+  Task dropped;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (index < 0 || index >= static_cast<int32_t>(nodes_.size())) return false;
+  auto &node = nodes_[index];
+  if (node.generation != generation) return false;
+
+  switch (node.state) {
+    case NodeState::QUEUED:unlink(index);
+      release(index, &dropped);
+      return true;
+    case NodeState::DUE:release(index, &dropped);
+      return true;
+    case NodeState::RUNNING: {
+      bool periodic = node.period_ms != 0;
+      node.cancelled = true;
+      if (std::this_thread::get_id() != thread_.get_id()) {
+        done_cv_.wait(lock, [&]() { return running_ != index; });
+      }
+      return periodic;
+    }
+    default:return false;
+  }
+}
+
+size_t TimerQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+uint64_t TimerQueue::nowTick() const {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - origin_).count());
+}
+
+void TimerQueue::insert(int32_t index) {
+  auto &node = nodes_[index];
+  auto delta = node.expires - current_;
+  uint32_t slot;
+  if (delta < (1u << 8)) {
+    slot = static_cast<uint32_t>(node.expires & 0xff);
+  } else {
+    int level = 1;
+    while (level < kLevels - 1 && delta >= (uint64_t(1) << levelShift(level + 1))) ++level;
+    // beyond the outermost level the entry waits in its last slot and is re-placed when cascaded
+    auto placed = delta < (uint64_t(1) << (levelShift(kLevels - 1) + 6))
+                  ? node.expires : current_ + (uint64_t(1) << (levelShift(kLevels - 1) + 6)) - 1;
+    slot = levelBase(level) + static_cast<uint32_t>((placed >> levelShift(level)) & 0x3f);
+  }
+
+  node.slot = static_cast<int32_t>(slot);
+  node.prev = -1;
+  node.next = slots_[slot];
+  if (node.next >= 0) nodes_[node.next].prev = index;
+  slots_[slot] = index;
+  node.state = NodeState::QUEUED;
+  ++level_size_[levelOf(slot)];
+}
+
+void TimerQueue::unlink(int32_t index) {
+  auto &node = nodes_[index];
+  if (node.prev >= 0) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[node.slot] = node.next;
+  }
+  if (node.next >= 0) nodes_[node.next].prev = node.prev;
+  --level_size_[levelOf(static_cast<uint32_t>(node.slot))];
+  node.slot = -1;
+}
+
+void TimerQueue::release(int32_t index, Task *dropped) {
+  auto &node = nodes_[index];
+  *dropped = std::move(node.task);
+  node.task = nullptr;
+  node.state = NodeState::FREE;
+  if (++node.generation == 0) node.generation = 1;
+  free_.push_back(index);
+  --size_;
+}
+
+void TimerQueue::collect(uint32_t slot) {
+  auto index = slots_[slot];
+  slots_[slot] = -1;
+  while (index >= 0) {
+    auto &node = nodes_[index];
+    auto next = node.next;
+    --level_size_[0];
+    node.slot = -1;
+    node.state = NodeState::DUE;
+    due_.push_back(makeId(index, node.generation));
+    index = next;
+  }
+}
+
+void TimerQueue::cascade(int level, uint64_t tick) {
+  auto slot = levelBase(level) + static_cast<uint32_t>((tick >> levelShift(level)) & 0x3f);
+  auto index = slots_[slot];
+  slots_[slot] = -1;
+  while (index >= 0) {
+    auto next = nodes_[index].next;
+    --level_size_[level];
+    insert(index);
+    index = next;
+  }
+}
+
+void TimerQueue::advance(uint64_t now) {
+  while (current_ < now) {
+    if (queued() == 0) {
+      current_ = now;
+      break;
+    }
+    if (level_size_[0] == 0) {
+      // nothing due before the next cascade, skip straight to it
+      auto boundary = (current_ | 0xff) + 1;
+      if (boundary > now) {
+        current_ = now;
+        break;
+      }
+      current_ = boundary - 1;
+    }
+
+    ++current_;
+    if ((current_ & 0xff) == 0) {
+      for (int level = 1; level < kLevels; ++level) {
+        cascade(level, current_);
+        if ((current_ >> levelShift(level)) & 0x3f) break;
+      }
+    }
+    collect(static_cast<uint32_t>(current_ & 0xff));
+  }
+}
+
+size_t TimerQueue::queued() const {
+  size_t count = 0;
+  for (auto size : level_size_) count += size;
+  return count;
+}
+
+uint64_t TimerQueue::nextTick() const {
+  uint64_t next = kNever;
+  if (level_size_[0] > 0) {
+    for (uint64_t tick = current_ + 1; tick <= current_ + 0xff; ++tick) {
+      if (slots_[tick & 0xff] >= 0) {
+        next = tick;
+        break;
+      }
+    }
+  }
+  for (int level = 1; level < kLevels; ++level) {
+    if (level_size_[level] == 0) continue;
+    auto shift = levelShift(level);
+    for (uint64_t k = 1; k <= 64; ++k) {
+      auto boundary = ((current_ >> shift) + k) << shift;
+      if (boundary >= next) break;
+      if (slots_[levelBase(level) + ((boundary >> shift) & 0x3f)] >= 0) {
+        next = boundary;
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+void TimerQueue::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (is_alive_) {
+    advance(nowTick());
+
+    for (size_t i = 0; i < due_.size() && is_alive_; ++i) {
+      auto index = static_cast<int32_t>(due_[i] & 0xffffffffu);
+      auto &node = nodes_[index];
+      if (node.generation != static_cast<uint32_t>(due_[i] >> 32) || node.state != NodeState::DUE) continue;
+
+      node.state = NodeState::RUNNING;
+      running_ = index;
+      auto task = std::move(node.task);
+      lock.unlock();
+      try {
+        task();
+      }
+      catch (const std::exception &e) {
+        LOG(ERROR) << "timer callback threw: " << e.what();
+      }
+      catch (...) {}
+      lock.lock();
+
+      auto &done = nodes_[index];
+      if (done.period_ms != 0 && !done.cancelled) {
+        done.task = std::move(task);
+        done.expires = std::max(done.expires + done.period_ms, current_ + 1);
+        insert(index);
+      } else {
+        // captures go before cancel() returns to whoever is waiting for this callback
+        Task dropped;
+        release(index, &dropped);
+        lock.unlock();
+        dropped = nullptr;
+        task = nullptr;
+        lock.lock();
+      }
+      running_ = -1;
+      done_cv_.notify_all();
+    }
+    due_.clear();
+    if (!is_alive_) break;
+
+    auto next = nextTick();
+    if (next <= nowTick()) continue;
+    wake_tick_ = next;
+    if (next == kNever) {
+      cv_.wait(lock);
+    } else {
+      cv_.wait_until(lock, origin_ + std::chrono::milliseconds(next));
+    }
+    wake_tick_ = kNever;
+  }
+}
+
+RepeatOperation::RepeatOperation(std::function<void()> operation, uint32_t period_ms)
+    : operation_(std::move(operation)),
+      period_ms_(period_ms),
+      timer_(0) {
+}
+
+RepeatOperation::~RepeatOperation() {
+  stop();
+}
+
+void RepeatOperation::start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (timer_) return;
+  timer_ = TimerQueue::shared().schedulePeriodic(period_ms_, [this]() { operation_(); });
+}
+
+void RepeatOperation::stop() {
+  TimerQueue::TimerId timer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timer = timer_;
+    timer_ = 0;
+  }
+  if (timer) TimerQueue::shared().cancel(timer);
+}
+
+void RepeatOperation::setPeriod(uint32_t period_ms) {
+  bool was_running;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    period_ms_ = period_ms;
+    was_running = timer_ != 0;
+  }
+  if (was_running) {
+    stop();
+    start();
+  }
+}
+
+bool RepeatOperation::running() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return timer_ != 0;
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,173 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_TIMER_QUEUE_H
+#define LIBSMARTEREYE2_TIMER_QUEUE_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "task.h"
+
+namespace libsmartereye2 {
+
+// How often and how patiently to repeat a request. attempts == 0 keeps trying until the owner goes
+// away; the wait before attempt n + 1 (or for the response to attempt n) doubles from
+// initial_delay_ms up to max_delay_ms.
+struct RetryPolicy {
+  uint32_t attempts;
+  uint32_t initial_delay_ms;
+  uint32_t max_delay_ms;
+
+  uint32_t delayFor(uint32_t attempt) const {
+    uint64_t delay = initial_delay_ms;
+    for (uint32_t i = 1; i < attempt && delay < max_delay_ms; ++i) delay *= 2;
+    return static_cast<uint32_t>(delay < max_delay_ms ? delay : max_delay_ms);
+  }
+
+  bool exhausted(uint32_t attempt) const { return attempts != 0 && attempt >= attempts; }
+};
+
+// Callbacks that may outlive their owner (timer callbacks, completions on other threads) go through
+// run(); once the owner called expire() they are skipped, and expire() waits for a running one.
+class LifetimeGuard {
+ public:
+  LifetimeGuard() : alive_(true) {}
+
+  template<class F>
+  bool run(F &&f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!alive_) return false;
+    f();
+    return true;
+  }
+
+  void expire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    alive_ = false;
+  }
+
+ private:
+  std::mutex mutex_;
+  bool alive_;
+};
+
+// A hierarchical timing wheel (1 ms ticks; 256 slots, then three levels of 64) on one thread, shared by
+// every timeout, retry, watchdog and poll in the process. Scheduling and cancelling are O(1), and the
+// thread sleeps until the next occupied slot rather than ticking. Callbacks run on the timer thread
+// and should be short; anything slow belongs on a Dispatcher.
+class TimerQueue {
+ public:
+  using TimerId = uint64_t;
+  using Task = InlineTask<void()>;
+
+  static TimerQueue &shared();
+
+  TimerQueue();
+  ~TimerQueue();
+
+  TimerQueue(const TimerQueue &) = delete;
+  TimerQueue &operator=(const TimerQueue &) = delete;
+
+  TimerId schedule(uint32_t delay_ms, Task task);
+  // runs task every period_ms, first one period from now, until cancelled
+  TimerId schedulePeriodic(uint32_t period_ms, Task task);
+  // False when a one-shot timer already fired or the id is unknown. A callback that is running on
+  // another thread is waited for, so whatever it captured can be released once this returns.
+  bool cancel(TimerId id);
+
+  size_t size() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static const int kLevels = 4;
+  static const uint32_t kRootBits = 8;
+  static const uint32_t kLevelBits = 6;
+  static const uint32_t kSlotCount = (1u << kRootBits) + (kLevels - 1) * (1u << kLevelBits);
+
+  enum class NodeState : uint8_t { FREE, QUEUED, DUE, RUNNING };
+
+  struct Node {
+    uint64_t expires;
+    uint32_t period_ms;
+    uint32_t generation;
+    int32_t slot;
+    int32_t prev;
+    int32_t next;
+    NodeState state;
+    bool cancelled;
+    Task task;
+  };
+
+  TimerId add(uint32_t delay_ms, uint32_t period_ms, Task task);
+  uint64_t nowTick() const;
+  void insert(int32_t index);
+  void unlink(int32_t index);
+  void release(int32_t index, Task *dropped);
+  void collect(uint32_t slot);
+  void cascade(int level, uint64_t tick);
+  void advance(uint64_t now);
+  size_t queued() const;
+  uint64_t nextTick() const;
+  void run();
+
+  const Clock::time_point origin_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable done_cv_;
+  std::vector<Node> nodes_;
+  std::vector<int32_t> free_;
+  std::array<int32_t, kSlotCount> slots_;
+  std::array<size_t, kLevels> level_size_;
+  std::vector<TimerId> due_;
+  size_t size_;
+  uint64_t current_;
+  uint64_t wake_tick_;
+  int32_t running_;
+  bool is_alive_;
+  std::thread thread_;
+};
+
+// Runs operation every period_ms on the shared timer.
+class RepeatOperation {
+ public:
+  RepeatOperation(std::function<void()> operation, uint32_t period_ms);
+  ~RepeatOperation();
+
+  RepeatOperation(const RepeatOperation &) = delete;
+  RepeatOperation &operator=(const RepeatOperation &) = delete;
+
+  void start();
+  // waits for a running operation, unless called from it
+  void stop();
+  void setPeriod(uint32_t period_ms);
+  bool running() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::function<void()> operation_;
+  uint32_t period_ms_;
+  TimerQueue::TimerId timer_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_TIMER_QUEUE_H
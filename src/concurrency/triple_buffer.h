@@ -0,0 +1,87 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_TRIPLE_BUFFER_H
+#define LIBSMARTEREYE2_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace libsmartereye2 {
+
+// Latest-value hand-off between one writer and one reader, neither of which ever waits. The writer
+// fills its back buffer and swaps it with the middle one; the reader swaps its front buffer with the
+// middle one only when the writer has published since. Values the reader skipped are handed back
+// to the writer and overwritten, so the reader always sees the newest value and nothing queues.
+template<class T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : middle_(1), back_(0), front_(2), generation_(0) {}
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // writer side; the value displaced from the back buffer is returned so that the writer releases it
+  T publish(T value) {
+    Slot &slot = slots_[back_];
+    slot.value = std::move(value);
+    slot.generation = ++generation_;
+    auto previous = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+    back_ = previous & kIndexMask;
+    return std::move(slots_[back_].value);
+  }
+
+  // reader side; generation is 0 until the first publish and grows by one per publish
+  const T &read(uint64_t *generation = nullptr) {
+    if (middle_.load(std::memory_order_relaxed) & kFresh) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    if (generation) *generation = slots_[front_].generation;
+    return slots_[front_].value;
+  }
+
+  // reader side, tells whether read() would return something newer
+  bool fresh() const {
+    return (middle_.load(std::memory_order_acquire) & kFresh) != 0;
+  }
+
+  // drops every held value; neither side may run meanwhile. Generations keep growing from where they were.
+  void clear() {
+    for (auto &slot : slots_) {
+      slot.value = T{};
+      slot.generation = 0;
+    }
+    middle_.fetch_and(kIndexMask, std::memory_order_relaxed);
+  }
+
+ private:
+  static const uint8_t kIndexMask = 0x03;
+  static const uint8_t kFresh = 0x04;
+
+  struct Slot {
+    T value{};
+    uint64_t generation = 0;
+  };
+
+  Slot slots_[3];
+  std::atomic<uint8_t> middle_;
+  uint8_t back_;       // writer only
+  uint8_t front_;      // reader only
+  uint64_t generation_;  // writer only
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_TRIPLE_BUFFER_H
@@ -15,48 +15,79 @@
 #ifndef LIBSMARTEREYE2_WATCHDOG_H
 #define LIBSMARTEREYE2_WATCHDOG_H
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
 #include "dispatcher.h"
+#include "timer_queue.h"
 
 namespace libsmartereye2 {
 
+// Runs the operations of every expired Watchdog, off the timer thread. Never destroyed, like
+// TimerQueue::shared().
+inline Dispatcher &watchdogDispatcher() {
+  static Dispatcher *dispatcher = []() {
+    auto d = new Dispatcher(64, ThreadRole::WATCHDOG, "se2-watchdog");
+    d->start();
+    return d;
+  }();
+  return *dispatcher;
+}
+
+// Calls operation when kick() was not called for timeout_ms. The timeout is an entry on the shared timer
+// and the operation runs on watchdogDispatcher(), so neither costs a thread per watchdog.
 class Watchdog {
  public:
   Watchdog(std::function<void()> operation, uint64_t timeout_ms) :
-      timeout_ms_(timeout_ms), operation_(std::move(operation)) {
-    watcher_ = std::make_shared<RepeatOperation<>>([this](Dispatcher::CancellableTimer cancellable_timer) {
-      if (cancellable_timer.trySleep(timeout_ms_)) {
-        if (!kicked_)
-          operation_();
+      operation_(std::move(operation)) {
+    watcher_ = std::make_shared<RepeatOperation>([this]() {
+      bool kicked;
+      std::weak_ptr<LifetimeGuard> guard;
+      {
         std::lock_guard<std::mutex> lk(mutex_);
+        kicked = kicked_;
         kicked_ = false;
+        guard = guard_;
+      }
+      if (!kicked) {
+        watchdogDispatcher().invoke([this, guard](Dispatcher::CancellableTimer) {
+          auto alive = guard.lock();
+          if (alive) alive->run([this]() { operation_(); });
+        });
       }
-    });
+    }, static_cast<uint32_t>(timeout_ms));
   }
 
   ~Watchdog() {
-    if (running_)
-      stop();
+    stop();
   }
 
   void start() {
-    std::lock_guard<std::mutex> lk(mutex_);
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      kicked_ = false;
+      // operations posted before an earlier stop() stay skipped
+      if (!guard_) guard_ = std::make_shared<LifetimeGuard>();
+    }
     watcher_->start();
-    running_ = true;
   }
+  // waits for a running operation, so it must not be called from one
   void stop() {
+    watcher_->stop();
+    std::shared_ptr<LifetimeGuard> guard;
     {
       std::lock_guard<std::mutex> lk(mutex_);
-      running_ = false;
+      guard.swap(guard_);
     }
-    watcher_->stop();
+    if (guard) guard->expire();
   }
   bool running() {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return running_;
+    return watcher_->running();
   }
   void set_timeout(uint64_t timeout_ms) {
-    std::lock_guard<std::mutex> lk(mutex_);
-    timeout_ms_ = timeout_ms;
+    watcher_->setPeriod(static_cast<uint32_t>(timeout_ms));
   }
   void kick() {
     std::lock_guard<std::mutex> lk(mutex_);
@@ -65,11 +96,10 @@ class Watchdog {
 
  private:
   std::mutex mutex_;
-  uint64_t timeout_ms_;
   bool kicked_ = false;
-  bool running_ = false;
+  std::shared_ptr<LifetimeGuard> guard_;
   std::function<void()> operation_;
-  std::shared_ptr<RepeatOperation<>> watcher_{};
+  std::shared_ptr<RepeatOperation> watcher_{};
 };
 
 }  // namespace libsmartereye2
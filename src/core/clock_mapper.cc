@@ -0,0 +1,161 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "clock_mapper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace libsmartereye2 {
+
+// a round trip slower than twice the fastest one (plus scheduling noise) says little about when the device read its clock
+static const int64_t kRoundTripSlackNs = 200000;
+// with less than this much device time in the window, the rate is assumed nominal instead of fitted
+static const double kMinRateSpanMs = 2000;
+static const double kNominalRate = 1e6;
+
+ClockMapper::ClockMapper(size_t window)
+    : window_(std::max(window, kMinSamples)),
+      next_(0),
+      converged_(false),
+      device_origin_ms_(0),
+      host_origin_ns_(0),
+      rate_(kNominalRate),
+      offset_(0),
+      used_(0),
+      jitter_ns_(0),
+      min_round_trip_ns_(0) {
+  samples_.reserve(window_);
+}
+
+int64_t ClockMapper::hostNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ClockMapper::addRoundTrip(int64_t host_send_ns, double device_ms, int64_t host_receive_ns) {
+  if (host_receive_ns < host_send_ns || device_ms <= 0) return;
+
+  Sample sample{device_ms, host_send_ns + (host_receive_ns - host_send_ns) / 2, host_receive_ns - host_send_ns};
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (samples_.size() < window_) {
+    samples_.push_back(sample);
+  } else {
+    samples_[next_] = sample;
+    next_ = (next_ + 1) % window_;
+  }
+  refit();
+}
+
+void ClockMapper::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.clear();
+  next_ = 0;
+  converged_ = false;
+  used_ = 0;
+  jitter_ns_ = 0;
+}
+
+bool ClockMapper::converged() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return converged_;
+}
+
+int64_t ClockMapper::toHost(double device_ms) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!converged_) return 0;
+  return host_origin_ns_ + static_cast<int64_t>(std::llround(offset_ + rate_ * (device_ms - device_origin_ms_)));
+}
+
+ClockSyncStatistics ClockMapper::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ClockSyncStatistics statistics;
+  statistics.converged = converged_;
+  statistics.samples = used_;
+  statistics.drift_ppm = (rate_ / kNominalRate - 1.0) * 1e6;
+  statistics.jitter_us = jitter_ns_ / 1e3;
+  statistics.round_trip_us = min_round_trip_ns_ / 1e3;
+  return statistics;
+}
+
+// called with mutex_ held
+void ClockMapper::refit() {
+  min_round_trip_ns_ = samples_.front().round_trip_ns;
+  for (const auto &sample : samples_) {
+    min_round_trip_ns_ = std::min(min_round_trip_ns_, sample.round_trip_ns);
+  }
+  const int64_t max_round_trip_ns = 2 * min_round_trip_ns_ + kRoundTripSlackNs;
+
+  // fit around the first sample so the sums stay well inside double precision; the origins change
+  // together with the fit, a failed one keeps the previous mapping whole
+  const double device_origin_ms = samples_.front().device_ms;
+  const int64_t host_origin_ns = samples_.front().host_ns;
+
+  double rate = kNominalRate, offset = 0, jitter = 0;
+  uint32_t used = 0;
+  double reject_beyond = -1;
+
+  for (int pass = 0; pass < 2; ++pass) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double min_x = 0, max_x = 0;
+    for (const auto &sample : samples_) {
+      if (sample.round_trip_ns > max_round_trip_ns) continue;
+      double x = sample.device_ms - device_origin_ms;
+      double y = static_cast<double>(sample.host_ns - host_origin_ns);
+      if (reject_beyond >= 0 && std::abs(y - offset - rate * x) > reject_beyond) continue;
+      if (n == 0 || x < min_x) min_x = x;
+      if (n == 0 || x > max_x) max_x = x;
+      n += 1;
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    if (n < kMinSamples) break;
+
+    double denominator = n * sxx - sx * sx;
+    if (max_x - min_x >= kMinRateSpanMs && denominator > 0) {
+      rate = (n * sxy - sx * sy) / denominator;
+    } else {
+      rate = kNominalRate;
+    }
+    offset = (sy - rate * sx) / n;
+
+    double squares = 0;
+    for (const auto &sample : samples_) {
+      if (sample.round_trip_ns > max_round_trip_ns) continue;
+      double x = sample.device_ms - device_origin_ms;
+      double residual = static_cast<double>(sample.host_ns - host_origin_ns) - offset - rate * x;
+      if (reject_beyond >= 0 && std::abs(residual) > reject_beyond) continue;
+      squares += residual * residual;
+    }
+    jitter = std::sqrt(squares / n);
+    used = static_cast<uint32_t>(n);
+    // second pass without the samples beyond three sigma, but never narrower than a round trip
+    reject_beyond = std::max(3 * jitter, static_cast<double>(min_round_trip_ns_));
+  }
+
+  if (used >= kMinSamples) {
+    converged_ = true;
+    device_origin_ms_ = device_origin_ms;
+    host_origin_ns_ = host_origin_ns;
+    rate_ = rate;
+    offset_ = offset;
+    used_ = used;
+    jitter_ns_ = jitter;
+  }
+}
+
+}  // namespace libsmartereye2
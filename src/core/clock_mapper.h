@@ -0,0 +1,75 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_CLOCK_MAPPER_H
+#define LIBSMARTEREYE2_CLOCK_MAPPER_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "core/core_types.hpp"
+
+namespace libsmartereye2 {
+
+using namespace se2;
+
+// Maps device timestamps (ms) onto the host's monotonic clock (ns). Every round trip tells that the
+// device read its clock somewhere between sending and receiving on the host; assuming the middle,
+// host = offset + rate * device is fitted by least squares over the latest samples. Round trips
+// much slower than the fastest recent one, and samples far off the first fit, are left out.
+class ClockMapper {
+ public:
+  explicit ClockMapper(size_t window = kDefaultWindow);
+
+  void addRoundTrip(int64_t host_send_ns, double device_ms, int64_t host_receive_ns);
+  void reset();
+
+  bool converged() const;
+  // 0 until converged
+  int64_t toHost(double device_ms) const;
+  ClockSyncStatistics statistics() const;
+
+  static int64_t hostNow();
+
+  static const size_t kDefaultWindow = 64;
+  static const size_t kMinSamples = 4;
+
+ private:
+  struct Sample {
+    double device_ms;
+    int64_t host_ns;
+    int64_t round_trip_ns;
+  };
+
+  void refit();
+
+  mutable std::mutex mutex_;
+  std::vector<Sample> samples_;
+  size_t window_;
+  size_t next_;
+
+  bool converged_;
+  double device_origin_ms_;
+  int64_t host_origin_ns_;
+  double rate_;    // host ns per device ms
+  double offset_;  // host ns at device_origin_ms_, relative to host_origin_ns_
+  uint32_t used_;
+  double jitter_ns_;
+  int64_t min_round_trip_ns_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_CLOCK_MAPPER_H
@@ -38,7 +38,7 @@ Frame::Frame(SeFrame *ref) : frame_ref_(ref) {
     frame_index_ = ref->getFrameIndex();
     auto frame_data = dynamic_cast<libsmartereye2::CompositeFrameData *>(ref);
     if (!frame_data) {
-      profile_ = StreamProfile(new SeStreamProfile{ref->getStreamProfile().get()});
+      profile_ = StreamProfile(new SeStreamProfile{ref->getStreamProfile()});
     }
   }
 }
@@ -53,12 +53,6 @@ void Frame::keep() {
   frame_ref_->keep();
 }
 
-SeSensor *Frame::getSensor() const {
-  std::shared_ptr<libsmartereye2::SensorInterface> sensor(frame_ref_->getSensor());
-  auto &dev = sensor->getDevice();
-  return nullptr;   // TODO
-}
-
 StreamProfile Frame::getProfile() const {
   return profile_;
 }
@@ -67,6 +61,15 @@ double Frame::timestamp() const {
   return frame_ref_->getFrameTimestamp();
 }
 
+TimestampDomain Frame::timestampDomain() const {
+  return frame_ref_->getFrameTimestampDomain();
+}
+
+int64_t Frame::globalTimestamp() const {
+  auto frame_data = dynamic_cast<libsmartereye2::FrameData *>(frame_ref_);
+  return frame_data ? frame_data->extension().global_timestamp_ns : 0;
+}
+
 const char* Frame::getFrameMetadata(FrameMetadataValue frame_metadata) const {
   return frame_ref_->getFrameMetadata(frame_metadata);
 }
@@ -105,6 +108,11 @@ void Frame::reset() {
   }
 }
 
+uint32_t FrameSet::missingStreams() const {
+  auto frame_data = dynamic_cast<libsmartereye2::FrameData *>(get());
+  return frame_data ? frame_data->extension().missing_streams : 0;
+}
+
 Frame FrameSet::operator[](size_t index) const {
   if (index < size()) {
     auto frame_interface = dynamic_cast<libsmartereye2::CompositeFrameData *>(get())->getFrame(index);
@@ -122,18 +130,23 @@ VideoFrame FrameSet::operator[](FrameId frame_id) const {
 }
 
 Frame FrameSet::firstOrDefault(FrameId frame_id, FrameFormat format) const {
-  Frame result;
-  for (size_t i = 0; i < size(); i++) {
-    auto cur_frame = dynamic_cast<libsmartereye2::CompositeFrameData *>(get())->getFrame(i);
-    cur_frame->acquire();
-    Frame frame(cur_frame);
-    if (!result && frame_id == frame.getProfile().frameId()
-        && (format == FrameFormat::Any || format == frame.getProfile().format())) {
-      result = std::move(frame);
-      break;
+  auto composite = dynamic_cast<libsmartereye2::CompositeFrameData *>(get());
+  if (!composite) return Frame();
+
+  auto member = composite->find(frame_id);
+  if (member && format != FrameFormat::Any && member->getStreamProfile()->format() != format) {
+    // the stream is carried in more than one format, rare enough to scan for
+    member = nullptr;
+    for (size_t i = 0; i < size() && !member; i++) {
+      auto cur_frame = composite->getFrame(i);
+      auto profile = cur_frame->getStreamProfile();
+      if (profile && profile->frameId() == frame_id && profile->format() == format) member = cur_frame;
     }
   }
-  return result;
+  if (!member) return Frame();
+
+  member->acquire();
+  return Frame(member);
 }
 
 int VideoFrame::width() const {
@@ -164,8 +177,8 @@ float DepthFrame::units() const {
 }
 
 float DisparityFrame::baseline() const {
-  // TODO
-  return 0.f;
+  auto profile = get()->getStreamProfile();
+  return profile ? profile->getIntrinsics().base_line : 0.f;
 }
 
 Points::Points(const Frame &frame)
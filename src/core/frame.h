@@ -27,10 +27,13 @@ class SensorInterface;
 class StreamProfileInterface;
 class ArchiveInterface;
 
+// A frame carries its sensor and stream profile as plain pointers. The archive the frame belongs to keeps
+// both alive until its last frame returns, so they stay valid for as long as the caller holds the frame,
+// even past the sensor's device. The sensor's getDevice() is only valid while the device is.
 class FrameInterface {
  public:
-  virtual std::shared_ptr<SensorInterface> getSensor() const = 0;
-  virtual void setSensor(std::shared_ptr<SensorInterface> sensor) = 0;
+  virtual SensorInterface *getSensor() const = 0;
+  virtual void setSensor(const std::shared_ptr<SensorInterface> &sensor) = 0;
 
   virtual const char* getFrameMetadata(const FrameMetadataValue &frame_metadata) const = 0;
   virtual size_t getFrameMetadataSize() const = 0;
@@ -41,11 +44,13 @@ class FrameInterface {
   virtual TimestampDomain getFrameTimestampDomain() const = 0;
   virtual int64_t getFrameIndex() const = 0;
   virtual int64_t getSpeed() const = 0;
-  virtual std::shared_ptr<StreamProfileInterface> getStreamProfile() const = 0;
+  virtual StreamProfileInterface *getStreamProfile() const = 0;
 
   virtual void setTimestamp(double new_ts) = 0;
   virtual void setTimestampDomain(TimestampDomain timestamp_domain) = 0;
-  virtual void setStreamProfile(std::shared_ptr<StreamProfileInterface> sp) = 0;
+  virtual void setStreamProfile(const std::shared_ptr<StreamProfileInterface> &sp) = 0;
+  // the sensor and stream profile of original, which this frame was made from
+  virtual void inheritHandles(const FrameInterface *original) = 0;
 
   virtual void acquire() = 0;
   virtual void release() = 0;
@@ -62,6 +67,8 @@ class FrameInterface {
   virtual ArchiveInterface *getOwner() const = 0;
 };
 
+// Owns one reference. Moving a holder hands that reference over without touching the frame's count;
+// only clone() adds an owner, and releasing the only one skips the atomic decrement.
 struct FrameHolder {
   FrameInterface *frame;
 
@@ -14,8 +14,12 @@
 
 #include "frame_aggregator.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <utility>
-#include "frame_data.h"
+
 #include "streaming/stream_profile.h"
 #include "easylogging++.h"
 
@@ -23,106 +27,398 @@
 
 namespace libsmartereye2 {
 
-static const int kFrameNum2Aggregate(250);
+static bool isImage(FrameId frame_id) {
+  return static_cast<uint32_t>(frame_id) < static_cast<uint32_t>(FrameId::Lane);
+}
 
-FrameAggregator::FrameAggregator(const std::vector<int>& streams_to_aggregate)
-    : ProcessingBlock("Aggregator"),
-      queue_(new ConsumerQueue<FrameHolder>(kFrameNum2Aggregate)),
-      accepting_(true) {
-  for (auto uid : streams_to_aggregate) {
-    streams_to_aggregate_ids_.insert(uid);
-  }
+// slot of the lowest bit set
+static int lowestSlot(uint32_t bits) {
+  return frameIdSlot(static_cast<FrameId>(bits));
 }
 
-bool FrameAggregator::dequeue(FrameHolder *item, uint32_t timeout_ms) {
-  return queue_->dequeue(item, timeout_ms);
+FrameAggregator::FrameAggregator(const StreamProfiles &streams_to_aggregate, FramesetSink sink,
+                                 uint32_t max_wait_ms)
+    : ProcessingBlock("Aggregator"),
+      sink_(std::move(sink)),
+      accepting_(true),
+      max_wait_ms_(max_wait_ms),
+      streams_(0),
+      images_(0),
+      timed_(0),
+      join_window_(20),
+      trigger_(FramesetTrigger::MATCHED),
+      leader_(static_cast<uint32_t>(FrameId::LeftCamera)),
+      pending_head_(0),
+      pending_count_(0),
+      early_bits_(0),
+      untimed_bits_(0),
+      latest_bits_(0),
+      fresh_bits_(0),
+      emitted_timestamp_(std::numeric_limits<double>::lowest()),
+      guard_(std::make_shared<LifetimeGuard>()),
+      emitter_(kEmitterQueueSize, ThreadRole::DISPATCHER, "se2-aggregate") {
+  for (const auto &profile : streams_to_aggregate) {
+    auto frame_id = profile->frameId();
+    auto slot = frameIdSlot(frame_id);
+    auto uid = profile->uniqueId();
+    if (slot < 0 || uid < 0) continue;
+
+    if (static_cast<size_t>(uid) >= slot_of_stream_.size()) {
+      slot_of_stream_.resize(uid + 1, -1);
+    }
+    slot_of_stream_[uid] = static_cast<int8_t>(slot);
+    streams_ |= static_cast<uint32_t>(frame_id);
+    if (isImage(frame_id)) {
+      images_ |= static_cast<uint32_t>(frame_id);
+      if (profile->fps() > 0) join_window_ = 500.0 / profile->fps();
+    } else {
+      timed_ |= static_cast<uint32_t>(frame_id);
+    }
+  }
 }
 
-bool FrameAggregator::tryDequeue(FrameHolder *item) {
-  return queue_->tryDequeue(item);
+FrameAggregator::~FrameAggregator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    periodic_.reset();
+  }
+  guard_->expire();
+  emitter_.stop();
 }
 
 void FrameAggregator::start() {
-  auto processing_callback = [&](const FrameHolder& frame, SyntheticSourceInterface *source) {
-    handleFrame(frame, source);
+  auto processing_callback = [&](FrameHolder frame, SyntheticSourceInterface *) {
+    handleFrame(std::move(frame));
   };
 
   setProcessingCallback(FrameProcessorCallbackPtr(
       new InternalFrameProcessorCallback<decltype(processing_callback)>(processing_callback)
   ));
 
+  emitter_.start();
   accepting_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (periodic_) periodic_->start();
 }
 
 void FrameAggregator::stop() {
   accepting_ = false;
-  queue_->clear();
+  {
+    // the ticks only post to emitter_, so waiting for a running one under the lock is safe
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (periodic_) periodic_->stop();
+  }
+  emitter_.stop();
   setProcessingCallback(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clearSlots();
+    ready_.clear();
+  }
 }
 
-void FrameAggregator::handleFrame(const FrameHolder& frame, SyntheticSourceInterface *source) {
-  if (!accepting_) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    return;
+void FrameAggregator::setTrigger(FramesetTrigger trigger, FrameId leader, uint32_t period_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  periodic_.reset();
+  trigger_ = trigger;
+  leader_ = static_cast<uint32_t>(leader);
+  clearSlots();
+
+  if (trigger == FramesetTrigger::PERIODIC) {
+    periodic_.reset(new RepeatOperation(onTimer(&FrameAggregator::emitPeriodic), std::max<uint32_t>(period_ms, 1)));
+    if (accepting_) periodic_->start();
   }
+}
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto comp = dynamic_cast<CompositeFrameData *>(frame.frame);
-  if (comp) {
-    for (size_t i = 0; i < comp->getFrameCount(); i++) {
-      FrameInterface *current_frame = comp->getFrame(i);
-      current_frame->acquire();
-      int uid = current_frame->getStreamProfile()->uniqueId();
-      last_set_[uid] = FrameHolder(current_frame);
-    }
+// the timer thread is shared by the whole process, its callbacks only post the emission to emitter_;
+// a full queue skips the tick, the tasks still queued emit by then
+std::function<void()> FrameAggregator::onTimer(void (FrameAggregator::*emission)()) {
+  std::weak_ptr<LifetimeGuard> guard = guard_;
+  return [guard, this, emission]() {
+    auto alive = guard.lock();
+    if (!alive) return;
+    alive->run([this, emission]() {
+      emitter_.tryInvoke([this, emission](Dispatcher::CancellableTimer) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          (this->*emission)();
+        }
+        deliver();
+      });
+    });
+  };
+}
 
-    for (int stream_id : streams_to_aggregate_ids_) {
-      if (!last_set_[stream_id]) return;
+void FrameAggregator::emitPeriodic() {
+  if (trigger_ == FramesetTrigger::PERIODIC) emitLatest();
+}
+
+void FrameAggregator::emitDue() {
+  if (trigger_ == FramesetTrigger::MATCHED) emitExpired(nowMs());
+}
+
+void FrameAggregator::deliver() {
+  // one thread at a time hands out whatever is ready, in the order it was emitted
+  std::lock_guard<std::mutex> sink_lock(sink_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ready_.empty()) return;
+    delivering_.swap(ready_);
+  }
+  for (auto &frameset : delivering_) {
+    sink_(std::move(frameset), getSource());
+  }
+  delivering_.clear();
+}
+
+void FrameAggregator::clearSlots() {
+  for (auto &set : pending_) {
+    for (auto &frame : set.frames) frame = FrameHolder();
+  }
+  pending_head_ = 0;
+  pending_count_ = 0;
+  for (auto &frame : early_) frame = FrameHolder();
+  for (auto &frame : untimed_) frame = FrameHolder();
+  for (auto &frame : latest_) frame = FrameHolder();
+  early_bits_ = 0;
+  untimed_bits_ = 0;
+  latest_bits_ = 0;
+  fresh_bits_ = 0;
+  emitted_timestamp_ = std::numeric_limits<double>::lowest();
+  timed_ = streams_ & ~images_;
+}
+
+int64_t FrameAggregator::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameAggregator::handleFrame(FrameHolder frame) {
+  if (!accepting_) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collect(std::move(frame));
+  }
+  deliver();
+}
+
+void FrameAggregator::collect(FrameHolder frame) {
+  auto now = nowMs();
+
+  auto composite = dynamic_cast<CompositeFrameData *>(frame.frame);
+  if (composite) {
+    for (size_t i = 0; i < composite->getFrameCount(); i++) {
+      FrameInterface *member = composite->getFrame(i);
+      member->acquire();
+      addFrame(FrameHolder(member), now);
     }
+  } else {
+    addFrame(std::move(frame), now);
+  }
 
-    std::vector<FrameHolder> sync_set;
-    for (auto &&pair : last_set_) {
-      sync_set.push_back(pair.second.clone());
+  switch (trigger_) {
+    case FramesetTrigger::MATCHED:
+      emitCompleted();
+      emitExpired(now);
+      break;
+    case FramesetTrigger::LEADER:
+      if (fresh_bits_ & leader_) emitLatest();
+      break;
+    case FramesetTrigger::ALL_NEW:
+      if ((fresh_bits_ & streams_) == streams_) emitLatest();
+      break;
+    case FramesetTrigger::ANY_NEW:
+      emitLatest();
+      break;
+    default:
+      break;
+  }
+}
+
+void FrameAggregator::addFrame(FrameHolder frame, int64_t now) {
+  auto profile = frame->getStreamProfile();
+  if (!profile) return;
+  auto uid = profile->uniqueId();
+  if (uid < 0 || static_cast<size_t>(uid) >= slot_of_stream_.size() || slot_of_stream_[uid] < 0) return;
+
+  auto slot = slot_of_stream_[uid];
+  auto bit = 1u << slot;
+  if (trigger_ != FramesetTrigger::MATCHED) {
+    latest_[slot] = std::move(frame);
+    latest_bits_ |= bit;
+    fresh_bits_ |= bit;
+  } else if (images_ & bit) {
+    addImage(std::move(frame), slot, now);
+  } else if (frame->getFrameTimestamp() == 0) {
+    // nothing to match on, such a stream is carried along with every set instead
+    timed_ &= ~bit;
+    untimed_[slot] = std::move(frame);
+    untimed_bits_ |= bit;
+  } else {
+    addPerception(std::move(frame), slot);
+  }
+}
+
+void FrameAggregator::addImage(FrameHolder frame, int slot, int64_t now) {
+  auto bit = 1u << slot;
+  auto timestamp = frame->getFrameTimestamp();
+
+  // streams run on their own strands, so an image may arrive after newer ones of other streams
+  size_t pos = 0;
+  for (; pos < pending_count_; ++pos) {
+    auto &set = pendingAt(pos);
+    if (set.timestamp > timestamp) break;
+    if (set.timestamp == timestamp) {
+      if (set.present & bit) {
+        LOG(DEBUG) << "Image slot " << slot << " @" << std::fixed << timestamp << " arrived twice";
+      } else {
+        set.present |= bit;
+        set.frames[slot] = std::move(frame);
+      }
+      return;
     }
+  }
 
-    FrameHolder sync_fref(source->allocateCompositeFrame(std::move(sync_set)));
-    if (!sync_fref) {
-      LOG(ERROR) << "Failed to allocate composite frame";
+  if (timestamp <= emitted_timestamp_) {
+    LOG(DEBUG) << "Image slot " << slot << " @" << std::fixed << timestamp << " arrived after its frameset was emitted";
+    return;
+  }
+  if (pending_count_ == kMaxPendingSets) {
+    // the oldest set goes out incomplete; an image older than every set waiting would follow it out of order
+    if (!pos) {
+      LOG(DEBUG) << "Image slot " << slot << " @" << std::fixed << timestamp << " is older than every pending frameset";
       return;
     }
-    queue_->enqueue(sync_fref.clone());
-  } else {
-//    source->frameReady(frame.clone());
+    emitFront();
+    --pos;
+  }
 
-    // filter invalid frame
-    if (!frame->getStreamProfile()) return;
+  // sets stay in timestamp order
+  for (auto i = pending_count_; i > pos; --i) {
+    pendingAt(i) = std::move(pendingAt(i - 1));
+  }
+  ++pending_count_;
 
-    auto uid = frame->getStreamProfile()->uniqueId();
-    if (streams_to_aggregate_ids_.find(uid) == streams_to_aggregate_ids_.end()) {
-      return;
+  auto max_wait_ms = max_wait_ms_.load();
+  auto &set = pendingAt(pos);
+  set.timestamp = timestamp;
+  set.deadline_ms = now + max_wait_ms;
+  set.present = bit;
+  set.frames[slot] = std::move(frame);
+
+  for (auto bits = early_bits_; bits; bits &= bits - 1) {
+    auto early_slot = lowestSlot(bits);
+    if (std::abs(early_[early_slot]->getFrameTimestamp() - timestamp) <= join_window_) {
+      set.frames[early_slot] = std::move(early_[early_slot]);
+      set.present |= 1u << early_slot;
+      early_bits_ &= ~(1u << early_slot);
     }
+  }
 
-    last_set_[uid] = frame.clone();
-    if (last_set_.size() == streams_to_aggregate_ids_.size()) {
-      std::vector<FrameHolder> sync_set;
-      for (auto &&s : last_set_) {
-        sync_set.push_back(s.second.clone());
-      }
-      FrameHolder sync_fref(source->allocateCompositeFrame(std::move(sync_set)));
-      if (!sync_fref) {
-        LOG(ERROR) << "Failed to allocate composite frame";
-        return;
-      }
-      sync_fref->setTimestamp(frame->getFrameTimestamp());
-      sync_fref->setTimestampDomain(frame->getFrameTimestampDomain());
-      sync_fref->setSensor(frame->getSensor());
-      sync_fref->setStreamProfile(frame->getStreamProfile());
-      (queue_->size() < kFrameNum2Aggregate) ? queue_->enqueue(sync_fref.clone()) : queue_->popFront();
+  if (!isComplete(set)) {
+    TimerQueue::shared().schedule(max_wait_ms + 1, onTimer(&FrameAggregator::emitDue));
+  }
+}
+
+void FrameAggregator::addPerception(FrameHolder frame, int slot) {
+  auto timestamp = frame->getFrameTimestamp();
+
+  PendingSet *best = nullptr;
+  double best_distance = join_window_;
+  for (size_t i = 0; i < pending_count_; ++i) {
+    auto &set = pendingAt(i);
+    auto distance = std::abs(set.timestamp - timestamp);
+    if (distance <= best_distance) {
+      best = &set;
+      best_distance = distance;
+    }
+  }
+
+  if (best) {
+    best->frames[slot] = std::move(frame);
+    best->present |= 1u << slot;
+  } else if (!pending_count_ || timestamp > pendingAt(pending_count_ - 1).timestamp) {
+    early_[slot] = std::move(frame);
+    early_bits_ |= 1u << slot;
+  } else {
+    LOG(DEBUG) << "Perception slot " << slot << " @" << std::fixed << timestamp
+               << " arrived after its frameset was emitted";
+  }
+}
+
+bool FrameAggregator::isComplete(const PendingSet &set) const {
+  auto expected = images_ | timed_;
+  return (set.present & expected) == expected;
+}
+
+// a set that got all its results pushes out the older ones, whose results are not coming
+void FrameAggregator::emitCompleted() {
+  for (size_t i = pending_count_; i > 0; --i) {
+    if (isComplete(pendingAt(i - 1))) {
+      while (i--) emitFront();
+      break;
+    }
+  }
+}
 
-      last_set_.clear();
+// an image that came late opens its set with a later deadline than the newer ones behind it
+void FrameAggregator::emitExpired(int64_t now) {
+  for (size_t i = pending_count_; i > 0; --i) {
+    if (pendingAt(i - 1).deadline_ms <= now) {
+      while (i--) emitFront();
+      break;
     }
   }
+}
+
+void FrameAggregator::emitFront() {
+  auto &set = pendingAt(0);
+  pending_head_ = (pending_head_ + 1) % kMaxPendingSets;
+  --pending_count_;
+  emitted_timestamp_ = set.timestamp;
+
+  FrameHolder members[kFrameIdSlots];
+  size_t count = 0;
+  for (auto bits = set.present; bits; bits &= bits - 1) {
+    members[count++] = std::move(set.frames[lowestSlot(bits)]);
+  }
+  for (auto bits = untimed_bits_ & ~set.present; bits; bits &= bits - 1) {
+    members[count++] = untimed_[lowestSlot(bits)].clone();
+  }
+  emit(members, count, set.present | untimed_bits_, set.timestamp);
+}
+
+void FrameAggregator::emitLatest() {
+  if (!fresh_bits_) return;
+
+  FrameHolder members[kFrameIdSlots];
+  size_t count = 0;
+  for (auto bits = latest_bits_; bits; bits &= bits - 1) {
+    members[count++] = latest_[lowestSlot(bits)].clone();
+  }
+  auto stamp_slot = lowestSlot((trigger_ == FramesetTrigger::LEADER && (latest_bits_ & leader_)) ? leader_ : latest_bits_);
+  auto timestamp = latest_[stamp_slot]->getFrameTimestamp();
+  fresh_bits_ = 0;
+  emit(members, count, latest_bits_, timestamp);
+}
+
+void FrameAggregator::emit(FrameHolder *members, size_t count, uint32_t present, double timestamp) {
+  // the frameset holds the members from here on, first stays valid
+  auto first = members[0].frame;
+
+  FrameHolder frameset(getSource().allocateCompositeFrame(members, count));
+  if (!frameset) {
+    LOG(ERROR) << "Failed to allocate composite frame";
+    return;
+  }
+  frameset->setTimestamp(timestamp);
+  frameset->setTimestampDomain(first->getFrameTimestampDomain());
+  frameset->inheritHandles(first);
+  static_cast<FrameData *>(frameset.frame)->extension().missing_streams = (images_ | timed_) & ~present;
 
+  // the sink may block on a slow subscription, deliver() calls it once mutex_ is released
+  ready_.push_back(std::move(frameset));
 }
 
 }  // namespace libsmartereye2
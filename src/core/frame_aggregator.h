@@ -15,34 +15,110 @@
 #ifndef LIBSMARTEREYE2_FRAME_AGGREGATOR_H
 #define LIBSMARTEREYE2_FRAME_AGGREGATOR_H
 
-#include <map>
-#include <set>
 #include <atomic>
+#include <functional>
 
 #include "proc/processing.h"
-#include "concurrency/consumer_queue.h"
+#include "core/frame_data.h"
+#include "concurrency/dispatcher.h"
+#include "concurrency/timer_queue.h"
+#include "streaming/stream_types.hpp"
 
 namespace libsmartereye2 {
 
-using StreamId = int;
+class StreamProfileInterface;
+using StreamProfiles = std::vector<std::shared_ptr<StreamProfileInterface>>;
+// receives every frameset, source allocates further composites while the aggregator is alive
+using FramesetSink = std::function<void(FrameHolder frameset, SyntheticSourceInterface &source)>;
 
+// Builds framesets for the pipeline. Every stream owns a fixed slot, the position of its FrameId bit.
+//
+// With FramesetTrigger::MATCHED images that share a timestamp form a set; perception results from
+// the serial link join the set whose images they were computed from, matched by device timestamp.
+// A set waits at most max_wait_ms for its results and is then emitted with the absent streams marked
+// as missing. The other triggers emit the latest frame of every stream.
+//
+// Framesets go to the sink after the aggregator's lock is released; the ones a timer emits are built
+// and delivered on the aggregator's own thread, never on the shared timer thread.
 class FrameAggregator : public ProcessingBlock {
  public:
-  explicit FrameAggregator(const std::vector<int>& streams_to_aggregate);
+  FrameAggregator(const StreamProfiles &streams_to_aggregate, FramesetSink sink,
+                  uint32_t max_wait_ms = kDefaultMaxWaitMs);
+  ~FrameAggregator() override;
 
-  bool dequeue(FrameHolder *item, uint32_t timeout_ms);
-  bool tryDequeue(FrameHolder *item);
   void start();
   void stop();
 
+  void setMaxWait(uint32_t max_wait_ms) { max_wait_ms_ = max_wait_ms; }
+  // drops whatever is being aggregated; leader applies to LEADER, period_ms to PERIODIC
+  void setTrigger(FramesetTrigger trigger, FrameId leader, uint32_t period_ms);
+
+  static const uint32_t kDefaultMaxWaitMs = 100;
+
  private:
-  void handleFrame(const FrameHolder& frame, SyntheticSourceInterface *source);
+  // sets still waiting for perception, beyond this the oldest goes out incomplete
+  static const size_t kMaxPendingSets = 8;
+  static const unsigned int kEmitterQueueSize = 4;
+
+  struct PendingSet {
+    double timestamp;
+    int64_t deadline_ms;
+    uint32_t present;  // FrameId bits
+    FrameHolder frames[kFrameIdSlots];
+  };
 
-  std::mutex mutex_;
-  std::map<StreamId, FrameHolder> last_set_;
-  std::unique_ptr<ConsumerQueue<FrameHolder>> queue_;
-  std::set<int> streams_to_aggregate_ids_;
+  void handleFrame(FrameHolder frame);
+  void collect(FrameHolder frame);
+  void deliver();
+  // a timer callback that runs emission under the lock on emitter_ and delivers the result
+  std::function<void()> onTimer(void (FrameAggregator::*emission)());
+  void emitDue();
+  void emitPeriodic();
+  void addFrame(FrameHolder frame, int64_t now);
+  void addImage(FrameHolder frame, int slot, int64_t now);
+  void addPerception(FrameHolder frame, int slot);
+  void emitCompleted();
+  void emitExpired(int64_t now);
+  void emitFront();
+  void emitLatest();
+  void emit(FrameHolder *members, size_t count, uint32_t present, double timestamp);
+  void clearSlots();
+  bool isComplete(const PendingSet &set) const;
+  PendingSet &pendingAt(size_t i) { return pending_[(pending_head_ + i) % kMaxPendingSets]; }
+  static int64_t nowMs();
+
+  FramesetSink sink_;
   std::atomic<bool> accepting_;
+  std::atomic<uint32_t> max_wait_ms_;
+
+  std::vector<int8_t> slot_of_stream_;  // by profile unique id, -1 for streams not aggregated
+  uint32_t streams_;      // FrameId bits of every aggregated stream
+  uint32_t images_;       // FrameId bits of the image streams
+  uint32_t timed_;        // perception streams a set waits for
+  double join_window_;    // half an image period, in timestamp units
+
+  FramesetTrigger trigger_;
+  uint32_t leader_;       // FrameId bit
+  std::unique_ptr<RepeatOperation> periodic_;
+
+  PendingSet pending_[kMaxPendingSets];
+  size_t pending_head_;
+  size_t pending_count_;
+  FrameHolder early_[kFrameIdSlots];    // perception that overtook its images
+  uint32_t early_bits_;
+  FrameHolder untimed_[kFrameIdSlots];  // latest of streams without timestamps, added to every set
+  uint32_t untimed_bits_;
+  FrameHolder latest_[kFrameIdSlots];   // everything but MATCHED
+  uint32_t latest_bits_;
+  uint32_t fresh_bits_;                 // arrived since the last frameset
+  double emitted_timestamp_;            // of the newest set emitted, older images came too late
+
+  std::vector<FrameHolder> ready_;      // emitted under mutex_, waiting for deliver()
+  std::mutex sink_mutex_;               // keeps the sink calls in emission order
+  std::vector<FrameHolder> delivering_;
+
+  std::shared_ptr<LifetimeGuard> guard_;
+  Dispatcher emitter_;
 };
 
 }  // namespace libsmartereye2
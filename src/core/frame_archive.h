@@ -31,10 +31,22 @@ namespace libsmartereye2 {
 
 class ArchiveInterface {
  public:
-  virtual std::shared_ptr<SensorInterface> get_sensor() const = 0;
+  // the sensor of frames that were not given one, valid while such a frame is out
+  virtual SensorInterface *get_sensor() const = 0;
 
   virtual void set_sensor(std::shared_ptr<SensorInterface> sensor) = 0;
 
+  // Keeps what a frame of this archive points at alive until the archive's last frame returns. A
+  // handle already kept costs a few loads, so frames can be given them one by one.
+  virtual void retain(const std::shared_ptr<SensorInterface> &sensor) = 0;
+  virtual void retain(const std::shared_ptr<StreamProfileInterface> &profile) = 0;
+  // the handles of original, from another archive, for a frame of this one
+  virtual void retain_handles(const FrameInterface *original) = 0;
+
+  // owners of handles kept for the frames still out, nullptr for handles this archive does not keep
+  virtual std::shared_ptr<SensorInterface> share_sensor(const SensorInterface *sensor) const = 0;
+  virtual std::shared_ptr<StreamProfileInterface> share_profile(const StreamProfileInterface *profile) const = 0;
+
   virtual CallbackInvocationHolder begin_callback() = 0;
 
   virtual FrameInterface *alloc_and_track(size_t size, const FrameExtension &additional_data, bool requires_memory) = 0;
@@ -51,6 +63,8 @@ class ArchiveInterface {
 };
 
 static const int kUserQueueSize(128);
+static const size_t kRecycledBuffers = 8;  // data buffers an archive keeps from released frames
+static const size_t kKeptHandles = 8;      // handles an archive finds without taking its lock
 
 template<class T>
 class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, public ArchiveInterface {
@@ -62,7 +76,7 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
         time_service_(std::move(ts)),
         metadata_parsers_(std::move(parsers)),
         published_frames_count_(0) {
-
+    for (auto &handle : kept_handles_) handle = nullptr;
   }
 
   ~FrameArchive() {
@@ -105,9 +119,43 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
  protected:
   friend class FrameData;
 
-  std::shared_ptr<SensorInterface> get_sensor() const override { return sensor_.lock(); }
+  SensorInterface *get_sensor() const override { return sensor_pin_.get(); }
   void set_sensor(std::shared_ptr<SensorInterface> sensor) override { sensor_ = sensor; }
 
+  void retain(const std::shared_ptr<SensorInterface> &sensor) override {
+    if (!sensor || isKept(sensor.get())) return;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    keep(sensors_, sensor);
+  }
+
+  void retain(const std::shared_ptr<StreamProfileInterface> &profile) override {
+    if (!profile || isKept(profile.get())) return;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    keep(profiles_, profile);
+  }
+
+  void retain_handles(const FrameInterface *original) override {
+    auto sensor = original->getSensor();
+    auto profile = original->getStreamProfile();
+    auto owner = original->getOwner();
+    if (!owner) return;
+    // the owners come from original's archive before this one's lock, so the two locks never nest
+    if (sensor && !isKept(sensor)) retain(owner->share_sensor(sensor));
+    if (profile && !isKept(profile)) retain(owner->share_profile(profile));
+  }
+
+  std::shared_ptr<SensorInterface> share_sensor(const SensorInterface *sensor) const override {
+    // the caller holds a frame of this archive, which keeps sensor_pin_ from changing
+    if (sensor_pin_.get() == sensor) return sensor_pin_;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return find(sensors_, sensor);
+  }
+
+  std::shared_ptr<StreamProfileInterface> share_profile(const StreamProfileInterface *profile) const override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return find(profiles_, profile);
+  }
+
   FrameInterface *publish_frame(FrameInterface *frame) override {
     T *cur_frame = (T *) frame;
     uint32_t max_frames_size = *max_frame_queue_size_;
@@ -131,8 +179,32 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
   void unpublish_frame(FrameInterface *frame) override {
     if (frame) {
       T *f = (T *) frame;
+      // the last frame out lets go of the sensors the frames pointed at, outside the lock, this may be
+      // the last owner of one and its destructor flushes this archive. Profiles own nothing and stay
+      // kept for the next frames, unless the stream went through more than fit the kept handles
+      std::shared_ptr<SensorInterface> sensors[kKeptHandles + 1];
+      std::vector<std::shared_ptr<SensorInterface>> more_sensors;
       std::unique_lock<std::recursive_mutex> lock(mutex_);
       frame->keep();
+      if (freelist_.size() < kRecycledBuffers && f->data().capacity() > 0) {
+        freelist_.push_back(std::move(f->data()));
+        f->data().clear();
+      }
+      if (--live_frames_ == 0) {
+        sensors[0].swap(sensor_pin_);
+        for (size_t i = 0; i < sensors_.size(); ++i) {
+          if (i < kKeptHandles) {
+            sensors[i + 1].swap(sensors_[i]);
+          } else {
+            more_sensors.push_back(std::move(sensors_[i]));
+          }
+        }
+        sensors_.clear();
+        if (profiles_.size() > kKeptHandles) profiles_.clear();
+        size_t slot = 0;
+        for (const auto &profile : profiles_) kept_handles_[slot++].store(profile.get(), std::memory_order_relaxed);
+        while (slot < kKeptHandles) kept_handles_[slot++].store(nullptr, std::memory_order_relaxed);
+      }
       lock.unlock();
 
       if (f->isFixed())
@@ -152,6 +224,13 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
     T back_buffer;
 
     if (requires_memory) {
+      // a released frame's buffer already has the capacity, steady streams allocate nothing
+      std::unique_lock<std::recursive_mutex> lock(mutex_);
+      if (!freelist_.empty()) {
+        back_buffer.data().swap(freelist_.back());
+        freelist_.pop_back();
+      }
+      lock.unlock();
       back_buffer.data().resize(size, 0);
     }
     back_buffer.extension() = frame_extension;
@@ -162,6 +241,7 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
     std::unique_lock<std::recursive_mutex> locker(mutex_);
     auto published_frame = f.publish(this->shared_from_this());
     if (published_frame) {
+      if (live_frames_++ == 0) sensor_pin_ = sensor_.lock();
       published_frame->acquire();
       return published_frame;
     }
@@ -179,13 +259,51 @@ class FrameArchive : public std::enable_shared_from_this<FrameArchive<T>>, publi
   std::shared_ptr<MetadataParserMap> metadata_parsers_ = nullptr;
   CallbacksHeap callback_inflight_;
 
-//  std::vector<T> freelist_; // return frames here
-//  std::atomic<bool> recycle_frames_{};
+  std::vector<std::vector<char>> freelist_;  // buffers of released frames, under mutex_
   int pending_frames_size_ = 0;
-  std::recursive_mutex mutex_;
+  mutable std::recursive_mutex mutex_;
   std::shared_ptr<platform::TimeService> time_service_;
 
   std::weak_ptr<SensorInterface> sensor_;
+
+  // Everything below changes under mutex_, the sensors live from the first frame out to the last one
+  // back. A live frame keeps that span open, so whatever it finds in kept_handles_ stays kept for as
+  // long as it looks.
+  size_t live_frames_ = 0;
+  std::shared_ptr<SensorInterface> sensor_pin_;
+  std::vector<std::shared_ptr<SensorInterface>> sensors_;
+  std::vector<std::shared_ptr<StreamProfileInterface>> profiles_;
+  std::atomic<const void *> kept_handles_[kKeptHandles];
+
+  bool isKept(const void *handle) const {
+    for (const auto &kept : kept_handles_) {
+      auto current = kept.load(std::memory_order_acquire);
+      if (current == handle) return true;
+      if (!current) break;
+    }
+    return false;
+  }
+
+  template<class H>
+  void keep(std::vector<std::shared_ptr<H>> &kept, const std::shared_ptr<H> &handle) {
+    if (isKept(handle.get())) return;
+    if (find(kept, handle.get())) return;
+    kept.push_back(handle);
+    for (auto &slot : kept_handles_) {
+      if (!slot.load(std::memory_order_relaxed)) {
+        slot.store(handle.get(), std::memory_order_release);
+        break;
+      }
+    }
+  }
+
+  template<class H>
+  static std::shared_ptr<H> find(const std::vector<std::shared_ptr<H>> &kept, const H *handle) {
+    for (const auto &owner : kept) {
+      if (owner.get() == handle) return owner;
+    }
+    return nullptr;
+  }
 };
 
 }  // namespace libsmartereye2
@@ -13,11 +13,25 @@
 // limitations under the License.
 
 #include "frame_data.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
 #include "streaming/streaming.h"
 #include "streaming/stream_profile.h"
 
 namespace libsmartereye2 {
 
+namespace {
+
+// bytes of the derived frames cached on all frames, and what they may add up to
+std::atomic<size_t> derived_bytes(0);
+std::atomic<size_t> derived_limit(64u << 20);
+
+}  // namespace
+
 std::shared_ptr<ArchiveInterface> makeArchive(SeExtension extension_type,
                                               std::atomic<uint32_t> *in_max_frame_queue_size,
                                               const std::shared_ptr<platform::TimeService> &ts,
@@ -109,39 +123,57 @@ std::shared_ptr<ArchiveInterface> makeArchive(SeExtension extension_type,
 }
 
 FrameData::FrameData()
-    : ref_count_(0), kept_(false), owner_(nullptr) {
+    : ref_count_(0), kept_(false), owner_(nullptr), sensor_(nullptr), stream_profile_(nullptr) {
 }
 
-FrameData::~FrameData() = default;
+FrameData::~FrameData() {
+  releaseExternalData();
+}
 
 FrameData::FrameData(FrameData &&other) noexcept
     : ref_count_(other.ref_count_.exchange(0)),
       kept_(other.kept_.exchange(false)),
-      owner_(other.owner_) {
+      owner_(other.owner_),
+      sensor_(nullptr),
+      stream_profile_(nullptr) {
   *this = std::move(other);
 }
 
 FrameData &FrameData::operator=(FrameData &&other) noexcept {
+  releaseExternalData();
   data_ = std::move(other.data_);
+  external_data_ = other.external_data_;
+  external_size_ = other.external_size_;
+  external_release_ = std::move(other.external_release_);
+  other.external_data_ = nullptr;
+  other.external_size_ = 0;
+  other.external_release_ = nullptr;
   extension_data_ = std::move(other.extension_data_);
   ref_count_ = other.ref_count_.exchange(0);
   kept_ = other.kept_.exchange(false);
   owner_ = other.owner_;
   other.owner_.reset();
+  sensor_ = other.sensor_;
+  stream_profile_ = other.stream_profile_;
+  other.sensor_ = nullptr;
+  other.stream_profile_ = nullptr;
   return *this;
 }
 
-std::shared_ptr<SensorInterface> FrameData::getSensor() const {
-  auto handle = sensor_.lock();
-  if (!handle) {
-    auto archive = getOwner();
-    if (archive) return archive->get_sensor();
-  }
-  return handle;
+SensorInterface *FrameData::getSensor() const {
+  if (sensor_ || !owner_) return sensor_;
+  return owner_->get_sensor();
 }
 
-void FrameData::setSensor(std::shared_ptr<SensorInterface> sensor) {
-  sensor_ = sensor;
+void FrameData::setSensor(const std::shared_ptr<SensorInterface> &sensor) {
+  sensor_ = sensor.get();
+  if (owner_) owner_->retain(sensor);
+}
+
+void FrameData::inheritHandles(const FrameInterface *original) {
+  sensor_ = original->getSensor();
+  stream_profile_ = original->getStreamProfile();
+  if (owner_) owner_->retain_handles(original);
 }
 
 const char *FrameData::getFrameMetadata(const FrameMetadataValue &frame_metadata) const {
@@ -157,11 +189,105 @@ bool FrameData::supportsFrameMetadata(const FrameMetadataValue &frame_metadata)
 }
 
 size_t FrameData::getFrameDataSize() const {
-  return data_.size();
+  return external_data_ ? external_size_ : data_.size();
 }
 
 const char *FrameData::getFrameData() const {
-  return data_.data();
+  return external_data_ ? external_data_ : data_.data();
+}
+
+void FrameData::attachExternalData(const char *data, size_t size, std::function<void()> on_release) {
+  releaseExternalData();
+  external_data_ = data;
+  external_size_ = size;
+  external_release_ = std::move(on_release);
+}
+
+void FrameData::releaseExternalData() {
+  external_data_ = nullptr;
+  external_size_ = 0;
+  if (external_release_) {
+    auto on_release = std::move(external_release_);
+    external_release_ = nullptr;
+    on_release();
+  }
+}
+
+FrameInterface *FrameData::derived(uint64_t key, const std::function<FrameInterface *()> &make) {
+  std::unique_lock<std::mutex> lock(derived_mutex_);
+  int slot = -1;
+  for (bool pending = true; pending;) {
+    pending = false;
+    slot = -1;
+    for (int i = 0; i < kDerivedFrames; ++i) {
+      auto &entry = derived_[i];
+      if (entry.used && entry.key == key) {
+        if (entry.frame) {
+          entry.frame->acquire();
+          return entry.frame;
+        }
+        pending = true;
+      } else if (!entry.used && slot < 0) {
+        slot = i;
+      }
+    }
+    if (pending) derived_ready_.wait(lock);
+  }
+  if (slot >= 0) derived_[slot] = DerivedFrame{true, key, nullptr, 0};
+  lock.unlock();
+
+  // other keys are looked up and made meanwhile
+  FrameInterface *frame = nullptr;
+  try {
+    frame = make();
+  } catch (...) {
+    if (slot >= 0) {
+      lock.lock();
+      derived_[slot].used = false;
+      lock.unlock();
+      derived_ready_.notify_all();
+    }
+    throw;
+  }
+  if (slot < 0) return frame;
+
+  auto size = frame ? frame->getFrameDataSize() : 0;
+  bool cached = frame && derived_bytes.fetch_add(size) + size <= derived_limit.load();
+  if (frame && !cached) derived_bytes.fetch_sub(size);
+  lock.lock();
+  auto &entry = derived_[slot];
+  if (cached) {
+    frame->acquire();
+    if (kept_) frame->keep();
+    entry.frame = frame;
+    entry.size = size;
+  } else {
+    entry.used = false;
+  }
+  lock.unlock();
+  derived_ready_.notify_all();
+  return frame;
+}
+
+void FrameData::setDerivedMemoryLimit(size_t bytes) {
+  derived_limit = bytes;
+}
+
+void FrameData::releaseDerived() {
+  DerivedFrame entries[kDerivedFrames];
+  {
+    std::lock_guard<std::mutex> lock(derived_mutex_);
+    for (int i = 0; i < kDerivedFrames; ++i) {
+      entries[i] = derived_[i];
+      derived_[i].used = false;
+      derived_[i].frame = nullptr;
+    }
+  }
+  for (const auto &entry : entries) {
+    if (!entry.used || !entry.frame) continue;
+    derived_bytes.fetch_sub(entry.size);
+    entry.frame->release();
+  }
 }
 
 double FrameData::getFrameTimestamp() const {
@@ -180,7 +306,7 @@ int64_t FrameData::getSpeed() const {
   return extension_data_.speed;
 }
 
-std::shared_ptr<StreamProfileInterface> FrameData::getStreamProfile() const {
+StreamProfileInterface *FrameData::getStreamProfile() const {
   return stream_profile_;
 }
 
@@ -192,16 +318,27 @@ void FrameData::setTimestampDomain(TimestampDomain timestamp_domain) {
   extension_data_.timestamp_domain = timestamp_domain;
 }
 
-void FrameData::setStreamProfile(std::shared_ptr<StreamProfileInterface> sp) {
-  stream_profile_ = sp;
+void FrameData::setStreamProfile(const std::shared_ptr<StreamProfileInterface> &sp) {
+  stream_profile_ = sp.get();
+  if (owner_) owner_->retain(sp);
 }
 
 void FrameData::acquire() {
-  ref_count_.fetch_add(1);
+  ref_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FrameData::releaseRef() {
+  // acquire() needs a reference of its own, so the only owner has nobody to race with and needs no
+  // read-modify-write; the acquire load still orders the other owners' releases before the reuse
+  if (ref_count_.load(std::memory_order_acquire) == 1) {
+    ref_count_.store(0, std::memory_order_relaxed);
+    return true;
+  }
+  return ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
 }
 
 void FrameData::release() {
-  if (ref_count_.fetch_sub(1) == 1) {
+  if (releaseRef()) {
     unpublish();
     owner_->unpublish_frame(this);
   }
@@ -210,6 +347,10 @@ void FrameData::release() {
 void FrameData::keep() {
   if (!kept_.exchange(true)) {
     owner_->keep_frame(this);
+    std::lock_guard<std::mutex> lock(derived_mutex_);
+    for (const auto &entry : derived_) {
+      if (entry.used && entry.frame) entry.frame->keep();
+    }
   }
 }
 
@@ -224,8 +365,34 @@ FrameInterface *CompositeFrameData::getFrame(size_t i) const {
   return frames[i];
 }
 
+void CompositeFrameData::assign(FrameHolder *members, size_t count) {
+  setFrameCount(count);
+  std::memset(member_of_slot_, 0, sizeof(member_of_slot_));
+  streams_ = 0;
+
+  auto frames = getFrames();
+  for (size_t i = 0; i < count; ++i) {
+    frames[i] = nullptr;
+    std::swap(frames[i], members[i].frame);
+    if (frames[i]->isBlocking()) setBlocking(true);
+
+    auto profile = frames[i]->getStreamProfile();
+    auto slot = profile ? frameIdSlot(profile->frameId()) : -1;
+    if (slot >= 0 && !member_of_slot_[slot]) {
+      member_of_slot_[slot] = static_cast<uint8_t>(i + 1);
+      streams_ |= 1u << slot;
+    }
+  }
+}
+
+FrameInterface *CompositeFrameData::find(FrameId frame_id) const {
+  auto slot = frameIdSlot(frame_id);
+  if (slot < 0 || !member_of_slot_[slot]) return nullptr;
+  return getFrame(member_of_slot_[slot] - 1);
+}
+
 void CompositeFrameData::release() {
-  if (ref_count_.fetch_sub(1) == 1) {
+  if (releaseRef()) {
     unpublish(); // not used
     auto frames = getFrames();
     for (int i = 0; i < getFrameCount(); i++) {
@@ -233,6 +400,9 @@ void CompositeFrameData::release() {
         frames[i]->release();
       }
     }
+    // the archive hands this frame out again, possibly to a producer that does not assign()
+    std::memset(member_of_slot_, 0, sizeof(member_of_slot_));
+    streams_ = 0;
     owner_->unpublish_frame(this);
   }
 }
@@ -249,38 +419,70 @@ void DepthFrameData::keep() {
 }
 
 float DepthFrameData::distance(int x, int y) const {
-  if (original_ && getStreamProfile()->format() != FrameFormat::Disparity16) {
+  auto profile = getStreamProfile();
+  auto format = profile ? profile->format() : FrameFormat::Any;
+  if (original_ && formatUnits(format) == 0.f) {
     return (reinterpret_cast<DepthFrameData *>(original_.frame))->distance(x, y);
   }
+  if (x < 0 || y < 0 || x >= width() || y >= height()) {
+    throw std::runtime_error(toString() << "Pixel (" << x << ", " << y << ") is outside of the "
+                                        << width() << "x" << height() << " frame");
+  }
 
-  uint64_t pixel = 0;
-  switch (bpp() / 8) // bits per pixel
-  {
-    case 1: pixel = getFrameData()[y * width() + x];
-      break;
-    case 2: pixel = reinterpret_cast<const uint16_t *>(getFrameData())[y * width() + x];
-      break;
-    case 4: pixel = reinterpret_cast<const uint32_t *>(getFrameData())[y * width() + x];
+  auto row_bytes = getStrideByFormat(format, width());
+  auto row = reinterpret_cast<const uint8_t *>(getFrameData())
+      + static_cast<size_t>(stride() ? stride() : row_bytes) * y;
+  uint32_t value = 0;
+  switch (format) {
+    case FrameFormat::Depth16:
+      return reinterpret_cast<const uint16_t *>(row)[x] * units();
+    case FrameFormat::DepthFloat:
+      return reinterpret_cast<const float *>(row)[x] * units();
+    case FrameFormat::Disparity7:
+    case FrameFormat::Disparity8:
+    case FrameFormat::Disparity10:
+    case FrameFormat::Disparity12: {
+      // values are packed LSB first, one spans at most three bytes
+      auto bits = getBppByFormat(format);
+      auto first = x * bits / 8;
+      for (int i = 2; i >= 0; --i) {
+        value = (value << 8) | (first + i < row_bytes ? row[first + i] : 0u);
+      }
+      value = (value >> (x * bits % 8)) & ((1u << bits) - 1);
       break;
-    case 8: pixel = reinterpret_cast<const uint64_t *>(getFrameData())[y * width() + x];
+    }
+    case FrameFormat::DisparitySparse:
+    case FrameFormat::Disparity16:
+      value = reinterpret_cast<const uint16_t *>(row)[x];
       break;
     default:
-      throw std::runtime_error(toString() << "Unrecognized depth format " << int(bpp() / 8) << " bytes per pixel");
+      throw std::runtime_error(toString() << "Unrecognized depth format " << static_cast<int>(format));
   }
-
-  return pixel * units();
+  auto disparity = value * units();
+  return disparity > 0.f ? profile->getIntrinsics().bf_value / disparity : 0.f;
 }
 
 float DepthFrameData::units() const {
-  return 0.f; // TODO
+  auto profile = getStreamProfile();
+  return profile ? formatUnits(profile->format()) : 0.f;
 }
 
 void DepthFrameData::setOriginal(FrameHolder holder) {
   original_ = std::move(holder);
 }
 
-float DepthFrameData::queryUnits(const std::shared_ptr<SensorInterface> &sensor) {
-  return 0.f; // TODO
+float DepthFrameData::formatUnits(FrameFormat format) {
+  switch (format) {
+    case FrameFormat::Depth16: return 0.001f;
+    case FrameFormat::DepthFloat: return 1.f;
+    case FrameFormat::Disparity7:
+    case FrameFormat::Disparity8: return 1.f;
+    case FrameFormat::Disparity10: return 0.25f;
+    case FrameFormat::Disparity12: return 1.f / 16;
+    case FrameFormat::DisparitySparse:
+    case FrameFormat::Disparity16: return 1.f / (1 << kDisparity16FractionBits);
+    default: return 0.f;
+  }
 }
 
 const Vertex *PointsData::vertex() const {
@@ -301,7 +503,74 @@ const TextureCoordinate *PointsData::textureCoordinate() const {
 }
 
 void PointsData::exportToPly(const std::string &fname, const FrameHolder &texture) {
+  const auto *xyz = vertex();
+  const auto *uv = textureCoordinate();
+  auto count = vertexCount();
+
+  // colours are sampled from 8-bit Gray, Color (BGR), RGB and RGBA textures
+  auto video = dynamic_cast<VideoFrameData *>(texture.frame);
+  auto texture_profile = video ? video->getStreamProfile() : nullptr;
+  auto texture_format = texture_profile ? texture_profile->format() : FrameFormat::Any;
+  int channels = 0;
+  switch (texture_format) {
+    case FrameFormat::Gray: channels = 1; break;
+    case FrameFormat::Color:
+    case FrameFormat::RGB: channels = 3; break;
+    case FrameFormat::RGBA: channels = 4; break;
+    default: break;
+  }
+  auto texture_stride = channels && video->stride() ? video->stride() : (video ? video->width() * channels : 0);
+  if (channels && (video->width() <= 0 || video->height() <= 0
+      || video->getFrameDataSize() < static_cast<size_t>(texture_stride) * video->height())) {
+    channels = 0;
+  }
 
+  size_t valid = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (xyz[i].z != 0.f) ++valid;
+  }
+
+  std::ofstream out(fname, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error(toString() << "Cannot open " << fname << " to export points");
+  }
+  out << "ply\nformat binary_little_endian 1.0\ncomment generated by libsmartereye2\n"
+      << "element vertex " << valid << "\n"
+      << "property float x\nproperty float y\nproperty float z\n";
+  if (channels) out << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  out << "end_header\n";
+
+  // records are written in blocks rather than one by one
+  const size_t record_size = sizeof(Vertex) + (channels ? 3 : 0);
+  std::vector<char> block;
+  block.reserve(record_size * 4096);
+  auto pixels = channels ? reinterpret_cast<const uint8_t *>(video->getFrameData()) : nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    if (xyz[i].z == 0.f) continue;
+    auto record = reinterpret_cast<const char *>(&xyz[i]);
+    block.insert(block.end(), record, record + sizeof(Vertex));
+    if (channels) {
+      auto x = std::min(std::max(static_cast<int>(uv[i].u * video->width()), 0), video->width() - 1);
+      auto y = std::min(std::max(static_cast<int>(uv[i].v * video->height()), 0), video->height() - 1);
+      auto pixel = pixels + static_cast<size_t>(texture_stride) * y + x * channels;
+      bool bgr = texture_format == FrameFormat::Color;
+      char rgb[3] = {static_cast<char>(pixel[0]), static_cast<char>(pixel[0]), static_cast<char>(pixel[0])};
+      if (channels >= 3) {
+        rgb[0] = static_cast<char>(pixel[bgr ? 2 : 0]);
+        rgb[1] = static_cast<char>(pixel[1]);
+        rgb[2] = static_cast<char>(pixel[bgr ? 0 : 2]);
+      }
+      block.insert(block.end(), rgb, rgb + 3);
+    }
+    if (block.size() + record_size > block.capacity()) {
+      out.write(block.data(), block.size());
+      block.clear();
+    }
+  }
+  out.write(block.data(), block.size());
+  if (!out) {
+    throw std::runtime_error(toString() << "Failed to write points to " << fname);
+  }
 }
 
 void JourneyFrameData::loadData(const uint8_t *data, uint32_t data_size) {
@@ -15,9 +15,14 @@
 #ifndef LIBSMARTEREYE2_FRAME_DATA_H
 #define LIBSMARTEREYE2_FRAME_DATA_H
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
 #include "frame.h"
 #include "frame_archive.h"
 #include "core/core_types.hpp"
+#include "streaming/stream_types.hpp"
 #include "device/device_types.hpp"
 #include "se_util.hpp"
 #include "alg/packed_types.h"
@@ -29,6 +34,24 @@ std::shared_ptr<ArchiveInterface> makeArchive(SeExtension extension_type,
                                               const std::shared_ptr<platform::TimeService> &ts,
                                               const std::shared_ptr<MetadataParserMap> &parsers);
 
+// FrameIds are single bits, the bit position indexes fixed per-stream tables
+static const int kFrameIdSlots = 32;
+
+inline int frameIdSlot(FrameId frame_id) {
+  auto bits = static_cast<uint32_t>(frame_id);
+  if (!bits) return -1;
+#if defined(__GNUC__)
+  return __builtin_ctz(bits);
+#else
+  int slot = 0;
+  while (!(bits & 1u)) {
+    bits >>= 1;
+    ++slot;
+  }
+  return slot;
+#endif
+}
+
 class FrameData : public FrameInterface, public noncopyable {
  public:
   FrameData();
@@ -44,9 +67,9 @@ class FrameData : public FrameInterface, public noncopyable {
     data_.assign(data, data + data_size);
   }
 
-  std::shared_ptr<SensorInterface> getSensor() const override;
+  SensorInterface *getSensor() const override;
 
-  void setSensor(std::shared_ptr<SensorInterface> sensor) override;
+  void setSensor(const std::shared_ptr<SensorInterface> &sensor) override;
 
   const char *getFrameMetadata(const FrameMetadataValue &frame_metadata) const override;
 
@@ -66,13 +89,15 @@ class FrameData : public FrameInterface, public noncopyable {
 
   int64_t getSpeed() const override;
 
-  std::shared_ptr<StreamProfileInterface> getStreamProfile() const override;
+  StreamProfileInterface *getStreamProfile() const override;
 
   void setTimestamp(double new_ts) override;
 
   void setTimestampDomain(TimestampDomain timestamp_domain) override;
 
-  void setStreamProfile(std::shared_ptr<StreamProfileInterface> sp) override;
+  void setStreamProfile(const std::shared_ptr<StreamProfileInterface> &sp) override;
+
+  void inheritHandles(const FrameInterface *original) override;
 
   void acquire() override;
 
@@ -82,7 +107,12 @@ class FrameData : public FrameInterface, public noncopyable {
 
   FrameInterface *publish(std::shared_ptr<ArchiveInterface> new_owner) override;
 
-  void unpublish() override {}
+  void unpublish() override {
+    releaseDerived();
+    releaseExternalData();
+    sensor_ = nullptr;
+    stream_profile_ = nullptr;
+  }
 
   void markFixed() override { fixed_ = true; }
 
@@ -98,15 +128,47 @@ class FrameData : public FrameInterface, public noncopyable {
 
   FrameExtension &extension() { return extension_data_; }
 
+  // Lets the frame expose memory it does not own (e.g. a shared-memory slot) instead of data_.
+  // on_release runs once, when the frame goes back to its archive.
+  void attachExternalData(const char *data, size_t size, std::function<void()> on_release);
+
+  // The frame derived from this one under key, made by make() the first time it is asked for. Callers
+  // on other threads asking for the same key wait for that and share the result, which is released
+  // together with this frame. Returned acquired, nullptr when make() fails.
+  FrameInterface *derived(uint64_t key, const std::function<FrameInterface *()> &make);
+
+  // Bytes the derived frames cached on all frames may add up to, process wide. Frames derived beyond it
+  // are returned without being cached; 0 turns the cache off.
+  static void setDerivedMemoryLimit(size_t bytes);
+
  protected:
+  void releaseExternalData();
+  void releaseDerived();
+
+  // true when the caller dropped the last reference
+  bool releaseRef();
+
   std::vector<char> data_;
+  const char *external_data_ = nullptr;
+  size_t external_size_ = 0;
+  std::function<void()> external_release_;
+  struct DerivedFrame {
+    bool used;
+    uint64_t key;
+    FrameInterface *frame;  // nullptr while it is being made
+    size_t size;
+  };
+  static const int kDerivedFrames = 8;
+  std::mutex derived_mutex_;
+  std::condition_variable derived_ready_;
+  DerivedFrame derived_[kDerivedFrames] = {};
   FrameExtension extension_data_;
   std::atomic<int> ref_count_;
   std::atomic_bool kept_;
   bool fixed_{};
   std::shared_ptr<ArchiveInterface> owner_; // pointer to the owner to be returned to by last observe
-  std::weak_ptr<SensorInterface> sensor_;
-  std::shared_ptr<StreamProfileInterface> stream_profile_ = nullptr;
+  SensorInterface *sensor_;                  // kept alive by owner_, nullptr for the archive's own sensor
+  StreamProfileInterface *stream_profile_;   // kept alive by owner_
 };
 
 class CompositeFrameData : public FrameData {
@@ -125,8 +187,19 @@ class CompositeFrameData : public FrameData {
 
   void setFrameCount(size_t count) { frame_count_ = count; }
 
+  // takes the members over and indexes them by stream
+  void assign(FrameHolder *members, size_t count);
+
+  // first member of the stream, nullptr when the set has none
+  FrameInterface *find(FrameId frame_id) const;
+
+  // FrameId bits of the members, 0 when the set was not built by assign()
+  uint32_t streams() const { return streams_; }
+
  private:
   size_t frame_count_ = 0;
+  uint32_t streams_ = 0;
+  uint8_t member_of_slot_[kFrameIdSlots] = {};  // member index + 1, 0 when absent
 };
 
 class VideoFrameData : public FrameData {
@@ -157,23 +230,24 @@ class VideoFrameData : public FrameData {
 
 class DepthFrameData : public VideoFrameData {
  public:
-  DepthFrameData() : VideoFrameData(), depth_units_(0.f) {}
+  DepthFrameData() : VideoFrameData() {}
 
   FrameInterface *publish(std::shared_ptr<ArchiveInterface> new_owner) override;
 
   void keep() override;
 
+  // metres to whatever is seen at (x, y), 0 where it is unknown
   float distance(int x, int y) const;
 
+  // metres per value of a depth frame, pixels per value of a disparity frame
   float units() const;
 
   void setOriginal(FrameHolder holder);
 
- private:
-  static float queryUnits(const std::shared_ptr<SensorInterface> &sensor);
+  static float formatUnits(FrameFormat format);
 
+ private:
   FrameHolder original_;
-  mutable float depth_units_;
 };
 
 class DisparityData : public DepthFrameData {
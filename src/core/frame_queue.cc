@@ -21,13 +21,19 @@ using namespace libsmartereye2;
 
 namespace se2 {
 
+FrameQueue::FrameQueue(uint32_t capacity, bool keep_frames)
+    : queue_(std::make_shared<SeFrameQueue>(static_cast<int>(capacity))), capacity_(capacity), keep_(keep_frames) {
+}
+
 void FrameQueue::operator()(Frame frame) {
   enqueue(std::move(frame));
 }
 
 void FrameQueue::enqueue(Frame frame) {
   if (keep_) frame.keep();
-  FrameHolder fh(frame.frame_ref_);
+  FrameInterface *ref = nullptr;
+  std::swap(ref, frame.frame_ref_);
+  FrameHolder fh(ref);
   queue_->queue.enqueue(std::move(fh));
 }
 
@@ -42,33 +48,24 @@ Frame FrameQueue::waitForFrame(int32_t timeout_ms) const {
   return Frame(frame);
 }
 
-//template<typename T>
-//bool FrameQueue::pollForFrame(T *output) const {
-//  if (!std::is_base_of<Frame, T>::value) return false;
-//
-//  FrameHolder fh;
-//  if (queue_->queue.tryDequeue(&fh)) {
-//    FrameInterface *frame = nullptr;
-//    std::swap(frame, fh.frame);
-//    *output = frame;
-//  }
-//
-//  return false;
-//}
-//
-//template<typename T>
-//bool FrameQueue::tryWaitForFrame(T *output, uint32_t timeout_ms) const {
-//  if (!std::is_base_of<Frame, T>::value) return false;
-//
-//  libsmartereye2::FrameHolder fh;
-//  if (queue_->queue.dequeue(&fh, timeout_ms)) {
-//    return false;
-//  }
-//
-//  FrameInterface *frame = nullptr;
-//  std::swap(frame, fh.frame);
-//  *output = frame;
-//  return true;
-//}
+bool FrameQueue::pollForFrame(Frame *output) const {
+  FrameHolder fh;
+  if (!queue_->queue.tryDequeue(&fh)) return false;
+
+  FrameInterface *frame = nullptr;
+  std::swap(frame, fh.frame);
+  *output = Frame(frame);
+  return true;
+}
+
+bool FrameQueue::tryWaitForFrame(Frame *output, uint32_t timeout_ms) const {
+  FrameHolder fh;
+  if (!queue_->queue.dequeue(&fh, timeout_ms)) return false;
+
+  FrameInterface *frame = nullptr;
+  std::swap(frame, fh.frame);
+  *output = Frame(frame);
+  return true;
+}
 
 }  // namespace se2
@@ -14,15 +14,47 @@
 
 #include "frame_source.h"
 #include "frame_data.h"
+#include "options.h"
 #include "easylogging++.h"
 
 #include <utility>
 
 namespace libsmartereye2 {
 
+namespace {
+
+// reads the limit straight from the source, so set_max_publish_list_size() shows up in query()
+class PublishedSizeOption : public Option {
+ public:
+  PublishedSizeOption(std::atomic<uint32_t> *size, uint32_t def) : size_(size), def_(def) {}
+
+  void set(float value) override {
+    auto range = getRange();
+    if (value < range.min || value > range.max) {
+      throw std::runtime_error(toString() << "Option value " << value << " is out of range ["
+                                          << range.min << ", " << range.max << "]");
+    }
+    *size_ = static_cast<uint32_t>(value);
+  }
+
+  float query() const override { return static_cast<float>(size_->load()); }
+  OptionRange getRange() const override { return OptionRange{0, 1024, 1, static_cast<float>(def_)}; }
+  bool isEnabled() const override { return true; }
+  std::string getDescription() const override {
+    return "Maximum number of frames of one type held by the application at a time, 0 for unlimited";
+  }
+
+ private:
+  std::atomic<uint32_t> *size_;
+  uint32_t def_;
+};
+
+}  // namespace
+
 FrameSource::FrameSource(uint32_t max_publish_list_size)
     : frame_callback_(nullptr),
       max_publish_list_size_(max_publish_list_size),
+      published_size_option_(std::make_shared<PublishedSizeOption>(&max_publish_list_size_, max_publish_list_size)),
       time_service_(Environment::instance().getTimeService()) {
 
 }
@@ -72,7 +104,7 @@ void FrameSource::reset() {
 }
 
 std::shared_ptr<Option> FrameSource::get_published_size_option() {
-  return std::shared_ptr<Option>();
+  return published_size_option_;
 }
 
 FrameInterface *FrameSource::alloc_frame(SeExtension type,
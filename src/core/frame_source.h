@@ -77,6 +77,7 @@ class FrameSource {
   mutable std::mutex callback_mutex_;
 
   std::atomic<uint32_t> max_publish_list_size_;
+  std::shared_ptr<Option> published_size_option_;
   std::shared_ptr<platform::TimeService> time_service_;
   std::shared_ptr<MetadataParserMap> metadata_parsers_;
 };
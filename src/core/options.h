@@ -18,6 +18,7 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
 
 #include "se_util.hpp"
 #include "core/core_types.hpp"
@@ -46,6 +47,33 @@ class Option : public noncopyable {
   virtual std::string getValueDescription(float value) const { return std::string(); }
 };
 
+// A plain numeric option; on_set may reject the value by throwing.
+class RangeOption : public Option {
+ public:
+  RangeOption(OptionRange range, std::string description, std::function<void(float)> on_set = nullptr)
+      : range_(range), value_(range.def), description_(std::move(description)), on_set_(std::move(on_set)) {}
+
+  void set(float value) override {
+    if (value < range_.min || value > range_.max) {
+      throw std::runtime_error(toString() << "Option value " << value << " is out of range ["
+                                          << range_.min << ", " << range_.max << "]");
+    }
+    if (on_set_) on_set_(value);
+    value_ = value;
+  }
+
+  float query() const override { return value_; }
+  OptionRange getRange() const override { return range_; }
+  bool isEnabled() const override { return true; }
+  std::string getDescription() const override { return description_; }
+
+ private:
+  OptionRange range_;
+  float value_;
+  std::string description_;
+  std::function<void(float)> on_set_;
+};
+
 class OptionsInterface {
  public:
   virtual Option &getOption(OptionKey id) = 0;
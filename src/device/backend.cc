@@ -56,7 +56,7 @@ std::vector<UsbDeviceInfo> StandardBackend::queryUsbDevices() const {
 }
 
 std::shared_ptr<platform::TimeService> StandardBackend::createTimeService() const {
-  return std::shared_ptr<platform::OsTimeService>();
+  return std::make_shared<platform::OsTimeService>();
 }
 
 std::shared_ptr<DeviceWather> StandardBackend::createDeviceWatcher() const {
@@ -64,10 +64,17 @@ std::shared_ptr<DeviceWather> StandardBackend::createDeviceWatcher() const {
 }
 
 PollingDeviceWatcher::PollingDeviceWatcher(const Backend *backend)
-    : backend_(backend),
-      repeat_operation_([this](Dispatcher::CancellableTimer timer) {
-        polling(timer);
-      }),
+    : poller_(1, ThreadRole::DEVICE_WATCHER, "se2-devwatch"),
+      poll_queued_(false),
+      repeat_operation_([this]() {
+        // a slow enumeration skips ticks instead of queueing them up
+        if (poll_queued_.exchange(true)) return;
+        poller_.invoke([this](Dispatcher::CancellableTimer) {
+          poll_queued_ = false;
+          polling();
+        });
+      }, 1000),
+      backend_(backend),
       discovered_devices_() {
 }
 
@@ -75,15 +82,15 @@ PollingDeviceWatcher::~PollingDeviceWatcher() {
   stop();
 }
 
-void PollingDeviceWatcher::polling(Dispatcher::CancellableTimer timer) {
-  if (timer.trySleep(1000)) {
-    platform::BackendDeviceGroup curr(backend_->queryUsbDevices());
-    if (listChanged(discovered_devices_.usb_devices, curr.usb_devices)) {
-      CallbackInvocationHolder callback = {callback_inflight_.allocate(), &callback_inflight_};
-      if (callback) {
-        callback_(discovered_devices_, curr);
-        discovered_devices_ = curr;
-      }
+void PollingDeviceWatcher::polling() {
+  platform::BackendDeviceGroup curr(backend_->queryUsbDevices());
+  curr.shared_devices = backend_->querySharedDevices();
+  if (listChanged(discovered_devices_.usb_devices, curr.usb_devices)
+      || listChanged(discovered_devices_.shared_devices, curr.shared_devices)) {
+    CallbackInvocationHolder callback = {callback_inflight_.allocate(), &callback_inflight_};
+    if (callback) {
+      callback_(discovered_devices_, curr);
+      discovered_devices_ = curr;
     }
   }
 }
@@ -91,11 +98,14 @@ void PollingDeviceWatcher::polling(Dispatcher::CancellableTimer timer) {
 void PollingDeviceWatcher::start(DeviceChangedCallback callback) {
   stop();
   callback_ = std::move(callback);
+  poll_queued_ = false;
+  poller_.start();
   repeat_operation_.start();
 }
 
 void PollingDeviceWatcher::stop() {
   repeat_operation_.stop();
+  poller_.stop();
   callback_inflight_.waitUntilEmpty();
 }
 
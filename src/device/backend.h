@@ -33,7 +33,8 @@ namespace platform {
 enum class BackendType {
   STANDARD,
   PLAYBACK,
-  RECORD
+  RECORD,
+  SHARED
 };
 
 template<class T>
@@ -83,6 +84,15 @@ inline bool operator==(const PlaybackDeviceInfo &a, const PlaybackDeviceInfo &b)
   return (a.file_path == b.file_path);
 }
 
+struct SharedDeviceInfo {
+  std::string endpoint;  // unix socket of the process owning the device
+  operator std::string() { return endpoint; }
+};
+
+inline bool operator==(const SharedDeviceInfo &a, const SharedDeviceInfo &b) {
+  return (a.endpoint == b.endpoint);
+}
+
 struct BackendDeviceGroup {
   BackendDeviceGroup() = default;
 
@@ -92,12 +102,17 @@ struct BackendDeviceGroup {
   explicit BackendDeviceGroup(std::vector<PlaybackDeviceInfo> playback_devices)
       : playback_devices(std::move(playback_devices)) {}
 
+  explicit BackendDeviceGroup(std::vector<SharedDeviceInfo> shared_devices)
+      : shared_devices(std::move(shared_devices)) {}
+
   std::vector<UsbDeviceInfo> usb_devices;
   std::vector<PlaybackDeviceInfo> playback_devices;
+  std::vector<SharedDeviceInfo> shared_devices;
 
   bool operator==(const BackendDeviceGroup &other) const {
     return !listChanged(usb_devices, other.usb_devices) &&
-        !listChanged(playback_devices, other.playback_devices);
+        !listChanged(playback_devices, other.playback_devices) &&
+        !listChanged(shared_devices, other.shared_devices);
   }
 
   explicit operator std::string() {
@@ -115,6 +130,12 @@ struct BackendDeviceGroup {
       s += "\n\n";
     }
 
+    s += !shared_devices.empty() ? "shared devices: \n" : "";
+    for (auto shared_device : shared_devices) {
+      s += shared_device;
+      s += "\n\n";
+    }
+
     return s;
   }
 };
@@ -134,13 +155,16 @@ class PollingDeviceWatcher : public DeviceWather {
   explicit PollingDeviceWatcher(const Backend *backend);
   ~PollingDeviceWatcher();
 
-  void polling(Dispatcher::CancellableTimer timer);
+  void polling();
 
   void start(DeviceChangedCallback callback) override;
   void stop() override;
 
  private:
-  RepeatOperation<> repeat_operation_;
+  // the timer only posts a poll here; enumeration and callbacks run on this thread
+  Dispatcher poller_;
+  std::atomic<bool> poll_queued_;
+  RepeatOperation repeat_operation_;
 
   CallbacksHeap callback_inflight_;
   const Backend *backend_;
@@ -155,6 +179,8 @@ class Backend {
 
   virtual std::vector<UsbDeviceInfo> queryUsbDevices() const = 0;
 
+  virtual std::vector<SharedDeviceInfo> querySharedDevices() const { return {}; }
+
   virtual std::shared_ptr<platform::TimeService> createTimeService() const = 0;
 
   virtual std::shared_ptr<DeviceWather> createDeviceWatcher() const = 0;
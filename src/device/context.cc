@@ -17,6 +17,8 @@
 #include "device/device.h"
 #include "device/backend.h"
 #include "device/device_info.h"
+#include "concurrency/thread_placement.h"
+#include "core/frame_data.h"
 
 #include "mock/playback/playback.h"
 #include "mock/record/record.h"
@@ -29,6 +31,11 @@
 
 #include "gemini/gemini_info.h"
 
+#ifdef WITH_SHARED_DEVICE
+#include "ipc/shared_backend.h"
+#include "ipc/shared_device.h"
+#endif
+
 #include <memory>
 #include <utility>
 
@@ -51,6 +58,14 @@ ContextPrivate::ContextPrivate(platform::BackendType type, const std::string &fi
       backend_ = nullptr; // TODO
     }
       break;
+    case BackendType::SHARED: {
+#ifdef WITH_SHARED_DEVICE
+      backend_ = std::make_shared<platform::SharedBackend>(filename);
+#else
+      throw std::runtime_error("Shared devices are not supported on this platform");
+#endif
+    }
+      break;
   }
 
   CHECK_PTR_NOT_NULL(backend_);
@@ -77,6 +92,7 @@ void ContextPrivate::stop() {
 
 std::vector<std::shared_ptr<DeviceInfo>> ContextPrivate::queryDevices(int mask) const {
   platform::BackendDeviceGroup devices(backend_->queryUsbDevices());
+  devices.shared_devices = backend_->querySharedDevices();
   auto device_list = createDevices(devices, playback_devices_, mask);
   LOG(INFO) << "Found " << device_list.size() << " SmarterEye devices (mask " << mask << ")";
   return device_list;
@@ -109,6 +125,11 @@ ContextPrivate::createDevices(platform::BackendDeviceGroup devices,
   if (mask & ProductCode::SE_PRODUCT_GEMINI) {
     auto gemini_devices = GeminiInfo::pickup(ctx, devices.usb_devices);
     std::copy(gemini_devices.begin(), gemini_devices.end(), std::back_inserter(matched_list));
+
+#ifdef WITH_SHARED_DEVICE
+    auto shared_devices = SharedInfo::pickup(ctx, devices.shared_devices);
+    std::copy(shared_devices.begin(), shared_devices.end(), std::back_inserter(matched_list));
+#endif
   }
 
   std::copy(matched_list.begin(), matched_list.end(), std::back_inserter(result_list));
@@ -240,6 +261,18 @@ DeviceList Context::queryDevices(int mask) const {
   return DeviceList(list);
 }
 
+void Context::setThreadPolicy(ThreadRole role, const ThreadPolicy &policy) {
+  libsmartereye2::ThreadPlacement::instance().setPolicy(role, policy);
+}
+
+void Context::setRealtimeMode(bool enabled) {
+  libsmartereye2::ThreadPlacement::instance().setRealtimeMode(enabled);
+}
+
+void Context::setDerivedFrameMemory(size_t bytes) {
+  libsmartereye2::FrameData::setDerivedMemoryLimit(bytes);
+}
+
 std::vector<Sensor> Context::queryAllSensors() const {
   std::vector<Sensor> results;
   for (auto &&dev : queryDevices()) {
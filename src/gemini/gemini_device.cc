@@ -30,6 +30,22 @@ namespace libsmartereye2 {
 static const int kUsbTimeout(1000);
 static const int kUsbRequestTypeIn(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_IN);
 static const int kUsbRequestTypeOut(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT);
+static const int kControlBufferSize(1024);
+
+static std::string usbStatusName(int status) {
+  auto it = platform::kUsbStatus2String.find(status);
+  return it != platform::kUsbStatus2String.end() ? it->second : std::to_string(status);
+}
+
+struct GeminiDevice::ControlRequest {
+  int cmd;
+  int index;
+  ControlAccept accept;
+  RetryPolicy policy;
+  ControlCallback on_done;
+  uint32_t attempt;
+  std::vector<uint8_t> buffer;
+};
 
 GeminiDevice::GeminiDevice(std::shared_ptr<ContextPrivate> ctx,
                            const platform::BackendDeviceGroup &group,
@@ -76,6 +92,10 @@ GeminiDevice::GeminiDevice(std::shared_ptr<ContextPrivate> ctx,
 
   LOG(DEBUG) << "Successfully opened and claimed interface 0";
 
+  control_guard_ = std::make_shared<LifetimeGuard>();
+  control_dispatcher_ = std::make_shared<Dispatcher>(16, ThreadRole::CONTROL, "se2-control");
+  control_dispatcher_->start();
+
   sensor_ = std::make_shared<GeminiSensor>(this);
   addSensor(sensor_);
 }
@@ -83,9 +103,81 @@ GeminiDevice::GeminiDevice(std::shared_ptr<ContextPrivate> ctx,
 GeminiDevice::~GeminiDevice() {
   LOG(DEBUG) << "Stopping sensor";
   sensor_->dispose();
+  // no retry may reach the control thread from now on, and nothing still queued may run
+  control_guard_->expire();
+  control_dispatcher_->stop();
   LOG(DEBUG) << "Destroying Gemini Device";
 }
 
+void GeminiDevice::requestAsync(int cmd,
+                                int index,
+                                ControlAccept accept,
+                                RetryPolicy policy,
+                                ControlCallback on_done) {
+  auto request = std::make_shared<ControlRequest>();
+  request->cmd = cmd;
+  request->index = index;
+  request->accept = std::move(accept);
+  request->policy = policy;
+  request->on_done = std::move(on_done);
+  request->attempt = 0;
+  request->buffer.resize(kControlBufferSize);
+  issueControlRequest(std::move(request));
+}
+
+std::future<std::vector<uint8_t>> GeminiDevice::requestAsync(int cmd,
+                                                             int index,
+                                                             ControlAccept accept,
+                                                             RetryPolicy policy) {
+  auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+  auto future = promise->get_future();
+  requestAsync(cmd, index, std::move(accept), policy,
+               [promise, cmd](platform::UsbStatus status, const platform::UsbCommonPackHead *response) {
+                 if (status != platform::SE2_USB_STATUS_SUCCESS) {
+                   promise->set_exception(std::make_exception_ptr(std::runtime_error(
+                       toString() << "control request " << cmd << " failed: "
+                                  << usbStatusName(status))));
+                   return;
+                 }
+                 auto bytes = reinterpret_cast<const uint8_t *>(response);
+                 promise->set_value(std::vector<uint8_t>(bytes, bytes + kControlBufferSize));
+               });
+  return future;
+}
+
+void GeminiDevice::issueControlRequest(std::shared_ptr<ControlRequest> request) {
+  // retries come from the shared timer thread, so this must not wait for room on the control queue
+  auto queued = control_dispatcher_->tryInvoke([this, request](Dispatcher::CancellableTimer) {
+    auto *response = reinterpret_cast<platform::UsbCommonPackHead *>(request->buffer.data());
+    auto status = control_transfer_in(request->cmd, request->index, response, kControlBufferSize);
+    if (status == platform::SE2_USB_STATUS_SUCCESS && request->accept && !request->accept(*response)) {
+      status = platform::SE2_USB_STATUS_OTHER;
+    }
+    completeControlRequest(request, status);
+  });
+  // a full queue counts as a failed attempt and backs off like one
+  if (!queued) completeControlRequest(request, platform::SE2_USB_STATUS_BUSY);
+}
+
+void GeminiDevice::completeControlRequest(const std::shared_ptr<ControlRequest> &request, platform::UsbStatus status) {
+  ++request->attempt;
+  if (status == platform::SE2_USB_STATUS_SUCCESS || request->policy.exhausted(request->attempt)) {
+    auto *response = reinterpret_cast<platform::UsbCommonPackHead *>(request->buffer.data());
+    if (request->on_done) request->on_done(status, response);
+    return;
+  }
+
+  auto delay_ms = request->policy.delayFor(request->attempt);
+  LOG(WARNING) << "control request " << request->cmd << " failed ("
+               << usbStatusName(status) << "), retrying in " << delay_ms << "ms";
+  std::weak_ptr<LifetimeGuard> guard = control_guard_;
+  TimerQueue::shared().schedule(delay_ms, [this, guard, request]() {
+    if (auto alive = guard.lock()) {
+      alive->run([&]() { issueControlRequest(request); });
+    }
+  });
+}
+
 void GeminiDevice::hardwareReset() {
   LOG(INFO) << "Sending hardware reset";
   control_transfer_out(platform::UsbCommand::RESET_USB_EDP, 0, nullptr, 0);
@@ -15,7 +15,11 @@
 #ifndef LIBSMARTEREYE2_GEMINI_DEVICE_H
 #define LIBSMARTEREYE2_GEMINI_DEVICE_H
 
+#include <future>
+
 #include "device/device.h"
+#include "concurrency/dispatcher.h"
+#include "concurrency/timer_queue.h"
 
 namespace libsmartereye2 {
 
@@ -35,7 +39,24 @@ class GeminiDevice : public DevicePrivate {
 
   std::shared_ptr<GeminiSensor> getGeminiSensor() const { return sensor_; }
 
+  using ControlAccept = std::function<bool(const platform::UsbCommonPackHead &)>;
+  using ControlCallback = std::function<void(platform::UsbStatus, const platform::UsbCommonPackHead *)>;
+
+  // Runs a control-in request on the device's control thread. A failed transfer, or a response that
+  // accept rejects, is retried from the shared timer according to policy; on_done gets the outcome.
+  void requestAsync(int cmd, int index, ControlAccept accept, RetryPolicy policy, ControlCallback on_done);
+  // the response bytes, or an exception once the policy gives up
+  std::future<std::vector<uint8_t>> requestAsync(int cmd, int index, ControlAccept accept, RetryPolicy policy);
+
  private:
+  struct ControlRequest;
+
+  void issueControlRequest(std::shared_ptr<ControlRequest> request);
+  // hands the result to on_done, or schedules the next attempt
+  void completeControlRequest(const std::shared_ptr<ControlRequest> &request, platform::UsbStatus status);
+
+  std::shared_ptr<LifetimeGuard> control_guard_;
+  std::shared_ptr<Dispatcher> control_dispatcher_;
   std::shared_ptr<GeminiSensor> sensor_;
 
   platform::UsbDeviceInfo usb_info_;
@@ -13,14 +13,16 @@
 // limitations under the License.
 
 #include "gemini_sensor.h"
+
+#include <algorithm>
+#include <thread>
+
 #include "gemini_device.h"
 #include "gemini_serial_port.h"
 #include "streaming/stream_profile.h"
 #include "core/frame_data.h"
 #include "easylogging++.h"
 
-static const int BUFFER_SIZE = 1024;  // Max size for control transfers
-
 namespace libsmartereye2 {
 
 static const FrameId kNecessaryFrameIds = (FrameId::LeftCamera | FrameId::RightCamera
@@ -28,8 +30,42 @@ static const FrameId kNecessaryFrameIds = (FrameId::LeftCamera | FrameId::RightC
     | FrameId::Disparity
 );
 
+// the camera's task runner may still be booting when the device enumerates
+static const RetryPolicy kUntilReady{0, 100, 5000};
+
+static OverflowPolicy toOverflowPolicy(BackpressurePolicy policy) {
+  switch (policy) {
+    case BackpressurePolicy::LATEST_ONLY: return OverflowPolicy::LATEST_ONLY;
+    case BackpressurePolicy::DROP_NEWEST: return OverflowPolicy::DROP_NEWEST;
+    case BackpressurePolicy::BLOCK_PRODUCER: return OverflowPolicy::BLOCK;
+    default: return OverflowPolicy::DROP_OLDEST;
+  }
+}
+
+static BackpressurePolicy toBackpressurePolicy(OverflowPolicy policy) {
+  switch (policy) {
+    case OverflowPolicy::LATEST_ONLY: return BackpressurePolicy::LATEST_ONLY;
+    case OverflowPolicy::DROP_NEWEST: return BackpressurePolicy::DROP_NEWEST;
+    case OverflowPolicy::BLOCK: return BackpressurePolicy::BLOCK_PRODUCER;
+    default: return BackpressurePolicy::DROP_OLDEST;
+  }
+}
+
+// raw images are the first to go when callbacks fall behind, perception results are small and rare
+static bool isSheddable(uint32_t frame_id) {
+  return frame_id != 0 && frame_id < static_cast<uint32_t>(FrameId::Lane);
+}
+
+static size_t defaultCallbackWorkers() {
+  auto cores = std::thread::hardware_concurrency();
+  return std::max<size_t>(2, std::min<size_t>(4, cores));
+}
+
 GeminiSensor::GeminiSensor(GeminiDevice *owner)
-    : SensorBase("Gemini Sensor", owner) {
+    : SensorBase("Gemini Sensor", owner),
+      callback_workers_(defaultCallbackWorkers()),
+      adaptive_shedding_(false),
+      packet_framesets_(false) {
   LOG(DEBUG) << "Making a Gemini Sensor " << this;
   init();
 }
@@ -38,37 +74,18 @@ GeminiSensor::~GeminiSensor() = default;
 
 StreamProfiles GeminiSensor::initStreamProfiles() {
   StreamProfiles results = {};
-  uint8_t buf[BUFFER_SIZE] = {0};
-
-  auto *response = reinterpret_cast<platform::UsbCommonPackHead *>(buf);
   auto gemini_device = dynamic_cast<GeminiDevice *>(device_owner_);
 
-  // wait for TaskRunner
-  int16_t open_cam_stat = -1;
-  while (open_cam_stat < 0) {
-    platform::UsbStatus ret = gemini_device->control_transfer_in(platform::UsbCommand::OPEN_CAM,
-                                                                 0, response, BUFFER_SIZE);
-
-    if (ret != platform::UsbStatus::SE2_USB_STATUS_SUCCESS || response->state != 0) {
-      LOG(ERROR) << "OPEN_CAM error";
-      std::this_thread::sleep_for(std::chrono::seconds(5));
-    } else {
-      open_cam_stat = response->state;
-    }
-  }
-
-  int16_t frame_info_count = -1;
-  while (frame_info_count < 0) {
-    platform::UsbStatus ret = gemini_device->control_transfer_in(platform::UsbCommand::QUERY_FRAME_CAP,
-                                                                 0, response, BUFFER_SIZE);
-
-    if (ret != platform::UsbStatus::SE2_USB_STATUS_SUCCESS || response->state < 0) {
-      LOG(ERROR) << "QUERY_FRAME_CAP error";
-      std::this_thread::sleep_for(std::chrono::seconds(5));
-    } else {
-      frame_info_count = response->frame_info_count;
-    }
-  }
+  gemini_device->requestAsync(platform::UsbCommand::OPEN_CAM, 0,
+                              [](const platform::UsbCommonPackHead &r) { return r.state == 0; },
+                              kUntilReady).get();
+  auto caps = gemini_device->requestAsync(platform::UsbCommand::QUERY_FRAME_CAP, 0,
+                                          [](const platform::UsbCommonPackHead &r) {
+                                            return r.state >= 0 && r.frame_info_count >= 0;
+                                          },
+                                          kUntilReady).get();
+  auto *response = reinterpret_cast<platform::UsbCommonPackHead *>(caps.data());
+  int16_t frame_info_count = response->frame_info_count;
 
   auto *frame_capacity = (platform::UsbFrameCapacity *) malloc(
       sizeof(platform::UsbFrameCapacity) + sizeof(platform::UsbFrameInfo) * frame_info_count
@@ -138,13 +155,12 @@ void GeminiSensor::open(const StreamProfiles &requests) {
     request_frame_ids = request_frame_ids | r->frameId();
   }
 
-  uint8_t buf[BUFFER_SIZE] = {0};
-  auto *response = reinterpret_cast<platform::UsbCommonPackHead *>(buf);
   auto gemini_device = dynamic_cast<GeminiDevice *>(device_owner_);
-  int ret = gemini_device->control_transfer_in(platform::UsbCommand::SET_FRAME_IDS,
-                                               static_cast<int>(request_frame_ids), response, BUFFER_SIZE);
-  if (ret < 0) {
-    LOG(ERROR) << "SET_FRAME_IDS failed: " << libusb_error_name(ret);
+  try {
+    gemini_device->requestAsync(platform::UsbCommand::SET_FRAME_IDS, static_cast<int>(request_frame_ids),
+                                nullptr, RetryPolicy{1, 0, 0}).get();
+  } catch (const std::exception &e) {
+    LOG(ERROR) << "SET_FRAME_IDS failed: " << e.what();
     return;
   }
 
@@ -190,7 +206,7 @@ void GeminiSensor::start(FrameCallbackPtr callback) {
   LOG(DEBUG) << "Gemini Sensor start...";
 
   std::lock_guard<std::mutex> lock(operation_lock_);
-  data_dispatcher_->start();
+  data_executor_->start();
 
   if (is_streaming_) {
     throw std::runtime_error("start(...) failed. Gemini device is already streaming!");
@@ -206,8 +222,8 @@ void GeminiSensor::stop() {
   LOG(DEBUG) << "Gemini Sensor stop...";
 
   std::lock_guard<std::mutex> lock(operation_lock_);
-  data_dispatcher_->flush();
-  data_dispatcher_->stop();
+  data_executor_->flush();
+  data_executor_->stop();
 
   if (!is_streaming_) {
     throw std::runtime_error("stop(...) failed. Gemini device is not streaming!");
@@ -220,7 +236,21 @@ void GeminiSensor::init() {
   profiles_ = initStreamProfiles();
   device_owner_->tagProfiles(profiles_);
   frame_source_->set_max_publish_list_size(256);
-  data_dispatcher_ = std::make_shared<Dispatcher>(256);
+  registerOption(OptionKey::FRAMES_QUEUE_SIZE, frame_source_->get_published_size_option());
+  data_executor_ = std::make_shared<StrandExecutor>(callback_workers_);
+  registerOption(OptionKey::CALLBACK_WORKERS, std::make_shared<RangeOption>(
+      OptionRange{1, 16, 1, static_cast<float>(callback_workers_)},
+      "Number of threads delivering frame callbacks; frames of one stream are always delivered in order",
+      [this](float value) { setCallbackWorkers(static_cast<size_t>(value)); }));
+  registerBackpressureOptions();
+  registerOption(OptionKey::PACKET_FRAMESETS, std::make_shared<RangeOption>(
+      OptionRange{0, 1, 1, 0},
+      "Deliver the image frames of one USB packet as a single frameset; they share one timestamp",
+      [this](float value) { packet_framesets_ = value != 0; }));
+  {
+    std::lock_guard<std::mutex> lock(backpressure_mutex_);
+    applyBackpressure(data_executor_.get());
+  }
 
   serial_port_ = std::make_shared<GeminiSerialPort>(this);
 }
@@ -229,12 +259,117 @@ void GeminiSensor::dispose() {
   // TODO
 }
 
+namespace {
+
+// moves the frame into the task itself, so queueing a frame costs no allocation
+struct FrameDelivery {
+  FrameSource *source;
+  FrameHolder frame;
+
+  void operator()() { source->invoke_callback(std::move(frame)); }
+};
+
+}  // namespace
+
 void GeminiSensor::dispatch_threaded(FrameHolder frame) {
-  auto frame_holder_ptr = std::make_shared<FrameHolder>();
-  *frame_holder_ptr = std::move(frame);
-  data_dispatcher_->invoke([this, frame_holder_ptr](Dispatcher::CancellableTimer timer) {
-    frame_source_->invoke_callback(std::move(*frame_holder_ptr));
-  });
+  auto profile = frame->getStreamProfile();
+  auto strand = profile ? static_cast<uint32_t>(profile->frameId()) : 0u;
+  data_executor_->post(strand, FrameDelivery{frame_source_.get(), std::move(frame)});
+}
+
+void GeminiSensor::setCallbackWorkers(size_t workers) {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (is_streaming_) {
+    throw std::runtime_error("setCallbackWorkers(...) failed. Gemini device is streaming!");
+  }
+  if (workers == callback_workers_) return;
+
+  callback_workers_ = workers;
+  auto executor = std::make_shared<StrandExecutor>(callback_workers_);
+  std::lock_guard<std::mutex> backpressure_lock(backpressure_mutex_);
+  applyBackpressure(executor.get());
+  data_executor_ = executor;
+}
+
+void GeminiSensor::registerBackpressureOptions() {
+  backpressure_[0] = Backpressure{BackpressurePolicy::DROP_OLDEST, StrandExecutor::kDefaultStrandCapacity};
+
+  registerOption(OptionKey::ADAPTIVE_SHEDDING, std::make_shared<RangeOption>(
+      OptionRange{0, 1, 1, 0},
+      "While callbacks fall behind, keep only the newest queued image frame so perception results go first",
+      [this](float value) {
+        std::lock_guard<std::mutex> lock(backpressure_mutex_);
+        adaptive_shedding_ = value != 0;
+        data_executor_->setAdaptiveShedding(adaptive_shedding_);
+      }));
+}
+
+void GeminiSensor::setBackpressure(FrameId stream, BackpressurePolicy policy, uint32_t queue_size) {
+  auto frame_id = static_cast<uint32_t>(stream);
+  if (frame_id & (frame_id - 1)) {
+    throw std::runtime_error(toString() << "Backpressure stream " << frame_id << " is not a single FrameId");
+  }
+  if (policy >= BackpressurePolicy::COUNT) {
+    throw std::runtime_error(toString() << "Unknown backpressure policy " << static_cast<int>(policy));
+  }
+  if (queue_size < 1 || queue_size > StrandExecutor::kMaxStrandCapacity) {
+    throw std::runtime_error(toString() << "Stream queue size " << queue_size << " is out of range [1, "
+                                        << StrandExecutor::kMaxStrandCapacity << "]");
+  }
+
+  std::lock_guard<std::mutex> lock(backpressure_mutex_);
+  Backpressure config{policy, queue_size};
+  if (frame_id == 0) {
+    // a new default overrides every per-stream setting
+    backpressure_.clear();
+    backpressure_[0] = config;
+    data_executor_->setDefaults(toOverflowPolicy(policy), queue_size);
+  } else {
+    backpressure_[frame_id] = config;
+    data_executor_->configure(frame_id, toOverflowPolicy(policy), queue_size);
+  }
+}
+
+// called with backpressure_mutex_ held
+void GeminiSensor::applyBackpressure(StrandExecutor *executor) const {
+  for (const auto &kvp : backpressure_) {
+    auto policy = toOverflowPolicy(kvp.second.policy);
+    if (kvp.first == 0) {
+      executor->setDefaults(policy, kvp.second.queue_size);
+    } else {
+      executor->configure(kvp.first, policy, kvp.second.queue_size);
+    }
+  }
+  for (const auto &frame_info : supported_frame_infos_) {
+    if (isSheddable(frame_info.frame_id)) executor->setSheddable(frame_info.frame_id, true);
+  }
+  executor->setAdaptiveShedding(adaptive_shedding_);
+}
+
+std::vector<StreamStatistics> GeminiSensor::getStreamStatistics() const {
+  std::shared_ptr<StrandExecutor> executor;
+  {
+    std::lock_guard<std::mutex> lock(backpressure_mutex_);
+    executor = data_executor_;
+  }
+
+  std::vector<StreamStatistics> results;
+  for (const auto &stats : executor->stats()) {
+    StreamStatistics statistics{};
+    statistics.frame_id = static_cast<FrameId>(stats.key);
+    statistics.policy = toBackpressurePolicy(stats.policy);
+    statistics.queue_size = stats.limit;
+    statistics.depth = static_cast<uint32_t>(stats.depth);
+    statistics.delivered = stats.delivered;
+    statistics.dropped = stats.dropped;
+    statistics.shed = stats.shed;
+    if (stats.delivered) {
+      statistics.mean_latency_ms = stats.latency_total_ns / 1e6 / stats.delivered;
+    }
+    statistics.max_latency_ms = stats.latency_max_ns / 1e6;
+    results.push_back(statistics);
+  }
+  return results;
 }
 
 bool GeminiSensor::startStream() {
@@ -245,6 +380,7 @@ bool GeminiSensor::startStream() {
   std::fill(buffer_.begin(), buffer_.end(), 0);
 
   stream_thread_ = std::thread([this] {
+    ThreadPlacement::Scope placement(ThreadRole::STREAM, "se2-stream");
     auto gemini_device = dynamic_cast<GeminiDevice *>(device_owner_);
     int ret = 0;
     int missing_cnt = 0;
@@ -299,6 +435,9 @@ void GeminiSensor::stopStream() {
 
 void GeminiSensor::handle_received_frames() {
   auto timestamp = usb_frame_group_.timestamp;
+  const bool as_frameset = packet_framesets_;
+  FrameHolder packet[sizeof(usb_frame_group_.frame_infos) / sizeof(usb_frame_group_.frame_infos[0])];
+  size_t packet_size = 0;
 
   for (auto &pair : active_frame_infos_) {
     auto index = pair.first;
@@ -308,7 +447,7 @@ void GeminiSensor::handle_received_frames() {
     auto frame_index = info->frame_index;
     auto data_ptr = usb_frame_group_.frame_datas[index];
 
-    auto profile = frame_id_to_profile_[static_cast<int>(frame_id)];
+    auto &profile = frame_id_to_profile_[static_cast<int>(frame_id)];
     if (profile == nullptr) {
       LOG(WARNING) << "Dropped frame. No valid profile";
       continue;
@@ -320,15 +459,14 @@ void GeminiSensor::handle_received_frames() {
     FrameExtension frame_ext;
     frame_ext.index = frame_index;
     frame_ext.speed = serial_port_->speed_;
-    FrameHolder frame_holder(frame_source_->alloc_frame(SeExtension::EXTENSION_VIDEO_FRAME,
-                                                        info->data_size, frame_ext, true));
+    auto extension = frame_id == FrameId::Disparity ? SeExtension::EXTENSION_DISPARITY_FRAME
+                                                    : SeExtension::EXTENSION_VIDEO_FRAME;
+    FrameHolder frame_holder(frame_source_->alloc_frame(extension, info->data_size, frame_ext, true));
     if (frame_holder.frame) {
       auto video = reinterpret_cast<VideoFrameData *>(frame_holder.frame);
       video->assign(info->width, info->height, 0, getBppByFormat(frame_format));
-      video->setTimestamp(timestamp);
-      video->setTimestampDomain(TimestampDomain::SYSTEM_TIME);
+      stampTimestamp(video, static_cast<double>(timestamp));
       video->setStreamProfile(profile);
-      video->setSensor(shared_from_this());
       if (with_embeddedline) {
         auto raw_frame_with_embeddedline = reinterpret_cast<RawUsbImageFrame4Embeddedline *>(data_ptr);
         auto embeddedline_size = sizeof(raw_frame_with_embeddedline->embeddedline);
@@ -349,14 +487,63 @@ void GeminiSensor::handle_received_frames() {
       continue;
     }
 
-    dispatch_threaded(std::move(frame_holder));
+    if (as_frameset) {
+      packet[packet_size++] = std::move(frame_holder);
+    } else {
+      dispatch_threaded(std::move(frame_holder));
+    }
+  }
+
+  if (packet_size > 0) {
+    dispatch_packet(packet, packet_size);
+  }
+}
+
+// GLOBAL_TIME once the device clock is mapped; until then the device time, which the host set at connect
+void GeminiSensor::stampTimestamp(FrameInterface *frame, double device_ms) {
+  auto global_ns = device_ms > 0 ? clock_mapper_.toHost(device_ms) : 0;
+  if (global_ns) {
+    frame->setTimestamp(global_ns / 1e6);
+    frame->setTimestampDomain(TimestampDomain::GLOBAL_TIME);
+    static_cast<FrameData *>(frame)->extension().global_timestamp_ns = global_ns;
+  } else {
+    frame->setTimestamp(device_ms);
+    frame->setTimestampDomain(TimestampDomain::SYSTEM_TIME);
   }
 }
 
-void GeminiSensor::sendOpenCamCommand() {
-  std::unique_ptr<platform::UsbCommonPackHead> response(new platform::UsbCommonPackHead);
-  dynamic_cast<GeminiDevice *>(device_owner_)->control_transfer_in(platform::UsbCommand::OPEN_CAM,
-                                                                   0, response.get(), sizeof(*response));
+// Frames of one packet were captured together, so they form a frameset without any matching.
+void GeminiSensor::dispatch_packet(FrameHolder *frames, size_t count) {
+  if (count == 1) {
+    dispatch_threaded(std::move(frames[0]));
+    return;
+  }
+
+  FrameExtension frame_ext;
+  frame_ext.index = frames[0]->getFrameIndex();
+  FrameHolder frameset(frame_source_->alloc_frame(SeExtension::EXTENSION_COMPOSITE_FRAME,
+                                                  count * sizeof(FrameInterface *), frame_ext, true));
+  if (!frameset.frame) {
+    LOG(WARNING) << "Dropped frameset. alloc_frame(...) returned nullptr";
+    return;
+  }
+
+  auto composite = static_cast<CompositeFrameData *>(frameset.frame);
+  composite->assign(frames, count);
+  auto first = composite->getFrame(0);
+  composite->setTimestamp(first->getFrameTimestamp());
+  composite->setTimestampDomain(first->getFrameTimestampDomain());
+  composite->inheritHandles(first);
+
+  dispatch_threaded(std::move(frameset));
+}
+
+void GeminiSensor::sendOpenCamCommand(std::function<void(bool)> on_done) {
+  dynamic_cast<GeminiDevice *>(device_owner_)->requestAsync(
+      platform::UsbCommand::OPEN_CAM, 0, nullptr, RetryPolicy{3, 100, 400},
+      [on_done](platform::UsbStatus status, const platform::UsbCommonPackHead *) {
+        if (on_done) on_done(status == platform::SE2_USB_STATUS_SUCCESS);
+      });
 }
 
 }  // namespace libsmartereye2
@@ -16,6 +16,7 @@
 #define LIBSMARTEREYE2_GEMINI_SENSOR_H
 
 #include "sensor/sensor.h"
+#include "core/clock_mapper.h"
 
 namespace libsmartereye2 {
 
@@ -54,10 +55,15 @@ class GeminiSensor : public SensorBase {
   void init();
   void dispose();
 
+  void setBackpressure(FrameId stream, BackpressurePolicy policy, uint32_t queue_size) override;
+  std::vector<StreamStatistics> getStreamStatistics() const override;
+  ClockSyncStatistics getClockSyncStatistics() const override { return clock_mapper_.statistics(); }
+
  protected:
   bool startStream();
   void stopStream();
-  void sendOpenCamCommand();
+  // completes on the device's control thread
+  void sendOpenCamCommand(std::function<void(bool)> on_done);
 
  private:
   friend class GeminiSerialPort;
@@ -74,13 +80,33 @@ class GeminiSensor : public SensorBase {
   // virtual COM
   std::shared_ptr<GeminiSerialPort> serial_port_;
 
-  // threaded dispatch
-  std::shared_ptr<Dispatcher> data_dispatcher_;
+  // device clock to host clock, fed by the serial port's round trips
+  ClockMapper clock_mapper_;
+  // the frame's final timestamp; call after loadData(), which sets the raw device time of perception payloads
+  void stampTimestamp(FrameInterface *frame, double device_ms);
+
+  // threaded dispatch, one strand per stream
+  std::shared_ptr<StrandExecutor> data_executor_;
+  size_t callback_workers_;
   void dispatch_threaded(FrameHolder frame);
+  void setCallbackWorkers(size_t workers);
+
+  // backpressure between the readers and the callback, keyed by FrameId; 0 holds the default
+  struct Backpressure {
+    BackpressurePolicy policy;
+    uint32_t queue_size;
+  };
+  mutable std::mutex backpressure_mutex_;
+  std::map<uint32_t, Backpressure> backpressure_;
+  bool adaptive_shedding_;
+  void registerBackpressureOptions();
+  void applyBackpressure(StrandExecutor *executor) const;
 
   // stream
   std::thread stream_thread_;
+  std::atomic<bool> packet_framesets_;
   void handle_received_frames();
+  void dispatch_packet(FrameHolder *frames, size_t count);
 };
 
 }  // namespace libsmartereye2
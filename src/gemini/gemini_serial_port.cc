@@ -14,6 +14,10 @@
 
 #include "gemini_serial_port.h"
 
+#include <array>
+#include <cstring>
+#include <vector>
+
 #include "gemini_device.h"
 #include "gemini_sensor.h"
 #include "core/frame_data.h"
@@ -27,16 +31,36 @@
 
 namespace libsmartereye2 {
 
+// the camera answers within a frame or two once connected
+static const RetryPolicy kResponsePolicy{3, 500, 2000};
+// round trips keep the clock mapper's drift estimate fresh
+static const uint32_t kClockSyncPeriodMs = 1000;
+
+struct GeminiSerialPort::PendingRequest {
+  uint32_t command;
+  RetryPolicy policy;
+  uint32_t attempt;
+  TimerQueue::TimerId timer;
+  std::promise<bool> done;
+};
+
 GeminiSerialPort::GeminiSerialPort(GeminiSensor *owner)
     : sensor_owner_(owner),
       watchdog_(nullptr),
       working_state_(WorkingState::Disconnected),
-      write_dispatcher_(std::make_shared<Dispatcher>(1)),
+      write_dispatcher_(std::make_shared<Dispatcher>(1, ThreadRole::SERIAL, "se2-serial-tx")),
       serial_running_(false),
+      request_guard_(std::make_shared<LifetimeGuard>()),
       speed_(0) {
   init();
 }
 
+GeminiSerialPort::~GeminiSerialPort() {
+  clock_sync_->stop();
+  request_guard_->expire();
+  failPendingRequests();
+}
+
 void GeminiSerialPort::init() {
   watchdog_ = std::make_shared<Watchdog>([this]() {
     LOG(DEBUG) << "onDisconnected by Watchdog";
@@ -44,10 +68,18 @@ void GeminiSerialPort::init() {
     is_head_found_ = false;
     pack_read_ = 0;
     pack_lack_ = 0;
-    sensor_owner_->sendOpenCamCommand();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // wait for device open
-    offerHand();  // reconnect
+    // reconnect once the device confirms it is open, the handshake goes out behind queued writes
+    std::weak_ptr<LifetimeGuard> guard = request_guard_;
+    sensor_owner_->sendOpenCamCommand([this, guard](bool opened) {
+      auto alive = guard.lock();
+      if (!alive) return;
+      alive->run([&]() {
+        if (!opened) LOG(WARNING) << "OPEN_CAM failed, offering hand anyway";
+        write_dispatcher_->invoke([this](Dispatcher::CancellableTimer) { offerHand(); }, true);
+      });
+    });
   }, 5000);
+  clock_sync_.reset(new RepeatOperation([this]() { queryTimestamp(); }, kClockSyncPeriodMs));
 
   auto obstacle_profile = std::make_shared<StreamProfileBase>();
   obstacle_profile->setFrameId(FrameId::Obstacle);
@@ -168,12 +200,15 @@ void GeminiSerialPort::close() {
   disconnect();
 
   watchdog_->stop();
+  clock_sync_->stop();
 
   serial_running_ = false;
   if (recv_thread_.joinable()) {
     recv_thread_.join();
   }
 
+  failPendingRequests();
+
   write_dispatcher_->flush();
   write_dispatcher_->stop();
 
@@ -189,22 +224,149 @@ void GeminiSerialPort::requireUserFiles() {
   send(SerialCommand_RequireUserFiles);
 }
 
+std::future<bool> GeminiSerialPort::request(uint32_t command, uint32_t response, RetryPolicy policy) {
+  auto pending = std::make_shared<PendingRequest>();
+  pending->command = command;
+  pending->policy = policy;
+  pending->attempt = 0;
+  pending->timer = 0;
+  auto future = pending->done.get_future();
+
+  std::shared_ptr<PendingRequest> superseded;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    auto &slot = pending_[response];
+    superseded = std::move(slot);
+    slot = pending;
+    sendRequest(response, pending);
+  }
+  if (superseded) {
+    TimerQueue::shared().cancel(superseded->timer);
+    superseded->done.set_value(false);
+  }
+  return future;
+}
+
+std::future<bool> GeminiSerialPort::syncTimestamp() {
+  using namespace std::chrono;
+  int64_t timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+  auto written = std::make_shared<std::promise<bool>>();
+  auto future = written->get_future();
+  write_dispatcher_->invoke([this, timestamp, written](Dispatcher::CancellableTimer) {
+    write(SerialCommand_SyncTimestamp, reinterpret_cast<const char *>(&timestamp), sizeof(timestamp));
+    written->set_value(true);
+  }, true);
+  return future;
+}
+
+void GeminiSerialPort::queryTimestamp() {
+  write_dispatcher_->invoke([this](Dispatcher::CancellableTimer) {
+    // stamped on the writer thread so queueing behind other writes does not count as transit
+    int64_t host_ns = ClockMapper::hostNow();
+    write(SerialCommand_QueryTimestamp, reinterpret_cast<const char *>(&host_ns), sizeof(host_ns));
+  });
+}
+
+// called with pending_mutex_ held, and from the shared timer thread on resends, so it must not wait for
+// room on the write queue; a command that finds it full is lost like an unanswered one and resent
+void GeminiSerialPort::sendRequest(uint32_t response, const std::shared_ptr<PendingRequest> &pending) {
+  auto command = pending->command;
+  if (!write_dispatcher_->tryInvoke([this, command](Dispatcher::CancellableTimer) { write(command, nullptr, 0); })) {
+    LOG(DEBUG) << "write queue full, command " << command << " goes out with the next attempt";
+  }
+  ++pending->attempt;
+
+  std::weak_ptr<LifetimeGuard> guard = request_guard_;
+  pending->timer = TimerQueue::shared().schedule(pending->policy.delayFor(pending->attempt),
+                                                 [this, guard, response, pending]() {
+                                                   auto alive = guard.lock();
+                                                   if (!alive) return;
+                                                   alive->run([&]() { onRequestTimeout(response, pending); });
+                                                 });
+}
+
+void GeminiSerialPort::onRequestTimeout(uint32_t response, const std::shared_ptr<PendingRequest> &pending) {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    auto it = pending_.find(response);
+    if (it == pending_.end() || it->second != pending) return;  // answered or superseded meanwhile
+
+    if (!pending->policy.exhausted(pending->attempt)) {
+      LOG(DEBUG) << "no response " << response << " to command " << pending->command << ", resending";
+      sendRequest(response, pending);
+      return;
+    }
+    pending_.erase(it);
+  }
+  LOG(WARNING) << "command " << pending->command << " got no response after " << pending->attempt << " attempts";
+  pending->done.set_value(false);
+}
+
+void GeminiSerialPort::completeRequest(uint32_t response, bool ok) {
+  std::shared_ptr<PendingRequest> pending;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    auto it = pending_.find(response);
+    if (it == pending_.end()) return;
+    pending = std::move(it->second);
+    pending_.erase(it);
+  }
+  TimerQueue::shared().cancel(pending->timer);
+  pending->done.set_value(ok);
+}
+
+void GeminiSerialPort::failPendingRequests() {
+  std::map<uint32_t, std::shared_ptr<PendingRequest>> pending;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending.swap(pending_);
+  }
+  for (auto &kvp : pending) {
+    TimerQueue::shared().cancel(kvp.second->timer);
+    kvp.second->done.set_value(false);
+  }
+}
+
 void GeminiSerialPort::send(uint32_t command_type, const char *data, uint32_t data_size) {
-  write_dispatcher_->invoke([=](Dispatcher::CancellableTimer timer) {
-    std::string buffer;
-    buffer.resize(sizeof(TLVStruct) + data_size);
-    auto *cmd = (TLVStruct *) buffer.data();
-    cmd->type = command_type;
-    cmd->length = data_size;
+  // the payload is copied now, callers hand in stack buffers that are gone by the time the write runs
+  if (data_size <= kInlinePayloadSize) {
+    std::array<char, kInlinePayloadSize> payload;
     if (data_size > 0) {
-      memcpy(cmd->data, data, data_size);
-    }
-    try {
-      serial_->write(buffer);
-    } catch (serial::IOException &e) {
-      LOG(DEBUG) << "serial write error: " << e.what();
+      memcpy(payload.data(), data, data_size);
     }
-  }, true);
+    write_dispatcher_->invoke([this, command_type, data_size, payload](Dispatcher::CancellableTimer timer) {
+      write(command_type, payload.data(), data_size);
+    }, true);
+  } else {
+    std::string payload(data, data_size);
+    write_dispatcher_->invoke([this, command_type, payload](Dispatcher::CancellableTimer timer) {
+      write(command_type, payload.data(), static_cast<uint32_t>(payload.size()));
+    }, true);
+  }
+}
+
+void GeminiSerialPort::write(uint32_t command_type, const char *data, uint32_t data_size) {
+  uint8_t small[sizeof(TLVStruct) + kInlinePayloadSize];
+  std::vector<uint8_t> large;
+  auto total = sizeof(TLVStruct) + data_size;
+  uint8_t *buffer = small;
+  if (total > sizeof(small)) {
+    large.resize(total);
+    buffer = large.data();
+  }
+
+  auto *cmd = reinterpret_cast<TLVStruct *>(buffer);
+  cmd->type = command_type;
+  cmd->length = data_size;
+  if (data_size > 0) {
+    memcpy(cmd->data, data, data_size);
+  }
+  try {
+    serial_->write(buffer, total);
+  } catch (serial::IOException &e) {
+    LOG(DEBUG) << "serial write error: " << e.what();
+  }
 }
 
 void GeminiSerialPort::handleTlvData(uint32_t type, const uint8_t *data, uint32_t data_size) {
@@ -246,7 +408,10 @@ void GeminiSerialPort::offerHand() {
 
 void GeminiSerialPort::connect() {
   serial_running_ = true;
-  recv_thread_ = std::thread([this]() {
+  std::promise<void> started;
+  recv_thread_ = std::thread([this, &started]() {
+    ThreadPlacement::Scope placement(ThreadRole::SERIAL, "se2-serial-rx");
+    started.set_value();
     size_t nread = 0;
     std::string recv_buffer;
     TLVStruct tlv_head;
@@ -302,8 +467,8 @@ void GeminiSerialPort::connect() {
     }
   });
 
-  // wait for recv thread start
-  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // the handshake answer must find the receiver running
+  started.get_future().wait();
   offerHand();
 }
 
@@ -352,15 +517,14 @@ void GeminiSerialPort::onConnected() {
   send(SerialConnection_Ack);
   watchdog_->start();
 
-  // when connected, request intrinsics and extrinsics first...
-  using namespace std::chrono;
-  auto time_now = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-  int64_t timestamp = time_now.count();
-  send(SerialCommand_SyncTimestamp, (const char*)&timestamp, sizeof (timestamp));
-  send(SerialCommand_RequireIntrinsics);
-  send(SerialCommand_RequireExtrinsics);
-  std::this_thread::sleep_for(std::chrono::microseconds(40));
+  // when connected, request intrinsics and extrinsics first, the write queue keeps them in order
+  // setting the device clock invalidates the old mapping
+  sensor_owner_->clock_mapper_.reset();
+  syncTimestamp();
+  request(SerialCommand_RequireIntrinsics, SerialCommand_RespondIntrinsics, kResponsePolicy);
+  request(SerialCommand_RequireExtrinsics, SerialCommand_RespondExtrinsics, kResponsePolicy);
   requireUserFiles();
+  clock_sync_->start();
 }
 
 void GeminiSerialPort::onHeartbeat() {
@@ -372,6 +536,7 @@ void GeminiSerialPort::onHeartbeat() {
 
 void GeminiSerialPort::onDisconnected() {
   working_state_ = WorkingState::Disconnected;
+  clock_sync_->stop();
   LOG(INFO) << "serial port disconnected";
 }
 
@@ -391,6 +556,15 @@ void GeminiSerialPort::handleConnection(uint32_t type, const uint8_t *data, uint
 
 void GeminiSerialPort::handleCommand(uint32_t type, const uint8_t *data, uint32_t data_size) {
   switch (type) {
+    case SerialCommand_RespondTimestamp: {
+      int64_t host_receive_ns = ClockMapper::hostNow();
+      if (data_size < sizeof(SerialTimestampRespond)) break;
+      SerialTimestampRespond respond;
+      std::memcpy(&respond, data, sizeof(respond));
+      sensor_owner_->clock_mapper_.addRoundTrip(respond.host_token, static_cast<double>(respond.device_timestamp),
+                                                host_receive_ns);
+    }
+      break;
     case SerialCommand_RespondIntrinsics: {
       if (data_size == sizeof(Intrinsics)) {
         auto *intrinsics = (Intrinsics *) data;
@@ -404,6 +578,7 @@ void GeminiSerialPort::handleCommand(uint32_t type, const uint8_t *data, uint32_
       } else {
         LOG(WARNING) << "SerialCommand_RespondIntrinsics error";
       }
+      completeRequest(type, data_size == sizeof(Intrinsics));
     }
       break;
     case SerialCommand_RespondExtrinsics: {
@@ -419,6 +594,7 @@ void GeminiSerialPort::handleCommand(uint32_t type, const uint8_t *data, uint32_
       } else {
         LOG(WARNING) << "SerialCommand_RespondExtrinsics error";
       }
+      completeRequest(type, data_size == sizeof(Extrinsics));
     }
       break;
     default:break;
@@ -448,8 +624,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto journey = reinterpret_cast<JourneyFrameData *>(frame_holder.frame);
         journey->setStreamProfile(profiles_[SeExtension::EXTENSION_JOURNEY_FRAME]);
-        journey->setSensor(sensor_owner_->shared_from_this());
         journey->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(journey, journey->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -462,8 +638,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto obstacle_frame = reinterpret_cast<ObstacleFrameData *>(frame_holder.frame);
         obstacle_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_OBSTACLE_FRAME]);
-        obstacle_frame->setSensor(sensor_owner_->shared_from_this());
         obstacle_frame->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(obstacle_frame, obstacle_frame->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -476,8 +652,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto lane_frame = reinterpret_cast<LaneFrameData *>(frame_holder.frame);
         lane_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_LANE_FRAME]);
-        lane_frame->setSensor(sensor_owner_->shared_from_this());
         lane_frame->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(lane_frame, lane_frame->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -490,8 +666,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto free_space_frame = reinterpret_cast<FreeSpaceFrameData *>(frame_holder.frame);
         free_space_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_FREESPACE_FRAME]);
-        free_space_frame->setSensor(sensor_owner_->shared_from_this());
         free_space_frame->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(free_space_frame, free_space_frame->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -504,8 +680,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto tsr_frame = reinterpret_cast<TrafficSignFrameData *>(frame_holder.frame);
         tsr_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_TRAFFIC_SIGN_FRAME]);
-        tsr_frame->setSensor(sensor_owner_->shared_from_this());
         tsr_frame->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(tsr_frame, tsr_frame->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -518,8 +694,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto tfl_frame = reinterpret_cast<TrafficLightFrameData *>(frame_holder.frame);
         tfl_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_TRAFFIC_LIGHT_FRAME]);
-        tfl_frame->setSensor(sensor_owner_->shared_from_this());
         tfl_frame->loadData(data, data_size);
+        sensor_owner_->stampTimestamp(tfl_frame, tfl_frame->getFrameTimestamp());
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
     }
@@ -532,7 +708,6 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
       if (frame_holder.frame) {
         auto vehicle_frame = reinterpret_cast<VehicleInfoFrameData *>(frame_holder.frame);
         vehicle_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_VEHICLE_INFO_FRAME]);
-        vehicle_frame->setSensor(sensor_owner_->shared_from_this());
         vehicle_frame->loadData(data, data_size);
         sensor_owner_->dispatch_threaded(std::move(frame_holder));
       }
@@ -546,8 +721,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
         if (frame_holder.frame) {
           auto matrix_frame = reinterpret_cast<MatrixData *>(frame_holder.frame);
           matrix_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_Matrix]);
-          matrix_frame->setSensor(sensor_owner_->shared_from_this());
           matrix_frame->loadData(data, data_size);
+          sensor_owner_->stampTimestamp(matrix_frame, matrix_frame->getFrameTimestamp());
           sensor_owner_->dispatch_threaded(std::move(frame_holder));
         }
     }
@@ -564,9 +739,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
         if (frame_holder.frame) {
           auto small_obs_frame = reinterpret_cast<SmallObstacleFrameData *>(frame_holder.frame);
           small_obs_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_SMALL_OBS_FRAME]);
-          small_obs_frame->setSensor(sensor_owner_->shared_from_this());
-          small_obs_frame->setTimestamp(alg_res->timestamp);
           small_obs_frame->loadData((const uint8_t *) alg_res->data, alg_res->dataSize);
+          sensor_owner_->stampTimestamp(small_obs_frame, static_cast<double>(alg_res->timestamp));
           sensor_owner_->dispatch_threaded(std::move(frame_holder));
         }
       } else if (alg_res->dataType == AlgorithmResult::Flatness) {
@@ -577,9 +751,8 @@ void GeminiSerialPort::handleDataUnit(uint32_t type, const uint8_t *data, uint32
         if (frame_holder.frame) {
           auto flatness_frame = reinterpret_cast<FlatnessFrameData *>(frame_holder.frame);
           flatness_frame->setStreamProfile(profiles_[SeExtension::EXTENSION_FLATNESS_FRAME]);
-          flatness_frame->setSensor(sensor_owner_->shared_from_this());
-          flatness_frame->setTimestamp(alg_res->timestamp);
           flatness_frame->loadData((const uint8_t *) alg_res->data, alg_res->dataSize);
+          sensor_owner_->stampTimestamp(flatness_frame, static_cast<double>(alg_res->timestamp));
           sensor_owner_->dispatch_threaded(std::move(frame_holder));
         }
       }
@@ -16,11 +16,14 @@
 #define GEMINI_SERIAL_PORT_H
 
 #include <map>
+#include <mutex>
 #include <thread>
 #include <atomic>
+#include <future>
 
 #include "se_types.hpp"
 #include "core/core_types.hpp"
+#include "concurrency/timer_queue.h"
 
 namespace serial {
 class Serial;
@@ -43,6 +46,7 @@ class GeminiSerialPort {
   };
 
   explicit GeminiSerialPort(GeminiSensor *owner);
+  ~GeminiSerialPort();
   void init();
 
   void open();
@@ -51,11 +55,30 @@ class GeminiSerialPort {
   void requirePerception();
   void requireUserFiles();
 
+  // Sends command and resolves once a packet of type response arrives: true on arrival, false when
+  // every attempt timed out, the port closed, or a newer request for the same response took over.
+  std::future<bool> request(uint32_t command, uint32_t response, RetryPolicy policy);
+  // resolves once the host time has been written to the port
+  std::future<bool> syncTimestamp();
+  // one round trip for the clock mapper, the payload is the host time the query was written at
+  void queryTimestamp();
+
  private:
+  struct PendingRequest;
+
+  // commands with payloads up to this size are queued without touching the heap
+  static const uint32_t kInlinePayloadSize = 40;
+
   void send(uint32_t command_type, const char *data = nullptr, uint32_t data_size = 0);
+  void write(uint32_t command_type, const char *data, uint32_t data_size);
   void handleTlvData(uint32_t type, const uint8_t *data, uint32_t data_size);
   void offerHand();
 
+  void sendRequest(uint32_t response, const std::shared_ptr<PendingRequest> &pending);
+  void onRequestTimeout(uint32_t response, const std::shared_ptr<PendingRequest> &pending);
+  void completeRequest(uint32_t response, bool ok);
+  void failPendingRequests();
+
   void connect();
   void disconnect();
   void retry();
@@ -75,6 +98,7 @@ class GeminiSerialPort {
   GeminiSensor *sensor_owner_;
 
   std::shared_ptr<Watchdog> watchdog_;
+  std::unique_ptr<RepeatOperation> clock_sync_;
   WorkingState working_state_;
 
   // virtual COM
@@ -87,6 +111,10 @@ class GeminiSerialPort {
   int pack_read_ = 0;
   int pack_lack_ = 0;
 
+  std::shared_ptr<LifetimeGuard> request_guard_;
+  std::mutex pending_mutex_;
+  std::map<uint32_t, std::shared_ptr<PendingRequest>> pending_;  // by response type
+
   std::atomic<int64_t> speed_;
   std::map<SeExtension, std::shared_ptr<StreamProfileBase>> profiles_;
 };
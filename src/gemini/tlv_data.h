@@ -44,7 +44,9 @@ enum SerialCommand {
   SerialCommand_RespondIntrinsics,
   SerialCommand_RequireExtrinsics,
   SerialCommand_RespondExtrinsics,
-  SerialCommand_SyncTimestamp
+  SerialCommand_SyncTimestamp,
+  SerialCommand_QueryTimestamp,      /**< Host monotonic ns as a token, answered right away. */
+  SerialCommand_RespondTimestamp     /**< SerialTimestampRespond */
 };
 
 enum SerialDataUnit {
@@ -65,6 +67,11 @@ enum SerialDataUnit {
   SerialDataUnit_Matrix
 };
 
+struct SerialTimestampRespond {
+  int64_t host_token;         /**< echoed from SerialCommand_QueryTimestamp */
+  uint64_t device_timestamp;  /**< device clock in ms, the clock frames are stamped with */
+};
+
 struct SerialFileHeader {
   uint32_t fileSize;
   inline const char *fileName() const {
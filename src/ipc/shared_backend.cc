@@ -0,0 +1,51 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shared_backend.h"
+
+#include <sys/stat.h>
+
+namespace libsmartereye2 {
+namespace platform {
+
+SharedBackend::SharedBackend(std::string endpoint)
+    : endpoint_(std::move(endpoint)) {
+}
+
+std::shared_ptr<CommandTransfer> SharedBackend::createUsbDevice(UsbDeviceInfo) const {
+  return nullptr;
+}
+
+std::vector<UsbDeviceInfo> SharedBackend::queryUsbDevices() const {
+  return std::vector<UsbDeviceInfo>();
+}
+
+std::vector<SharedDeviceInfo> SharedBackend::querySharedDevices() const {
+  struct stat st{};
+  if (::stat(endpoint_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    return {SharedDeviceInfo{endpoint_}};
+  }
+  return {};
+}
+
+std::shared_ptr<platform::TimeService> SharedBackend::createTimeService() const {
+  return std::make_shared<platform::OsTimeService>();
+}
+
+std::shared_ptr<DeviceWather> SharedBackend::createDeviceWatcher() const {
+  return std::make_shared<PollingDeviceWatcher>(this);
+}
+
+}  // namespace platform
+}  // namespace libsmartereye2
@@ -0,0 +1,46 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHARED_BACKEND_H
+#define LIBSMARTEREYE2_SHARED_BACKEND_H
+
+#include "device/backend.h"
+
+namespace libsmartereye2 {
+namespace platform {
+
+// Backend of a process that does not own the camera: its only device is the one
+// served on the given unix socket by a shared device server.
+class SharedBackend : public Backend, public std::enable_shared_from_this<SharedBackend> {
+ public:
+  explicit SharedBackend(std::string endpoint);
+
+  std::shared_ptr<CommandTransfer> createUsbDevice(UsbDeviceInfo info) const override;
+
+  std::vector<UsbDeviceInfo> queryUsbDevices() const override;
+
+  std::vector<SharedDeviceInfo> querySharedDevices() const override;
+
+  std::shared_ptr<platform::TimeService> createTimeService() const override;
+
+  std::shared_ptr<DeviceWather> createDeviceWatcher() const override;
+
+ private:
+  std::string endpoint_;
+};
+
+}  // namespace platform
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_SHARED_BACKEND_H
@@ -0,0 +1,278 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shared_device.h"
+#include "shared_backend.h"
+#include "shared_protocol.h"
+
+#include <cstring>
+
+#include "concurrency/thread_placement.h"
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+#include "device/shared_device.hpp"
+
+namespace libsmartereye2 {
+
+static const int kDescribeTimeout(3000);  // ms
+static const int kReceivePollTimeout(200);  // ms
+
+SharedSensor::SharedSensor(SharedDevice *owner, std::string endpoint)
+    : SensorBase("Shared Sensor", owner), endpoint_(std::move(endpoint)) {
+  LOG(DEBUG) << "Making a Shared Sensor on " << endpoint_;
+  profiles_ = initStreamProfiles();
+  frame_source_->set_max_publish_list_size(256);
+}
+
+SharedSensor::~SharedSensor() {
+  is_streaming_ = false;
+  if (receive_thread_.joinable()) {
+    receive_thread_.join();
+  }
+}
+
+StreamProfiles SharedSensor::initStreamProfiles() {
+  socket_.connect(endpoint_);
+
+  ipc::MessageHead head{};
+  std::vector<uint8_t> body;
+  if (!socket_.recv(&head, &body, kDescribeTimeout) || head.type != ipc::SharedMessage_Describe
+      || body.size() < sizeof(ipc::SharedDescribe)) {
+    throw std::runtime_error(toString() << "No device description from " << endpoint_);
+  }
+
+  ipc::SharedDescribe describe{};
+  std::memcpy(&describe, body.data(), sizeof(describe));
+  if (body.size() < sizeof(describe) + describe.stream_count * sizeof(ipc::SharedStreamDesc)) {
+    throw std::runtime_error(toString() << "Truncated device description from " << endpoint_);
+  }
+  describe.ring_name[ipc::kSharedRingNameLength - 1] = '\0';
+  ring_ = ipc::ShmFrameRing::open(describe.ring_name);
+  ring_->setLease(describe.lease_client, describe.lease_epoch);
+
+  StreamProfiles results = {};
+  auto streams = body.data() + sizeof(describe);
+  for (uint32_t i = 0; i < describe.stream_count; ++i) {
+    ipc::SharedStreamDesc desc{};
+    std::memcpy(&desc, streams + i * sizeof(desc), sizeof(desc));
+
+    auto profile = std::make_shared<VideoStreamProfilePrivate>();
+    profile->setDims(desc.width, desc.height);
+    profile->setFrameId(static_cast<FrameId>(desc.frame_id));
+    profile->setFormat(static_cast<FrameFormat>(desc.format));
+    profile->setIndex(desc.index);
+    profile->setFrameRate(desc.fps);
+    profile->setUniqueId(Environment::instance().generateStreamId());
+    profile->setIntrinsics(desc.intrinsics);
+    profile->setExtrinsics(desc.extrinsics);
+    profile->tagProfile(ProfileTag::PROFILE_TAG_DEFAULT | ProfileTag::PROFILE_TAG_SUPERSET);
+    results.push_back(profile);
+
+    frame_id_to_profile_[desc.frame_id] = profile;
+  }
+
+  LOG(INFO) << "Shared device " << endpoint_ << " offers " << results.size() << " streams";
+  return results;
+}
+
+void SharedSensor::open(const StreamProfiles &requests) {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (is_streaming_) {
+    throw std::runtime_error("open(...) failed. Shared device is streaming!");
+  } else if (is_opened_) {
+    throw std::runtime_error("open(...) failed. Shared device already opened!");
+  }
+
+  frame_source_->init(metadata_parsers_);
+  frame_source_->set_sensor(shared_from_this());
+
+  requested_ids_ = 0;
+  for (auto &&r : requests) {
+    requested_ids_ |= static_cast<uint32_t>(r->frameId());
+  }
+
+  is_opened_ = true;
+  setActiveStream(requests);
+}
+
+void SharedSensor::close() {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (is_streaming_) {
+    throw std::runtime_error("close(...) failed. Shared device is streaming!");
+  } else if (!is_opened_) {
+    throw std::runtime_error("close(...) failed. Shared device was not opened!");
+  }
+
+  requested_ids_ = 0;
+  is_opened_ = false;
+  setActiveStream({});
+}
+
+void SharedSensor::start(FrameCallbackPtr callback) {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (is_streaming_) {
+    throw std::runtime_error("start(...) failed. Shared device is already streaming!");
+  } else if (!is_opened_) {
+    throw std::runtime_error("start(...) failed. Shared device was not opened!");
+  }
+
+  frame_source_->set_callback(callback);
+
+  ipc::SharedSubscribe subscribe{requested_ids_};
+  if (!socket_.send(ipc::SharedMessage_Subscribe, &subscribe, sizeof(subscribe))) {
+    throw std::runtime_error(toString() << "start(...) failed. Lost connection to " << endpoint_);
+  }
+
+  is_streaming_ = true;
+  receive_thread_ = std::thread([this] {
+    ThreadPlacement::Scope placement(ThreadRole::IPC, "se2-ipc-recv");
+    receive();
+  });
+}
+
+void SharedSensor::stop() {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (!is_streaming_) {
+    throw std::runtime_error("stop(...) failed. Shared device is not streaming!");
+  }
+
+  socket_.send(ipc::SharedMessage_Unsubscribe, nullptr, 0);
+  is_streaming_ = false;
+  if (receive_thread_.joinable()) {
+    receive_thread_.join();
+  }
+}
+
+void SharedSensor::receive() {
+  ipc::MessageHead head{};
+  std::vector<uint8_t> body;
+  auto shared_device = dynamic_cast<SharedDevice *>(device_owner_);
+
+  while (is_streaming_) {
+    if (!socket_.waitReadable(kReceivePollTimeout)) continue;
+
+    if (!socket_.recv(&head, &body)) {
+      LOG(ERROR) << "Shared device " << endpoint_ << " went away";
+      shared_device->setValid(false);
+      break;
+    }
+
+    if (head.type == ipc::SharedMessage_Frame && body.size() >= sizeof(ipc::SharedFrameNotify)) {
+      ipc::SharedFrameNotify notify{};
+      std::memcpy(&notify, body.data(), sizeof(notify));
+      handleFrame(notify);
+    }
+  }
+}
+
+void SharedSensor::handleFrame(const ipc::SharedFrameNotify &notify) {
+  auto header = ring_->acquire(notify.slot, notify.sequence);
+  if (!header) {
+    LOG(DEBUG) << "Dropped frame. Shared slot was recycled before it was read";
+    return;
+  }
+
+  auto extension = static_cast<SeExtension>(header->extension);
+  FrameExtension frame_ext;
+  frame_ext.index = header->index;
+  frame_ext.speed = header->speed;
+  frame_ext.timestamp = header->timestamp;
+  frame_ext.timestamp_domain = static_cast<TimestampDomain>(header->timestamp_domain);
+  frame_ext.metadata_value = static_cast<FrameMetadataValue>(header->metadata_value);
+  frame_ext.metadata_blob.assign(header->metadata, header->metadata + header->metadata_size);
+
+  FrameHolder frame_holder(frame_source_->alloc_frame(extension, 0, frame_ext, false));
+  if (!frame_holder.frame) {
+    ring_->release(notify.slot);
+    LOG(WARNING) << "Dropped frame. alloc_frame(...) returned nullptr";
+    return;
+  }
+
+  auto frame = reinterpret_cast<FrameData *>(frame_holder.frame);
+  auto payload = ring_->payload(notify.slot);
+  if (extension == SeExtension::EXTENSION_VIDEO_FRAME || extension == SeExtension::EXTENSION_DEPTH_FRAME
+      || extension == SeExtension::EXTENSION_DISPARITY_FRAME) {
+    auto video = reinterpret_cast<VideoFrameData *>(frame_holder.frame);
+    video->assign(header->width, header->height, header->stride, header->bpp);
+    auto ring = ring_;
+    auto slot = notify.slot;
+    video->attachExternalData(reinterpret_cast<const char *>(payload), header->data_size,
+                              [ring, slot] { ring->release(slot); });
+  } else {
+    // perception frames are parsed into their own containers anyway
+    frame->loadData(payload, header->data_size);
+    ring_->release(notify.slot);
+  }
+
+  frame->setStreamProfile(profileOf(header->frame_id, header->frame_format, header->stream_index));
+  frame_source_->invoke_callback(std::move(frame_holder));
+}
+
+const std::shared_ptr<StreamProfileInterface> &SharedSensor::profileOf(uint32_t frame_id, int32_t format, int32_t index) {
+  auto &profile = frame_id_to_profile_[frame_id];
+  if (!profile) {
+    auto stream = std::make_shared<StreamProfileBase>();
+    stream->setFrameId(static_cast<FrameId>(frame_id));
+    stream->setFormat(static_cast<FrameFormat>(format));
+    stream->setIndex(index);
+    stream->setUniqueId(Environment::instance().generateStreamId());
+    profile = stream;
+  }
+  return profile;
+}
+
+SharedDevice::SharedDevice(std::shared_ptr<ContextPrivate> ctx,
+                           const platform::BackendDeviceGroup &group,
+                           bool register_device_notifications)
+    : DevicePrivate(std::move(ctx), group, register_device_notifications) {
+  LOG(DEBUG) << "Creating a Shared device";
+  sensor_ = std::make_shared<SharedSensor>(this, group.shared_devices.at(0).endpoint);
+  addSensor(sensor_);
+}
+
+SharedInfo::SharedInfo(std::shared_ptr<ContextPrivate> ctx, platform::SharedDeviceInfo info)
+    : DeviceInfo(std::move(ctx)), shared_device_info_(std::move(info)) {
+}
+
+platform::BackendDeviceGroup SharedInfo::getDeviceData() const {
+  return platform::BackendDeviceGroup(std::vector<platform::SharedDeviceInfo>{shared_device_info_});
+}
+
+std::shared_ptr<DeviceInterface> SharedInfo::create(std::shared_ptr<ContextPrivate> ctx,
+                                                    bool register_device_notifications) const {
+  return std::make_shared<SharedDevice>(ctx, getDeviceData(), register_device_notifications);
+}
+
+std::vector<std::shared_ptr<DeviceInfo>> SharedInfo::pickup(const std::shared_ptr<ContextPrivate> &ctx,
+                                                            const std::vector<platform::SharedDeviceInfo> &shared_infos) {
+  std::vector<std::shared_ptr<DeviceInfo>> matched_list;
+  for (const auto &it : shared_infos) {
+    matched_list.push_back(std::make_shared<SharedInfo>(ctx, it));
+  }
+  return matched_list;
+}
+
+}  // namespace libsmartereye2
+
+namespace se2 {
+
+SharedContext::SharedContext(const std::string &endpoint)
+    : Context(std::make_shared<SeContext>(SeContext{
+    std::make_shared<libsmartereye2::ContextPrivate>(libsmartereye2::platform::BackendType::SHARED, endpoint)
+})) {
+}
+
+}  // namespace se2
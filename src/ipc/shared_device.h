@@ -0,0 +1,99 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHARED_DEVICE_H
+#define LIBSMARTEREYE2_SHARED_DEVICE_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "device/device.h"
+#include "device/device_info.h"
+#include "sensor/sensor.h"
+#include "unix_socket.h"
+#include "shm_frame_ring.h"
+
+namespace libsmartereye2 {
+
+namespace ipc {
+struct SharedFrameNotify;
+}
+
+class SharedDevice;
+
+// Client end of a device served by another process. Frames are read in place from the
+// server's shared-memory ring; a video frame keeps its slot until the user releases it.
+class SharedSensor : public SensorBase {
+ public:
+  SharedSensor(SharedDevice *owner, std::string endpoint);
+  ~SharedSensor() override;
+
+  StreamProfiles initStreamProfiles() override;
+
+  void open(const StreamProfiles &requests) override;
+  void close() override;
+  void start(FrameCallbackPtr callback) override;
+  void stop() override;
+
+ private:
+  void receive();
+  void handleFrame(const ipc::SharedFrameNotify &notify);
+  const std::shared_ptr<StreamProfileInterface> &profileOf(uint32_t frame_id, int32_t format, int32_t index);
+
+  mutable std::mutex operation_lock_;
+
+  std::string endpoint_;
+  ipc::UnixSocket socket_;
+  std::shared_ptr<ipc::ShmFrameRing> ring_;
+
+  uint32_t requested_ids_ = 0;
+  std::map<uint32_t, std::shared_ptr<StreamProfileInterface>> frame_id_to_profile_;
+
+  std::thread receive_thread_;
+};
+
+class SharedDevice : public DevicePrivate {
+ public:
+  SharedDevice(std::shared_ptr<ContextPrivate> ctx, const platform::BackendDeviceGroup &group,
+               bool register_device_notifications);
+
+  std::vector<TaggedProfile> getProfilesTags() const override { return std::vector<TaggedProfile>(); }
+  void tagProfiles(StreamProfiles) const override {}
+
+ private:
+  friend class SharedSensor;
+
+  std::shared_ptr<SharedSensor> sensor_;
+};
+
+class SharedInfo : public DeviceInfo {
+ public:
+  SharedInfo(std::shared_ptr<ContextPrivate> ctx, platform::SharedDeviceInfo info);
+
+  platform::BackendDeviceGroup getDeviceData() const override;
+
+  std::shared_ptr<DeviceInterface> create(std::shared_ptr<ContextPrivate> ctx,
+                                          bool register_device_notifications) const override;
+
+  static std::vector<std::shared_ptr<DeviceInfo>> pickup(const std::shared_ptr<ContextPrivate> &ctx,
+                                                         const std::vector<platform::SharedDeviceInfo> &shared_infos);
+
+ private:
+  platform::SharedDeviceInfo shared_device_info_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_SHARED_DEVICE_H
@@ -0,0 +1,370 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shared_device_server.h"
+#include "shared_protocol.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "concurrency/thread_placement.h"
+#include "core/frame_data.h"
+#include "device/device.h"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+#include "device/shared_device.hpp"
+
+namespace libsmartereye2 {
+namespace ipc {
+
+static const uint32_t kMinSlotCapacity(1024 * 1024);
+static const int kServePollTimeout(200);  // ms
+
+static SeExtension extensionOf(FrameId frame_id) {
+  switch (frame_id) {
+    case FrameId::Disparity: return SeExtension::EXTENSION_DISPARITY_FRAME;
+    case FrameId::Lane: return SeExtension::EXTENSION_LANE_FRAME;
+    case FrameId::Obstacle: return SeExtension::EXTENSION_OBSTACLE_FRAME;
+    case FrameId::FreeSpace: return SeExtension::EXTENSION_FREESPACE_FRAME;
+    case FrameId::TrafficSign: return SeExtension::EXTENSION_TRAFFIC_SIGN_FRAME;
+    case FrameId::TrafficLight: return SeExtension::EXTENSION_TRAFFIC_LIGHT_FRAME;
+    case FrameId::J2Perception: return SeExtension::EXTENSION_JOURNEY_FRAME;
+    case FrameId::SmallObstacle: return SeExtension::EXTENSION_SMALL_OBS_FRAME;
+    case FrameId::Flatness: return SeExtension::EXTENSION_FLATNESS_FRAME;
+    case FrameId::VehicleInfo: return SeExtension::EXTENSION_VEHICLE_INFO_FRAME;
+    case FrameId::Matrix: return SeExtension::EXTENSION_Matrix;
+    default: return SeExtension::EXTENSION_VIDEO_FRAME;
+  }
+}
+
+SharedServerPrivate::SharedServerPrivate(std::shared_ptr<DeviceInterface> device,
+                                         std::string endpoint,
+                                         uint32_t slot_count)
+    : device_(std::move(device)),
+      sensor_(nullptr),
+      endpoint_(std::move(endpoint)),
+      slot_count_(slot_count),
+      leases_in_use_(0),
+      subscribed_ids_(0),
+      running_(false) {
+  CHECK_PTR_NOT_NULL(device_);
+  if (device_->getSensorCount() == 0) {
+    throw std::runtime_error("Shared device server needs a device with at least one sensor");
+  }
+  sensor_ = &device_->getSensor(0);
+}
+
+SharedServerPrivate::~SharedServerPrivate() {
+  try {
+    stop();
+  } catch (const std::exception &e) {
+    LOG(WARNING) << "Shared device server did not stop cleanly: " << e.what();
+  }
+}
+
+void SharedServerPrivate::start() {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (running_) {
+    throw std::runtime_error("start(...) failed. Shared device server is already running!");
+  }
+
+  auto profiles = sensor_->getStreamProfiles(ProfileTag::PROFILE_TAG_ANY);
+  uint32_t slot_capacity = kMinSlotCapacity;
+  for (auto &&profile : profiles) {
+    if (auto video = dynamic_cast<VideoStreamProfileInterface *>(profile.get())) {
+      auto frame_size = static_cast<uint32_t>(getStrideByFormat(video->format(), video->width())) * video->height();
+      slot_capacity = std::max(slot_capacity, frame_size);
+    }
+  }
+
+  ring_ = ShmFrameRing::create(toString() << "/smartereye2." << ::getpid(), slot_count_, slot_capacity);
+  try {
+    buildDescribe();
+    listener_.listen(endpoint_);
+
+    sensor_->open(profiles);
+    try {
+      auto on_frame = [this](FrameHolder frame) { publish(std::move(frame)); };
+      sensor_->start(FrameCallbackPtr(new InternalFrameCallback<decltype(on_frame)>(on_frame)));
+    } catch (...) {
+      sensor_->close();
+      throw;
+    }
+  } catch (...) {
+    // a later start() begins from scratch
+    listener_.close();
+    describe_.clear();
+    ring_.reset();
+    throw;
+  }
+
+  running_ = true;
+  serve_thread_ = std::thread([this] {
+    ThreadPlacement::Scope placement(ThreadRole::IPC, "se2-ipc-serve");
+    serve();
+  });
+  LOG(INFO) << "Sharing device on " << endpoint_;
+}
+
+void SharedServerPrivate::stop() {
+  std::lock_guard<std::mutex> lock(operation_lock_);
+  if (!running_) return;
+
+  running_ = false;
+  if (serve_thread_.joinable()) {
+    serve_thread_.join();
+  }
+
+  sensor_->stop();
+  sensor_->close();
+
+  {
+    std::lock_guard<std::mutex> clients_lock(clients_mutex_);
+    clients_.clear();
+  }
+  leases_in_use_ = 0;
+  subscribed_ids_ = 0;
+  listener_.close();
+  ring_.reset();
+}
+
+void SharedServerPrivate::buildDescribe() {
+  auto profiles = sensor_->getStreamProfiles(ProfileTag::PROFILE_TAG_ANY);
+
+  SharedDescribe describe{};
+  std::strncpy(describe.ring_name, ring_->name().c_str(), kSharedRingNameLength - 1);
+  describe.slot_count = ring_->slotCount();
+  describe.slot_capacity = ring_->slotCapacity();
+  describe.stream_count = static_cast<uint32_t>(profiles.size());
+
+  describe_.resize(sizeof(describe) + profiles.size() * sizeof(SharedStreamDesc));
+  std::memcpy(describe_.data(), &describe, sizeof(describe));
+
+  auto streams = reinterpret_cast<SharedStreamDesc *>(describe_.data() + sizeof(describe));
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    auto &profile = profiles[i];
+    SharedStreamDesc desc{};
+    desc.frame_id = static_cast<uint32_t>(profile->frameId());
+    desc.format = static_cast<int32_t>(profile->format());
+    desc.index = profile->index();
+    desc.fps = profile->fps();
+    desc.intrinsics = profile->getIntrinsics();
+    desc.extrinsics = profile->getExtrinsics();
+    if (auto video = dynamic_cast<VideoStreamProfileInterface *>(profile.get())) {
+      desc.width = video->width();
+      desc.height = video->height();
+    }
+    std::memcpy(streams + i, &desc, sizeof(desc));
+  }
+}
+
+void SharedServerPrivate::serve() {
+  std::vector<pollfd> fds;
+  std::vector<std::shared_ptr<Client>> polled;
+  MessageHead head{};
+  std::vector<uint8_t> body;
+
+  while (running_) {
+    {
+      std::lock_guard<std::mutex> lock(clients_mutex_);
+      polled = clients_;
+    }
+
+    fds.clear();
+    fds.push_back({listener_.fd(), POLLIN, 0});
+    for (auto &&client : polled) {
+      fds.push_back({client->socket.fd(), POLLIN, 0});
+    }
+
+    if (::poll(fds.data(), fds.size(), kServePollTimeout) <= 0) continue;
+
+    if (fds[0].revents & POLLIN) {
+      accept();
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < polled.size(); ++i) {
+      if (!fds[i + 1].revents) continue;
+
+      auto &client = polled[i];
+      bool alive = client->socket.recv(&head, &body, 0) && handleMessage(*client, head, body);
+      if (!alive) {
+        disconnect(client);
+      }
+      changed = true;
+    }
+
+    if (changed) updateSubscriptions();
+  }
+}
+
+void SharedServerPrivate::accept() {
+  auto client = std::make_shared<Client>();
+  client->socket = listener_.accept();
+  if (!client->socket.isValid()) return;
+
+  while (client->lease < kShmMaxClients && (leases_in_use_ & (1u << client->lease))) {
+    ++client->lease;
+  }
+  if (client->lease == kShmMaxClients) {
+    LOG(WARNING) << "Shared device already serves " << kShmMaxClients << " clients, connection refused";
+    return;
+  }
+
+  // a fresh epoch, whatever the last client of this lease still held is void
+  std::vector<uint8_t> describe(describe_);
+  auto describe_head = reinterpret_cast<SharedDescribe *>(describe.data());
+  describe_head->lease_client = client->lease;
+  describe_head->lease_epoch = ring_->renewLease(client->lease);
+  if (!client->socket.send(SharedMessage_Describe, describe.data(), static_cast<uint32_t>(describe.size()))) return;
+
+  leases_in_use_ |= 1u << client->lease;
+  std::lock_guard<std::mutex> lock(clients_mutex_);
+  clients_.push_back(client);
+  LOG(INFO) << "Shared device client connected, " << clients_.size() << " in total";
+}
+
+void SharedServerPrivate::disconnect(const std::shared_ptr<Client> &client) {
+  // the client may have crashed holding slots; they go back to the ring now
+  ring_->renewLease(client->lease);
+  leases_in_use_ &= ~(1u << client->lease);
+
+  std::lock_guard<std::mutex> lock(clients_mutex_);
+  clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+  LOG(INFO) << "Shared device client disconnected, " << clients_.size() << " left";
+}
+
+bool SharedServerPrivate::handleMessage(Client &client, const MessageHead &head, const std::vector<uint8_t> &body) {
+  switch (head.type) {
+    case SharedMessage_Subscribe: {
+      if (body.size() < sizeof(SharedSubscribe)) return false;
+      SharedSubscribe subscribe{};
+      std::memcpy(&subscribe, body.data(), sizeof(subscribe));
+      std::lock_guard<std::mutex> lock(clients_mutex_);
+      client.frame_ids = subscribe.frame_ids;
+    }
+      break;
+    case SharedMessage_Unsubscribe: {
+      std::lock_guard<std::mutex> lock(clients_mutex_);
+      client.frame_ids = 0;
+    }
+      break;
+    default:
+      LOG(WARNING) << "Unexpected message " << head.type << " from shared device client";
+      return false;
+  }
+  return true;
+}
+
+void SharedServerPrivate::updateSubscriptions() {
+  uint32_t frame_ids = 0;
+  std::lock_guard<std::mutex> lock(clients_mutex_);
+  for (auto &&client : clients_) {
+    frame_ids |= client->frame_ids;
+  }
+  subscribed_ids_ = frame_ids;
+}
+
+void SharedServerPrivate::publish(FrameHolder frame) {
+  auto profile = frame->getStreamProfile();
+  if (!profile) return;
+
+  auto frame_id = profile->frameId();
+  auto frame_id_bits = static_cast<uint32_t>(frame_id);
+  if (!(subscribed_ids_ & frame_id_bits)) return;  // nobody asked, skip the copy
+
+  auto data_size = frame->getFrameDataSize();
+  auto metadata_size = frame->getFrameMetadataSize();
+  if (data_size > ring_->slotCapacity() || metadata_size > kShmMetadataCapacity) {
+    LOG(WARNING) << "Frame of " << data_size << " bytes does not fit into a shared slot, dropped";
+    return;
+  }
+
+  uint32_t slot = 0;
+  auto header = ring_->beginWrite(&slot);
+  if (!header) {
+    LOG(DEBUG) << "All shared slots are held by clients, frame dropped";
+    return;
+  }
+
+  auto frame_data = dynamic_cast<FrameData *>(frame.frame);
+  header->extension = static_cast<uint32_t>(extensionOf(frame_id));
+  header->frame_id = frame_id_bits;
+  header->frame_format = static_cast<int32_t>(profile->format());
+  header->stream_index = profile->index();
+  header->width = header->height = header->stride = header->bpp = 0;
+  if (auto video = dynamic_cast<VideoFrameData *>(frame.frame)) {
+    header->width = video->width();
+    header->height = video->height();
+    header->stride = video->stride();
+    header->bpp = video->bpp();
+  }
+  header->index = static_cast<uint64_t>(frame->getFrameIndex());
+  header->speed = frame->getSpeed();
+  header->timestamp = frame->getFrameTimestamp();
+  header->timestamp_domain = static_cast<int32_t>(frame->getFrameTimestampDomain());
+  header->metadata_value = frame_data ? static_cast<int32_t>(frame_data->extension().metadata_value) : 0;
+  header->metadata_size = static_cast<uint32_t>(metadata_size);
+  if (metadata_size > 0) {
+    std::memcpy(header->metadata, frame->getFrameMetadata(FrameMetadataValue::None), metadata_size);
+  }
+  header->data_size = static_cast<uint32_t>(data_size);
+  std::memcpy(ring_->payload(slot), frame->getFrameData(), data_size);
+
+  SharedFrameNotify notify{slot, ring_->commit(slot)};
+
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (auto &&client : clients_) {
+      if (client->frame_ids & frame_id_bits) notified_.push_back(client);
+    }
+  }
+  // A client that does not keep up misses frames instead of stalling the device. One left with half a
+  // notification has its socket shut down, the serve thread disconnects it.
+  for (auto &&client : notified_) {
+    client->socket.send(SharedMessage_Frame, &notify, sizeof(notify), false);
+  }
+  notified_.clear();
+}
+
+}  // namespace ipc
+}  // namespace libsmartereye2
+
+namespace se2 {
+
+SharedDeviceServer::SharedDeviceServer(const Device &device, const std::string &endpoint, uint32_t slot_count) {
+  auto dev = device.get();
+  if (!dev || !dev->device) {
+    throw std::runtime_error("SharedDeviceServer needs a valid device");
+  }
+  auto server = std::make_shared<libsmartereye2::ipc::SharedServerPrivate>(dev->device, endpoint, slot_count);
+  server_ = std::make_shared<SeSharedDeviceServer>(SeSharedDeviceServer{server});
+}
+
+void SharedDeviceServer::start() {
+  server_->server->start();
+}
+
+void SharedDeviceServer::stop() {
+  server_->server->stop();
+}
+
+uint64_t SharedDeviceServer::droppedFrames() const {
+  return server_->server->dropped();
+}
+
+}  // namespace se2
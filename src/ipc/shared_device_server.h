@@ -0,0 +1,94 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHARED_DEVICE_SERVER_H
+#define LIBSMARTEREYE2_SHARED_DEVICE_SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/frame.h"
+#include "unix_socket.h"
+#include "shm_frame_ring.h"
+
+namespace libsmartereye2 {
+class DeviceInterface;
+class SensorInterface;
+namespace ipc {
+class SharedServerPrivate;
+}
+}
+
+struct SeSharedDeviceServer {
+  std::shared_ptr<libsmartereye2::ipc::SharedServerPrivate> server;
+};
+
+namespace libsmartereye2 {
+namespace ipc {
+
+// Owns a device on behalf of other processes: frames go into a shared-memory ring,
+// clients pick their streams and get slot notifications over a unix socket.
+class SharedServerPrivate {
+ public:
+  SharedServerPrivate(std::shared_ptr<DeviceInterface> device, std::string endpoint, uint32_t slot_count);
+  ~SharedServerPrivate();
+
+  void start();
+  void stop();
+
+  uint64_t dropped() const { return ring_ ? ring_->dropped() : 0; }
+
+ private:
+  struct Client {
+    UnixSocket socket;
+    uint32_t frame_ids = 0;
+    uint32_t lease = 0;
+  };
+
+  void serve();
+  void accept();
+  void disconnect(const std::shared_ptr<Client> &client);
+  bool handleMessage(Client &client, const MessageHead &head, const std::vector<uint8_t> &body);
+  void updateSubscriptions();
+  void buildDescribe();
+  void publish(FrameHolder frame);
+
+  std::shared_ptr<DeviceInterface> device_;
+  SensorInterface *sensor_;
+  std::string endpoint_;
+  uint32_t slot_count_;
+
+  std::shared_ptr<ShmFrameRing> ring_;
+  std::vector<uint8_t> describe_;
+
+  UnixSocket listener_;
+  std::vector<std::shared_ptr<Client>> clients_;
+  std::vector<std::shared_ptr<Client>> notified_;  // publish()'s, kept for its capacity
+  uint32_t leases_in_use_;  // one bit per ring lease, serve thread only
+  std::mutex clients_mutex_;
+  std::atomic<uint32_t> subscribed_ids_;
+
+  std::atomic<bool> running_;
+  std::thread serve_thread_;
+  std::mutex operation_lock_;
+};
+
+}  // namespace ipc
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_SHARED_DEVICE_SERVER_H
@@ -0,0 +1,68 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHARED_PROTOCOL_H
+#define LIBSMARTEREYE2_SHARED_PROTOCOL_H
+
+#include <cstdint>
+
+#include "device/device_types.hpp"
+
+namespace libsmartereye2 {
+namespace ipc {
+
+// Messages exchanged over the unix socket of a shared device.
+// Frames themselves never cross the socket, only the slot they were written to.
+enum SharedMessage : uint32_t {
+  SharedMessage_Describe = 1,  // server -> client: SharedDescribe + SharedStreamDesc[stream_count]
+  SharedMessage_Subscribe,     // client -> server: SharedSubscribe
+  SharedMessage_Unsubscribe,   // client -> server: no body
+  SharedMessage_Frame,         // server -> client: SharedFrameNotify
+};
+
+static const uint32_t kSharedRingNameLength(64);
+
+struct SharedDescribe {
+  char ring_name[kSharedRingNameLength];
+  uint32_t slot_count;
+  uint32_t slot_capacity;
+  uint32_t stream_count;
+  uint32_t lease_client;  // the client's holds on ring slots are counted under this lease
+  uint32_t lease_epoch;
+};
+
+struct SharedStreamDesc {
+  uint32_t frame_id;
+  int32_t format;
+  int32_t index;
+  int32_t width;
+  int32_t height;
+  uint32_t fps;
+  se2::Intrinsics intrinsics;
+  se2::Extrinsics extrinsics;
+};
+
+struct SharedSubscribe {
+  uint32_t frame_ids;  // FrameId mask
+};
+
+struct SharedFrameNotify {
+  uint32_t slot;
+  uint64_t sequence;
+};
+
+}  // namespace ipc
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_SHARED_PROTOCOL_H
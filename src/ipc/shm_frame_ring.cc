@@ -0,0 +1,221 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shm_frame_ring.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+namespace ipc {
+
+static size_t alignUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+static size_t headerSize() {
+  return alignUp(sizeof(ShmRingHeader), 64);
+}
+
+static const uint32_t kLeaseCountMask(0xffff);
+
+static uint32_t leaseWord(uint32_t epoch, uint32_t count) {
+  return (epoch << 16) | count;
+}
+
+ShmFrameRing::~ShmFrameRing() {
+  if (base_) {
+    ::munmap(base_, size_);
+  }
+  if (owner_) {
+    ::shm_unlink(name_.c_str());
+  }
+}
+
+std::shared_ptr<ShmFrameRing> ShmFrameRing::create(const std::string &name,
+                                                   uint32_t slot_count,
+                                                   uint32_t slot_capacity) {
+  if (slot_count == 0 || slot_capacity == 0) {
+    throw std::runtime_error("ShmFrameRing needs at least one non-empty slot");
+  }
+
+  auto slot_stride = alignUp(sizeof(ShmSlotHeader) + slot_capacity, 64);
+  auto size = headerSize() + slot_stride * slot_count;
+
+  ::shm_unlink(name.c_str());  // stale ring left by a crashed server
+  int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+  if (fd < 0) {
+    throw std::runtime_error(toString() << "shm_open(" << name << ") failed: " << std::strerror(errno));
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) < 0) {
+    auto err = errno;
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    throw std::runtime_error(toString() << "ftruncate(" << name << ") failed: " << std::strerror(err));
+  }
+
+  std::shared_ptr<ShmFrameRing> ring(new ShmFrameRing(name, true));
+  ring->map(fd, size);
+
+  auto header = new(ring->base_) ShmRingHeader();
+  header->magic = kShmRingMagic;
+  header->version = kShmRingVersion;
+  header->slot_count = slot_count;
+  header->slot_capacity = slot_capacity;
+  header->slot_stride = slot_stride;
+  header->write_sequence = 0;
+  header->dropped = 0;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    auto slot = new(ring->slotHeader(i)) ShmSlotHeader();
+    slot->sequence = 0;
+    for (auto &lease : slot->leases) {
+      lease = 0;
+    }
+  }
+
+  LOG(INFO) << "Shared frame ring " << name << ": " << slot_count << " slots of " << slot_capacity << " bytes";
+  return ring;
+}
+
+std::shared_ptr<ShmFrameRing> ShmFrameRing::open(const std::string &name) {
+  int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw std::runtime_error(toString() << "shm_open(" << name << ") failed: " << std::strerror(errno));
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < headerSize()) {
+    ::close(fd);
+    throw std::runtime_error(toString() << "Shared frame ring " << name << " is truncated");
+  }
+
+  std::shared_ptr<ShmFrameRing> ring(new ShmFrameRing(name, false));
+  ring->map(fd, static_cast<size_t>(st.st_size));
+
+  auto header = ring->header_;
+  if (header->magic != kShmRingMagic || header->version != kShmRingVersion
+      || headerSize() + header->slot_stride * header->slot_count > ring->size_) {
+    throw std::runtime_error(toString() << "Shared frame ring " << name << " has an unexpected layout");
+  }
+  return ring;
+}
+
+void ShmFrameRing::map(int fd, size_t size) {
+  void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error(toString() << "mmap(" << name_ << ") failed: " << std::strerror(errno));
+  }
+  base_ = static_cast<uint8_t *>(addr);
+  size_ = size;
+  header_ = reinterpret_cast<ShmRingHeader *>(base_);
+}
+
+ShmSlotHeader *ShmFrameRing::slotHeader(uint32_t slot) const {
+  return reinterpret_cast<ShmSlotHeader *>(base_ + headerSize() + header_->slot_stride * slot);
+}
+
+uint8_t *ShmFrameRing::payload(uint32_t slot) const {
+  return reinterpret_cast<uint8_t *>(slotHeader(slot)) + sizeof(ShmSlotHeader);
+}
+
+ShmSlotHeader *ShmFrameRing::beginWrite(uint32_t *slot) {
+  auto slot_count = header_->slot_count;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    auto candidate = next_slot_;
+    next_slot_ = (next_slot_ + 1) % slot_count;
+
+    // claim first, then look for holders: a reader either sees the claim or is seen here
+    auto header = slotHeader(candidate);
+    auto previous = header->sequence.exchange(0);
+    bool held = false;
+    for (auto &lease : header->leases) {
+      if (lease.load() & kLeaseCountMask) {
+        held = true;
+        break;
+      }
+    }
+    if (!held) {
+      *slot = candidate;
+      return header;
+    }
+    header->sequence.store(previous);
+  }
+
+  header_->dropped.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+uint64_t ShmFrameRing::commit(uint32_t slot) {
+  auto header = slotHeader(slot);
+  auto sequence = header_->write_sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+  header->sequence.store(sequence, std::memory_order_release);
+  return sequence;
+}
+
+uint32_t ShmFrameRing::renewLease(uint32_t client) {
+  if (client >= kShmMaxClients) {
+    throw std::runtime_error(toString() << "Shared frame ring has no lease " << client);
+  }
+  auto epoch = epochs_[client] = (epochs_[client] + 1) & kLeaseCountMask;
+  for (uint32_t i = 0; i < header_->slot_count; ++i) {
+    slotHeader(i)->leases[client].store(leaseWord(epoch, 0));
+  }
+  return epoch;
+}
+
+void ShmFrameRing::setLease(uint32_t client, uint32_t epoch) {
+  if (client >= kShmMaxClients) {
+    throw std::runtime_error(toString() << "Shared frame ring has no lease " << client);
+  }
+  lease_client_ = client;
+  lease_epoch_ = epoch;
+}
+
+const ShmSlotHeader *ShmFrameRing::acquire(uint32_t slot, uint64_t sequence) {
+  if (slot >= header_->slot_count) return nullptr;
+
+  auto header = slotHeader(slot);
+  auto &lease = header->leases[lease_client_];
+  auto word = lease.load(std::memory_order_relaxed);
+  do {
+    if ((word >> 16) != lease_epoch_) return nullptr;  // revoked
+  } while (!lease.compare_exchange_weak(word, word + 1));
+
+  if (header->sequence.load() != sequence) {
+    release(slot);
+    return nullptr;
+  }
+  return header;
+}
+
+void ShmFrameRing::release(uint32_t slot) {
+  auto &lease = slotHeader(slot)->leases[lease_client_];
+  auto word = lease.load(std::memory_order_relaxed);
+  do {
+    // the server took the lease back, the hold is gone already
+    if ((word >> 16) != lease_epoch_ || !(word & kLeaseCountMask)) return;
+  } while (!lease.compare_exchange_weak(word, word - 1, std::memory_order_release));
+}
+
+}  // namespace ipc
+}  // namespace libsmartereye2
@@ -0,0 +1,119 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SHM_FRAME_RING_H
+#define LIBSMARTEREYE2_SHM_FRAME_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "se_util.hpp"
+
+namespace libsmartereye2 {
+namespace ipc {
+
+static const uint32_t kShmRingMagic(0x53453252);  // "SE2R"
+static const uint32_t kShmRingVersion(2);
+static const uint32_t kShmMetadataCapacity(2048);
+static const uint32_t kShmMaxClients(32);
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared-memory ring needs address-free atomics");
+
+// Everything a client needs to rebuild the FrameExtension and the frame geometry.
+struct ShmSlotHeader {
+  std::atomic<uint64_t> sequence;  // 0 while the slot is being written
+  // per client lease: its epoch in the high half, frames of this slot it holds in the low half
+  std::atomic<uint32_t> leases[kShmMaxClients];
+  uint32_t extension;              // SeExtension
+  uint32_t frame_id;
+  int32_t frame_format;
+  int32_t stream_index;
+  int32_t width, height, stride, bpp;
+  uint64_t index;
+  int64_t speed;
+  double timestamp;
+  int32_t timestamp_domain;
+  int32_t metadata_value;
+  uint32_t metadata_size;
+  uint32_t data_size;
+  uint8_t metadata[kShmMetadataCapacity];
+};
+
+struct ShmRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_capacity;  // payload bytes per slot
+  uint64_t slot_stride;
+  std::atomic<uint64_t> write_sequence;
+  std::atomic<uint64_t> dropped;
+};
+
+// Single-writer ring of frame slots in POSIX shared memory.
+// The writer never touches a slot a reader still holds; it skips to the next free one
+// and drops the frame when every slot is in use. Holds are counted per client lease, so
+// the server takes back everything a client held when it goes away, even if it crashed;
+// releases made under a revoked lease are ignored.
+class ShmFrameRing : public noncopyable {
+ public:
+  ~ShmFrameRing();
+
+  static std::shared_ptr<ShmFrameRing> create(const std::string &name, uint32_t slot_count, uint32_t slot_capacity);
+  static std::shared_ptr<ShmFrameRing> open(const std::string &name);
+
+  // writer side
+  ShmSlotHeader *beginWrite(uint32_t *slot);
+  uint64_t commit(uint32_t slot);
+
+  // writer side; drops every hold of the client and starts a new lease epoch, which is returned
+  uint32_t renewLease(uint32_t client);
+
+  // reader side, holds are counted under this lease from now on
+  void setLease(uint32_t client, uint32_t epoch);
+
+  // reader side, the sequence tells whether the slot was recycled in the meantime
+  const ShmSlotHeader *acquire(uint32_t slot, uint64_t sequence);
+  void release(uint32_t slot);
+
+  uint8_t *payload(uint32_t slot) const;
+  ShmSlotHeader *slotHeader(uint32_t slot) const;
+
+  const std::string &name() const { return name_; }
+  uint32_t slotCount() const { return header_->slot_count; }
+  uint32_t slotCapacity() const { return header_->slot_capacity; }
+  uint64_t dropped() const { return header_->dropped.load(std::memory_order_relaxed); }
+
+ private:
+  ShmFrameRing(std::string name, bool owner) : name_(std::move(name)), owner_(owner) {}
+
+  void map(int fd, size_t size);
+
+  std::string name_;
+  bool owner_;
+  uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+  ShmRingHeader *header_ = nullptr;
+  uint32_t next_slot_ = 0;
+  uint32_t lease_client_ = 0;
+  uint32_t lease_epoch_ = 0;
+  uint32_t epochs_[kShmMaxClients] = {};  // writer only
+};
+
+}  // namespace ipc
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_SHM_FRAME_RING_H
@@ -0,0 +1,185 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unix_socket.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace libsmartereye2 {
+namespace ipc {
+
+static const uint32_t kMaxMessageLength(16 * 1024 * 1024);
+
+static sockaddr_un makeAddress(const std::string &path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error(toString() << "Socket path is too long: " << path);
+  }
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+UnixSocket::UnixSocket(UnixSocket &&other) noexcept
+    : fd_(other.fd_), bound_path_(std::move(other.bound_path_)) {
+  other.fd_ = -1;
+  other.bound_path_.clear();
+}
+
+UnixSocket &UnixSocket::operator=(UnixSocket &&other) noexcept {
+  if (this != &other) {
+    close();
+    fd_ = other.fd_;
+    bound_path_ = std::move(other.bound_path_);
+    other.fd_ = -1;
+    other.bound_path_.clear();
+  }
+  return *this;
+}
+
+UnixSocket::~UnixSocket() {
+  close();
+}
+
+void UnixSocket::listen(const std::string &path) {
+  close();
+  auto addr = makeAddress(path);
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error(toString() << "socket() failed: " << std::strerror(errno));
+  }
+
+  ::unlink(path.c_str());
+  if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd_, 8) < 0) {
+    auto err = errno;
+    close();
+    throw std::runtime_error(toString() << "Unable to listen on " << path << ": " << std::strerror(err));
+  }
+  bound_path_ = path;
+}
+
+void UnixSocket::connect(const std::string &path) {
+  close();
+  auto addr = makeAddress(path);
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error(toString() << "socket() failed: " << std::strerror(errno));
+  }
+
+  if (::connect(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    auto err = errno;
+    close();
+    throw std::runtime_error(toString() << "Unable to connect to " << path << ": " << std::strerror(err));
+  }
+}
+
+UnixSocket UnixSocket::accept() const {
+  int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+  return UnixSocket(fd);
+}
+
+void UnixSocket::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  if (!bound_path_.empty()) {
+    ::unlink(bound_path_.c_str());
+    bound_path_.clear();
+  }
+}
+
+bool UnixSocket::send(uint32_t type, const void *data, uint32_t size, bool blocking) const {
+  if (fd_ < 0) return false;
+
+  MessageHead head{type, size};
+  iovec iov[2];
+  iov[0].iov_base = &head;
+  iov[0].iov_len = sizeof(head);
+  iov[1].iov_base = const_cast<void *>(data);
+  iov[1].iov_len = data ? size : 0;
+
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  int flags = MSG_NOSIGNAL | (blocking ? 0 : MSG_DONTWAIT);
+  size_t total = sizeof(head) + iov[1].iov_len;
+  size_t sent = 0;
+  while (sent < total) {
+    auto ret = ::sendmsg(fd_, &msg, flags);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN && !blocking && sent > 0) {
+        // never leave half a message on the wire, nor wait for a peer that does not read
+        ::shutdown(fd_, SHUT_RDWR);
+      }
+      return false;
+    }
+    sent += ret;
+
+    auto left = static_cast<size_t>(ret);
+    while (msg.msg_iovlen > 0 && left >= msg.msg_iov[0].iov_len) {
+      left -= msg.msg_iov[0].iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (msg.msg_iovlen > 0) {
+      msg.msg_iov[0].iov_base = static_cast<uint8_t *>(msg.msg_iov[0].iov_base) + left;
+      msg.msg_iov[0].iov_len -= left;
+    }
+  }
+  return true;
+}
+
+bool UnixSocket::recv(MessageHead *head, std::vector<uint8_t> *body, int timeout_ms) const {
+  if (timeout_ms >= 0 && !waitReadable(timeout_ms)) return false;
+  if (!readAll(head, sizeof(*head))) return false;
+  if (head->length > kMaxMessageLength) return false;
+
+  body->resize(head->length);
+  return head->length == 0 || readAll(body->data(), head->length);
+}
+
+bool UnixSocket::waitReadable(int timeout_ms) const {
+  if (fd_ < 0) return false;
+
+  pollfd pfd{fd_, POLLIN, 0};
+  int ret;
+  do {
+    ret = ::poll(&pfd, 1, timeout_ms);
+  } while (ret < 0 && errno == EINTR);
+  return ret > 0;
+}
+
+bool UnixSocket::readAll(void *data, size_t size) const {
+  auto ptr = static_cast<uint8_t *>(data);
+  while (size > 0) {
+    auto ret = ::recv(fd_, ptr, size, 0);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) return false;
+    ptr += ret;
+    size -= ret;
+  }
+  return true;
+}
+
+}  // namespace ipc
+}  // namespace libsmartereye2
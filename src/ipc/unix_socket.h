@@ -0,0 +1,68 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_UNIX_SOCKET_H
+#define LIBSMARTEREYE2_UNIX_SOCKET_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "se_util.hpp"
+
+namespace libsmartereye2 {
+namespace ipc {
+
+struct MessageHead {
+  uint32_t type;
+  uint32_t length;
+};
+
+// Stream socket on a filesystem path, framed as MessageHead + body.
+class UnixSocket : public noncopyable {
+ public:
+  UnixSocket() = default;
+  explicit UnixSocket(int fd) : fd_(fd) {}
+  UnixSocket(UnixSocket &&other) noexcept;
+  UnixSocket &operator=(UnixSocket &&other) noexcept;
+  ~UnixSocket();
+
+  void listen(const std::string &path);
+  void connect(const std::string &path);
+  UnixSocket accept() const;
+  void close();
+
+  // A blocking send retries until the whole message is written;
+  // a non-blocking one gives up when the peer's buffer is full. One that gives up
+  // halfway shuts the socket down, the peer reads the end of the stream instead of
+  // half a message.
+  bool send(uint32_t type, const void *data, uint32_t size, bool blocking = true) const;
+  // Waits at most timeout_ms (-1 forever). Returns false on timeout or disconnect.
+  bool recv(MessageHead *head, std::vector<uint8_t> *body, int timeout_ms = -1) const;
+  bool waitReadable(int timeout_ms) const;
+
+  int fd() const { return fd_; }
+  bool isValid() const { return fd_ >= 0; }
+
+ private:
+  bool readAll(void *data, size_t size) const;
+
+  int fd_ = -1;
+  std::string bound_path_;
+};
+
+}  // namespace ipc
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_UNIX_SOCKET_H
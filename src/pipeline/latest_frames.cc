@@ -0,0 +1,85 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latest_frames.h"
+
+#include "streaming/stream_profile.h"
+
+namespace libsmartereye2 {
+
+LatestFrames::LatestFrames()
+    : streams_wanted_(0),
+      framesets_wanted_(false) {
+}
+
+void LatestFrames::publish(const FrameHolder &frame) {
+  auto wanted = streams_wanted_.load(std::memory_order_relaxed);
+  if (!frame || !wanted) return;
+
+  auto composite = dynamic_cast<CompositeFrameData *>(frame.frame);
+  if (composite) {
+    for (size_t i = 0; i < composite->getFrameCount(); ++i) {
+      auto member = composite->getFrame(i);
+      auto profile = member ? member->getStreamProfile() : nullptr;
+      auto slot = profile ? frameIdSlot(profile->frameId()) : -1;
+      if (slot < 0 || !(wanted & (1u << slot))) continue;
+      member->acquire();
+      streams_[slot].buffer.publish(FrameHolder(member));
+    }
+    return;
+  }
+
+  auto profile = frame->getStreamProfile();
+  auto slot = profile ? frameIdSlot(profile->frameId()) : -1;
+  if (slot < 0 || !(wanted & (1u << slot))) return;
+  // the displaced frame is released here, on the writer
+  streams_[slot].buffer.publish(frame.clone());
+}
+
+void LatestFrames::publishFrameset(const FrameHolder &frameset) {
+  if (!frameset || !framesetsWanted()) return;
+  framesets_.buffer.publish(frameset.clone());
+}
+
+FrameHolder LatestFrames::latest(FrameId frame_id, uint64_t *generation) {
+  auto slot = frameIdSlot(frame_id);
+  if (slot < 0) {
+    if (generation) *generation = 0;
+    return FrameHolder();
+  }
+  streams_wanted_.fetch_or(1u << slot, std::memory_order_relaxed);
+  return read(&streams_[slot], generation);
+}
+
+FrameHolder LatestFrames::latestFrameset(uint64_t *generation) {
+  framesets_wanted_.store(true, std::memory_order_relaxed);
+  return read(&framesets_, generation);
+}
+
+void LatestFrames::clear() {
+  for (auto &stream : streams_) {
+    std::lock_guard<std::mutex> lock(stream.reader);
+    stream.buffer.clear();
+  }
+  std::lock_guard<std::mutex> lock(framesets_.reader);
+  framesets_.buffer.clear();
+}
+
+FrameHolder LatestFrames::read(Latest *latest, uint64_t *generation) {
+  std::lock_guard<std::mutex> lock(latest->reader);
+  const auto &frame = latest->buffer.read(generation);
+  return frame ? frame.clone() : FrameHolder();
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,64 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_LATEST_FRAMES_H
+#define LIBSMARTEREYE2_LATEST_FRAMES_H
+
+#include <atomic>
+#include <mutex>
+
+#include "core/frame.h"
+#include "core/frame_data.h"
+#include "concurrency/triple_buffer.h"
+
+namespace libsmartereye2 {
+
+// The newest frame of every stream and the newest frameset of a pipeline. Publishing never waits,
+// each stream has one writer (the thread its sensor delivers on); readers of one stream take turns
+// on a lock the writer never touches. A stream is kept from the first read of it on, so streams
+// nobody reads pin no frames.
+class LatestFrames {
+ public:
+  LatestFrames();
+
+  // members of a composite go to their own streams
+  void publish(const FrameHolder &frame);
+  void publishFrameset(const FrameHolder &frameset);
+
+  FrameHolder latest(FrameId frame_id, uint64_t *generation);
+  FrameHolder latestFrameset(uint64_t *generation);
+
+  // true once latestFrameset() has been asked for, framesets need not be built before
+  bool framesetsWanted() const { return framesets_wanted_.load(std::memory_order_relaxed); }
+
+  // releases every kept frame; call only while nothing publishes
+  void clear();
+
+ private:
+  struct Latest {
+    TripleBuffer<FrameHolder> buffer;
+    std::mutex reader;
+  };
+
+  static FrameHolder read(Latest *latest, uint64_t *generation);
+
+  Latest streams_[kFrameIdSlots];
+  Latest framesets_;
+  std::atomic<uint32_t> streams_wanted_;  // one bit per FrameId slot
+  std::atomic<bool> framesets_wanted_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_LATEST_FRAMES_H
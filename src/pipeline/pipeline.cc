@@ -24,6 +24,7 @@
 #include "pipeline_profile.h"
 #include "streaming/stream_profile.h"
 #include "core/frame.h"
+#include "concurrency/thread_placement.h"
 #include "easylogging++.h"
 
 #include "pipeline/pipeline.hpp"
@@ -34,10 +35,31 @@
 
 namespace libsmartereye2 {
 
+namespace {
+
+// more than one image stream the aggregator would otherwise have to match in software
+bool wantsPacketFramesets(const SensorInterface *sensor) {
+  uint32_t images = 0;
+  for (auto &&stream : sensor->getActiveStreams()) {
+    auto frame_id = stream->frameId();
+    if (static_cast<uint32_t>(frame_id) < static_cast<uint32_t>(FrameId::Lane)) {
+      images |= static_cast<uint32_t>(frame_id);
+    }
+  }
+  return images & (images - 1);
+}
+
+}  // namespace
+
 PipelinePrivate::PipelinePrivate(const std::shared_ptr<ContextPrivate> &context)
     : context_(context),
       device_hub_(context),
+      fanout_(std::make_shared<FrameFanout>()),
       synced_streams_({FrameId::CalibLeftCamera, FrameId::Disparity}),
+      perception_wait_ms_(FrameAggregator::kDefaultMaxWaitMs),
+      trigger_(FramesetTrigger::MATCHED),
+      trigger_leader_(FrameId::LeftCamera),
+      trigger_period_ms_(40),
       is_stopping_(false) {
 }
 
@@ -45,6 +67,7 @@ PipelinePrivate::~PipelinePrivate() {
   try {
     unsafeStop();
   } catch (...) {}
+  if (polling_) polling_->cancel();
 }
 
 std::shared_ptr<PipelineProfilePrivate> PipelinePrivate::start(std::shared_ptr<PipelineConfigPrivate> conf,
@@ -121,22 +144,38 @@ std::shared_ptr<PipelineProfilePrivate> PipelinePrivate::getActiveProfile() cons
   return unsafeGetActiveProfile();
 }
 
-FrameHolder PipelinePrivate::waitForFrames(uint32_t timeout_ms) {
+std::shared_ptr<SubscriptionPrivate> PipelinePrivate::beginPolling(const char *caller) {
   std::lock_guard<std::mutex> lock(mutex_);
-  FrameHolder frame_holder;
   if (!active_profile_) {
-    LOG(WARNING) << "wait_for_frames cannot be called before start()";
-    return frame_holder;
+    LOG(WARNING) << caller << " cannot be called before start()";
+    return nullptr;
   }
   if (streams_callback_) {
-    LOG(WARNING) << "wait_for_frames cannot be called if a callback was provided";
-    return frame_holder;
+    LOG(WARNING) << caller << " cannot be called if a callback was provided";
+    return nullptr;
   }
 
-  if (aggregator_->dequeue(&frame_holder, timeout_ms)) {
+  if (!polling_) {
+    SubscriptionConfig config;
+    config.queue_size = kQueueMaxSize;
+    polling_ = std::make_shared<SubscriptionPrivate>(config, nullptr);
+    fanout_->add(polling_);
+  }
+  return polling_;
+}
+
+// Only the reconnect takes mutex_, waiting for frames does not hold up stop() or getActiveProfile().
+FrameHolder PipelinePrivate::waitForFrames(uint32_t timeout_ms) {
+  FrameHolder frame_holder;
+  auto polling = beginPolling("wait_for_frames");
+  if (!polling) return frame_holder;
+
+  if (polling->dequeue(&frame_holder, timeout_ms)) {
     return frame_holder;
   }
-  if (!isConnected()) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_profile_ || isConnected()) return frame_holder;
     // reconnect
     try {
       auto prev_conf = prev_conf_;
@@ -144,61 +183,75 @@ FrameHolder PipelinePrivate::waitForFrames(uint32_t timeout_ms) {
       if (!unsafeStart(prev_conf)) {
         return frame_holder;
       }
-      // if timeout_ms < 3000, stream may not resumed
-      timeout_ms = timeout_ms < 3000 ? 3000 : timeout_ms;
-      if (aggregator_->dequeue(&frame_holder, timeout_ms)) {
-        return frame_holder;
-      }
     } catch (const std::exception &e) {
       throw std::runtime_error(toString() << "Device disconnected. Failed to recconect: " << e.what() << timeout_ms);
     }
-    throw std::runtime_error(toString() << "Frame didn't arrive within " << timeout_ms);
   }
-  return frame_holder;
+  // if timeout_ms < 3000, stream may not resumed
+  timeout_ms = timeout_ms < 3000 ? 3000 : timeout_ms;
+  if (polling->dequeue(&frame_holder, timeout_ms)) {
+    return frame_holder;
+  }
+  throw std::runtime_error(toString() << "Frame didn't arrive within " << timeout_ms);
 }
 
 bool PipelinePrivate::pollForFrames(FrameHolder *frame_holder) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (!active_profile_) {
-    LOG(WARNING) << ("poll_for_frames cannot be called before start()");
-    return false;
-  }
-  if (streams_callback_) {
-    LOG(WARNING) << "poll_for_frames cannot be called if a callback was provided";
-    return false;
-  }
-
-  return aggregator_->tryDequeue(frame_holder);
+  auto polling = beginPolling("poll_for_frames");
+  return polling && polling->tryDequeue(frame_holder);
 }
 
 bool PipelinePrivate::tryWaitForFrames(FrameHolder *frame_holder, uint32_t timeout_ms) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (!active_profile_) {
-    LOG(WARNING) << "try_wait_for_frames cannot be called before start()";
-    return false;
-  }
-  if (streams_callback_) {
-    LOG(WARNING) << "try_wait_for_frames cannot be called if a callback was provided";
-    return false;
-  }
+  auto polling = beginPolling("try_wait_for_frames");
+  if (!polling) return false;
 
-  if (aggregator_->dequeue(frame_holder, timeout_ms)) {
+  if (polling->dequeue(frame_holder, timeout_ms)) {
     return true;
   }
 
   //hub returns true even if device already reconnected
-  if (!isConnected()) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_profile_ || isConnected()) return false;
     try {
       auto prev_conf = prev_conf_;
       unsafeStop();
-      return unsafeStart(prev_conf) ? aggregator_->dequeue(frame_holder, timeout_ms) : false;
+      if (!unsafeStart(prev_conf)) return false;
     }
     catch (const std::exception &e) {
       LOG(INFO) << e.what();
       return false;
     }
   }
-  return false;
+  return polling->dequeue(frame_holder, timeout_ms);
+}
+
+std::shared_ptr<SubscriptionPrivate> PipelinePrivate::subscribe(const SubscriptionConfig &config,
+                                                               FrameCallbackPtr callback) {
+  auto subscription = std::make_shared<SubscriptionPrivate>(config, std::move(callback));
+  fanout_->add(subscription);
+  return subscription;
+}
+
+FrameHolder PipelinePrivate::latest(FrameId frame_id, uint64_t *generation) {
+  return latest_.latest(frame_id, generation);
+}
+
+FrameHolder PipelinePrivate::latestFrameset(uint64_t *generation) {
+  return latest_.latestFrameset(generation);
+}
+
+void PipelinePrivate::setPerceptionWait(uint32_t max_wait_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  perception_wait_ms_ = max_wait_ms;
+  if (aggregator_) aggregator_->setMaxWait(max_wait_ms);
+}
+
+void PipelinePrivate::setFramesetTrigger(FramesetTrigger trigger, FrameId leader, uint32_t period_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  trigger_ = trigger;
+  trigger_leader_ = leader;
+  trigger_period_ms_ = period_ms;
+  if (aggregator_) aggregator_->setTrigger(trigger, leader, period_ms);
 }
 
 std::shared_ptr<DeviceInterface> PipelinePrivate::waitForDevice(const std::chrono::milliseconds &timeout,
@@ -208,6 +261,24 @@ std::shared_ptr<DeviceInterface> PipelinePrivate::waitForDevice(const std::chron
 
 FrameCallbackPtr PipelinePrivate::getCallback() const {
   auto on_frame_func = [this](FrameHolder fref) {
+    latest_.publish(fref);
+    if (streams_callback_) {
+      // the start() callback gets single frames, framesets are built only for subscriptions and latestFrameSet()
+      auto frame = fanout_->empty() && !latest_.framesetsWanted() ? std::move(fref) : fref.clone();
+      auto invocation = frame->getOwner()->begin_callback();
+      FrameInterface *ref = nullptr;
+      std::swap(frame.frame, ref);
+      try {
+        streams_callback_->onFrame(ref);
+      }
+      catch (const std::exception &e) {
+        LOG(ERROR) << "Exception was thrown during user callback: " << e.what();
+      }
+      catch (...) {
+        LOG(ERROR) << "Exception was thrown during user callback!";
+      }
+      if (!fref) return;
+    }
     aggregator_->invoke(std::move(fref));
   };
 
@@ -218,18 +289,22 @@ FrameCallbackPtr PipelinePrivate::getCallback() const {
 std::vector<int> PipelinePrivate::onStart(const std::shared_ptr<PipelineProfilePrivate> &profile) {
   std::vector<int> streams_to_aggregate_ids;
 
-  for (auto &&s : profile->getActiveStreams()) {
+  auto active_streams = profile->getActiveStreams();
+  for (auto &&s : active_streams) {
     streams_to_aggregate_ids.push_back(s->uniqueId());
   }
 
-//  aggregator_ = std::make_unique<FrameAggregator>(streams_to_aggregate_ids);  // c++ 14
-  aggregator_ = std::unique_ptr<FrameAggregator>(new FrameAggregator(streams_to_aggregate_ids));
+//  aggregator_ = std::make_unique<FrameAggregator>(active_streams, perception_wait_ms_);  // c++ 14
+  auto fanout = fanout_;
+  auto latest = &latest_;
+  auto sink = [fanout, latest](FrameHolder frameset, SyntheticSourceInterface &source) {
+    latest->publishFrameset(frameset);
+    fanout->publish(std::move(frameset), source);
+  };
+  aggregator_ = std::unique_ptr<FrameAggregator>(new FrameAggregator(active_streams, sink, perception_wait_ms_));
+  aggregator_->setTrigger(trigger_, trigger_leader_, trigger_period_ms_);
   aggregator_->start();
 
-  if (streams_callback_) {
-    aggregator_->setOutputCallback(streams_callback_);
-  }
-
   return streams_to_aggregate_ids;
 }
 
@@ -263,6 +338,14 @@ bool PipelinePrivate::unsafeStart(std::shared_ptr<PipelineConfigPrivate> conf) {
   auto multi_stream = profile->multi_stream_;
   assert(!multi_stream->getAllProfiles().empty());
   multi_stream->open();
+  // images sent together by the device need no software matching; unsafeStop() puts the option back
+  for (auto sensor : multi_stream->getSensors()) {
+    if (sensor->supportsOption(OptionKey::PACKET_FRAMESETS) && wantsPacketFramesets(sensor)) {
+      auto &option = sensor->getOption(OptionKey::PACKET_FRAMESETS);
+      packet_framesets_restore_.emplace_back(sensor, option.query());
+      option.set(1);
+    }
+  }
   auto synced_streams_ids = onStart(profile);
 
   FrameCallbackPtr callbacks = getCallback();
@@ -279,9 +362,15 @@ void PipelinePrivate::unsafeStop() {
       aggregator_->stop();
       active_profile_->multi_stream_->stop();
       active_profile_->multi_stream_->close();
+      for (auto &&restore : packet_framesets_restore_) {
+        restore.first->getOption(OptionKey::PACKET_FRAMESETS).set(restore.second);
+      }
     } catch (...) {
     } // Stop will throw if device was disconnected. TODO - refactoring anticipated
   }
+  packet_framesets_restore_.clear();
+  // kept frames point at the sensor and profiles, which may go with the device
+  latest_.clear();
   active_profile_.reset();
   prev_conf_.reset();
   is_stopping_ = false;
@@ -341,6 +430,41 @@ void Pipeline::restart(bool force) {
   pipeline_->pipeline->restart(force);
 }
 
+void Pipeline::setThreadPolicy(ThreadRole role, const ThreadPolicy &policy) {
+  libsmartereye2::ThreadPlacement::instance().setPolicy(role, policy);
+}
+
+void Pipeline::setRealtimeMode(bool enabled) {
+  libsmartereye2::ThreadPlacement::instance().setRealtimeMode(enabled);
+}
+
+void Pipeline::setPerceptionWait(uint32_t max_wait_ms) {
+  pipeline_->pipeline->setPerceptionWait(max_wait_ms);
+}
+
+void Pipeline::setFramesetTrigger(FramesetTrigger trigger, FrameId leader, uint32_t period_ms) {
+  pipeline_->pipeline->setFramesetTrigger(trigger, leader, period_ms);
+}
+
+Subscription Pipeline::subscribe(const SubscriptionConfig &config, FrameCallbackPtr callback) {
+  auto subscription = pipeline_->pipeline->subscribe(config, std::move(callback));
+  return Subscription(std::make_shared<SeSubscription>(SeSubscription{subscription}));
+}
+
+Frame Pipeline::latest(FrameId frame_id, uint64_t *generation) const {
+  auto frame_holder = pipeline_->pipeline->latest(frame_id, generation);
+  FrameInterface *result = nullptr;
+  std::swap(result, frame_holder.frame);
+  return Frame(result);
+}
+
+FrameSet Pipeline::latestFrameSet(uint64_t *generation) const {
+  auto frame_holder = pipeline_->pipeline->latestFrameset(generation);
+  FrameInterface *result = nullptr;
+  std::swap(result, frame_holder.frame);
+  return FrameSet(Frame(result));
+}
+
 bool Pipeline::isConnected() const {
   return pipeline_->pipeline->isConnected();
 }
@@ -21,6 +21,8 @@
 #include "device/context.h"
 #include "device/device_hub.h"
 #include "pipeline_profile.h"
+#include "subscription.h"
+#include "latest_frames.h"
 #include "concurrency/concurrency.h"
 
 namespace libsmartereye2 {
@@ -56,6 +58,11 @@ class PipelinePrivate : public std::enable_shared_from_this<PipelinePrivate> {
   std::shared_ptr<DeviceInterface> waitForDevice(const std::chrono::milliseconds &timeout,
                                                  const std::string &serial = "");
   std::shared_ptr<ContextPrivate> getContext() const { return context_; }
+  void setPerceptionWait(uint32_t max_wait_ms);
+  void setFramesetTrigger(FramesetTrigger trigger, FrameId leader, uint32_t period_ms);
+  std::shared_ptr<SubscriptionPrivate> subscribe(const SubscriptionConfig &config, FrameCallbackPtr callback);
+  FrameHolder latest(FrameId frame_id, uint64_t *generation);
+  FrameHolder latestFrameset(uint64_t *generation);
 
  protected:
   FrameCallbackPtr getCallback() const;
@@ -70,11 +77,20 @@ class PipelinePrivate : public std::enable_shared_from_this<PipelinePrivate> {
 
  private:
   std::shared_ptr<PipelineProfilePrivate> unsafeGetActiveProfile() const;
+  std::shared_ptr<SubscriptionPrivate> beginPolling(const char *caller);
 
   std::shared_ptr<ContextPrivate> context_;
 
   std::unique_ptr<FrameAggregator> aggregator_;
+  std::shared_ptr<FrameFanout> fanout_;
+  std::shared_ptr<SubscriptionPrivate> polling_;  // behind waitForFrames() and friends, made on first use
+  mutable LatestFrames latest_;  // written by the frame callback, which getCallback() const hands out
   std::vector<FrameId> synced_streams_;
+  std::vector<std::pair<SensorInterface *, float>> packet_framesets_restore_;  // PACKET_FRAMESETS before start
+  uint32_t perception_wait_ms_;
+  FramesetTrigger trigger_;
+  FrameId trigger_leader_;
+  uint32_t trigger_period_ms_;
   FrameCallbackPtr streams_callback_;
   bool is_stopping_;
 };
@@ -0,0 +1,270 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "subscription.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "core/frame_data.h"
+#include "proc/synthetic_stream.h"
+#include "streaming/stream_profile.h"
+#include "concurrency/thread_placement.h"
+#include "easylogging++.h"
+
+#include "core/frame.hpp"
+#include "core/frame_set.hpp"
+
+namespace libsmartereye2 {
+
+static OverflowPolicy toOverflowPolicy(BackpressurePolicy policy) {
+  switch (policy) {
+    case BackpressurePolicy::LATEST_ONLY: return OverflowPolicy::LATEST_ONLY;
+    case BackpressurePolicy::DROP_NEWEST: return OverflowPolicy::DROP_NEWEST;
+    case BackpressurePolicy::BLOCK_PRODUCER: return OverflowPolicy::BLOCK;
+    default: return OverflowPolicy::DROP_OLDEST;
+  }
+}
+
+static uint32_t streamsOf(FrameInterface *frameset) {
+  auto composite = dynamic_cast<CompositeFrameData *>(frameset);
+  if (composite && composite->streams()) return composite->streams();
+
+  uint32_t streams = 0;
+  auto count = composite ? composite->getFrameCount() : 1;
+  for (size_t i = 0; i < count; ++i) {
+    auto profile = composite ? composite->getFrame(i)->getStreamProfile() : frameset->getStreamProfile();
+    if (profile) streams |= static_cast<uint32_t>(profile->frameId());
+  }
+  return streams;
+}
+
+SubscriptionPrivate::SubscriptionPrivate(const SubscriptionConfig &config, FrameCallbackPtr callback)
+    : streams_(config.streams),
+      mode_(config.mode),
+      queue_(config.mode == DeliveryMode::LATEST_ONLY ? 1 : std::min(std::max<uint32_t>(config.queue_size, 1), kQueueMaxSize),
+             config.mode == DeliveryMode::LATEST_ONLY ? OverflowPolicy::LATEST_ONLY : toOverflowPolicy(config.policy)),
+      callback_(std::move(callback)),
+      cancelled_(false),
+      delivered_(0) {
+  if (mode_ == DeliveryMode::CALLBACK) {
+    if (!callback_) {
+      throw std::runtime_error("A callback subscription needs a callback");
+    }
+    worker_ = std::thread([this]() { deliverLoop(); });
+  }
+}
+
+SubscriptionPrivate::~SubscriptionPrivate() {
+  cancel();
+  if (worker_.joinable()) {
+    if (worker_.get_id() == std::this_thread::get_id()) {
+      worker_.detach();
+    } else {
+      worker_.join();
+    }
+  }
+}
+
+void SubscriptionPrivate::cancel() {
+  cancelled_.store(true, std::memory_order_relaxed);
+  queue_.clear();
+}
+
+void SubscriptionPrivate::offer(const FrameHolder &frameset, uint32_t streams, SyntheticSourceInterface &source) {
+  if (cancelled()) return;
+
+  FrameHolder item;
+  if (!streams_ || !(streams & ~streams_)) {
+    item = frameset.clone();
+  } else if (streams & streams_) {
+    item = narrow(frameset, source);
+    if (!item) return;
+  } else {
+    return;
+  }
+  queue_.enqueue(std::move(item));
+}
+
+FrameHolder SubscriptionPrivate::narrow(const FrameHolder &frameset, SyntheticSourceInterface &source) const {
+  // a set holding more than one stream is always composite
+  auto composite = static_cast<CompositeFrameData *>(frameset.frame);
+  FrameHolder members[kFrameIdSlots];
+  size_t count = 0;
+  for (size_t i = 0; i < composite->getFrameCount() && count < kFrameIdSlots; ++i) {
+    auto member = composite->getFrame(i);
+    auto profile = member->getStreamProfile();
+    if (!profile || !(static_cast<uint32_t>(profile->frameId()) & streams_)) continue;
+    member->acquire();
+    members[count++] = FrameHolder(member);
+  }
+
+  FrameHolder narrowed(source.allocateCompositeFrame(members, count));
+  if (!narrowed) {
+    LOG(WARNING) << "Dropped frameset for a subscription, no composite frame available";
+    return narrowed;
+  }
+  narrowed->setTimestamp(composite->getFrameTimestamp());
+  narrowed->setTimestampDomain(composite->getFrameTimestampDomain());
+  narrowed->inheritHandles(composite);
+  static_cast<FrameData *>(narrowed.frame)->extension().missing_streams =
+      composite->extension().missing_streams & streams_;
+  return narrowed;
+}
+
+bool SubscriptionPrivate::dequeue(FrameHolder *item, uint32_t timeout_ms) {
+  if (cancelled() || !queue_.dequeue(item, timeout_ms)) return false;
+  delivered_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool SubscriptionPrivate::tryDequeue(FrameHolder *item) {
+  if (cancelled() || !queue_.tryDequeue(item)) return false;
+  delivered_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+SubscriptionStatistics SubscriptionPrivate::statistics() const {
+  return SubscriptionStatistics{delivered_.load(std::memory_order_relaxed), queue_.dropped(),
+                                static_cast<uint32_t>(queue_.size())};
+}
+
+void SubscriptionPrivate::deliverLoop() {
+  ThreadPlacement::Scope placement(ThreadRole::CALLBACK, "se2-subscriber");
+  FrameHolder frameset;
+  while (!cancelled()) {
+    // cancel() flushes the queue, which ends the wait
+    if (!dequeue(&frameset, std::numeric_limits<uint32_t>::max())) continue;
+
+    FrameInterface *ref = nullptr;
+    std::swap(frameset.frame, ref);
+    try {
+      callback_->onFrame(ref);
+    }
+    catch (const std::exception &e) {
+      LOG(ERROR) << "Exception was thrown during subscription callback: " << e.what();
+    }
+    catch (...) {
+      LOG(ERROR) << "Exception was thrown during subscription callback!";
+    }
+  }
+}
+
+void FrameFanout::add(std::shared_ptr<SubscriptionPrivate> subscription) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<Subscriptions> next(new Subscriptions);
+  if (subscriptions_) {
+    for (const auto &current : *subscriptions_) {
+      if (!current->cancelled()) next->push_back(current);
+    }
+  }
+  next->push_back(std::move(subscription));
+  subscriptions_ = std::move(next);
+}
+
+void FrameFanout::prune() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!subscriptions_) return;
+  std::shared_ptr<Subscriptions> next(new Subscriptions);
+  for (const auto &current : *subscriptions_) {
+    if (!current->cancelled()) next->push_back(current);
+  }
+  subscriptions_ = std::move(next);
+}
+
+bool FrameFanout::empty() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !subscriptions_ || subscriptions_->empty();
+}
+
+void FrameFanout::publish(FrameHolder frameset, SyntheticSourceInterface &source) {
+  std::shared_ptr<const Subscriptions> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriptions = subscriptions_;
+  }
+  if (!subscriptions || subscriptions->empty()) return;
+
+  auto streams = streamsOf(frameset.frame);
+  bool stale = false;
+  for (const auto &subscription : *subscriptions) {
+    if (subscription->cancelled()) {
+      stale = true;
+      continue;
+    }
+    subscription->offer(frameset, streams, source);
+  }
+  if (stale) prune();
+}
+
+}  // namespace libsmartereye2
+
+namespace se2 {
+
+using namespace libsmartereye2;
+
+static SubscriptionPrivate &subscriptionOf(const std::shared_ptr<SeSubscription> &subscription) {
+  if (!subscription || !subscription->subscription) {
+    throw std::runtime_error("Subscription is empty, it was not made by Pipeline::subscribe()");
+  }
+  return *subscription->subscription;
+}
+
+FrameSet Subscription::waitForFrames(uint32_t timeout_ms) const {
+  FrameHolder fh;
+  subscriptionOf(subscription_).dequeue(&fh, timeout_ms);
+  FrameInterface *result = nullptr;
+  std::swap(result, fh.frame);
+  return FrameSet(Frame(result));
+}
+
+bool Subscription::pollForFrames(FrameSet *frame_set) const {
+  if (!frame_set) {
+    throw std::invalid_argument("null frameset");
+  }
+
+  FrameHolder fh;
+  if (subscriptionOf(subscription_).tryDequeue(&fh)) {
+    FrameInterface *result = nullptr;
+    std::swap(result, fh.frame);
+    *frame_set = FrameSet(Frame(result));
+    return true;
+  }
+  return false;
+}
+
+bool Subscription::tryWaitForFrames(FrameSet *frame_set, uint32_t timeout_ms) const {
+  if (!frame_set) {
+    throw std::invalid_argument("null frameset");
+  }
+
+  FrameHolder fh;
+  if (subscriptionOf(subscription_).dequeue(&fh, timeout_ms)) {
+    FrameInterface *result = nullptr;
+    std::swap(result, fh.frame);
+    *frame_set = FrameSet(Frame(result));
+    return true;
+  }
+  return false;
+}
+
+SubscriptionStatistics Subscription::statistics() const {
+  return subscriptionOf(subscription_).statistics();
+}
+
+void Subscription::unsubscribe() {
+  if (subscription_) subscription_->subscription->cancel();
+}
+
+}  // namespace se2
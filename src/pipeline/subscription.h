@@ -0,0 +1,88 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_SUBSCRIPTION_H
+#define LIBSMARTEREYE2_SUBSCRIPTION_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/frame.h"
+#include "concurrency/consumer_queue.h"
+#include "pipeline/subscription.hpp"
+
+namespace libsmartereye2 {
+
+class SyntheticSourceInterface;
+
+// The queue of one pipeline consumer. Framesets that fit its stream filter are shared by reference,
+// others are narrowed into a set of their own that references the wanted members.
+class SubscriptionPrivate {
+ public:
+  SubscriptionPrivate(const SubscriptionConfig &config, FrameCallbackPtr callback);
+  ~SubscriptionPrivate();
+
+  // on the aggregating thread; streams are the FrameId bits of the set
+  void offer(const FrameHolder &frameset, uint32_t streams, SyntheticSourceInterface &source);
+
+  bool dequeue(FrameHolder *item, uint32_t timeout_ms);
+  bool tryDequeue(FrameHolder *item);
+
+  void cancel();
+  bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+  SubscriptionStatistics statistics() const;
+
+ private:
+  FrameHolder narrow(const FrameHolder &frameset, SyntheticSourceInterface &source) const;
+  void deliverLoop();
+
+  uint32_t streams_;
+  DeliveryMode mode_;
+  ConsumerQueue<FrameHolder, ProducerMode::SINGLE> queue_;
+  FrameCallbackPtr callback_;
+  std::thread worker_;
+  std::atomic<bool> cancelled_;
+  std::atomic<uint64_t> delivered_;
+};
+
+// Hands every frameset of a pipeline to its subscriptions. Outlives the aggregator, so that
+// subscriptions stay attached across restarts.
+class FrameFanout {
+ public:
+  void add(std::shared_ptr<SubscriptionPrivate> subscription);
+  void publish(FrameHolder frameset, SyntheticSourceInterface &source);
+  bool empty() const;
+
+ private:
+  using Subscriptions = std::vector<std::shared_ptr<SubscriptionPrivate>>;
+
+  void prune();
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Subscriptions> subscriptions_;  // replaced, never changed, publish runs on a snapshot
+};
+
+}  // namespace libsmartereye2
+
+struct SeSubscription {
+  std::shared_ptr<libsmartereye2::SubscriptionPrivate> subscription;
+
+  ~SeSubscription() {
+    if (subscription) subscription->cancel();
+  }
+};
+
+#endif //LIBSMARTEREYE2_SUBSCRIPTION_H
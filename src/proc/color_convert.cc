@@ -0,0 +1,544 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "color_convert.h"
+
+#include <cstring>
+#include <utility>
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#elif defined(SE2_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+enum Layout { kRgb, kBgr, kRgba, kGray };
+const int kChannels[] = {3, 3, 4, 1};
+
+// BT.601 limited range in 6-bit fixed point. Every step saturates to 16 bits the way the SIMD lanes
+// do, so all levels agree to the bit.
+const int kYScale = 74;
+const int kVToR = 102;
+const int kVToG = 52;
+const int kUToG = 25;
+const int kUToB = 129;
+const int kShift = 6;
+const int kRound = 1 << (kShift - 1);
+// luma of RGB in 8-bit fixed point, for RGB565 to Gray
+const int kRToY = 77;
+const int kGToY = 150;
+const int kBToY = 29;
+
+inline int sat16(int value) {
+  return value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+}
+
+inline uint8_t clamp8(int value) {
+  return static_cast<uint8_t>(value > 255 ? 255 : (value < 0 ? 0 : value));
+}
+
+template<Layout L>
+inline void putRgb(uint8_t *dst, int r, int g, int b) {
+  if (L == kGray) {
+    dst[0] = static_cast<uint8_t>((r * kRToY + g * kGToY + b * kBToY + 128) >> 8);
+    return;
+  }
+  dst[0] = static_cast<uint8_t>(L == kBgr ? b : r);
+  dst[1] = static_cast<uint8_t>(g);
+  dst[2] = static_cast<uint8_t>(L == kBgr ? r : b);
+  if (L == kRgba) dst[3] = 0xFF;
+}
+
+template<Layout L>
+inline void putYuv(uint8_t *dst, int y, int u, int v) {
+  if (L == kGray) {
+    dst[0] = static_cast<uint8_t>(y);
+    return;
+  }
+  int yy = (y - 16) * kYScale;
+  int ud = u - 128;
+  int vd = v - 128;
+  int r = sat16(sat16(yy + vd * kVToR) + kRound) >> kShift;
+  int g = sat16(sat16(sat16(yy - vd * kVToG) - ud * kUToG) + kRound) >> kShift;
+  int b = sat16(sat16(yy + ud * kUToB) + kRound) >> kShift;
+  putRgb<L>(dst, clamp8(r), clamp8(g), clamp8(b));
+}
+
+template<Layout L>
+void yuyvRow(const uint8_t *src, uint8_t *dst, int x, int width) {
+  for (; x < width; ++x) {
+    const uint8_t *pair = src + (x & ~1) * 2;
+    putYuv<L>(dst + x * kChannels[L], src[x * 2], pair[1], (x | 1) < width ? pair[3] : 128);
+  }
+}
+
+template<Layout L>
+void planarRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int x, int width) {
+  for (; x < width; ++x) {
+    putYuv<L>(dst + x * kChannels[L], y[x], u[x >> 1], v[x >> 1]);
+  }
+}
+
+template<Layout L>
+void rgb565Row(const uint8_t *src, uint8_t *dst, int x, int width) {
+  for (; x < width; ++x) {
+    int pixel = src[x * 2] | (src[x * 2 + 1] << 8);
+    int r = pixel >> 11;
+    int g = (pixel >> 5) & 0x3F;
+    int b = pixel & 0x1F;
+    putRgb<L>(dst + x * kChannels[L], (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+  }
+}
+
+#if defined(SE2_SIMD_X86)
+
+// 8 pixels, 16-bit lanes
+SE2_TARGET_SSE2 inline void yuvToRgbSse2(__m128i y, __m128i u, __m128i v, __m128i *r, __m128i *g, __m128i *b) {
+  auto yy = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(kYScale));
+  auto ud = _mm_sub_epi16(u, _mm_set1_epi16(128));
+  auto vd = _mm_sub_epi16(v, _mm_set1_epi16(128));
+  auto round = _mm_set1_epi16(kRound);
+  *r = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(vd, _mm_set1_epi16(kVToR))), round), kShift);
+  *g = _mm_srai_epi16(_mm_adds_epi16(_mm_subs_epi16(_mm_subs_epi16(yy, _mm_mullo_epi16(vd, _mm_set1_epi16(kVToG))),
+                                                    _mm_mullo_epi16(ud, _mm_set1_epi16(kUToG))), round), kShift);
+  *b = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(yy, _mm_mullo_epi16(ud, _mm_set1_epi16(kUToB))), round), kShift);
+}
+
+// 8 YUYV pixels whose lumas are already split off
+SE2_TARGET_SSE2 inline void yuyvToRgbSse2(__m128i yuyv, __m128i y, __m128i *r, __m128i *g, __m128i *b) {
+  auto low_words = _mm_set1_epi32(0x0000FFFF);
+  auto uv = _mm_srli_epi16(yuyv, 8);
+  auto u = _mm_and_si128(uv, low_words);
+  auto v = _mm_srli_epi32(uv, 16);
+  yuvToRgbSse2(y, _mm_or_si128(u, _mm_slli_epi32(u, 16)), _mm_or_si128(v, _mm_slli_epi32(v, 16)), r, g, b);
+}
+
+SE2_TARGET_SSE2 inline void expandRgb565Sse2(__m128i pixels, __m128i *r, __m128i *g, __m128i *b) {
+  auto r5 = _mm_srli_epi16(pixels, 11);
+  auto g6 = _mm_and_si128(_mm_srli_epi16(pixels, 5), _mm_set1_epi16(0x3F));
+  auto b5 = _mm_and_si128(pixels, _mm_set1_epi16(0x1F));
+  *r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+  *g = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+  *b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+}
+
+SE2_TARGET_SSE2 inline __m128i lumaSse2(__m128i r, __m128i g, __m128i b) {
+  auto sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kRToY)), _mm_mullo_epi16(g, _mm_set1_epi16(kGToY)));
+  sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(kBToY)));
+  return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+}
+
+// 16 pixels as RGBA, four registers
+SE2_TARGET_SSE2 inline void interleaveSse2(__m128i r, __m128i g, __m128i b, __m128i *rgba) {
+  auto alpha = _mm_set1_epi8(-1);
+  auto rg_lo = _mm_unpacklo_epi8(r, g);
+  auto rg_hi = _mm_unpackhi_epi8(r, g);
+  auto ba_lo = _mm_unpacklo_epi8(b, alpha);
+  auto ba_hi = _mm_unpackhi_epi8(b, alpha);
+  rgba[0] = _mm_unpacklo_epi16(rg_lo, ba_lo);
+  rgba[1] = _mm_unpackhi_epi16(rg_lo, ba_lo);
+  rgba[2] = _mm_unpacklo_epi16(rg_hi, ba_hi);
+  rgba[3] = _mm_unpackhi_epi16(rg_hi, ba_hi);
+}
+
+template<Layout L>
+SE2_TARGET_SSE2 inline void storeSse2(uint8_t *dst, __m128i r, __m128i g, __m128i b) {
+  if (L == kBgr) std::swap(r, b);
+  __m128i rgba[4];
+  interleaveSse2(r, g, b, rgba);
+  if (L == kRgba) {
+    for (int i = 0; i < 4; ++i) _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 16), rgba[i]);
+    return;
+  }
+  // no byte shuffle before SSSE3, the fourth bytes are dropped on the way out
+  alignas(16) uint8_t packed[64];
+  for (int i = 0; i < 4; ++i) _mm_store_si128(reinterpret_cast<__m128i *>(packed + i * 16), rgba[i]);
+  for (int i = 0; i < 16; ++i) memcpy(dst + i * 3, packed + i * 4, 3);
+}
+
+template<Layout L>
+SE2_TARGET_SSE2 int yuyvRowSse2(const uint8_t *src, uint8_t *dst, int width) {
+  auto low_bytes = _mm_set1_epi16(0x00FF);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+    auto p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2 + 16));
+    auto y0 = _mm_and_si128(p0, low_bytes);
+    auto y1 = _mm_and_si128(p1, low_bytes);
+    if (L == kGray) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(y0, y1));
+      continue;
+    }
+    __m128i r0, g0, b0, r1, g1, b1;
+    yuyvToRgbSse2(p0, y0, &r0, &g0, &b0);
+    yuyvToRgbSse2(p1, y1, &r1, &g1, &b1);
+    storeSse2<L>(dst + x * kChannels[L], _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                 _mm_packus_epi16(b0, b1));
+  }
+  return x;
+}
+
+template<Layout L>
+SE2_TARGET_SSE2 int planarRowSse2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width) {
+  auto zero = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto luma = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+    if (L == kGray) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), luma);
+      continue;
+    }
+    auto u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+    auto v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+    u8 = _mm_unpacklo_epi8(u8, u8);
+    v8 = _mm_unpacklo_epi8(v8, v8);
+    __m128i r0, g0, b0, r1, g1, b1;
+    yuvToRgbSse2(_mm_unpacklo_epi8(luma, zero), _mm_unpacklo_epi8(u8, zero), _mm_unpacklo_epi8(v8, zero),
+                 &r0, &g0, &b0);
+    yuvToRgbSse2(_mm_unpackhi_epi8(luma, zero), _mm_unpackhi_epi8(u8, zero), _mm_unpackhi_epi8(v8, zero),
+                 &r1, &g1, &b1);
+    storeSse2<L>(dst + x * kChannels[L], _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                 _mm_packus_epi16(b0, b1));
+  }
+  return x;
+}
+
+template<Layout L>
+SE2_TARGET_SSE2 int rgb565RowSse2(const uint8_t *src, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i r0, g0, b0, r1, g1, b1;
+    expandRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2)), &r0, &g0, &b0);
+    expandRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2 + 16)), &r1, &g1, &b1);
+    if (L == kGray) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                       _mm_packus_epi16(lumaSse2(r0, g0, b0), lumaSse2(r1, g1, b1)));
+      continue;
+    }
+    storeSse2<L>(dst + x * kChannels[L], _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                 _mm_packus_epi16(b0, b1));
+  }
+  return x;
+}
+
+// 16 pixels, 16-bit lanes
+SE2_TARGET_AVX2 inline void yuvToRgbAvx2(__m256i y, __m256i u, __m256i v, __m256i *r, __m256i *g, __m256i *b) {
+  auto yy = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(kYScale));
+  auto ud = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+  auto vd = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+  auto round = _mm256_set1_epi16(kRound);
+  *r = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(yy, _mm256_mullo_epi16(vd, _mm256_set1_epi16(kVToR))),
+                                           round), kShift);
+  *g = _mm256_srai_epi16(_mm256_adds_epi16(
+      _mm256_subs_epi16(_mm256_subs_epi16(yy, _mm256_mullo_epi16(vd, _mm256_set1_epi16(kVToG))),
+                        _mm256_mullo_epi16(ud, _mm256_set1_epi16(kUToG))), round), kShift);
+  *b = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(yy, _mm256_mullo_epi16(ud, _mm256_set1_epi16(kUToB))),
+                                           round), kShift);
+}
+
+SE2_TARGET_AVX2 inline __m128i packAvx2(__m256i words) {
+  return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+template<Layout L>
+SE2_TARGET_AVX2 inline void storeAvx2(uint8_t *dst, __m256i r, __m256i g, __m256i b) {
+  auto r8 = packAvx2(r);
+  auto g8 = packAvx2(g);
+  auto b8 = packAvx2(b);
+  if (L == kBgr) std::swap(r8, b8);
+  __m128i rgba[4];
+  interleaveSse2(r8, g8, b8, rgba);
+  if (L == kRgba) {
+    for (int i = 0; i < 4; ++i) _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 16), rgba[i]);
+    return;
+  }
+  // 12 bytes out of every 16; the overlapping stores are rewritten by the next one, the last is split
+  auto drop_alpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  for (int i = 0; i < 3; ++i) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 12), _mm_shuffle_epi8(rgba[i], drop_alpha));
+  }
+  auto last = _mm_shuffle_epi8(rgba[3], drop_alpha);
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + 36), last);
+  auto tail = _mm_cvtsi128_si32(_mm_srli_si128(last, 8));
+  memcpy(dst + 44, &tail, 4);
+}
+
+template<Layout L>
+SE2_TARGET_AVX2 int yuyvRowAvx2(const uint8_t *src, uint8_t *dst, int width) {
+  auto low_bytes = _mm256_set1_epi16(0x00FF);
+  auto low_words = _mm256_set1_epi32(0x0000FFFF);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 2));
+    auto y = _mm256_and_si256(pixels, low_bytes);
+    if (L == kGray) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packAvx2(y));
+      continue;
+    }
+    auto uv = _mm256_srli_epi16(pixels, 8);
+    auto u = _mm256_and_si256(uv, low_words);
+    auto v = _mm256_srli_epi32(uv, 16);
+    __m256i r, g, b;
+    yuvToRgbAvx2(y, _mm256_or_si256(u, _mm256_slli_epi32(u, 16)), _mm256_or_si256(v, _mm256_slli_epi32(v, 16)),
+                 &r, &g, &b);
+    storeAvx2<L>(dst + x * kChannels[L], r, g, b);
+  }
+  return x;
+}
+
+template<Layout L>
+SE2_TARGET_AVX2 int planarRowAvx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto luma = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+    if (L == kGray) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), luma);
+      continue;
+    }
+    auto u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+    auto v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+    __m256i r, g, b;
+    yuvToRgbAvx2(_mm256_cvtepu8_epi16(luma), _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)),
+                 _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), &r, &g, &b);
+    storeAvx2<L>(dst + x * kChannels[L], r, g, b);
+  }
+  return x;
+}
+
+template<Layout L>
+SE2_TARGET_AVX2 int rgb565RowAvx2(const uint8_t *src, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 2));
+    auto r5 = _mm256_srli_epi16(pixels, 11);
+    auto g6 = _mm256_and_si256(_mm256_srli_epi16(pixels, 5), _mm256_set1_epi16(0x3F));
+    auto b5 = _mm256_and_si256(pixels, _mm256_set1_epi16(0x1F));
+    auto r = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+    auto g = _mm256_or_si256(_mm256_slli_epi16(g6, 2), _mm256_srli_epi16(g6, 4));
+    auto b = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
+    if (L == kGray) {
+      auto sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(kRToY)),
+                                  _mm256_mullo_epi16(g, _mm256_set1_epi16(kGToY)));
+      sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(kBToY)));
+      auto luma = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(128)), 8);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packAvx2(luma));
+      continue;
+    }
+    storeAvx2<L>(dst + x * kChannels[L], r, g, b);
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_X86
+
+#if defined(SE2_SIMD_NEON)
+
+// 8 pixels
+inline void yuvToRgbNeon(int16x8_t y, int16x8_t u, int16x8_t v, uint8x8_t *r, uint8x8_t *g, uint8x8_t *b) {
+  auto yy = vmulq_n_s16(vsubq_s16(y, vdupq_n_s16(16)), kYScale);
+  auto ud = vsubq_s16(u, vdupq_n_s16(128));
+  auto vd = vsubq_s16(v, vdupq_n_s16(128));
+  auto round = vdupq_n_s16(kRound);
+  *r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(vqaddq_s16(yy, vmulq_n_s16(vd, kVToR)), round), kShift));
+  *g = vqmovun_s16(vshrq_n_s16(vqaddq_s16(vqsubq_s16(vqsubq_s16(yy, vmulq_n_s16(vd, kVToG)),
+                                                     vmulq_n_s16(ud, kUToG)), round), kShift));
+  *b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(vqaddq_s16(yy, vmulq_n_s16(ud, kUToB)), round), kShift));
+}
+
+inline int16x8_t widenNeon(uint8x8_t bytes) {
+  return vreinterpretq_s16_u16(vmovl_u8(bytes));
+}
+
+inline uint8x16_t zipNeon(uint8x8_t even, uint8x8_t odd) {
+  auto zipped = vzip_u8(even, odd);
+  return vcombine_u8(zipped.val[0], zipped.val[1]);
+}
+
+template<Layout L>
+inline void storeNeon(uint8_t *dst, uint8x16_t r, uint8x16_t g, uint8x16_t b) {
+  if (L == kRgba) {
+    uint8x16x4_t rgba = {{r, g, b, vdupq_n_u8(0xFF)}};
+    vst4q_u8(dst, rgba);
+  } else {
+    uint8x16x3_t rgb = {{L == kBgr ? b : r, g, L == kBgr ? r : b}};
+    vst3q_u8(dst, rgb);
+  }
+}
+
+// the even and odd pixels of 16 share their chroma
+template<Layout L>
+inline void storeYuvPairsNeon(uint8_t *dst, uint8x8_t even, uint8x8_t odd, uint8x8_t u8, uint8x8_t v8) {
+  auto u = widenNeon(u8);
+  auto v = widenNeon(v8);
+  uint8x8_t r0, g0, b0, r1, g1, b1;
+  yuvToRgbNeon(widenNeon(even), u, v, &r0, &g0, &b0);
+  yuvToRgbNeon(widenNeon(odd), u, v, &r1, &g1, &b1);
+  storeNeon<L>(dst, zipNeon(r0, r1), zipNeon(g0, g1), zipNeon(b0, b1));
+}
+
+template<Layout L>
+int yuyvRowNeon(const uint8_t *src, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto pixels = vld4_u8(src + x * 2);  // Y0, U, Y1, V of 8 pairs
+    if (L == kGray) {
+      vst1q_u8(dst + x, zipNeon(pixels.val[0], pixels.val[2]));
+      continue;
+    }
+    storeYuvPairsNeon<L>(dst + x * kChannels[L], pixels.val[0], pixels.val[2], pixels.val[1], pixels.val[3]);
+  }
+  return x;
+}
+
+template<Layout L>
+int planarRowNeon(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    if (L == kGray) {
+      vst1q_u8(dst + x, vld1q_u8(y + x));
+      continue;
+    }
+    auto luma = vld2_u8(y + x);
+    storeYuvPairsNeon<L>(dst + x * kChannels[L], luma.val[0], luma.val[1], vld1_u8(u + x / 2), vld1_u8(v + x / 2));
+  }
+  return x;
+}
+
+template<Layout L>
+int rgb565RowNeon(const uint8_t *src, uint8_t *dst, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x8_t r[2], g[2], b[2];
+    for (int half = 0; half < 2; ++half) {
+      auto pixels = vld1q_u16(reinterpret_cast<const uint16_t *>(src + x * 2 + half * 16));
+      auto r5 = vshrq_n_u16(pixels, 11);
+      auto g6 = vandq_u16(vshrq_n_u16(pixels, 5), vdupq_n_u16(0x3F));
+      auto b5 = vandq_u16(pixels, vdupq_n_u16(0x1F));
+      r[half] = vmovn_u16(vorrq_u16(vshlq_n_u16(r5, 3), vshrq_n_u16(r5, 2)));
+      g[half] = vmovn_u16(vorrq_u16(vshlq_n_u16(g6, 2), vshrq_n_u16(g6, 4)));
+      b[half] = vmovn_u16(vorrq_u16(vshlq_n_u16(b5, 3), vshrq_n_u16(b5, 2)));
+    }
+    if (L == kGray) {
+      uint8x8_t luma[2];
+      for (int half = 0; half < 2; ++half) {
+        auto sum = vmull_u8(r[half], vdup_n_u8(kRToY));
+        sum = vmlal_u8(sum, g[half], vdup_n_u8(kGToY));
+        sum = vmlal_u8(sum, b[half], vdup_n_u8(kBToY));
+        luma[half] = vshrn_n_u16(vaddq_u16(sum, vdupq_n_u16(128)), 8);
+      }
+      vst1q_u8(dst + x, vcombine_u8(luma[0], luma[1]));
+      continue;
+    }
+    storeNeon<L>(dst + x * kChannels[L], vcombine_u8(r[0], r[1]), vcombine_u8(g[0], g[1]), vcombine_u8(b[0], b[1]));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_NEON
+
+template<Layout L>
+void convertRows(const ColorConversion &c, int begin, int end, SimdLevel level) {
+  const uint8_t *u_plane = c.src + static_cast<size_t>(c.src_stride) * c.height;
+  const uint8_t *v_plane = u_plane + static_cast<size_t>(c.src_stride / 2) * c.height;
+
+  for (int row = begin; row < end; ++row) {
+    const uint8_t *src = c.src + static_cast<size_t>(c.src_stride) * row;
+    uint8_t *dst = c.dst + static_cast<size_t>(c.dst_stride) * row;
+    int x = 0;
+    switch (c.src_format) {
+      case FrameFormat::YUV422:
+#if defined(SE2_SIMD_X86)
+        if (level == SimdLevel::AVX2) x = yuyvRowAvx2<L>(src, dst, c.width);
+        else if (level == SimdLevel::SSE2) x = yuyvRowSse2<L>(src, dst, c.width);
+#elif defined(SE2_SIMD_NEON)
+        if (level == SimdLevel::NEON) x = yuyvRowNeon<L>(src, dst, c.width);
+#endif
+        yuyvRow<L>(src, dst, x, c.width);
+        break;
+      case FrameFormat::YUV422Planar: {
+        const uint8_t *u = u_plane + static_cast<size_t>(c.src_stride / 2) * row;
+        const uint8_t *v = v_plane + static_cast<size_t>(c.src_stride / 2) * row;
+#if defined(SE2_SIMD_X86)
+        if (level == SimdLevel::AVX2) x = planarRowAvx2<L>(src, u, v, dst, c.width);
+        else if (level == SimdLevel::SSE2) x = planarRowSse2<L>(src, u, v, dst, c.width);
+#elif defined(SE2_SIMD_NEON)
+        if (level == SimdLevel::NEON) x = planarRowNeon<L>(src, u, v, dst, c.width);
+#endif
+        planarRow<L>(src, u, v, dst, x, c.width);
+        break;
+      }
+      case FrameFormat::RGB565:
+#if defined(SE2_SIMD_X86)
+        if (level == SimdLevel::AVX2) x = rgb565RowAvx2<L>(src, dst, c.width);
+        else if (level == SimdLevel::SSE2) x = rgb565RowSse2<L>(src, dst, c.width);
+#elif defined(SE2_SIMD_NEON)
+        if (level == SimdLevel::NEON) x = rgb565RowNeon<L>(src, dst, c.width);
+#endif
+        rgb565Row<L>(src, dst, x, c.width);
+        break;
+      default:
+        return;
+    }
+  }
+}
+
+}  // namespace
+
+bool canConvertColor(FrameFormat from, FrameFormat to) {
+  bool source = from == FrameFormat::YUV422 || from == FrameFormat::YUV422Planar || from == FrameFormat::RGB565;
+  bool target = to == FrameFormat::RGB || to == FrameFormat::Color || to == FrameFormat::RGBA
+      || to == FrameFormat::Gray;
+  return source && target;
+}
+
+int colorPixelSize(FrameFormat format) {
+  switch (format) {
+    case FrameFormat::Gray: return 1;
+    case FrameFormat::YUV422:
+    case FrameFormat::YUV422Planar:
+    case FrameFormat::RGB565: return 2;
+    case FrameFormat::RGB:
+    case FrameFormat::Color: return 3;
+    case FrameFormat::RGBA: return 4;
+    default: return 0;
+  }
+}
+
+int colorRowSize(FrameFormat format, int width) {
+  return format == FrameFormat::YUV422Planar ? width : width * colorPixelSize(format);
+}
+
+size_t colorSourceSize(const ColorConversion &conversion) {
+  auto plane = static_cast<size_t>(conversion.src_stride) * conversion.height;
+  if (conversion.src_format == FrameFormat::YUV422Planar) {
+    return plane + 2 * static_cast<size_t>(conversion.src_stride / 2) * conversion.height;
+  }
+  return plane;
+}
+
+void convertColorRows(const ColorConversion &conversion, int begin, int end, SimdLevel level) {
+  if (!canConvertColor(conversion.src_format, conversion.dst_format)) return;
+  switch (conversion.dst_format) {
+    case FrameFormat::RGB: convertRows<kRgb>(conversion, begin, end, level); break;
+    case FrameFormat::Color: convertRows<kBgr>(conversion, begin, end, level); break;
+    case FrameFormat::RGBA: convertRows<kRgba>(conversion, begin, end, level); break;
+    default: convertRows<kGray>(conversion, begin, end, level); break;
+  }
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,59 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_COLOR_CONVERT_H
+#define LIBSMARTEREYE2_COLOR_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.h"
+#include "streaming/stream_types.hpp"
+
+namespace libsmartereye2 {
+
+using se2::FrameFormat;
+
+// One colour conversion, strides in bytes. For YUV422Planar src_stride is that of the Y plane; the U
+// and V planes, half as wide, follow it in that order.
+struct ColorConversion {
+  const uint8_t *src;
+  int src_stride;
+  FrameFormat src_format;
+  uint8_t *dst;
+  int dst_stride;
+  FrameFormat dst_format;
+  int width;
+  int height;
+};
+
+// YUV422 (YUYV), YUV422Planar and RGB565 into RGB, Color (BGR), RGBA or Gray
+bool canConvertColor(FrameFormat from, FrameFormat to);
+
+// bytes per pixel of the formats above, 0 for any other
+int colorPixelSize(FrameFormat format);
+
+// bytes of one unpadded source row; for YUV422Planar that of the Y plane
+int colorRowSize(FrameFormat format, int width);
+
+// bytes the conversion reads from src, including the U and V planes of YUV422Planar
+size_t colorSourceSize(const ColorConversion &conversion);
+
+// Converts rows [begin, end). Every level produces exactly the same pixels; YUV is BT.601 limited
+// range like OpenCV's COLOR_YUV2BGR_YUYV.
+void convertColorRows(const ColorConversion &conversion, int begin, int end, SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_COLOR_CONVERT_H
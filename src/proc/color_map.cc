@@ -0,0 +1,144 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "color_map.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "proc/filter.hpp"
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+const int kSubHistograms = 4;
+
+inline uint8_t toByte(float value) {
+  value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+  return static_cast<uint8_t>(std::lround(value * 255.f));
+}
+
+inline float polynomial(float t, const float (&c)[6]) {
+  return c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+}
+
+std::vector<uint8_t> makePalette(se2::ColorScheme scheme) {
+  // polynomial fit of Google's Turbo
+  static const float kTurboRed[6] = {0.13572138f, 4.61539260f, -42.66032258f, 132.13108234f, -152.94239396f,
+                                     59.28637943f};
+  static const float kTurboGreen[6] = {0.09140261f, 2.19418839f, 4.84296658f, -14.18503333f, 4.27729857f,
+                                       2.82956604f};
+  static const float kTurboBlue[6] = {0.10667330f, 12.64194608f, -60.58204836f, 110.36276771f, -89.90310912f,
+                                      27.34824973f};
+  std::vector<uint8_t> palette(256 * 3);
+  for (int i = 0; i < 256; ++i) {
+    float t = i / 255.f;
+    float rgb[3] = {t, t, t};
+    if (scheme == se2::ColorScheme::JET) {
+      rgb[0] = 1.5f - std::fabs(4.f * t - 3.f);
+      rgb[1] = 1.5f - std::fabs(4.f * t - 2.f);
+      rgb[2] = 1.5f - std::fabs(4.f * t - 1.f);
+    } else if (scheme == se2::ColorScheme::TURBO) {
+      rgb[0] = polynomial(t, kTurboRed);
+      rgb[1] = polynomial(t, kTurboGreen);
+      rgb[2] = polynomial(t, kTurboBlue);
+    }
+    for (int c = 0; c < 3; ++c) palette[i * 3 + c] = toByte(rgb[c]);
+  }
+  return palette;
+}
+
+inline void putPixel(uint8_t *dst, uint32_t color, int pixel_size) {
+  std::memcpy(dst, &color, static_cast<size_t>(pixel_size));
+}
+
+#if defined(SE2_SIMD_X86)
+
+SE2_TARGET_AVX2 int colorizeRowAvx2(const uint16_t *values, int width, const uint32_t *lut, int pixel_size,
+                                    uint8_t *dst) {
+  // drops the fourth byte of every entry in each 128-bit lane, 12 bytes then 4 of padding
+  const __m256i compress = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const int lut_scale = 4;
+  int x = 0;
+  // three byte pixels write 4 bytes past the 8 they convert, which the next pixels overwrite
+  for (; x + 8 <= width && (pixel_size == 4 || x + 10 <= width); x += 8) {
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + x));
+    __m256i bins = _mm256_srli_epi32(_mm256_cvtepu16_epi32(words), kColorBinShift);
+    __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut), bins, lut_scale);
+    if (pixel_size == 4) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), colors);
+      continue;
+    }
+    __m256i packed = _mm256_shuffle_epi8(colors, compress);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 3), _mm256_castsi256_si128(packed));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 3 + 12), _mm256_extracti128_si256(packed, 1));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_X86
+
+}  // namespace
+
+const uint8_t *colorPalette(int scheme) {
+  static const std::vector<uint8_t> palettes[] = {
+      makePalette(se2::ColorScheme::JET),
+      makePalette(se2::ColorScheme::TURBO),
+      makePalette(se2::ColorScheme::GRAYSCALE),
+  };
+  if (scheme < 0 || scheme >= static_cast<int>(sizeof(palettes) / sizeof(palettes[0]))) return nullptr;
+  return palettes[scheme].data();
+}
+
+ColorHistogram::ColorHistogram()
+    : counts_(static_cast<size_t>(kSubHistograms) * kColorBins, 0) {}
+
+void ColorHistogram::add(const uint16_t *values, int width) {
+  uint32_t *counts[kSubHistograms];
+  for (int i = 0; i < kSubHistograms; ++i) counts[i] = counts_.data() + static_cast<size_t>(i) * kColorBins;
+  int x = 0;
+  for (; x + kSubHistograms <= width; x += kSubHistograms) {
+    ++counts[0][values[x] >> kColorBinShift];
+    ++counts[1][values[x + 1] >> kColorBinShift];
+    ++counts[2][values[x + 2] >> kColorBinShift];
+    ++counts[3][values[x + 3] >> kColorBinShift];
+  }
+  for (; x < width; ++x) ++counts[0][values[x] >> kColorBinShift];
+}
+
+void ColorHistogram::mergeInto(uint32_t *bins) const {
+  for (int i = 0; i < kSubHistograms; ++i) {
+    const uint32_t *counts = counts_.data() + static_cast<size_t>(i) * kColorBins;
+    for (int bin = 0; bin < kColorBins; ++bin) bins[bin] += counts[bin];
+  }
+}
+
+void colorizeRow(const uint16_t *values, int width, const uint32_t *lut, int pixel_size, uint8_t *dst,
+                 SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2 && (pixel_size == 3 || pixel_size == 4)) {
+    x = colorizeRowAvx2(values, width, lut, pixel_size, dst);
+  }
+#endif
+  for (; x < width; ++x) putPixel(dst + x * pixel_size, lut[values[x] >> kColorBinShift], pixel_size);
+}
+
+}  // namespace libsmartereye2
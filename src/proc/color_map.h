@@ -0,0 +1,53 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_COLOR_MAP_H
+#define LIBSMARTEREYE2_COLOR_MAP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+
+namespace libsmartereye2 {
+
+// 16-bit values are coloured and counted in bins of 16
+const int kColorBinShift = 4;
+const int kColorBins = 65536 >> kColorBinShift;
+
+// 256 RGB triples running from the far to the near end of a se2::ColorScheme, nullptr for an unknown one
+const uint8_t *colorPalette(int scheme);
+
+// Counts values into kColorBins bins, bin 0 (no data) included. Consecutive values go to four interleaved
+// sub-histograms so that runs of equal values do not wait on each other's increments.
+class ColorHistogram {
+ public:
+  ColorHistogram();
+
+  void add(const uint16_t *values, int width);
+  // adds the counts to bins, which has kColorBins entries
+  void mergeInto(uint32_t *bins) const;
+
+ private:
+  std::vector<uint32_t> counts_;
+};
+
+// dst = lut[value >> kColorBinShift], pixel_size bytes of each 32-bit entry in memory order. Every level
+// produces the same pixels.
+void colorizeRow(const uint16_t *values, int width, const uint32_t *lut, int pixel_size, uint8_t *dst,
+                 SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_COLOR_MAP_H
@@ -0,0 +1,217 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "colorizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "color_map.h"
+#include "disparity_unpack.h"
+#include "core/frame_data.h"
+#include "proc/filter.hpp"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+namespace {
+
+// share of the values cut off at either end of an automatic range
+const double kRangeTail = 0.005;
+
+bool isDisparity(FrameFormat format) {
+  return isPackedDisparity(format) || format == FrameFormat::DisparitySparse || format == FrameFormat::Disparity16;
+}
+
+bool isDepth(FrameFormat format) {
+  return format == FrameFormat::Depth16 || format == FrameFormat::DepthFloat;
+}
+
+int toBin(float value) {
+  value = value < 0.f ? 0.f : (value > 65535.f ? 65535.f : value);
+  return static_cast<int>(value) >> kColorBinShift;
+}
+
+}  // namespace
+
+ColorizerUnit::ColorizerUnit()
+    : StreamConversionUnit("Colorizer"),
+      scheme_(static_cast<int>(se2::ColorScheme::JET)),
+      output_format_(static_cast<int>(FrameFormat::Color)),
+      equalize_(false),
+      min_distance_(0.f),
+      max_distance_(0.f) {
+  registerOption(OptionKey::COLOR_SCHEME, std::make_shared<RangeOption>(
+      OptionRange{static_cast<float>(se2::ColorScheme::JET), static_cast<float>(se2::ColorScheme::GRAYSCALE), 1,
+                  static_cast<float>(se2::ColorScheme::JET)},
+      "Colour scheme: Jet, Turbo or Grayscale",
+      [this](float value) { scheme_ = static_cast<int>(value); }));
+  registerOption(OptionKey::OUTPUT_FORMAT, std::make_shared<RangeOption>(
+      OptionRange{static_cast<float>(FrameFormat::Color), static_cast<float>(FrameFormat::RGBA), 1,
+                  static_cast<float>(FrameFormat::Color)},
+      "Format frames are coloured into: Color (BGR), RGB or RGBA",
+      [this](float value) {
+        auto format = static_cast<FrameFormat>(static_cast<int>(value));
+        if (format != FrameFormat::Color && format != FrameFormat::RGB && format != FrameFormat::RGBA) {
+          throw std::runtime_error(toString() << "Colorizer cannot colour into format " << value);
+        }
+        output_format_ = static_cast<int>(format);
+      }));
+  registerOption(OptionKey::HISTOGRAM_EQUALIZATION, std::make_shared<RangeOption>(
+      OptionRange{0, 1, 1, 0},
+      "1 colours values by their rank in the frame",
+      [this](float value) { equalize_ = value != 0.f; }));
+  registerOption(OptionKey::MIN_DISTANCE, std::make_shared<RangeOption>(
+      OptionRange{0, 1000, 0.1f, 0},
+      "Metres, the near end of the colour range",
+      [this](float value) { min_distance_ = value; }));
+  registerOption(OptionKey::MAX_DISTANCE, std::make_shared<RangeOption>(
+      OptionRange{0, 1000, 0.1f, 0},
+      "Metres, the far end of the colour range, 0 to fit the range to each frame",
+      [this](float value) { max_distance_ = value; }));
+}
+
+FrameInterface *ColorizerUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto video = dynamic_cast<VideoFrameData *>(frame);
+  auto profile = frame->getStreamProfile();
+  auto format = profile->format();
+  bool near_high = isDisparity(format);
+  if (!video || (!near_high && !isDepth(format))) return nullptr;
+
+  auto width = video->width();
+  auto height = video->height();
+  auto src_stride = video->stride() ? video->stride() : getStrideByFormat(format, width);
+  if (width <= 0 || height <= 0 || video->getFrameDataSize() < static_cast<size_t>(src_stride) * height) {
+    LOG(WARNING) << "Colorizer skipped a frame of stream " << static_cast<uint32_t>(profile->frameId()) << ", "
+                 << video->getFrameDataSize() << " bytes do not hold " << width << "x" << height;
+    return nullptr;
+  }
+
+  // 16-bit values: Disparity16 units for disparity, millimetres for depth
+  auto src = reinterpret_cast<const uint8_t *>(video->getFrameData());
+  std::vector<uint16_t> converted;
+  if (isPackedDisparity(format) || format == FrameFormat::DepthFloat) {
+    converted.resize(static_cast<size_t>(width) * height);
+    forRows(width, height, [&](int begin, int end) {
+      for (int row = begin; row < end; ++row) {
+        auto in = src + static_cast<size_t>(src_stride) * row;
+        auto out = converted.data() + static_cast<size_t>(width) * row;
+        if (format != FrameFormat::DepthFloat) {
+          unpackDisparityRow(in, format, width, out);
+          continue;
+        }
+        auto metres = reinterpret_cast<const float *>(in);
+        for (int x = 0; x < width; ++x) {
+          out[x] = metres[x] > 0.f ? static_cast<uint16_t>(std::min(metres[x] * 1000.f, 65535.f) + 0.5f) : 0;
+        }
+      }
+    });
+    src = reinterpret_cast<const uint8_t *>(converted.data());
+    src_stride = width * static_cast<int>(sizeof(uint16_t));
+  }
+  auto rowValues = [src, src_stride](int row) {
+    return reinterpret_cast<const uint16_t *>(src + static_cast<size_t>(src_stride) * row);
+  };
+
+  // colour bin range
+  bool equalize = equalize_;
+  int lo = 0;
+  int hi = kColorBins - 1;
+  bool fit = equalize || max_distance_ <= 0.f;
+  if (!fit && near_high) {
+    auto bf = profile->getIntrinsics().bf_value;
+    auto units = DepthFrameData::formatUnits(FrameFormat::Disparity16);
+    fit = !(bf > 0.f);
+    lo = toBin(bf / max_distance_ / units);
+    hi = min_distance_ > 0.f ? toBin(bf / min_distance_ / units) : kColorBins - 1;
+  } else if (!fit) {
+    lo = toBin(min_distance_ * 1000.f);
+    hi = toBin(max_distance_ * 1000.f);
+  }
+
+  std::vector<uint32_t> histogram;
+  if (fit) {
+    histogram.assign(kColorBins, 0);
+    std::mutex histogram_mutex;
+    forRows(width, height, [&](int begin, int end) {
+      ColorHistogram stripe;
+      for (int row = begin; row < end; ++row) stripe.add(rowValues(row), width);
+      std::lock_guard<std::mutex> lock(histogram_mutex);
+      stripe.mergeInto(histogram.data());
+    });
+  }
+  if (fit && !equalize) {
+    uint64_t total = 0;
+    for (int bin = 1; bin < kColorBins; ++bin) total += histogram[bin];
+    auto tail = static_cast<uint64_t>(total * kRangeTail);
+    uint64_t below = 0;
+    for (lo = 1; lo < kColorBins - 1 && below + histogram[lo] <= tail; ++lo) below += histogram[lo];
+    uint64_t above = 0;
+    for (hi = kColorBins - 1; hi > lo && above + histogram[hi] <= tail; --hi) above += histogram[hi];
+  }
+
+  auto output_format = static_cast<FrameFormat>(output_format_.load());
+  uint32_t lut[kColorBins];
+  buildLut(histogram.data(), lo, hi, equalize, near_high, output_format, lut);
+
+  auto pixel_size = getBppByFormat(output_format) / 8;
+  auto dst_stride = width * pixel_size;
+  auto result = source->allocateVideoFrame(outputProfile(frame, output_format), frame,
+                                           getBppByFormat(output_format), width, height, dst_stride,
+                                           SeExtension::EXTENSION_VIDEO_FRAME);
+  if (!result) return nullptr;
+
+  auto dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+  forRows(width, height, [&](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      colorizeRow(rowValues(row), width, lut, pixel_size, dst + static_cast<size_t>(dst_stride) * row);
+    }
+  });
+  return result;
+}
+
+void ColorizerUnit::buildLut(const uint32_t *histogram, int lo, int hi, bool equalize, bool near_high,
+                             FrameFormat output_format, uint32_t *lut) const {
+  auto palette = colorPalette(scheme_);
+  uint64_t total = 0;
+  if (equalize) {
+    for (int bin = 1; bin < kColorBins; ++bin) total += histogram[bin];
+  }
+
+  bool bgr = output_format == FrameFormat::Color;
+  uint8_t alpha = output_format == FrameFormat::RGBA ? 0xFF : 0;
+  uint8_t none[4] = {0, 0, 0, alpha};
+  std::memcpy(&lut[0], none, sizeof(none));
+  uint64_t rank = 0;
+  for (int bin = 1; bin < kColorBins; ++bin) {
+    // position from the far (0) to the near (1) end
+    float t = 0.f;
+    if (equalize) {
+      rank += histogram[bin];
+      t = total ? static_cast<float>(static_cast<double>(rank) / total) : 0.f;
+    } else {
+      t = hi > lo ? static_cast<float>(std::min(std::max(bin, lo), hi) - lo) / (hi - lo) : 0.f;
+    }
+    if (!near_high) t = 1.f - t;
+
+    auto color = palette + static_cast<int>(t * 255.f + 0.5f) * 3;
+    uint8_t entry[4] = {color[bgr ? 2 : 0], color[1], color[bgr ? 0 : 2], alpha};
+    std::memcpy(&lut[bin], entry, sizeof(entry));
+  }
+}
+
+}  // namespace libsmartereye2
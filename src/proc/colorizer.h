@@ -0,0 +1,50 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_COLORIZER_H
+#define LIBSMARTEREYE2_COLORIZER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "stream_conversion.h"
+
+namespace libsmartereye2 {
+
+// Colours disparity and depth frames through a se2::ColorScheme (OptionKey::COLOR_SCHEME) into Color
+// (BGR), RGB or RGBA. Values are spread over MIN_DISTANCE..MAX_DISTANCE, or with MAX_DISTANCE 0 over the
+// range most of the frame's values fall in, or by their rank with OptionKey::HISTOGRAM_EQUALIZATION.
+// Near is the hot end of the scheme; pixels without data are black.
+class ColorizerUnit : public StreamConversionUnit {
+ public:
+  ColorizerUnit();
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+
+ private:
+  // one 32-bit entry per colour bin, in the byte order of output_format
+  void buildLut(const uint32_t *histogram, int lo, int hi, bool equalize, bool near_high,
+                FrameFormat output_format, uint32_t *lut) const;
+
+  std::atomic<int> scheme_;
+  std::atomic<int> output_format_;
+  std::atomic<bool> equalize_;
+  std::atomic<float> min_distance_;
+  std::atomic<float> max_distance_;  // 0 for the range of each frame
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_COLORIZER_H
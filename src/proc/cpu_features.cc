@@ -0,0 +1,74 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_features.h"
+
+#if defined(SE2_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+static SimdLevel detectSimdLevel() {
+#if defined(SE2_SIMD_X86)
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  auto max_leaf = info[0];
+  __cpuid(info, 1);
+  bool sse2 = (info[3] & (1 << 26)) != 0;
+  bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+      && (_xgetbv(0) & 0x06) == 0x06;
+  bool avx2 = false;
+  if (os_avx && max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  bool sse2 = __builtin_cpu_supports("sse2");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+  if (avx2) return SimdLevel::AVX2;
+  if (sse2) return SimdLevel::SSE2;
+  return SimdLevel::NONE;
+#elif defined(SE2_SIMD_NEON)
+  return SimdLevel::NEON;
+#else
+  return SimdLevel::NONE;
+#endif
+}
+
+SimdLevel simdLevel() {
+  static const SimdLevel level = [] {
+    auto detected = detectSimdLevel();
+    LOG(INFO) << "Image kernels use " << simdLevelName(detected);
+    return detected;
+  }();
+  return level;
+}
+
+const char *simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::SSE2: return "SSE2";
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::NEON: return "NEON";
+    default: return "scalar code";
+  }
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,49 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_CPU_FEATURES_H
+#define LIBSMARTEREYE2_CPU_FEATURES_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SE2_SIMD_X86 1
+#if defined(__GNUC__)
+#define SE2_TARGET_SSE2 __attribute__((target("sse2")))
+#define SE2_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SE2_TARGET_SSE2
+#define SE2_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SE2_SIMD_NEON 1
+#endif
+
+namespace libsmartereye2 {
+
+// Image kernels come in one variant per level, compiled with function target attributes so that the
+// library itself is built for the baseline CPU.
+enum class SimdLevel {
+  NONE,
+  SSE2,
+  AVX2,
+  NEON,
+};
+
+// the widest level both the build and the running CPU support, detected once
+SimdLevel simdLevel();
+
+const char *simdLevelName(SimdLevel level);
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_CPU_FEATURES_H
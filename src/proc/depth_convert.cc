@@ -0,0 +1,276 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "depth_convert.h"
+
+#include <vector>
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#elif defined(SE2_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+const float kMaxU16 = 65535.f;
+
+// the scalar steps every SIMD lane takes, so that all levels agree
+inline uint16_t roundU16(float value) {
+  return static_cast<uint16_t>(static_cast<int>((value < kMaxU16 ? value : kMaxU16) + 0.5f));
+}
+
+#if defined(SE2_SIMD_X86)
+
+SE2_TARGET_SSE2 inline __m128i packU16Sse2(__m128 lo, __m128 hi) {
+  // there is no unsigned 32 to 16 bit pack before SSE4.1, so pack signed around -32768
+  const __m128 max = _mm_set1_ps(kMaxU16);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i bias = _mm_set1_epi32(32768);
+  __m128i a = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(lo, max), half)), bias);
+  __m128i b = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(hi, max), half)), bias);
+  return _mm_xor_si128(_mm_packs_epi32(a, b), _mm_set1_epi16(static_cast<short>(0x8000)));
+}
+
+// SSE2 has no gather, the table lookups stay scalar
+SE2_TARGET_SSE2 inline __m128 lookupSse2(const float *table, const uint16_t *src) {
+  return _mm_setr_ps(table[src[0]], table[src[1]], table[src[2]], table[src[3]]);
+}
+
+SE2_TARGET_SSE2 int reciprocalFloatSse2(const uint16_t *src, float *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  const __m128 factor = _mm_set1_ps(scale);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    _mm_storeu_ps(dst + x, _mm_mul_ps(lookupSse2(table, src + x), factor));
+  }
+  return x;
+}
+
+SE2_TARGET_SSE2 int reciprocalU16Sse2(const uint16_t *src, uint16_t *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  const __m128 factor = _mm_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128 lo = _mm_mul_ps(lookupSse2(table, src + x), factor);
+    __m128 hi = _mm_mul_ps(lookupSse2(table, src + x + 4), factor);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packU16Sse2(lo, hi));
+  }
+  return x;
+}
+
+SE2_TARGET_SSE2 inline __m128 divideSse2(const float *src, __m128 factor) {
+  __m128 value = _mm_loadu_ps(src);
+  __m128 known = _mm_cmpgt_ps(value, _mm_setzero_ps());
+  return _mm_and_ps(_mm_div_ps(factor, value), known);
+}
+
+SE2_TARGET_SSE2 int reciprocalFromFloatSse2(const float *src, uint16_t *dst, int width, float scale) {
+  const __m128 factor = _mm_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i packed = packU16Sse2(divideSse2(src + x, factor), divideSse2(src + x + 4, factor));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packed);
+  }
+  return x;
+}
+
+SE2_TARGET_SSE2 int scaleSse2(const uint16_t *src, float *dst, int width, float scale) {
+  const __m128 factor = _mm_set1_ps(scale);
+  const __m128i zero = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    _mm_storeu_ps(dst + x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), factor));
+    _mm_storeu_ps(dst + x + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), factor));
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 inline __m256 lookupAvx2(const float *table, const uint16_t *src) {
+  __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+  return _mm256_i32gather_ps(table, index, 4);
+}
+
+SE2_TARGET_AVX2 inline __m128i packU16Avx2(__m256 value) {
+  __m256i words = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(value, _mm256_set1_ps(kMaxU16)),
+                                                    _mm256_set1_ps(0.5f)));
+  return _mm_packus_epi32(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+SE2_TARGET_AVX2 int reciprocalFloatAvx2(const uint16_t *src, float *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  const __m256 factor = _mm256_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    _mm256_storeu_ps(dst + x, _mm256_mul_ps(lookupAvx2(table, src + x), factor));
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int reciprocalU16Avx2(const uint16_t *src, uint16_t *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  const __m256 factor = _mm256_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i packed = packU16Avx2(_mm256_mul_ps(lookupAvx2(table, src + x), factor));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packed);
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int reciprocalFromFloatAvx2(const float *src, uint16_t *dst, int width, float scale) {
+  const __m256 factor = _mm256_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256 value = _mm256_loadu_ps(src + x);
+    __m256 known = _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GT_OQ);
+    __m128i packed = packU16Avx2(_mm256_and_ps(_mm256_div_ps(factor, value), known));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packed);
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int scaleAvx2(const uint16_t *src, float *dst, int width, float scale) {
+  const __m256 factor = _mm256_set1_ps(scale);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x)));
+    _mm256_storeu_ps(dst + x, _mm256_mul_ps(_mm256_cvtepi32_ps(values), factor));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_X86
+
+#if defined(SE2_SIMD_NEON)
+
+inline float32x4_t lookupNeon(const float *table, const uint16_t *src) {
+  float values[4] = {table[src[0]], table[src[1]], table[src[2]], table[src[3]]};
+  return vld1q_f32(values);
+}
+
+inline uint16x4_t roundU16Neon(float32x4_t value) {
+  value = vaddq_f32(vminq_f32(value, vdupq_n_f32(kMaxU16)), vdupq_n_f32(0.5f));
+  return vmovn_u32(vcvtq_u32_f32(value));
+}
+
+int reciprocalFloatNeon(const uint16_t *src, float *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    vst1q_f32(dst + x, vmulq_n_f32(lookupNeon(table, src + x), scale));
+  }
+  return x;
+}
+
+int reciprocalU16Neon(const uint16_t *src, uint16_t *dst, int width, float scale) {
+  const float *table = reciprocalTable();
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x4_t lo = roundU16Neon(vmulq_n_f32(lookupNeon(table, src + x), scale));
+    uint16x4_t hi = roundU16Neon(vmulq_n_f32(lookupNeon(table, src + x + 4), scale));
+    vst1q_u16(dst + x, vcombine_u16(lo, hi));
+  }
+  return x;
+}
+
+#if defined(__aarch64__)
+// ARMv7 NEON has no divide, float input stays scalar there
+int reciprocalFromFloatNeon(const float *src, uint16_t *dst, int width, float scale) {
+  const float32x4_t factor = vdupq_n_f32(scale);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    float32x4_t value = vld1q_f32(src + x);
+    uint32x4_t known = vcgtq_f32(value, vdupq_n_f32(0.f));
+    uint16x4_t result = roundU16Neon(vdivq_f32(factor, value));
+    vst1_u16(dst + x, vand_u16(result, vmovn_u32(known)));
+  }
+  return x;
+}
+#endif
+
+int scaleNeon(const uint16_t *src, float *dst, int width, float scale) {
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t words = vld1q_u16(src + x);
+    vst1q_f32(dst + x, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), scale));
+    vst1q_f32(dst + x + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))), scale));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_NEON
+
+}  // namespace
+
+const float *reciprocalTable() {
+  static const std::vector<float> table = [] {
+    std::vector<float> values(65536);
+    values[0] = 0.f;
+    for (size_t v = 1; v < values.size(); ++v) values[v] = 1.f / static_cast<float>(v);
+    return values;
+  }();
+  return table.data();
+}
+
+void reciprocalRow(const uint16_t *src, float *dst, int width, float scale, SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) x = reciprocalFloatAvx2(src, dst, width, scale);
+  else if (level == SimdLevel::SSE2) x = reciprocalFloatSse2(src, dst, width, scale);
+#elif defined(SE2_SIMD_NEON)
+  if (level == SimdLevel::NEON) x = reciprocalFloatNeon(src, dst, width, scale);
+#endif
+  const float *table = reciprocalTable();
+  for (; x < width; ++x) dst[x] = table[src[x]] * scale;
+}
+
+void reciprocalRow(const uint16_t *src, uint16_t *dst, int width, float scale, SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) x = reciprocalU16Avx2(src, dst, width, scale);
+  else if (level == SimdLevel::SSE2) x = reciprocalU16Sse2(src, dst, width, scale);
+#elif defined(SE2_SIMD_NEON)
+  if (level == SimdLevel::NEON) x = reciprocalU16Neon(src, dst, width, scale);
+#endif
+  const float *table = reciprocalTable();
+  for (; x < width; ++x) dst[x] = roundU16(table[src[x]] * scale);
+}
+
+void reciprocalRow(const float *src, uint16_t *dst, int width, float scale, SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) x = reciprocalFromFloatAvx2(src, dst, width, scale);
+  else if (level == SimdLevel::SSE2) x = reciprocalFromFloatSse2(src, dst, width, scale);
+#elif defined(SE2_SIMD_NEON) && defined(__aarch64__)
+  if (level == SimdLevel::NEON) x = reciprocalFromFloatNeon(src, dst, width, scale);
+#endif
+  for (; x < width; ++x) dst[x] = src[x] > 0.f ? roundU16(scale / src[x]) : 0;
+}
+
+void scaleRow(const uint16_t *src, float *dst, int width, float scale, SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) x = scaleAvx2(src, dst, width, scale);
+  else if (level == SimdLevel::SSE2) x = scaleSse2(src, dst, width, scale);
+#elif defined(SE2_SIMD_NEON)
+  if (level == SimdLevel::NEON) x = scaleNeon(src, dst, width, scale);
+#endif
+  for (; x < width; ++x) dst[x] = static_cast<float>(src[x]) * scale;
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,41 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_DEPTH_CONVERT_H
+#define LIBSMARTEREYE2_DEPTH_CONVERT_H
+
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace libsmartereye2 {
+
+// 1 / v for every 16-bit v, 0 for 0. Built on first use.
+const float *reciprocalTable();
+
+// Row kernels between disparity and depth, which are reciprocal to each other. Unknown (0) input
+// stays 0, integer results are rounded and saturate at 65535. Every level produces the same values.
+
+// dst = scale / src
+void reciprocalRow(const uint16_t *src, float *dst, int width, float scale, SimdLevel level = simdLevel());
+void reciprocalRow(const uint16_t *src, uint16_t *dst, int width, float scale, SimdLevel level = simdLevel());
+// dst = scale / src, 0 where src is not positive
+void reciprocalRow(const float *src, uint16_t *dst, int width, float scale, SimdLevel level = simdLevel());
+
+// dst = scale * src
+void scaleRow(const uint16_t *src, float *dst, int width, float scale, SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_DEPTH_CONVERT_H
@@ -0,0 +1,145 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "depth_transform.h"
+
+#include <vector>
+
+#include "depth_convert.h"
+#include "disparity_unpack.h"
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+namespace {
+
+const char *const kName[] = {"Disparity to Depth", "Depth to Disparity"};
+
+// the rows of frame, nullptr when its data does not hold them
+const uint8_t *checkedRows(VideoFrameData *video, FrameFormat format, int *stride) {
+  *stride = video->stride() ? video->stride() : getStrideByFormat(format, video->width());
+  auto size = static_cast<size_t>(*stride) * video->height();
+  if (video->width() <= 0 || video->height() <= 0 || video->getFrameDataSize() < size) return nullptr;
+  return reinterpret_cast<const uint8_t *>(video->getFrameData());
+}
+
+}  // namespace
+
+DisparityTransformUnit::DisparityTransformUnit(bool to_disparity)
+    : StreamConversionUnit(kName[to_disparity]),
+      to_disparity_(to_disparity),
+      depth_format_(static_cast<int>(FrameFormat::Depth16)) {
+  if (to_disparity_) return;
+  registerOption(OptionKey::OUTPUT_FORMAT, std::make_shared<RangeOption>(
+      OptionRange{static_cast<float>(FrameFormat::Depth16), static_cast<float>(FrameFormat::DepthFloat), 1,
+                  static_cast<float>(FrameFormat::Depth16)},
+      "Format depth is written in: Depth16 (millimetres) or DepthFloat (metres)",
+      [this](float value) { depth_format_ = static_cast<int>(value); }));
+}
+
+FrameInterface *DisparityTransformUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto video = dynamic_cast<VideoFrameData *>(frame);
+  auto profile = frame->getStreamProfile();
+  auto input_format = profile->format();
+  auto output_format = to_disparity_ ? FrameFormat::Disparity16 : static_cast<FrameFormat>(depth_format_.load());
+  bool from_depth = input_format == FrameFormat::Depth16 || input_format == FrameFormat::DepthFloat;
+  // packed rows are unpacked into Disparity16 first
+  bool packed = isPackedDisparity(input_format);
+  bool from_disparity = packed || input_format == FrameFormat::Disparity16
+      || input_format == FrameFormat::DisparitySparse;
+  if (!video || (to_disparity_ ? !from_depth : !from_disparity)) return nullptr;
+
+  auto stream = static_cast<uint32_t>(profile->frameId());
+  auto bf = profile->getIntrinsics().bf_value;
+  if (!(bf > 0.f)) {
+    LOG(WARNING) << kName[to_disparity_] << " skipped a frame of stream " << stream
+                 << ", its profile has no calibration";
+    return nullptr;
+  }
+  int src_stride = 0;
+  auto src = checkedRows(video, input_format, &src_stride);
+  if (!src) {
+    LOG(WARNING) << kName[to_disparity_] << " skipped a frame of stream " << stream << ", "
+                 << video->getFrameDataSize() << " bytes do not hold " << video->width() << "x" << video->height();
+    return nullptr;
+  }
+
+  auto width = video->width();
+  auto height = video->height();
+  auto dst_stride = getStrideByFormat(output_format, width);
+  auto result = source->allocateVideoFrame(outputProfile(frame, output_format), frame,
+                                           getBppByFormat(output_format), width, height, dst_stride,
+                                           to_disparity_ ? SeExtension::EXTENSION_DISPARITY_FRAME
+                                                         : SeExtension::EXTENSION_DEPTH_FRAME);
+  if (!result) return nullptr;
+  auto dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+
+  // value of one format = scale / value of the other, both sides in their own units
+  auto units = DepthFrameData::formatUnits(packed ? FrameFormat::Disparity16 : input_format);
+  auto scale = bf / units / DepthFrameData::formatUnits(output_format);
+  forRows(width, height, [=](int begin, int end) {
+    std::vector<uint16_t> unpacked(packed ? width : 0);
+    for (int row = begin; row < end; ++row) {
+      auto in = src + static_cast<size_t>(src_stride) * row;
+      auto out = dst + static_cast<size_t>(dst_stride) * row;
+      if (packed) {
+        unpackDisparityRow(in, input_format, width, unpacked.data());
+        in = reinterpret_cast<const uint8_t *>(unpacked.data());
+      }
+      if (input_format == FrameFormat::DepthFloat) {
+        reciprocalRow(reinterpret_cast<const float *>(in), reinterpret_cast<uint16_t *>(out), width, scale);
+      } else if (output_format == FrameFormat::DepthFloat) {
+        reciprocalRow(reinterpret_cast<const uint16_t *>(in), reinterpret_cast<float *>(out), width, scale);
+      } else {
+        reciprocalRow(reinterpret_cast<const uint16_t *>(in), reinterpret_cast<uint16_t *>(out), width, scale);
+      }
+    }
+  });
+  return result;
+}
+
+UnitsTransformUnit::UnitsTransformUnit()
+    : StreamConversionUnit("Units Transform") {}
+
+FrameInterface *UnitsTransformUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto video = dynamic_cast<VideoFrameData *>(frame);
+  auto profile = frame->getStreamProfile();
+  if (!video || profile->format() != FrameFormat::Depth16) return nullptr;
+
+  int src_stride = 0;
+  auto src = checkedRows(video, FrameFormat::Depth16, &src_stride);
+  if (!src) return nullptr;
+
+  auto width = video->width();
+  auto height = video->height();
+  auto dst_stride = getStrideByFormat(FrameFormat::DepthFloat, width);
+  auto result = source->allocateVideoFrame(outputProfile(frame, FrameFormat::DepthFloat), frame,
+                                           getBppByFormat(FrameFormat::DepthFloat), width, height, dst_stride,
+                                           SeExtension::EXTENSION_DEPTH_FRAME);
+  if (!result) return nullptr;
+  auto dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+
+  auto scale = DepthFrameData::formatUnits(FrameFormat::Depth16);
+  forRows(width, height, [=](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      scaleRow(reinterpret_cast<const uint16_t *>(src + static_cast<size_t>(src_stride) * row),
+               reinterpret_cast<float *>(dst + static_cast<size_t>(dst_stride) * row), width, scale);
+    }
+  });
+  return result;
+}
+
+}  // namespace libsmartereye2
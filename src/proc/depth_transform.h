@@ -0,0 +1,50 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_DEPTH_TRANSFORM_H
+#define LIBSMARTEREYE2_DEPTH_TRANSFORM_H
+
+#include <atomic>
+
+#include "stream_conversion.h"
+
+namespace libsmartereye2 {
+
+// Disparity frames into depth, Depth16 (millimetres) or DepthFloat (metres) as chosen by
+// OptionKey::OUTPUT_FORMAT, or depth frames back into Disparity16. Depth is bf / disparity with bf
+// (baseline times focal length) from the intrinsics of the frame's profile.
+class DisparityTransformUnit : public StreamConversionUnit {
+ public:
+  explicit DisparityTransformUnit(bool to_disparity);
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+
+ private:
+  const bool to_disparity_;
+  std::atomic<int> depth_format_;
+};
+
+// Depth16 frames into DepthFloat
+class UnitsTransformUnit : public StreamConversionUnit {
+ public:
+  UnitsTransformUnit();
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_DEPTH_TRANSFORM_H
@@ -0,0 +1,253 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "disparity_unpack.h"
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#elif defined(SE2_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+// Eight values of N bits fill N bytes. Value k starts at bit k * N; the 16 bits from its first byte on
+// are shifted up so that it ends at bit 15 and then down into place, which also drops its neighbours.
+template<int N>
+struct Packing {
+  static const int kFractionBits = N == 10 ? 2 : (N == 12 ? 4 : 0);
+  static const int kUpShift = kDisparity16FractionBits - kFractionBits;
+  static const int kDownShift = 16 - N;
+
+  static int firstByte(int k) { return k * N / 8; }
+  static int multiplier(int k) { return 1 << (16 - N - k * N % 8); }
+};
+
+template<int N>
+void unpackRow(const uint8_t *src, int x, int width, uint16_t *dst) {
+  const int row_bytes = (width * N + 7) / 8;
+  for (; x < width; ++x) {
+    int bit = x * N;
+    int byte = bit / 8;
+    uint32_t word = src[byte];
+    if (byte + 1 < row_bytes) word |= static_cast<uint32_t>(src[byte + 1]) << 8;
+    if (byte + 2 < row_bytes) word |= static_cast<uint32_t>(src[byte + 2]) << 16;
+    auto value = (word >> (bit % 8)) & ((1u << N) - 1);
+    dst[x] = static_cast<uint16_t>(value << Packing<N>::kUpShift);
+  }
+}
+
+#if defined(SE2_SIMD_X86)
+
+SE2_TARGET_SSE2 int unpack8Sse2(const uint8_t *src, int width, uint16_t *dst) {
+  const __m128i zero = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                     _mm_slli_epi16(_mm_unpacklo_epi8(bytes, zero), kDisparity16FractionBits));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 8),
+                     _mm_slli_epi16(_mm_unpackhi_epi8(bytes, zero), kDisparity16FractionBits));
+  }
+  return x;
+}
+
+// 16 values a step, the groups of eight in the two 128-bit lanes
+template<int N>
+SE2_TARGET_AVX2 int unpackPackedAvx2(const uint8_t *src, int width, uint16_t *dst) {
+  typedef Packing<N> P;
+  const int row_bytes = (width * N + 7) / 8;
+  const __m128i shuffle = _mm_setr_epi8(
+      P::firstByte(0), P::firstByte(0) + 1, P::firstByte(1), P::firstByte(1) + 1,
+      P::firstByte(2), P::firstByte(2) + 1, P::firstByte(3), P::firstByte(3) + 1,
+      P::firstByte(4), P::firstByte(4) + 1, P::firstByte(5), P::firstByte(5) + 1,
+      P::firstByte(6), P::firstByte(6) + 1, P::firstByte(7), P::firstByte(7) + 1);
+  const __m128i multiplier = _mm_setr_epi16(
+      P::multiplier(0), P::multiplier(1), P::multiplier(2), P::multiplier(3),
+      P::multiplier(4), P::multiplier(5), P::multiplier(6), P::multiplier(7));
+  const __m256i shuffles = _mm256_inserti128_si256(_mm256_castsi128_si256(shuffle), shuffle, 1);
+  const __m256i multipliers = _mm256_inserti128_si256(_mm256_castsi128_si256(multiplier), multiplier, 1);
+  int x = 0;
+  // a lane loads 16 bytes of which N are used
+  for (; x + 16 <= width && x / 8 * N + N + 16 <= row_bytes; x += 16) {
+    const uint8_t *group = src + x / 8 * N;
+    __m256i bytes = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(group))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(group + N)), 1);
+    __m256i words = _mm256_mullo_epi16(_mm256_shuffle_epi8(bytes, shuffles), multipliers);
+    words = _mm256_slli_epi16(_mm256_srli_epi16(words, P::kDownShift), P::kUpShift);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), words);
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int unpack8Avx2(const uint8_t *src, int width, uint16_t *dst) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i words = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                        _mm256_slli_epi16(words, kDisparity16FractionBits));
+  }
+  return x;
+}
+
+// the first column at or after x whose 8 (SSE2) or 16 (AVX2) value block holds a non-zero value
+SE2_TARGET_SSE2 int skipZerosSse2(const uint16_t *row, int x, int width) {
+  const __m128i zero = _mm_setzero_si128();
+  for (; x + 8 <= width; x += 8) {
+    __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(values, zero)) != 0xFFFF) break;
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int skipZerosAvx2(const uint16_t *row, int x, int width) {
+  for (; x + 16 <= width; x += 16) {
+    __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x));
+    if (!_mm256_testz_si256(values, values)) break;
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_X86
+
+#if defined(SE2_SIMD_NEON)
+
+int unpack8Neon(const uint8_t *src, int width, uint16_t *dst) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t bytes = vld1q_u8(src + x);
+    vst1q_u16(dst + x, vshll_n_u8(vget_low_u8(bytes), kDisparity16FractionBits));
+    vst1q_u16(dst + x + 8, vshll_n_u8(vget_high_u8(bytes), kDisparity16FractionBits));
+  }
+  return x;
+}
+
+#if defined(__aarch64__)
+// ARMv7 has no 16-byte table lookup, packed rows stay scalar there
+template<int N>
+int unpackPackedNeon(const uint8_t *src, int width, uint16_t *dst) {
+  typedef Packing<N> P;
+  const int row_bytes = (width * N + 7) / 8;
+  const uint8_t shuffle_bytes[16] = {
+      P::firstByte(0), P::firstByte(0) + 1, P::firstByte(1), P::firstByte(1) + 1,
+      P::firstByte(2), P::firstByte(2) + 1, P::firstByte(3), P::firstByte(3) + 1,
+      P::firstByte(4), P::firstByte(4) + 1, P::firstByte(5), P::firstByte(5) + 1,
+      P::firstByte(6), P::firstByte(6) + 1, P::firstByte(7), P::firstByte(7) + 1};
+  const uint16_t multiplier_words[8] = {
+      P::multiplier(0), P::multiplier(1), P::multiplier(2), P::multiplier(3),
+      P::multiplier(4), P::multiplier(5), P::multiplier(6), P::multiplier(7)};
+  const uint8x16_t shuffle = vld1q_u8(shuffle_bytes);
+  const uint16x8_t multiplier = vld1q_u16(multiplier_words);
+  int x = 0;
+  for (; x + 8 <= width && x / 8 * N + 16 <= row_bytes; x += 8) {
+    uint8x16_t bytes = vqtbl1q_u8(vld1q_u8(src + x / 8 * N), shuffle);
+    uint16x8_t words = vmulq_u16(vreinterpretq_u16_u8(bytes), multiplier);
+    vst1q_u16(dst + x, vshlq_n_u16(vshrq_n_u16(words, P::kDownShift), P::kUpShift));
+  }
+  return x;
+}
+
+int skipZerosNeon(const uint16_t *row, int x, int width) {
+  for (; x + 8 <= width; x += 8) {
+    if (vmaxvq_u16(vld1q_u16(row + x))) break;
+  }
+  return x;
+}
+#endif
+
+#endif  // SE2_SIMD_NEON
+
+template<int N>
+void unpackPacked(const uint8_t *src, int width, uint16_t *dst, SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) x = unpackPackedAvx2<N>(src, width, dst);
+#elif defined(SE2_SIMD_NEON) && defined(__aarch64__)
+  if (level == SimdLevel::NEON) x = unpackPackedNeon<N>(src, width, dst);
+#endif
+  unpackRow<N>(src, x, width, dst);
+}
+
+int skipZeros(const uint16_t *row, int x, int width, SimdLevel level) {
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) return skipZerosAvx2(row, x, width);
+  if (level == SimdLevel::SSE2) return skipZerosSse2(row, x, width);
+#elif defined(SE2_SIMD_NEON) && defined(__aarch64__)
+  if (level == SimdLevel::NEON) return skipZerosNeon(row, x, width);
+#endif
+  return x;
+}
+
+}  // namespace
+
+bool isPackedDisparity(FrameFormat format) {
+  return format == FrameFormat::Disparity7 || format == FrameFormat::Disparity8
+      || format == FrameFormat::Disparity10 || format == FrameFormat::Disparity12;
+}
+
+void unpackDisparityRow(const uint8_t *src, FrameFormat format, int width, uint16_t *dst, SimdLevel level) {
+  switch (format) {
+    case FrameFormat::Disparity7:
+      unpackPacked<7>(src, width, dst, level);
+      break;
+    case FrameFormat::Disparity8: {
+      int x = 0;
+#if defined(SE2_SIMD_X86)
+      if (level == SimdLevel::AVX2) x = unpack8Avx2(src, width, dst);
+      else if (level == SimdLevel::SSE2) x = unpack8Sse2(src, width, dst);
+#elif defined(SE2_SIMD_NEON)
+      if (level == SimdLevel::NEON) x = unpack8Neon(src, width, dst);
+#endif
+      for (; x < width; ++x) dst[x] = static_cast<uint16_t>(src[x] << kDisparity16FractionBits);
+      break;
+    }
+    case FrameFormat::Disparity10:
+      unpackPacked<10>(src, width, dst, level);
+      break;
+    case FrameFormat::Disparity12:
+      unpackPacked<12>(src, width, dst, level);
+      break;
+    default:
+      break;
+  }
+}
+
+void compactDisparity(const uint16_t *src, int stride, int width, int height, SparseDisparity *sparse,
+                      SimdLevel level) {
+  sparse->width = width;
+  sparse->height = height;
+  sparse->row_offsets.assign(1, 0);
+  sparse->row_offsets.reserve(static_cast<size_t>(height) + 1);
+  sparse->columns.clear();
+  sparse->values.clear();
+  for (int y = 0; y < height; ++y) {
+    auto row = reinterpret_cast<const uint16_t *>(reinterpret_cast<const uint8_t *>(src)
+        + static_cast<size_t>(stride) * y);
+    for (int x = skipZeros(row, 0, width, level); x < width; x = skipZeros(row, x, width, level)) {
+      // finishes the block skipZeros stopped at, or the tail
+      int end = x + 16 < width ? x + 16 : width;
+      for (; x < end; ++x) {
+        if (!row[x]) continue;
+        sparse->columns.push_back(static_cast<uint16_t>(x));
+        sparse->values.push_back(row[x]);
+      }
+    }
+    sparse->row_offsets.push_back(static_cast<uint32_t>(sparse->values.size()));
+  }
+}
+
+}  // namespace libsmartereye2
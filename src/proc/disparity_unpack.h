@@ -0,0 +1,54 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_DISPARITY_UNPACK_H
+#define LIBSMARTEREYE2_DISPARITY_UNPACK_H
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+#include "streaming/stream_types.hpp"
+
+namespace libsmartereye2 {
+
+using se2::FrameFormat;
+using se2::kDisparity16FractionBits;
+
+// Disparity7, Disparity8, Disparity10 and Disparity12
+bool isPackedDisparity(FrameFormat format);
+
+// Unpacks one row of a packed disparity format into Disparity16 values. Every level produces the same
+// values.
+void unpackDisparityRow(const uint8_t *src, FrameFormat format, int width, uint16_t *dst,
+                        SimdLevel level = simdLevel());
+
+// Matched pixels of a sparse disparity frame in compressed sparse rows: the pixels of row y are
+// columns[i], values[i] for i in [row_offsets[y], row_offsets[y + 1]).
+struct SparseDisparity {
+  int width = 0;
+  int height = 0;
+  std::vector<uint32_t> row_offsets;
+  std::vector<uint16_t> columns;
+  std::vector<uint16_t> values;  // Disparity16
+};
+
+// Collects the non-zero values of a Disparity16 or DisparitySparse frame, skipping empty runs a vector at
+// a time. stride is in bytes.
+void compactDisparity(const uint16_t *src, int stride, int width, int height, SparseDisparity *sparse,
+                      SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_DISPARITY_UNPACK_H
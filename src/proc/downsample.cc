@@ -0,0 +1,268 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "downsample.h"
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#elif defined(SE2_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+// sums keep two pixels of the edge on either side
+const int kGaussianPad = 2;
+
+void boxHalvePixels(const uint8_t *top, const uint8_t *bottom, int begin, int end, int channels, uint8_t *dst) {
+  for (int i = begin * channels; i < end * channels; ++i) {
+    auto x = i / channels;
+    auto left = 2 * x * channels + i % channels;
+    dst[i] = static_cast<uint8_t>((top[left] + top[left + channels] + bottom[left] + bottom[left + channels] + 2) >> 2);
+  }
+}
+
+void gaussianColumns(const uint8_t *const rows[5], int begin, int end, uint16_t *sums) {
+  for (int i = begin; i < end; ++i) {
+    sums[i] = static_cast<uint16_t>(rows[0][i] + 4 * (rows[1][i] + rows[3][i]) + 6 * rows[2][i] + rows[4][i]);
+  }
+}
+
+void gaussianHalvePixels(const uint16_t *sums, int begin, int end, int channels, uint8_t *dst) {
+  for (int i = begin * channels; i < end * channels; ++i) {
+    auto s = sums + 2 * (i / channels) * channels + i % channels;
+    int sum = s[0] + 4 * (s[channels] + s[3 * channels]) + 6 * s[2 * channels] + s[4 * channels];
+    dst[i] = static_cast<uint8_t>((sum + 128) >> 8);
+  }
+}
+
+#if defined(SE2_SIMD_X86)
+
+// sums of the byte pairs of v
+SE2_TARGET_SSE2 inline __m128i pairsSse2(__m128i v) {
+  return _mm_add_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), _mm_srli_epi16(v, 8));
+}
+
+SE2_TARGET_SSE2 int boxHalveGraySse2(const uint8_t *top, const uint8_t *bottom, int dst_width, uint8_t *dst) {
+  const __m128i two = _mm_set1_epi16(2);
+  int x = 0;
+  for (; x + 16 <= dst_width; x += 16) {
+    auto t = reinterpret_cast<const __m128i *>(top + 2 * x);
+    auto b = reinterpret_cast<const __m128i *>(bottom + 2 * x);
+    __m128i lo = _mm_add_epi16(pairsSse2(_mm_loadu_si128(t)), pairsSse2(_mm_loadu_si128(b)));
+    __m128i hi = _mm_add_epi16(pairsSse2(_mm_loadu_si128(t + 1)), pairsSse2(_mm_loadu_si128(b + 1)));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(lo, hi));
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 int boxHalveGrayAvx2(const uint8_t *top, const uint8_t *bottom, int dst_width, uint8_t *dst) {
+  const __m256i low = _mm256_set1_epi16(0xFF);
+  const __m256i two = _mm256_set1_epi16(2);
+  int x = 0;
+  for (; x + 32 <= dst_width; x += 32) {
+    auto t = reinterpret_cast<const __m256i *>(top + 2 * x);
+    auto b = reinterpret_cast<const __m256i *>(bottom + 2 * x);
+    __m256i t0 = _mm256_loadu_si256(t), t1 = _mm256_loadu_si256(t + 1);
+    __m256i b0 = _mm256_loadu_si256(b), b1 = _mm256_loadu_si256(b + 1);
+    __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(t0, low), _mm256_srli_epi16(t0, 8)),
+                                  _mm256_add_epi16(_mm256_and_si256(b0, low), _mm256_srli_epi16(b0, 8)));
+    __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(t1, low), _mm256_srli_epi16(t1, 8)),
+                                  _mm256_add_epi16(_mm256_and_si256(b1, low), _mm256_srli_epi16(b1, 8)));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+    // packus works within lanes
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), packed);
+  }
+  return x;
+}
+
+SE2_TARGET_SSE2 int gaussianColumnsSse2(const uint8_t *const rows[5], int count, uint16_t *sums) {
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i v[5];
+    for (int r = 0; r < 5; ++r) v[r] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[r] + i));
+    for (int half = 0; half < 2; ++half) {
+      __m128i w[5];
+      for (int r = 0; r < 5; ++r) w[r] = half ? _mm_unpackhi_epi8(v[r], zero) : _mm_unpacklo_epi8(v[r], zero);
+      __m128i sum = _mm_add_epi16(_mm_add_epi16(w[0], w[4]), _mm_slli_epi16(_mm_add_epi16(w[1], w[3]), 2));
+      sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_slli_epi16(w[2], 2), _mm_slli_epi16(w[2], 1)));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 8 * half), sum);
+    }
+  }
+  return i;
+}
+
+SE2_TARGET_AVX2 int gaussianColumnsAvx2(const uint8_t *const rows[5], int count, uint16_t *sums) {
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i w[5];
+    for (int r = 0; r < 5; ++r) {
+      w[r] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[r] + i)));
+    }
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(w[0], w[4]), _mm256_slli_epi16(_mm256_add_epi16(w[1], w[3]), 2));
+    sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_slli_epi16(w[2], 2), _mm256_slli_epi16(w[2], 1)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + i), sum);
+  }
+  return i;
+}
+
+// one byte pixels; sums of the even and odd columns from 16 values at s, which are below 1 << 15
+SE2_TARGET_SSE2 inline void deinterleaveSse2(const uint16_t *s, __m128i *even, __m128i *odd) {
+  const __m128i low = _mm_set1_epi32(0xFFFF);
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 8));
+  *even = _mm_packs_epi32(_mm_and_si128(a, low), _mm_and_si128(b, low));
+  *odd = _mm_packs_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+}
+
+SE2_TARGET_SSE2 int gaussianHalveGraySse2(const uint16_t *sums, int dst_width, uint8_t *dst) {
+  const __m128i round = _mm_set1_epi16(128);
+  int x = 0;
+  for (; x + 8 <= dst_width; x += 8) {
+    __m128i e0, o1, e2, o3, e4, unused;
+    deinterleaveSse2(sums + 2 * x, &e0, &o1);
+    deinterleaveSse2(sums + 2 * x + 2, &e2, &o3);
+    deinterleaveSse2(sums + 2 * x + 4, &e4, &unused);
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(e0, e4), _mm_slli_epi16(_mm_add_epi16(o1, o3), 2));
+    sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_slli_epi16(e2, 2), _mm_slli_epi16(e2, 1)));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(sum, sum));
+  }
+  return x;
+}
+
+SE2_TARGET_AVX2 inline void deinterleaveAvx2(const uint16_t *s, __m256i *even, __m256i *odd) {
+  const __m256i low = _mm256_set1_epi32(0xFFFF);
+  __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+  __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 16));
+  *even = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(a, low), _mm256_and_si256(b, low)), 0xD8);
+  *odd = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srli_epi32(a, 16), _mm256_srli_epi32(b, 16)), 0xD8);
+}
+
+SE2_TARGET_AVX2 int gaussianHalveGrayAvx2(const uint16_t *sums, int dst_width, uint8_t *dst) {
+  const __m256i round = _mm256_set1_epi16(128);
+  int x = 0;
+  for (; x + 16 <= dst_width; x += 16) {
+    __m256i e0, o1, e2, o3, e4, unused;
+    deinterleaveAvx2(sums + 2 * x, &e0, &o1);
+    deinterleaveAvx2(sums + 2 * x + 2, &e2, &o3);
+    deinterleaveAvx2(sums + 2 * x + 4, &e4, &unused);
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(e0, e4), _mm256_slli_epi16(_mm256_add_epi16(o1, o3), 2));
+    sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_slli_epi16(e2, 2), _mm256_slli_epi16(e2, 1)));
+    sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 8);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0xD8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm256_castsi256_si128(packed));
+  }
+  return x;
+}
+
+#elif defined(SE2_SIMD_NEON)
+
+int boxHalveGrayNeon(const uint8_t *top, const uint8_t *bottom, int dst_width, uint8_t *dst) {
+  int x = 0;
+  for (; x + 8 <= dst_width; x += 8) {
+    uint16x8_t sum = vaddq_u16(vpaddlq_u8(vld1q_u8(top + 2 * x)), vpaddlq_u8(vld1q_u8(bottom + 2 * x)));
+    vst1_u8(dst + x, vrshrn_n_u16(sum, 2));
+  }
+  return x;
+}
+
+int gaussianColumnsNeon(const uint8_t *const rows[5], int count, uint16_t *sums) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t sum = vaddl_u8(vld1_u8(rows[0] + i), vld1_u8(rows[4] + i));
+    sum = vmlaq_n_u16(sum, vaddl_u8(vld1_u8(rows[1] + i), vld1_u8(rows[3] + i)), 4);
+    sum = vmlaq_n_u16(sum, vmovl_u8(vld1_u8(rows[2] + i)), 6);
+    vst1q_u16(sums + i, sum);
+  }
+  return i;
+}
+
+int gaussianHalveGrayNeon(const uint16_t *sums, int dst_width, uint8_t *dst) {
+  int x = 0;
+  for (; x + 8 <= dst_width; x += 8) {
+    uint16x8x2_t s0 = vld2q_u16(sums + 2 * x);
+    uint16x8x2_t s2 = vld2q_u16(sums + 2 * x + 2);
+    uint16x8x2_t s4 = vld2q_u16(sums + 2 * x + 4);
+    uint16x8_t sum = vaddq_u16(s0.val[0], s4.val[0]);
+    sum = vmlaq_n_u16(sum, vaddq_u16(s0.val[1], s2.val[1]), 4);
+    sum = vmlaq_n_u16(sum, s2.val[0], 6);
+    vst1_u8(dst + x, vrshrn_n_u16(sum, 8));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_NEON
+
+}  // namespace
+
+void boxHalveRow(const uint8_t *top, const uint8_t *bottom, int dst_width, int channels, uint8_t *dst,
+                 SimdLevel level) {
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (channels == 1 && level == SimdLevel::AVX2) {
+    x = boxHalveGrayAvx2(top, bottom, dst_width, dst);
+  }
+  if (channels == 1 && (level == SimdLevel::AVX2 || level == SimdLevel::SSE2)) {
+    x += boxHalveGraySse2(top + 2 * x, bottom + 2 * x, dst_width - x, dst + x);
+  }
+#elif defined(SE2_SIMD_NEON)
+  if (channels == 1 && level == SimdLevel::NEON) x = boxHalveGrayNeon(top, bottom, dst_width, dst);
+#endif
+  boxHalvePixels(top, bottom, x, dst_width, channels, dst);
+}
+
+void gaussianHalveRow(const uint8_t *const rows[5], int src_width, int channels, uint16_t *sums, uint8_t *dst,
+                      SimdLevel level) {
+  auto count = src_width * channels;
+  auto pad = kGaussianPad * channels;
+  auto columns = sums + pad;
+  int i = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) {
+    i = gaussianColumnsAvx2(rows, count, columns);
+  } else if (level == SimdLevel::SSE2) {
+    i = gaussianColumnsSse2(rows, count, columns);
+  }
+#elif defined(SE2_SIMD_NEON)
+  if (level == SimdLevel::NEON) i = gaussianColumnsNeon(rows, count, columns);
+#endif
+  gaussianColumns(rows, i, count, columns);
+  for (int k = 0; k < pad; ++k) {
+    sums[k] = columns[k % channels];
+    columns[count + k] = columns[count - channels + k % channels];
+  }
+
+  auto dst_width = src_width / 2;
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (channels == 1 && level == SimdLevel::AVX2) {
+    x = gaussianHalveGrayAvx2(sums, dst_width, dst);
+  }
+  if (channels == 1 && (level == SimdLevel::AVX2 || level == SimdLevel::SSE2)) {
+    x += gaussianHalveGraySse2(sums + 2 * x, dst_width - x, dst + x);
+  }
+#elif defined(SE2_SIMD_NEON)
+  if (channels == 1 && level == SimdLevel::NEON) x = gaussianHalveGrayNeon(sums, dst_width, dst);
+#endif
+  gaussianHalvePixels(sums, x, dst_width, channels, dst);
+}
+
+}  // namespace libsmartereye2
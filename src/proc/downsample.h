@@ -0,0 +1,38 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef LIBSMARTEREYE2_DOWNSAMPLE_H
+#define LIBSMARTEREYE2_DOWNSAMPLE_H
+
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace libsmartereye2 {
+
+// Kernels halving images of one byte per channel, channels bytes per pixel; a row of src_width pixels
+// gives src_width / 2. Every level produces the same pixels.
+
+// dst[x] is the rounded mean of the 2x2 block at column 2x of rows top and bottom
+void boxHalveRow(const uint8_t *top, const uint8_t *bottom, int dst_width, int channels, uint8_t *dst,
+                 SimdLevel level = simdLevel());
+
+// The [1 4 6 4 1] x [1 4 6 4 1] / 256 Gaussian at every second pixel of rows[2], rows[0..4] being the five
+// rows around it with those outside the image clamped to its edge by the caller. sums is scratch space for
+// (src_width + 4) * channels values.
+void gaussianHalveRow(const uint8_t *const rows[5], int src_width, int channels, uint16_t *sums, uint8_t *dst,
+                      SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_DOWNSAMPLE_H
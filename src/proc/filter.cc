@@ -15,6 +15,12 @@
 #include "filter.h"
 
 #include "proc/filter.hpp"
+#include "proc/yuv_decoder.h"
+#include "proc/depth_transform.h"
+#include "proc/point_cloud.h"
+#include "proc/colorizer.h"
+#include "proc/rectify.h"
+#include "proc/pyramid.h"
 #include "core/frame_set.hpp"
 
 #include <utility>
@@ -23,11 +29,23 @@ namespace se2 {
 
 Filter::Filter(const std::shared_ptr<SeProcessingBlock> &block, uint32_t queue_size)
     : ProcessingBlock(block), queue_(queue_size) {
-  start(queue_);
+  if (!block_) return;
+  // blocks run on the invoking thread, process() finds the result queued when invoke() returns
+  auto queue = queue_;
+  auto on_frame = [queue](libsmartereye2::FrameHolder frame) mutable {
+    SeFrame *ref = nullptr;
+    std::swap(ref, frame.frame);
+    queue.enqueue(Frame(ref));
+  };
+  block_->block->setOutputCallback(FrameCallbackPtr(
+      new libsmartereye2::InternalFrameCallback<decltype(on_frame)>(on_frame)));
 }
 
 Frame Filter::process(Frame frame) const {
-//  invoke(frame);
+  if (!block_) {
+    throw std::runtime_error("The processing block is not available");
+  }
+  invoke(std::move(frame));
   Frame result_frame;
   if (!queue_.pollForFrame(&result_frame)) {
     throw std::runtime_error("Error occured during execution of the processing block! See the log for more info");
@@ -41,10 +59,10 @@ FrameQueue Filter::getQueue() const {
 
 PointCloud::PointCloud() : Filter(init(), 1) {}
 
-PointCloud::PointCloud(FrameId frame_id, int index)
+PointCloud::PointCloud(FrameId frame_id, int)
     : Filter(init(), 1) {
+  // Gemini streams come one per FrameId, so the index is not needed to pick the texture
   setOption(OptionKey::STREAM_FILTER, static_cast<float>(frame_id));
-  setOption(OptionKey::STREAM_INDEX_FILTER, static_cast<float>(index));
 }
 
 PointCloud::PointCloud(const std::shared_ptr<SeProcessingBlock> &block)
@@ -67,23 +85,29 @@ Points PointCloud::calculate(Frame depth) {
 
 void PointCloud::mapTo(Frame mapped) {
   setOption(OptionKey::STREAM_FILTER, float(mapped.getProfile().frameId()));
-  setOption(OptionKey::STREAM_FORMAT_FILTER, float(mapped.getProfile().format()));
-  setOption(OptionKey::STREAM_INDEX_FILTER, float(mapped.getProfile().index()));
-  process(std::move(mapped));
 }
 
 std::shared_ptr<SeProcessingBlock> PointCloud::init() {
-  // TODO
-  return std::shared_ptr<SeProcessingBlock>();
+  auto block = std::make_shared<libsmartereye2::PointCloudUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
 }
 
 YuvDecoder::YuvDecoder() : Filter(init(), 1) {}
 
+YuvDecoder::YuvDecoder(FrameFormat output_format)
+    : Filter(init(), 1) {
+  setOption(OptionKey::OUTPUT_FORMAT, static_cast<float>(output_format));
+}
+
 YuvDecoder::YuvDecoder(const std::shared_ptr<SeProcessingBlock> &block) : Filter(block, 1) {}
 
+VideoFrame YuvDecoder::decode(Frame frame) const {
+  return VideoFrame(process(std::move(frame)));
+}
+
 std::shared_ptr<SeProcessingBlock> YuvDecoder::init() {
-  // TODO
-  return std::shared_ptr<SeProcessingBlock>();
+  auto block = std::make_shared<libsmartereye2::YuvDecoderUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
 }
 
 UnitsTransform::UnitsTransform()
@@ -93,8 +117,8 @@ UnitsTransform::UnitsTransform(const std::shared_ptr<SeProcessingBlock> &block)
     : Filter(block, 1) {}
 
 std::shared_ptr<SeProcessingBlock> UnitsTransform::init() {
-  // TODO
-  return std::shared_ptr<SeProcessingBlock>();
+  auto block = std::make_shared<libsmartereye2::UnitsTransformUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
 }
 
 Colorizer::Colorizer()
@@ -109,8 +133,8 @@ Colorizer::Colorizer(const std::shared_ptr<SeProcessingBlock> &block)
     : Filter(block, 1) {}
 
 std::shared_ptr<SeProcessingBlock> Colorizer::init() {
-  // TODO
-  return std::shared_ptr<SeProcessingBlock>();
+  auto block = std::make_shared<libsmartereye2::ColorizerUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
 }
 
 VideoFrame Colorizer::colorize(Frame depth) const {
@@ -127,7 +151,56 @@ DisparityTransform::DisparityTransform(Filter filter)
 }
 
 std::shared_ptr<SeProcessingBlock> DisparityTransform::init(bool transform_to_disparity) {
-  return std::shared_ptr<SeProcessingBlock>();
+  auto block = std::make_shared<libsmartereye2::DisparityTransformUnit>(transform_to_disparity);
+  return std::make_shared<SeProcessingBlock>(block);
+}
+
+Rectifier::Rectifier()
+    : Filter(init(), 1) {}
+
+Rectifier::Rectifier(const std::shared_ptr<SeProcessingBlock> &block)
+    : Filter(block, 1) {}
+
+VideoFrame Rectifier::rectify(Frame frame) const {
+  return VideoFrame(process(std::move(frame)));
+}
+
+std::shared_ptr<SeProcessingBlock> Rectifier::init() {
+  auto block = std::make_shared<libsmartereye2::RectifyUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
+}
+
+Pyramid::Pyramid()
+    : Filter(init(), 1) {}
+
+Pyramid::Pyramid(int level, PyramidFilter filter)
+    : Filter(init(), 1) {
+  setOption(OptionKey::PYRAMID_LEVEL, static_cast<float>(level));
+  setOption(OptionKey::PYRAMID_FILTER, static_cast<float>(filter));
+}
+
+Pyramid::Pyramid(const std::shared_ptr<SeProcessingBlock> &block)
+    : Filter(block, 1) {}
+
+VideoFrame Pyramid::downsample(Frame frame) const {
+  return VideoFrame(process(std::move(frame)));
+}
+
+VideoFrame Pyramid::crop(const VideoFrame &frame, int x, int y, int width, int height) const {
+  auto unit = block_ ? std::dynamic_pointer_cast<libsmartereye2::PyramidUnit>(block_->block) : nullptr;
+  if (!unit) {
+    throw std::runtime_error("The processing block is not available");
+  }
+  auto view = frame ? unit->crop(frame.get(), x, y, width, height) : nullptr;
+  if (!view) {
+    throw std::runtime_error("Error occured during execution of the processing block! See the log for more info");
+  }
+  return VideoFrame(Frame(view));
+}
+
+std::shared_ptr<SeProcessingBlock> Pyramid::init() {
+  auto block = std::make_shared<libsmartereye2::PyramidUnit>();
+  return std::make_shared<SeProcessingBlock>(block);
 }
 
 }  // namespace se2
@@ -0,0 +1,226 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "point_cloud.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "reproject.h"
+#include "disparity_unpack.h"
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "concurrency/row_workers.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+PointCloudUnit::PointCloudUnit()
+    : ProcessingBlock("Pointcloud"),
+      texture_stream_(0),
+      decimation_(1),
+      min_distance_(0.f),
+      max_distance_(0.f),
+      threads_(0) {
+  registerOption(OptionKey::STREAM_FILTER, std::make_shared<RangeOption>(
+      OptionRange{0, 4294967295.f, 1, 0},
+      "FrameId of the image points are textured from, 0 for none",
+      [this](float value) { texture_stream_ = static_cast<uint32_t>(value); }));
+  registerOption(OptionKey::DECIMATION, std::make_shared<RangeOption>(
+      OptionRange{1, 8, 1, 1},
+      "One point for every n-th pixel of every n-th row",
+      [this](float value) { decimation_ = static_cast<int>(value); }));
+  registerOption(OptionKey::MIN_DISTANCE, std::make_shared<RangeOption>(
+      OptionRange{0, 1000, 0.1f, 0},
+      "Metres, nearer points are dropped",
+      [this](float value) { min_distance_ = value; }));
+  registerOption(OptionKey::MAX_DISTANCE, std::make_shared<RangeOption>(
+      OptionRange{0, 1000, 0.1f, 0},
+      "Metres, farther points are dropped, 0 for no limit",
+      [this](float value) { max_distance_ = value; }));
+  registerOption(OptionKey::PROCESSING_THREADS, std::make_shared<RangeOption>(
+      OptionRange{0, 64, 1, 0},
+      "Threads one large frame is split across, 0 for every core",
+      [this](float value) { threads_ = static_cast<int>(value); }));
+
+  auto on_frame = [this](FrameHolder frame, SyntheticSourceInterface *source) {
+    auto result = process(std::move(frame), source);
+    if (result) source->frameReady(std::move(result));
+  };
+  setProcessingCallback(FrameProcessorCallbackPtr(
+      new InternalFrameProcessorCallback<decltype(on_frame)>(on_frame)));
+}
+
+FrameHolder PointCloudUnit::process(FrameHolder frame, SyntheticSourceInterface *source) {
+  auto disparityOf = [](FrameInterface *frame) -> VideoFrameData * {
+    auto profile = frame ? frame->getStreamProfile() : nullptr;
+    auto format = profile ? profile->format() : FrameFormat::Any;
+    if (format != FrameFormat::Disparity16 && format != FrameFormat::DisparitySparse && !isPackedDisparity(format)) {
+      return nullptr;
+    }
+    return dynamic_cast<VideoFrameData *>(frame);
+  };
+
+  auto composite = dynamic_cast<CompositeFrameData *>(frame.frame);
+  if (!composite) {
+    auto disparity = disparityOf(frame.frame);
+    auto points = disparity ? reproject(disparity, source) : nullptr;
+    return points ? FrameHolder(points) : std::move(frame);
+  }
+
+  FrameHolder members[kFrameIdSlots + 1];
+  size_t count = 0;
+  FrameInterface *points = nullptr;
+  for (size_t i = 0; i < composite->getFrameCount() && count < kFrameIdSlots; ++i) {
+    auto member = composite->getFrame(i);
+    auto disparity = points ? nullptr : disparityOf(member);
+    if (disparity) points = reproject(disparity, source);
+    member->acquire();
+    members[count++] = FrameHolder(member);
+  }
+  if (!points) return frame;
+  members[count++] = FrameHolder(points);
+
+  auto frameset = source->allocateCompositeFrame(members, count);
+  return frameset ? FrameHolder(frameset) : std::move(frame);
+}
+
+FrameInterface *PointCloudUnit::reproject(VideoFrameData *disparity, SyntheticSourceInterface *source) {
+  auto profile = disparity->getStreamProfile();
+  auto format = profile->format();
+  const auto &intrinsics = profile->getIntrinsics();
+  auto width = disparity->width();
+  auto height = disparity->height();
+  auto stride = disparity->stride() ? disparity->stride() : getStrideByFormat(format, width);
+  if (width <= 0 || height <= 0 || disparity->getFrameDataSize() < static_cast<size_t>(stride) * height) {
+    LOG(WARNING) << "Pointcloud skipped a disparity frame, " << disparity->getFrameDataSize()
+                 << " bytes do not hold " << width << "x" << height;
+    return nullptr;
+  }
+
+  // the calibration may be for another resolution than the disparity's
+  auto scale_x = intrinsics.img_width > 0 ? static_cast<float>(width) / intrinsics.img_width : 1.f;
+  auto scale_y = intrinsics.img_height > 0 ? static_cast<float>(height) / intrinsics.img_height : 1.f;
+  auto cx = intrinsics.optic_center.x * scale_x;
+  auto cy = intrinsics.optic_center.y * scale_y;
+  auto baseline = intrinsics.base_line;
+  Reprojection reprojection{};
+  reprojection.bf = intrinsics.bf_value * scale_x;
+  reprojection.steps = 1.f / DepthFrameData::formatUnits(FrameFormat::Disparity16);
+  reprojection.min_z = min_distance_;
+  reprojection.max_z = max_distance_ > 0.f ? max_distance_.load() : std::numeric_limits<float>::max();
+  if (!(reprojection.bf > 0.f) || !(baseline > 0.f)) {
+    LOG(WARNING) << "Pointcloud skipped a disparity frame, its profile has no calibration";
+    return nullptr;
+  }
+
+  auto step = decimation_.load();
+  auto src = reinterpret_cast<const uint8_t *>(disparity->getFrameData());
+  bool textured = texture_stream_ != 0;
+  if (format == FrameFormat::DisparitySparse) {
+    return reprojectSparse(disparity, src, stride, step, cx, cy, baseline, reprojection, textured, source);
+  }
+
+  auto columns = (width + step - 1) / step;
+  auto rows = (height + step - 1) / step;
+  auto count = static_cast<size_t>(columns) * rows;
+  auto result = source->allocatePoints(nullptr, disparity, count);
+  if (!result) return nullptr;
+
+  auto xyz = reinterpret_cast<float *>(static_cast<PointsData *>(result)->data().data());
+  auto uv = reinterpret_cast<TextureCoordinate *>(xyz + count * 3);
+  std::vector<float> column_offsets(columns);
+  std::vector<float> column_u(columns);
+  for (int i = 0; i < columns; ++i) {
+    column_offsets[i] = (i * step - cx) * baseline;
+    column_u[i] = (i * step + 0.5f) / width;
+  }
+  bool packed = isPackedDisparity(format);
+
+  auto reproject_rows = [&](int begin, int end) {
+    std::vector<uint16_t> unpacked(packed ? width : 0);
+    std::vector<uint16_t> samples(step > 1 ? columns : 0);
+    for (int row = begin; row < end; ++row) {
+      auto y = row * step;
+      auto values = reinterpret_cast<const uint16_t *>(src + static_cast<size_t>(stride) * y);
+      if (packed) {
+        unpackDisparityRow(src + static_cast<size_t>(stride) * y, format, width, unpacked.data());
+        values = unpacked.data();
+      }
+      if (step > 1) {
+        for (int i = 0; i < columns; ++i) samples[i] = values[i * step];
+        values = samples.data();
+      }
+      auto offset = static_cast<size_t>(row) * columns;
+      reprojectRow(values, column_offsets.data(), (y - cy) * baseline, columns, reprojection, xyz + offset * 3);
+
+      auto coordinates = uv + offset;
+      if (!textured) {
+        std::memset(coordinates, 0, sizeof(TextureCoordinate) * columns);
+        continue;
+      }
+      auto v = (y + 0.5f) / height;
+      for (int i = 0; i < columns; ++i) coordinates[i] = TextureCoordinate{column_u[i], v};
+    }
+  };
+  if (width * height < kParallelPixels) {
+    reproject_rows(0, rows);
+  } else {
+    RowWorkers::shared().run(rows, kStripeRows, static_cast<size_t>(threads_.load()), reproject_rows);
+  }
+  return result;
+}
+
+FrameInterface *PointCloudUnit::reprojectSparse(VideoFrameData *disparity, const uint8_t *src, int stride,
+                                                int step, float cx, float cy, float baseline,
+                                                const Reprojection &reprojection, bool textured,
+                                                SyntheticSourceInterface *source) {
+  // only matched pixels become points, the frame is never walked densely again
+  SparseDisparity sparse;
+  compactDisparity(reinterpret_cast<const uint16_t *>(src), stride, disparity->width(), disparity->height(),
+                   &sparse);
+  size_t count = 0;
+  for (int y = 0; y < sparse.height; y += step) {
+    for (auto i = sparse.row_offsets[y]; i < sparse.row_offsets[y + 1]; ++i) {
+      if (sparse.columns[i] % step == 0) ++count;
+    }
+  }
+  auto result = source->allocatePoints(nullptr, disparity, count);
+  if (!result) return nullptr;
+
+  auto xyz = reinterpret_cast<float *>(static_cast<PointsData *>(result)->data().data());
+  auto uv = reinterpret_cast<TextureCoordinate *>(xyz + count * 3);
+  std::vector<uint16_t> values;
+  std::vector<float> column_offsets;
+  size_t offset = 0;
+  for (int y = 0; y < sparse.height; y += step) {
+    values.clear();
+    column_offsets.clear();
+    for (auto i = sparse.row_offsets[y]; i < sparse.row_offsets[y + 1]; ++i) {
+      auto x = sparse.columns[i];
+      if (x % step) continue;
+      uv[offset + values.size()] = textured ? TextureCoordinate{(x + 0.5f) / sparse.width, (y + 0.5f) / sparse.height}
+                                            : TextureCoordinate{0.f, 0.f};
+      values.push_back(sparse.values[i]);
+      column_offsets.push_back((x - cx) * baseline);
+    }
+    reprojectRow(values.data(), column_offsets.data(), (y - cy) * baseline, static_cast<int>(values.size()),
+                 reprojection, xyz + offset * 3);
+    offset += values.size();
+  }
+  return result;
+}
+
+}  // namespace libsmartereye2
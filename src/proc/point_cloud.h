@@ -0,0 +1,56 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_POINT_CLOUD_H
+#define LIBSMARTEREYE2_POINT_CLOUD_H
+
+#include <atomic>
+
+#include "processing.h"
+
+namespace libsmartereye2 {
+
+class VideoFrameData;
+struct Reprojection;
+
+// Reprojects disparity frames straight into points, one per OptionKey::DECIMATION pixels in both
+// directions, with the intrinsics of the disparity stream. A DisparitySparse frame gives only the points
+// of its matched pixels. Points outside MIN_DISTANCE..MAX_DISTANCE and
+// pixels without disparity become (0, 0, 0). With a texture stream set (OptionKey::STREAM_FILTER) every
+// point gets the coordinates of its pixel in the left image, which disparity is registered to.
+// A frameset comes back with the points added.
+class PointCloudUnit : public ProcessingBlock {
+ public:
+  PointCloudUnit();
+
+  static const int kStripeRows = 16;
+  static const int kParallelPixels = 640 * 360;  // smaller frames are reprojected on the calling thread
+
+ private:
+  FrameHolder process(FrameHolder frame, SyntheticSourceInterface *source);
+  FrameInterface *reproject(VideoFrameData *disparity, SyntheticSourceInterface *source);
+  FrameInterface *reprojectSparse(VideoFrameData *disparity, const uint8_t *src, int stride, int step, float cx,
+                                  float cy, float baseline, const Reprojection &reprojection, bool textured,
+                                  SyntheticSourceInterface *source);
+
+  std::atomic<uint32_t> texture_stream_;
+  std::atomic<int> decimation_;
+  std::atomic<float> min_distance_;
+  std::atomic<float> max_distance_;  // 0 for no limit
+  std::atomic<int> threads_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_POINT_CLOUD_H
@@ -23,7 +23,8 @@
 namespace libsmartereye2 {
 
 ProcessingBlock::ProcessingBlock(const std::string &name)
-    : source_wrapper_(frame_source_) {
+    : source_wrapper_(frame_source_),
+      synthetic_source_{&source_wrapper_} {
   registerOption(OptionKey::FRAMES_QUEUE_SIZE, frame_source_.get_published_size_option());
   registerInfo(CameraInfo::CAMERA_INFO_NAME, name);
   frame_source_.init(std::shared_ptr<MetadataParserMap>());
@@ -44,24 +45,21 @@ void ProcessingBlock::invoke(FrameHolder frame) {
   FrameInterface *frame_ptr = nullptr;
   std::swap(frame.frame, frame_ptr);
 
-  if (frame_source_.get_callback() != nullptr) {
-    // if frame callback has registered, only invoke frame callback
-    frame_source_.invoke_callback(FrameHolder(frame_ptr));
-  } else {
-    // handle frame for aggregator
-    try {
-      if (processing_callback_) {
-        auto source = new SeSyntheticSource{&source_wrapper_};
-        processing_callback_->onFrame(frame_ptr, source);
-      }
-    }
-    catch (std::exception const &e) {
-      LOG(ERROR) << "Exception was thrown during user processing callback: " << std::string(e.what());
-    }
-    catch (...) {
-      LOG(ERROR) << "Exception was thrown during user processing callback!";
+  try {
+    if (processing_callback_) {
+      // results leave through getSource().frameReady(), i.e. the output callback
+      processing_callback_->onFrame(frame_ptr, &synthetic_source_);
+    } else {
+      // a block without processing passes frames through
+      frame_source_.invoke_callback(FrameHolder(frame_ptr));
     }
   }
+  catch (std::exception const &e) {
+    LOG(ERROR) << "Exception was thrown during user processing callback: " << std::string(e.what());
+  }
+  catch (...) {
+    LOG(ERROR) << "Exception was thrown during user processing callback!";
+  }
 }
 
 }  // namespace libsmartereye2
@@ -65,6 +65,7 @@ class ProcessingBlock : public ProcessingBlockInterface, public OptionsContainer
   std::mutex mutex_;
   FrameProcessorCallbackPtr processing_callback_;
   SyntheticSource source_wrapper_;
+  SeSyntheticSource synthetic_source_;
 };
 
 template<class T>
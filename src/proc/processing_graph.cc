@@ -0,0 +1,314 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "processing_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+#include "core/frame.hpp"
+
+namespace libsmartereye2 {
+
+// moves the frame into the task itself, so queueing a frame costs no allocation
+struct ProcessingGraph::Invocation {
+  ProcessingGraph *graph;
+  size_t node;
+  FrameHolder frame;
+
+  void operator()() { graph->run(node, std::move(frame)); }
+};
+
+static bool matches(const StreamType &type, FrameId frame_id, FrameFormat format) {
+  return type.frame_id == frame_id && (type.format == FrameFormat::Any || type.format == format);
+}
+
+static bool compatible(const StreamType &output, const StreamType &input) {
+  return output.frame_id == input.frame_id
+      && (output.format == FrameFormat::Any || input.format == FrameFormat::Any || output.format == input.format);
+}
+
+static int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProcessingGraph::ProcessingGraph(size_t workers)
+    : executor_(workers ? workers : std::max(1u, std::thread::hardware_concurrency()),
+                StrandExecutor::kDefaultStrandCapacity, ThreadRole::DISPATCHER, "se2-graph"),
+      running_(false) {
+}
+
+ProcessingGraph::~ProcessingGraph() {
+  stop();
+}
+
+size_t ProcessingGraph::addNode(std::shared_ptr<ProcessingBlockInterface> block, std::vector<StreamType> inputs,
+                                std::vector<StreamType> outputs, uint32_t queue_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    throw std::runtime_error("addNode(...) failed. The processing graph is running!");
+  }
+  if (!block) {
+    throw std::runtime_error("addNode(...) failed. The processing block is not available");
+  }
+  if (inputs.empty()) {
+    throw std::runtime_error("addNode(...) failed. A node needs at least one input");
+  }
+  if (nodes_.size() >= StrandExecutor::kMaxStrands) {
+    throw std::runtime_error(toString() << "addNode(...) failed. A graph holds at most "
+                                        << StrandExecutor::kMaxStrands << " nodes");
+  }
+
+  auto index = nodes_.size();
+  std::unique_ptr<Node> node(new Node);
+  node->name = block->supportsInfo(CameraInfo::CAMERA_INFO_NAME)
+               ? block->getInfo(CameraInfo::CAMERA_INFO_NAME) : std::string(toString() << "node " << index);
+  node->block = std::move(block);
+  node->inputs = std::move(inputs);
+  node->outputs = std::move(outputs);
+  node->queue_size = queue_size;
+  node->run_total_ns = 0;
+  node->run_max_ns = 0;
+  node->mistyped = false;
+  nodes_.push_back(std::move(node));
+
+  // a cycle would feed frames back into the graph forever
+  for (size_t i = 0; i <= index; ++i) {
+    if (feeds(*nodes_[index], *nodes_[i]) && reaches(i, index)) {
+      auto name = nodes_[index]->name;
+      nodes_.pop_back();
+      throw std::runtime_error(toString() << "addNode(...) failed. " << name << " would close a cycle");
+    }
+  }
+  return index;
+}
+
+bool ProcessingGraph::feeds(const Node &from, const Node &to) {
+  for (const auto &output : from.outputs) {
+    for (const auto &input : to.inputs) {
+      if (compatible(output, input)) return true;
+    }
+  }
+  return false;
+}
+
+bool ProcessingGraph::accepts(const Node &node, FrameId frame_id, FrameFormat format) {
+  for (const auto &input : node.inputs) {
+    if (matches(input, frame_id, format)) return true;
+  }
+  return false;
+}
+
+bool ProcessingGraph::reaches(size_t from, size_t to) const {
+  std::vector<bool> visited(nodes_.size(), false);
+  std::vector<size_t> pending{from};
+  while (!pending.empty()) {
+    auto current = pending.back();
+    pending.pop_back();
+    if (current == to) return true;
+    if (visited[current]) continue;
+    visited[current] = true;
+    for (size_t next = 0; next < nodes_.size(); ++next) {
+      if (!visited[next] && feeds(*nodes_[current], *nodes_[next])) pending.push_back(next);
+    }
+  }
+  return false;
+}
+
+void ProcessingGraph::start(FrameCallbackPtr callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) return;
+
+  callback_ = std::move(callback);
+  for (auto &consumers : consumers_) consumers.clear();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    auto node = nodes_[i].get();
+    for (const auto &input : node->inputs) {
+      auto slot = frameIdSlot(input.frame_id);
+      if (slot >= 0 && std::find(consumers_[slot].begin(), consumers_[slot].end(), i) == consumers_[slot].end()) {
+        consumers_[slot].push_back(i);
+      }
+    }
+
+    auto on_output = [this, node](FrameHolder frame) {
+      route(node, std::move(frame));
+    };
+    node->block->setOutputCallback(FrameCallbackPtr(new InternalFrameCallback<decltype(on_output)>(on_output)));
+    executor_.configure(static_cast<uint32_t>(i), OverflowPolicy::DROP_OLDEST, node->queue_size);
+  }
+
+  executor_.start();
+  running_ = true;
+}
+
+void ProcessingGraph::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_) return;
+
+  running_ = false;
+  executor_.stop();
+  for (auto &node : nodes_) {
+    node->block->setOutputCallback(nullptr);
+  }
+}
+
+bool ProcessingGraph::flush(uint32_t timeout_ms) {
+  return executor_.flush(timeout_ms);
+}
+
+void ProcessingGraph::invoke(FrameHolder frame) {
+  if (!running_ || !frame) return;
+  route(nullptr, std::move(frame));
+}
+
+void ProcessingGraph::route(Node *producer, FrameHolder frame) {
+  auto composite = dynamic_cast<CompositeFrameData *>(frame.frame);
+  if (composite) {
+    for (size_t i = 0; i < composite->getFrameCount(); ++i) {
+      auto member = composite->getFrame(i);
+      member->acquire();
+      route(producer, FrameHolder(member));
+    }
+    return;
+  }
+
+  auto profile = frame->getStreamProfile();
+  if (!profile) {
+    deliver(std::move(frame));
+    return;
+  }
+  auto frame_id = profile->frameId();
+  auto format = profile->format();
+
+  if (producer) {
+    bool declared = false;
+    for (const auto &output : producer->outputs) {
+      declared = declared || matches(output, frame_id, format);
+    }
+    if (!declared) {
+      if (!producer->mistyped.exchange(true)) {
+        LOG(WARNING) << producer->name << " output stream " << static_cast<uint32_t>(frame_id) << " format "
+                     << static_cast<int>(format) << " it did not declare, such frames are dropped";
+      }
+      return;
+    }
+  }
+
+  auto slot = frameIdSlot(frame_id);
+  bool consumed = false;
+  if (slot >= 0) {
+    for (auto index : consumers_[slot]) {
+      if (!accepts(*nodes_[index], frame_id, format)) continue;
+      consumed = true;
+      executor_.post(static_cast<uint32_t>(index), Invocation{this, index, frame.clone()});
+    }
+  }
+  if (!consumed) deliver(std::move(frame));
+}
+
+void ProcessingGraph::run(size_t index, FrameHolder frame) {
+  auto &node = *nodes_[index];
+  auto begin = nowNs();
+  node.block->invoke(std::move(frame));
+  auto elapsed = static_cast<uint64_t>(nowNs() - begin);
+
+  // one task per node at a time, no other writer
+  node.run_total_ns.store(node.run_total_ns.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+  if (elapsed > node.run_max_ns.load(std::memory_order_relaxed)) {
+    node.run_max_ns.store(elapsed, std::memory_order_relaxed);
+  }
+}
+
+void ProcessingGraph::deliver(FrameHolder frame) {
+  if (!callback_) return;
+
+  FrameInterface *ref = nullptr;
+  std::swap(frame.frame, ref);
+  try {
+    callback_->onFrame(ref);
+  }
+  catch (const std::exception &e) {
+    LOG(ERROR) << "Exception was thrown during processing graph callback: " << e.what();
+  }
+  catch (...) {
+    LOG(ERROR) << "Exception was thrown during processing graph callback!";
+  }
+}
+
+std::vector<ProcessingNodeStatistics> ProcessingGraph::statistics() const {
+  auto strands = executor_.stats();
+  std::vector<ProcessingNodeStatistics> result;
+  result.reserve(nodes_.size());
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const auto &node = *nodes_[i];
+    ProcessingNodeStatistics statistics{};
+    statistics.name = node.name;
+    for (const auto &strand : strands) {
+      if (strand.key != i) continue;
+      statistics.depth = static_cast<uint32_t>(strand.depth);
+      statistics.processed = strand.delivered;
+      statistics.dropped = strand.dropped;
+      if (strand.delivered) statistics.mean_wait_ms = strand.latency_total_ns / 1e6 / strand.delivered;
+      statistics.max_wait_ms = strand.latency_max_ns / 1e6;
+    }
+    if (statistics.processed) statistics.mean_run_ms = node.run_total_ns / 1e6 / statistics.processed;
+    statistics.max_run_ms = node.run_max_ns / 1e6;
+    result.push_back(statistics);
+  }
+  return result;
+}
+
+}  // namespace libsmartereye2
+
+namespace se2 {
+
+ProcessingGraph::ProcessingGraph(size_t workers)
+    : graph_(std::make_shared<SeProcessingGraph>(
+    SeProcessingGraph{std::make_shared<libsmartereye2::ProcessingGraph>(workers)})) {
+}
+
+size_t ProcessingGraph::addNode(const ProcessingBlock &block, const std::vector<StreamType> &inputs,
+                                const std::vector<StreamType> &outputs, uint32_t queue_size) {
+  auto se_block = block.block_;
+  return graph_->graph->addNode(se_block ? se_block->block : nullptr, inputs, outputs, queue_size);
+}
+
+void ProcessingGraph::start(FrameCallbackPtr callback) {
+  graph_->graph->start(std::move(callback));
+}
+
+void ProcessingGraph::invoke(Frame frame) const {
+  SeFrame *ptr = nullptr;
+  std::swap(frame.frame_ref_, ptr);
+  graph_->graph->invoke(libsmartereye2::FrameHolder(ptr));
+}
+
+bool ProcessingGraph::flush(uint32_t timeout_ms) const {
+  return graph_->graph->flush(timeout_ms);
+}
+
+void ProcessingGraph::stop() {
+  graph_->graph->stop();
+}
+
+std::vector<ProcessingNodeStatistics> ProcessingGraph::statistics() const {
+  return graph_->graph->statistics();
+}
+
+}  // namespace se2
@@ -0,0 +1,84 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_PROCESSING_GRAPH_H
+#define LIBSMARTEREYE2_PROCESSING_GRAPH_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "processing.h"
+#include "core/frame_data.h"
+#include "concurrency/strand_executor.h"
+#include "proc/processing_graph.hpp"
+
+namespace libsmartereye2 {
+
+// Nodes are strands of one StrandExecutor keyed by their index, so a block never runs twice at once
+// while the other nodes keep the remaining workers busy.
+class ProcessingGraph {
+ public:
+  explicit ProcessingGraph(size_t workers);
+  ~ProcessingGraph();
+
+  size_t addNode(std::shared_ptr<ProcessingBlockInterface> block, std::vector<StreamType> inputs,
+                 std::vector<StreamType> outputs, uint32_t queue_size);
+
+  void start(FrameCallbackPtr callback);
+  void invoke(FrameHolder frame);
+  bool flush(uint32_t timeout_ms);
+  void stop();
+
+  std::vector<ProcessingNodeStatistics> statistics() const;
+
+ private:
+  struct Node {
+    std::shared_ptr<ProcessingBlockInterface> block;
+    std::vector<StreamType> inputs;
+    std::vector<StreamType> outputs;
+    uint32_t queue_size;
+    std::string name;
+    std::atomic<uint64_t> run_total_ns;
+    std::atomic<uint64_t> run_max_ns;
+    std::atomic<bool> mistyped;
+  };
+
+  struct Invocation;
+
+  void run(size_t index, FrameHolder frame);
+  void route(Node *producer, FrameHolder frame);
+  void deliver(FrameHolder frame);
+  bool reaches(size_t from, size_t to) const;
+  static bool feeds(const Node &from, const Node &to);
+  static bool accepts(const Node &node, FrameId frame_id, FrameFormat format);
+
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::vector<size_t> consumers_[kFrameIdSlots];  // nodes by FrameId slot of their inputs, fixed while running
+
+  StrandExecutor executor_;
+  FrameCallbackPtr callback_;
+  std::atomic<bool> running_;
+  std::mutex mutex_;
+};
+
+}  // namespace libsmartereye2
+
+struct SeProcessingGraph {
+  std::shared_ptr<libsmartereye2::ProcessingGraph> graph;
+};
+
+#endif //LIBSMARTEREYE2_PROCESSING_GRAPH_H
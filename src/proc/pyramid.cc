@@ -0,0 +1,131 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pyramid.h"
+
+#include <vector>
+
+#include "color_convert.h"
+#include "downsample.h"
+#include "core/frame_data.h"
+#include "proc/filter.hpp"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+namespace {
+
+// derived frame key of the next level, "PYR" and the filter
+const uint64_t kHalfKey = 0x5059520000000000ull;
+
+bool canHalve(FrameFormat format) {
+  return format == FrameFormat::Gray || format == FrameFormat::Color || format == FrameFormat::RGB
+      || format == FrameFormat::RGBA;
+}
+
+}  // namespace
+
+PyramidUnit::PyramidUnit()
+    : StreamConversionUnit("Pyramid", false),
+      level_(1),
+      filter_(static_cast<int>(se2::PyramidFilter::BOX)) {
+  registerOption(OptionKey::PYRAMID_LEVEL, std::make_shared<RangeOption>(
+      OptionRange{1, kMaxLevels, 1, 1},
+      "Times frames are halved in width and height",
+      [this](float value) { level_ = static_cast<int>(value); }));
+  registerOption(OptionKey::PYRAMID_FILTER, std::make_shared<RangeOption>(
+      OptionRange{static_cast<float>(se2::PyramidFilter::BOX), static_cast<float>(se2::PyramidFilter::GAUSSIAN), 1,
+                  static_cast<float>(se2::PyramidFilter::BOX)},
+      "Filter of each halving: 2x2 box or 5x5 Gaussian",
+      [this](float value) { filter_ = static_cast<int>(value); }));
+}
+
+FrameInterface *PyramidUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto profile = frame->getStreamProfile();
+  if (!dynamic_cast<VideoFrameData *>(frame) || !canHalve(profile->format())) return nullptr;
+  return level(frame, level_, filter_, *source);
+}
+
+FrameInterface *PyramidUnit::level(FrameInterface *frame, int level, int filter) {
+  return this->level(frame, level, filter, getSource());
+}
+
+FrameInterface *PyramidUnit::level(FrameInterface *frame, int level, int filter, SyntheticSourceInterface &source) {
+  frame->acquire();
+  FrameHolder current(frame);
+  for (int i = 0; i < level && current; ++i) {
+    auto above = dynamic_cast<VideoFrameData *>(current.frame);
+    if (!above) return nullptr;
+    current = FrameHolder(above->derived(kHalfKey | static_cast<uint64_t>(filter), [this, above, filter, &source]() {
+      return halve(above, filter, source);
+    }));
+  }
+  auto result = current.frame;
+  current.frame = nullptr;
+  return result;
+}
+
+FrameInterface *PyramidUnit::crop(FrameInterface *frame, int x, int y, int width, int height) {
+  auto type = SeExtension::EXTENSION_VIDEO_FRAME;
+  if (dynamic_cast<DisparityData *>(frame)) {
+    type = SeExtension::EXTENSION_DISPARITY_FRAME;
+  } else if (dynamic_cast<DepthFrameData *>(frame)) {
+    type = SeExtension::EXTENSION_DEPTH_FRAME;
+  }
+  return getSource().allocateVideoView(frame, x, y, width, height, type);
+}
+
+FrameInterface *PyramidUnit::halve(VideoFrameData *frame, int filter, SyntheticSourceInterface &source) {
+  auto profile = frame->getStreamProfile();
+  auto format = profile->format();
+  auto channels = colorPixelSize(format);
+  auto width = frame->width();
+  auto height = frame->height();
+  auto src_stride = frame->stride() ? frame->stride() : width * channels;
+  if (width < 2 || height < 2 || frame->getFrameDataSize() < static_cast<size_t>(src_stride) * (height - 1)
+      + width * channels) {
+    LOG(WARNING) << "Pyramid cannot halve a " << width << "x" << height << " frame of stream "
+                 << static_cast<uint32_t>(profile->frameId());
+    return nullptr;
+  }
+
+  auto dst_width = width / 2;
+  auto dst_height = height / 2;
+  auto dst_stride = dst_width * channels;
+  auto result = source.allocateVideoFrame(nullptr, frame, channels * 8, dst_width, dst_height, dst_stride);
+  if (!result) return nullptr;
+
+  auto src = reinterpret_cast<const uint8_t *>(frame->getFrameData());
+  auto dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+  auto row = [src, src_stride, height](int y) {
+    y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+    return src + static_cast<size_t>(src_stride) * y;
+  };
+  bool gaussian = filter == static_cast<int>(se2::PyramidFilter::GAUSSIAN);
+  forRows(dst_width, dst_height, [&](int begin, int end) {
+    std::vector<uint16_t> sums(gaussian ? static_cast<size_t>(width + 4) * channels : 0);
+    for (int y = begin; y < end; ++y) {
+      auto out = dst + static_cast<size_t>(dst_stride) * y;
+      if (!gaussian) {
+        boxHalveRow(row(2 * y), row(2 * y + 1), dst_width, channels, out);
+        continue;
+      }
+      const uint8_t *const rows[5] = {row(2 * y - 2), row(2 * y - 1), row(2 * y), row(2 * y + 1), row(2 * y + 2)};
+      gaussianHalveRow(rows, width, channels, sums.data(), out);
+    }
+  });
+  return result;
+}
+
+}  // namespace libsmartereye2
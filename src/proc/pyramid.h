@@ -0,0 +1,55 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef LIBSMARTEREYE2_PYRAMID_H
+#define LIBSMARTEREYE2_PYRAMID_H
+
+#include <atomic>
+
+#include "stream_conversion.h"
+
+namespace libsmartereye2 {
+
+class VideoFrameData;
+
+// Halves Gray, Color, RGB and RGBA frames OptionKey::PYRAMID_LEVEL times with a 2x2 box or a 5x5 Gaussian
+// (OptionKey::PYRAMID_FILTER). Each level is derived from the one above and cached on it, so every block
+// and every thread asking for a level of the same frame shares one computation; the whole result is not
+// cached again.
+class PyramidUnit : public StreamConversionUnit {
+ public:
+  PyramidUnit();
+
+  static const int kMaxLevels = 8;
+
+  // level of frame with a se2::PyramidFilter, acquired; nullptr when the frame cannot be halved
+  FrameInterface *level(FrameInterface *frame, int level, int filter);
+
+  // the width x height region at (x, y) of frame without copying it, acquired; nullptr when it is not inside
+  FrameInterface *crop(FrameInterface *frame, int x, int y, int width, int height);
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+
+ private:
+  // level() with the frames made by source
+  FrameInterface *level(FrameInterface *frame, int level, int filter, SyntheticSourceInterface &source);
+  FrameInterface *halve(VideoFrameData *frame, int filter, SyntheticSourceInterface &source);
+
+  std::atomic<int> level_;
+  std::atomic<int> filter_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_PYRAMID_H
@@ -0,0 +1,178 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "rectify.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "color_convert.h"
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+RectifyUnit::RectifyUnit()
+    : StreamConversionUnit("Rectify") {
+  // Calib* frames come rectified from the device
+  getOption(OptionKey::STREAM_FILTER).set(static_cast<float>(FrameId::LeftCamera | FrameId::RightCamera));
+}
+
+FrameInterface *RectifyUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto video = dynamic_cast<VideoFrameData *>(frame);
+  auto profile = frame ? frame->getStreamProfile() : nullptr;
+  if (!video || !profile) return nullptr;
+
+  auto format = profile->format();
+  if (format != FrameFormat::Gray && format != FrameFormat::Color && format != FrameFormat::RGB
+      && format != FrameFormat::RGBA) {
+    return nullptr;
+  }
+
+  auto pixel_size = colorPixelSize(format);
+  auto width = video->width();
+  auto height = video->height();
+  auto src_stride = video->stride() ? video->stride() : width * pixel_size;
+  auto src_size = video->getFrameDataSize();
+  if (width < 2 || height < 2 || src_size < static_cast<size_t>(src_stride) * (height - 1) + width * pixel_size) {
+    LOG(WARNING) << "Rectify skipped a frame of stream " << static_cast<uint32_t>(profile->frameId()) << ", "
+                 << src_size << " bytes do not hold " << width << "x" << height;
+    return nullptr;
+  }
+
+  std::shared_ptr<StreamProfileInterface> output;
+  auto table = rectification(frame, width, height, src_stride, pixel_size, &output);
+  if (!table) return nullptr;
+
+  auto dst_stride = width * pixel_size;
+  auto result = source->allocateVideoFrame(output, frame, pixel_size * 8, width, height, dst_stride);
+  if (!result) return nullptr;
+
+  auto src = reinterpret_cast<const uint8_t *>(video->getFrameData());
+  auto dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+  forRows(width, height, [&](int begin, int end) {
+    for (int row = begin; row < end; ++row) {
+      remapRow(src, src_size, src_stride, pixel_size, *table, row, dst + static_cast<size_t>(dst_stride) * row);
+    }
+  });
+  return result;
+}
+
+std::shared_ptr<const RemapTable> RectifyUnit::rectification(FrameInterface *frame, int width, int height,
+                                                             int stride, int pixel_size,
+                                                             std::shared_ptr<StreamProfileInterface> *output) {
+  auto input = frame->getStreamProfile();
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto &intrinsics = input->getIntrinsics();
+  const auto &extrinsics = input->getExtrinsics();
+  auto &entry = rectifications_[input];
+  if (entry.profile && !entry.input.expired() && entry.width == width && entry.height == height && entry.stride == stride
+      && std::memcmp(&entry.intrinsics, &intrinsics, sizeof(Intrinsics)) == 0
+      && std::memcmp(&entry.extrinsics, &extrinsics, sizeof(Extrinsics)) == 0) {
+    *output = entry.profile;
+    return entry.table;
+  }
+
+  // first frame, a new profile at the address of one gone, or the device reported its calibration
+  // since the table was built; frames rectified before keep the profile they were given, so this one
+  // is a fresh clone rather than an update
+  entry.input = shareProfile(frame);
+  for (auto it = rectifications_.begin(); it != rectifications_.end();) {
+    it = it->second.input.expired() && &it->second != &entry ? rectifications_.erase(it) : std::next(it);
+  }
+  entry.intrinsics = intrinsics;
+  entry.extrinsics = extrinsics;
+  entry.width = width;
+  entry.height = height;
+  entry.stride = stride;
+  entry.table = buildTable(intrinsics, extrinsics, width, height, stride, pixel_size);
+  if (!entry.table) {
+    LOG(WARNING) << "Rectify passes stream " << static_cast<uint32_t>(input->frameId())
+                 << " through, its profile has no calibration";
+  }
+
+  auto rectified = intrinsics;
+  rectified.optic_center = opense::Point2i(intrinsics.img_width / 2, intrinsics.img_height / 2);
+  auto levelled = extrinsics;
+  levelled.rotation = opense::Point3f();
+  entry.profile = input->clone();
+  entry.profile->setIntrinsics(rectified);
+  entry.profile->setExtrinsics(levelled);
+  *output = entry.profile;
+  return entry.table;
+}
+
+std::shared_ptr<const RemapTable> RectifyUnit::buildTable(const Intrinsics &intrinsics, const Extrinsics &extrinsics,
+                                                          int width, int height, int stride, int pixel_size) const {
+  float focal = 0.f;
+  if (intrinsics.bf_value > 0.f && intrinsics.base_line > 0.f) {
+    focal = intrinsics.bf_value / intrinsics.base_line;
+  } else if (intrinsics.lens_focus > 0.f && intrinsics.pixel_size > 0.f) {
+    focal = intrinsics.lens_focus / intrinsics.pixel_size;
+  }
+  if (!(focal > 0.f) || intrinsics.img_width <= 0 || intrinsics.img_height <= 0) return nullptr;
+
+  // the calibration may be for another resolution than the frames'
+  auto scale_x = static_cast<float>(width) / intrinsics.img_width;
+  auto scale_y = static_cast<float>(height) / intrinsics.img_height;
+  auto fx = focal * scale_x;
+  auto fy = focal * scale_y;
+  auto cx = intrinsics.optic_center.x * scale_x;
+  auto cy = intrinsics.optic_center.y * scale_y;
+  auto ideal_cx = static_cast<float>(intrinsics.img_width / 2) * scale_x;
+  auto ideal_cy = static_cast<float>(intrinsics.img_height / 2) * scale_y;
+
+  // R = Rz(roll) Ry(yaw) Rx(pitch) turns the vehicle's axes into the camera's, radians; a ray d of the
+  // rectified camera is R^T d in the raw one
+  float r[3][3] = {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}};
+  if (extrinsics.is_valid) {
+    auto sin_p = std::sin(extrinsics.rotation.x), cos_p = std::cos(extrinsics.rotation.x);
+    auto sin_y = std::sin(extrinsics.rotation.y), cos_y = std::cos(extrinsics.rotation.y);
+    auto sin_r = std::sin(extrinsics.rotation.z), cos_r = std::cos(extrinsics.rotation.z);
+    float rotation[3][3] = {
+        {cos_r * cos_y, cos_r * sin_y * sin_p - sin_r * cos_p, cos_r * sin_y * cos_p + sin_r * sin_p},
+        {sin_r * cos_y, sin_r * sin_y * sin_p + cos_r * cos_p, sin_r * sin_y * cos_p - cos_r * sin_p},
+        {-sin_y, cos_y * sin_p, cos_y * cos_p},
+    };
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) r[i][j] = rotation[j][i];
+    }
+  }
+
+  auto table = std::make_shared<RemapTable>();
+  table->width = width;
+  table->height = height;
+  table->offsets.resize(static_cast<size_t>(width) * height);
+  table->weights.resize(static_cast<size_t>(width) * height);
+  forRows(width, height, [&](int begin, int end) {
+    for (int v = begin; v < end; ++v) {
+      auto dy = (v - ideal_cy) / fy;
+      for (int u = 0; u < width; ++u) {
+        auto dx = (u - ideal_cx) / fx;
+        auto x = r[0][0] * dx + r[0][1] * dy + r[0][2];
+        auto y = r[1][0] * dx + r[1][1] * dy + r[1][2];
+        auto z = r[2][0] * dx + r[2][1] * dy + r[2][2];
+        auto i = static_cast<size_t>(width) * v + u;
+        if (z <= 0.f) {
+          setRemapEntry(*table, i, -1.f, -1.f, width, height, stride, pixel_size);
+        } else {
+          setRemapEntry(*table, i, fx * x / z + cx, fy * y / z + cy, width, height, stride, pixel_size);
+        }
+      }
+    }
+  });
+  return table;
+}
+
+}  // namespace libsmartereye2
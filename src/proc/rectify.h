@@ -0,0 +1,67 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef LIBSMARTEREYE2_RECTIFY_H
+#define LIBSMARTEREYE2_RECTIFY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "remap.h"
+#include "stream_conversion.h"
+#include "device/device_types.hpp"
+
+namespace libsmartereye2 {
+
+using se2::Intrinsics;
+using se2::Extrinsics;
+
+// Remaps raw camera frames (LeftCamera and RightCamera unless OptionKey::STREAM_FILTER says otherwise) of
+// Gray, Color, RGB or RGBA into an ideal pinhole camera with the same focal length, the optical centre in
+// the middle of the image and the axes of the vehicle. The tables are built from the intrinsics and
+// extrinsics of the stream and rebuilt only when the device reports new ones.
+class RectifyUnit : public StreamConversionUnit {
+ public:
+  RectifyUnit();
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+
+ private:
+  struct Rectification {
+    // of the input when the table was built
+    Intrinsics intrinsics;
+    Extrinsics extrinsics;
+    int width;
+    int height;
+    int stride;
+    std::shared_ptr<const RemapTable> table;  // nullptr while the stream has no calibration
+    std::shared_ptr<StreamProfileInterface> profile;
+    std::weak_ptr<StreamProfileInterface> input;  // expired once the address may name another profile
+  };
+
+  // the table for frames of frame's stream, and in output the profile rectified frames point at
+  std::shared_ptr<const RemapTable> rectification(FrameInterface *frame, int width, int height,
+                                                  int stride, int pixel_size,
+                                                  std::shared_ptr<StreamProfileInterface> *output);
+  std::shared_ptr<const RemapTable> buildTable(const Intrinsics &intrinsics, const Extrinsics &extrinsics,
+                                               int width, int height, int stride, int pixel_size) const;
+
+  std::mutex mutex_;
+  std::map<const StreamProfileInterface *, Rectification> rectifications_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_RECTIFY_H
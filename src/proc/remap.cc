@@ -0,0 +1,193 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "remap.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+const int32_t kRemapRound = 1 << (kRemapWeightBits - 1);
+
+// four int16 weights per entry: top left, top right, bottom left, bottom right
+std::vector<int16_t> makeWeights() {
+  const int shift = kRemapWeightBits - 2 * kRemapFractionBits;
+  std::vector<int16_t> weights(4 * (kRemapOutside + 1), 0);
+  for (int fy = 0; fy <= kRemapFractions; ++fy) {
+    for (int fx = 0; fx <= kRemapFractions; ++fx) {
+      auto entry = weights.data() + 4 * (fy * (kRemapFractions + 1) + fx);
+      entry[0] = static_cast<int16_t>((kRemapFractions - fx) * (kRemapFractions - fy) << shift);
+      entry[1] = static_cast<int16_t>(fx * (kRemapFractions - fy) << shift);
+      entry[2] = static_cast<int16_t>((kRemapFractions - fx) * fy << shift);
+      entry[3] = static_cast<int16_t>(fx * fy << shift);
+    }
+  }
+  return weights;
+}
+
+const int16_t *remapWeights() {
+  static const std::vector<int16_t> weights = makeWeights();
+  return weights.data();
+}
+
+void remapPixels(const uint8_t *src, int src_stride, int pixel_size, const int32_t *offsets,
+                 const uint16_t *weights, int begin, int end, uint8_t *dst) {
+  auto table = remapWeights();
+  for (int x = begin; x < end; ++x) {
+    auto top = src + offsets[x];
+    auto bottom = top + src_stride;
+    auto w = table + 4 * weights[x];
+    auto out = dst + x * pixel_size;
+    for (int c = 0; c < pixel_size; ++c) {
+      int32_t sum = top[c] * w[0] + top[pixel_size + c] * w[1] + bottom[c] * w[2] + bottom[pixel_size + c] * w[3];
+      out[c] = static_cast<uint8_t>((sum + kRemapRound) >> kRemapWeightBits);
+    }
+  }
+}
+
+#if defined(SE2_SIMD_X86)
+
+// one byte pixels; the loads are scalar, the weighting is two pmaddwd per four pixels
+SE2_TARGET_SSE2 int remapGraySse2(const uint8_t *src, int src_stride, const int32_t *offsets,
+                                  const uint16_t *weights, int width, uint8_t *dst) {
+  auto table = reinterpret_cast<const int32_t *>(remapWeights());
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(kRemapRound);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16_t top[8], bottom[8];
+    int32_t top_weights[8], bottom_weights[8];
+    for (int i = 0; i < 8; ++i) {
+      std::memcpy(&top[i], src + offsets[x + i], sizeof(uint16_t));
+      std::memcpy(&bottom[i], src + offsets[x + i] + src_stride, sizeof(uint16_t));
+      top_weights[i] = table[2 * weights[x + i]];
+      bottom_weights[i] = table[2 * weights[x + i] + 1];
+    }
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom));
+    __m128i lo = _mm_add_epi32(
+        _mm_madd_epi16(_mm_unpacklo_epi8(t, zero), _mm_loadu_si128(reinterpret_cast<const __m128i *>(top_weights))),
+        _mm_madd_epi16(_mm_unpacklo_epi8(b, zero),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom_weights))));
+    __m128i hi = _mm_add_epi32(
+        _mm_madd_epi16(_mm_unpackhi_epi8(t, zero),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(top_weights + 4))),
+        _mm_madd_epi16(_mm_unpackhi_epi8(b, zero),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom_weights + 4))));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kRemapWeightBits);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kRemapWeightBits);
+    __m128i words = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(words, words));
+  }
+  return x;
+}
+
+// one byte pixels; gathers 4 bytes for each pair of neighbours, so a block that could read past src_size
+// is left to the scalar code
+SE2_TARGET_AVX2 int remapGrayAvx2(const uint8_t *src, size_t src_size, int src_stride, const int32_t *offsets,
+                                  const uint16_t *weights, int width, uint8_t *dst) {
+  if (src_size < static_cast<size_t>(src_stride) + 4) return 0;
+  auto table = reinterpret_cast<const int *>(remapWeights());
+  auto limit = src_size - src_stride - 4;
+  const __m256i last = _mm256_set1_epi32(static_cast<int>(
+      limit < static_cast<size_t>(std::numeric_limits<int>::max()) ? limit : std::numeric_limits<int>::max()));
+  // bytes 0 and 1 of every dword into the low bytes of its two words
+  const __m256i pairs = _mm256_setr_epi8(0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1,
+                                         0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1);
+  const __m256i round = _mm256_set1_epi32(kRemapRound);
+  auto base = reinterpret_cast<const int *>(src);
+  auto below = reinterpret_cast<const int *>(src + src_stride);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i offset = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets + x));
+    if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(offset, last))) {
+      remapPixels(src, src_stride, 1, offsets, weights, x, x + 8, dst);
+      continue;
+    }
+    __m256i index = _mm256_slli_epi32(
+        _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + x))), 1);
+    __m256i t = _mm256_shuffle_epi8(_mm256_i32gather_epi32(base, offset, 1), pairs);
+    __m256i b = _mm256_shuffle_epi8(_mm256_i32gather_epi32(below, offset, 1), pairs);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(t, _mm256_i32gather_epi32(table, index, 4)),
+                                   _mm256_madd_epi16(b, _mm256_i32gather_epi32(table + 1, index, 4)));
+    sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), kRemapWeightBits);
+    __m256i words = _mm256_packs_epi32(sum, sum);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    int32_t lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+    int32_t hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+    std::memcpy(dst + x, &lo, sizeof(lo));
+    std::memcpy(dst + x + 4, &hi, sizeof(hi));
+  }
+  return x;
+}
+
+#endif  // SE2_SIMD_X86
+
+}  // namespace
+
+void setRemapEntry(RemapTable &table, size_t i, float x, float y, int src_width, int src_height, int src_stride,
+                   int pixel_size) {
+  long fixed_x = -1;
+  long fixed_y = -1;
+  if (x >= 0.f && y >= 0.f && x <= src_width && y <= src_height) {
+    fixed_x = std::lround(x * kRemapFractions);
+    fixed_y = std::lround(y * kRemapFractions);
+  }
+  if (fixed_x < 0 || fixed_y < 0 || fixed_x > static_cast<long>(src_width - 1) * kRemapFractions
+      || fixed_y > static_cast<long>(src_height - 1) * kRemapFractions) {
+    table.offsets[i] = 0;
+    table.weights[i] = kRemapOutside;
+    return;
+  }
+
+  auto x0 = static_cast<int>(fixed_x >> kRemapFractionBits);
+  auto y0 = static_cast<int>(fixed_y >> kRemapFractionBits);
+  auto fx = static_cast<int>(fixed_x & (kRemapFractions - 1));
+  auto fy = static_cast<int>(fixed_y & (kRemapFractions - 1));
+  // the last column and row are reached from the one before, so that no neighbour lies outside
+  if (x0 == src_width - 1) {
+    --x0;
+    fx = kRemapFractions;
+  }
+  if (y0 == src_height - 1) {
+    --y0;
+    fy = kRemapFractions;
+  }
+  table.offsets[i] = y0 * src_stride + x0 * pixel_size;
+  table.weights[i] = static_cast<uint16_t>(fy * (kRemapFractions + 1) + fx);
+}
+
+void remapRow(const uint8_t *src, size_t src_size, int src_stride, int pixel_size, const RemapTable &table,
+              int row, uint8_t *dst, SimdLevel level) {
+  auto offsets = table.offsets.data() + static_cast<size_t>(table.width) * row;
+  auto weights = table.weights.data() + static_cast<size_t>(table.width) * row;
+  int x = 0;
+#if defined(SE2_SIMD_X86)
+  if (pixel_size == 1 && level == SimdLevel::AVX2) {
+    x = remapGrayAvx2(src, src_size, src_stride, offsets, weights, table.width, dst);
+  } else if (pixel_size == 1 && level == SimdLevel::SSE2) {
+    x = remapGraySse2(src, src_stride, offsets, weights, table.width, dst);
+  }
+#endif
+  remapPixels(src, src_stride, pixel_size, offsets, weights, x, table.width, dst);
+}
+
+}  // namespace libsmartereye2
@@ -0,0 +1,54 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef LIBSMARTEREYE2_REMAP_H
+#define LIBSMARTEREYE2_REMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+
+namespace libsmartereye2 {
+
+// Source positions are rounded to 1 / kRemapFractions of a pixel, bilinear weights sum to 1 << kRemapWeightBits
+const int kRemapFractionBits = 5;
+const int kRemapFractions = 1 << kRemapFractionBits;
+const int kRemapWeightBits = 14;
+// weight index of output pixels that fall outside the source, all four of its weights are 0
+const int kRemapOutside = (kRemapFractions + 1) * (kRemapFractions + 1);
+
+// Fixed-point lookup from the pixels of a width x height output to a source image: per output pixel the
+// byte offset of the top left of its 2x2 source neighbourhood and the index of its weights. Built once
+// per calibration, applied to every frame.
+struct RemapTable {
+  int width = 0;
+  int height = 0;
+  std::vector<int32_t> offsets;
+  std::vector<uint16_t> weights;
+};
+
+// Fills entry i of table from source position (x, y) of a src_width x src_height source with at least
+// two rows and columns; positions outside it map to kRemapOutside.
+void setRemapEntry(RemapTable &table, size_t i, float x, float y, int src_width, int src_height, int src_stride,
+                   int pixel_size);
+
+// Row row of table from src, pixel_size bytes per pixel with one byte per channel. src_size bounds what
+// the kernels may read. Every level produces the same pixels.
+void remapRow(const uint8_t *src, size_t src_size, int src_stride, int pixel_size, const RemapTable &table,
+              int row, uint8_t *dst, SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_REMAP_H
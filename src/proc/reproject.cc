@@ -0,0 +1,144 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reproject.h"
+
+#include "depth_convert.h"
+
+#if defined(SE2_SIMD_X86)
+#include <immintrin.h>
+#elif defined(SE2_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libsmartereye2 {
+
+namespace {
+
+#if defined(SE2_SIMD_X86)
+
+// x0..3, y0..3, z0..3 into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+SE2_TARGET_SSE2 inline void storeXyzSse2(float *xyz, __m128 x, __m128 y, __m128 z) {
+  __m128 xy_lo = _mm_unpacklo_ps(x, y);
+  __m128 xy_hi = _mm_unpackhi_ps(x, y);
+  __m128 z0x1 = _mm_shuffle_ps(z, xy_lo, _MM_SHUFFLE(2, 2, 0, 0));
+  __m128 y1z1 = _mm_shuffle_ps(xy_lo, z, _MM_SHUFFLE(1, 1, 3, 3));
+  __m128 z2x3 = _mm_shuffle_ps(z, xy_hi, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 y3z3 = _mm_shuffle_ps(xy_hi, z, _MM_SHUFFLE(3, 3, 3, 3));
+  _mm_storeu_ps(xyz, _mm_shuffle_ps(xy_lo, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(xyz + 4, _mm_shuffle_ps(y1z1, xy_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(xyz + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+SE2_TARGET_SSE2 int reprojectRowSse2(const uint16_t *disparity, const float *column_offsets, float row_offset,
+                                     int count, const Reprojection &r, float *xyz) {
+  const float *table = reciprocalTable();
+  const __m128 steps = _mm_set1_ps(r.steps);
+  const __m128 bf = _mm_set1_ps(r.bf);
+  const __m128 row = _mm_set1_ps(row_offset);
+  const __m128 min_z = _mm_set1_ps(r.min_z);
+  const __m128 max_z = _mm_set1_ps(r.max_z);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const uint16_t *d = disparity + i;
+    __m128 inverse = _mm_mul_ps(_mm_setr_ps(table[d[0]], table[d[1]], table[d[2]], table[d[3]]), steps);
+    __m128 z = _mm_mul_ps(bf, inverse);
+    __m128 keep = _mm_and_ps(_mm_cmpge_ps(z, min_z), _mm_cmple_ps(z, max_z));
+    __m128 x = _mm_and_ps(_mm_mul_ps(_mm_loadu_ps(column_offsets + i), inverse), keep);
+    __m128 y = _mm_and_ps(_mm_mul_ps(row, inverse), keep);
+    storeXyzSse2(xyz + i * 3, x, y, _mm_and_ps(z, keep));
+  }
+  return i;
+}
+
+SE2_TARGET_AVX2 int reprojectRowAvx2(const uint16_t *disparity, const float *column_offsets, float row_offset,
+                                     int count, const Reprojection &r, float *xyz) {
+  const float *table = reciprocalTable();
+  const __m256 steps = _mm256_set1_ps(r.steps);
+  const __m256 bf = _mm256_set1_ps(r.bf);
+  const __m256 row = _mm256_set1_ps(row_offset);
+  const __m256 min_z = _mm256_set1_ps(r.min_z);
+  const __m256 max_z = _mm256_set1_ps(r.max_z);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(disparity + i)));
+    __m256 inverse = _mm256_mul_ps(_mm256_i32gather_ps(table, index, 4), steps);
+    __m256 z = _mm256_mul_ps(bf, inverse);
+    __m256 keep = _mm256_and_ps(_mm256_cmp_ps(z, min_z, _CMP_GE_OQ), _mm256_cmp_ps(z, max_z, _CMP_LE_OQ));
+    __m256 x = _mm256_and_ps(_mm256_mul_ps(_mm256_loadu_ps(column_offsets + i), inverse), keep);
+    __m256 y = _mm256_and_ps(_mm256_mul_ps(row, inverse), keep);
+    z = _mm256_and_ps(z, keep);
+    storeXyzSse2(xyz + i * 3, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z));
+    storeXyzSse2(xyz + i * 3 + 12, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+                 _mm256_extractf128_ps(z, 1));
+  }
+  return i;
+}
+
+#endif  // SE2_SIMD_X86
+
+#if defined(SE2_SIMD_NEON)
+
+int reprojectRowNeon(const uint16_t *disparity, const float *column_offsets, float row_offset,
+                     int count, const Reprojection &r, float *xyz) {
+  const float *table = reciprocalTable();
+  const float32x4_t min_z = vdupq_n_f32(r.min_z);
+  const float32x4_t max_z = vdupq_n_f32(r.max_z);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const uint16_t *d = disparity + i;
+    float values[4] = {table[d[0]], table[d[1]], table[d[2]], table[d[3]]};
+    float32x4_t inverse = vmulq_n_f32(vld1q_f32(values), r.steps);
+    float32x4_t z = vmulq_n_f32(inverse, r.bf);
+    uint32x4_t keep = vandq_u32(vcgeq_f32(z, min_z), vcleq_f32(z, max_z));
+    float32x4x3_t points;
+    points.val[0] = vreinterpretq_f32_u32(vandq_u32(
+        vreinterpretq_u32_f32(vmulq_f32(vld1q_f32(column_offsets + i), inverse)), keep));
+    points.val[1] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_n_f32(inverse, row_offset)), keep));
+    points.val[2] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(z), keep));
+    vst3q_f32(xyz + i * 3, points);
+  }
+  return i;
+}
+
+#endif  // SE2_SIMD_NEON
+
+}  // namespace
+
+void reprojectRow(const uint16_t *disparity, const float *column_offsets, float row_offset, int count,
+                  const Reprojection &reprojection, float *xyz, SimdLevel level) {
+  int i = 0;
+#if defined(SE2_SIMD_X86)
+  if (level == SimdLevel::AVX2) {
+    i = reprojectRowAvx2(disparity, column_offsets, row_offset, count, reprojection, xyz);
+  } else if (level == SimdLevel::SSE2) {
+    i = reprojectRowSse2(disparity, column_offsets, row_offset, count, reprojection, xyz);
+  }
+#elif defined(SE2_SIMD_NEON)
+  if (level == SimdLevel::NEON) {
+    i = reprojectRowNeon(disparity, column_offsets, row_offset, count, reprojection, xyz);
+  }
+#endif
+  const float *table = reciprocalTable();
+  for (; i < count; ++i) {
+    float inverse = table[disparity[i]] * reprojection.steps;
+    float z = reprojection.bf * inverse;
+    bool keep = z >= reprojection.min_z && z <= reprojection.max_z;
+    xyz[i * 3] = keep ? column_offsets[i] * inverse : 0.f;
+    xyz[i * 3 + 1] = keep ? row_offset * inverse : 0.f;
+    xyz[i * 3 + 2] = keep ? z : 0.f;
+  }
+}
+
+}  // namespace libsmartereye2
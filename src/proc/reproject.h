@@ -0,0 +1,40 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_REPROJECT_H
+#define LIBSMARTEREYE2_REPROJECT_H
+
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace libsmartereye2 {
+
+// Stereo reprojection of a disparity d in pixels: z = bf / d, x = (u - cx) * baseline / d and
+// y = (v - cy) * baseline / d.
+struct Reprojection {
+  float bf;          // baseline times focal length, metres * pixels
+  float steps;       // disparity values per pixel
+  float min_z;       // points nearer or farther than these are zeroed, metres
+  float max_z;
+};
+
+// Reprojects one row of disparity values into count x, y, z triples. column_offsets[i] is (u - cx) *
+// baseline of value i and row_offset (v - cy) * baseline. Every level produces the same values.
+void reprojectRow(const uint16_t *disparity, const float *column_offsets, float row_offset, int count,
+                  const Reprojection &reprojection, float *xyz, SimdLevel level = simdLevel());
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_REPROJECT_H
@@ -0,0 +1,152 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream_conversion.h"
+
+#include <cstring>
+
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "concurrency/row_workers.h"
+
+namespace libsmartereye2 {
+
+namespace {
+
+const uint64_t kFnvOffset = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * kFnvPrime;
+  return hash;
+}
+
+}  // namespace
+
+StreamConversionUnit::StreamConversionUnit(const std::string &name, bool memoise)
+    : ProcessingBlock(name),
+      name_(name),
+      memoise_(memoise),
+      threads_(0),
+      streams_(0) {
+  registerOption(OptionKey::PROCESSING_THREADS, std::make_shared<RangeOption>(
+      OptionRange{0, 64, 1, 0},
+      "Threads one large frame is split across, 0 for every core",
+      [this](float value) { threads_ = static_cast<int>(value); }));
+  registerOption(OptionKey::STREAM_FILTER, std::make_shared<RangeOption>(
+      OptionRange{0, 4294967295.f, 1, 0},
+      "FrameId bits of the streams to convert, 0 for every stream",
+      [this](float value) { streams_ = static_cast<uint32_t>(value); }));
+
+  auto on_frame = [this](FrameHolder frame, SyntheticSourceInterface *source) {
+    auto result = process(std::move(frame), source);
+    if (result) source->frameReady(std::move(result));
+  };
+  setProcessingCallback(FrameProcessorCallbackPtr(
+      new InternalFrameProcessorCallback<decltype(on_frame)>(on_frame)));
+}
+
+FrameHolder StreamConversionUnit::process(FrameHolder frame, SyntheticSourceInterface *source) {
+  auto streams = streams_.load();
+  auto wanted = [streams](FrameInterface *frame) {
+    auto profile = frame->getStreamProfile();
+    return profile && (!streams || (streams & static_cast<uint32_t>(profile->frameId())));
+  };
+
+  auto key = memoise_ ? derivedKey() : 0;
+  auto composite = dynamic_cast<CompositeFrameData *>(frame.frame);
+  if (!composite) {
+    auto converted = frame && wanted(frame.frame) ? convertShared(frame.frame, source, key) : nullptr;
+    return converted ? FrameHolder(converted) : std::move(frame);
+  }
+
+  FrameHolder members[kFrameIdSlots];
+  size_t count = 0;
+  bool changed = false;
+  for (size_t i = 0; i < composite->getFrameCount() && count < kFrameIdSlots; ++i) {
+    auto member = composite->getFrame(i);
+    auto converted = wanted(member) ? convertShared(member, source, key) : nullptr;
+    if (converted) {
+      members[count++] = FrameHolder(converted);
+      changed = true;
+    } else {
+      member->acquire();
+      members[count++] = FrameHolder(member);
+    }
+  }
+  if (!changed) return frame;
+
+  auto frameset = source->allocateCompositeFrame(members, count);
+  return frameset ? FrameHolder(frameset) : std::move(frame);
+}
+
+FrameInterface *StreamConversionUnit::convertShared(FrameInterface *frame, SyntheticSourceInterface *source,
+                                                    uint64_t key) {
+  auto data = memoise_ ? dynamic_cast<FrameData *>(frame) : nullptr;
+  if (!data) return convert(frame, source);
+  return data->derived(key, [this, frame, source]() { return convert(frame, source); });
+}
+
+uint64_t StreamConversionUnit::derivedKey() const {
+  auto hash = fnv1a(kFnvOffset, name_.data(), name_.size());
+  for (const auto &kvp : _options) {
+    if (kvp.first == OptionKey::PROCESSING_THREADS || kvp.first == OptionKey::STREAM_FILTER
+        || kvp.first == OptionKey::FRAMES_QUEUE_SIZE) {
+      continue;
+    }
+    auto id = static_cast<int32_t>(kvp.first);
+    auto value = kvp.second->query();
+    hash = fnv1a(hash, &id, sizeof(id));
+    hash = fnv1a(hash, &value, sizeof(value));
+  }
+  return hash;
+}
+
+std::shared_ptr<StreamProfileInterface> StreamConversionUnit::outputProfile(FrameInterface *frame,
+                                                                            FrameFormat format) {
+  auto input = frame->getStreamProfile();
+  std::lock_guard<std::mutex> lock(profiles_mutex_);
+  auto &entry = profiles_[std::make_pair(input, format)];
+  if (entry.profile && !entry.input.expired()
+      && std::memcmp(&entry.profile->getIntrinsics(), &input->getIntrinsics(), sizeof(Intrinsics)) == 0) {
+    return entry.profile;
+  }
+
+  // first frame of the stream, a new profile at the address of one gone, or the device reported its
+  // calibration since; frames converted before keep the profile they were given
+  entry.input = shareProfile(frame);
+  entry.profile = input->clone();
+  entry.profile->setFormat(format);
+  for (auto it = profiles_.begin(); it != profiles_.end();) {
+    it = it->second.input.expired() && &it->second != &entry ? profiles_.erase(it) : std::next(it);
+  }
+  return entry.profile;
+}
+
+std::shared_ptr<StreamProfileInterface> StreamConversionUnit::shareProfile(const FrameInterface *frame) {
+  auto owner = frame->getOwner();
+  auto profile = frame->getStreamProfile();
+  return owner && profile ? owner->share_profile(profile) : nullptr;
+}
+
+void StreamConversionUnit::forRows(int width, int height, const std::function<void(int, int)> &fn) const {
+  if (width * height < kParallelPixels) {
+    fn(0, height);
+  } else {
+    RowWorkers::shared().run(height, kStripeRows, static_cast<size_t>(threads_.load()), fn);
+  }
+}
+
+}  // namespace libsmartereye2
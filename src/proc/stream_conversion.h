@@ -0,0 +1,78 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_STREAM_CONVERSION_H
+#define LIBSMARTEREYE2_STREAM_CONVERSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "processing.h"
+#include "streaming/stream_types.hpp"
+
+namespace libsmartereye2 {
+
+class StreamProfileInterface;
+
+// A block that turns single frames into frames of another format. Members of a frameset are replaced
+// by their conversions; frames convert() declines, or whose stream is filtered out
+// (OptionKey::STREAM_FILTER), pass through unchanged. Conversions are cached on the frame they come from
+// under the block's name and options, so blocks of one kind set up alike share them.
+class StreamConversionUnit : public ProcessingBlock {
+ public:
+  // memoise false for blocks that cache their results themselves
+  explicit StreamConversionUnit(const std::string &name, bool memoise = true);
+
+  static const int kStripeRows = 32;
+  static const int kParallelPixels = 640 * 360;  // smaller frames are converted on the calling thread
+
+ protected:
+  // the converted frame, nullptr to pass the frame through
+  virtual FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) = 0;
+
+  // A clone of frame's stream profile in the given format, with its current intrinsics. Frames given
+  // it before keep theirs, new intrinsics make a new clone.
+  std::shared_ptr<StreamProfileInterface> outputProfile(FrameInterface *frame, FrameFormat format);
+
+  // the owner of frame's stream profile, nullptr when no archive keeps it
+  static std::shared_ptr<StreamProfileInterface> shareProfile(const FrameInterface *frame);
+
+  // fn(begin, end) over the rows of a width x height frame, in stripes on RowWorkers once it is large
+  void forRows(int width, int height, const std::function<void(int, int)> &fn) const;
+
+ private:
+  FrameHolder process(FrameHolder frame, SyntheticSourceInterface *source);
+  FrameInterface *convertShared(FrameInterface *frame, SyntheticSourceInterface *source, uint64_t key);
+  // names the conversion: the block's name and the options that change its output
+  uint64_t derivedKey() const;
+
+  const std::string name_;
+  const bool memoise_;
+  std::atomic<int> threads_;
+  std::atomic<uint32_t> streams_;  // FrameId bits to convert, 0 for every stream
+  std::mutex profiles_mutex_;
+  struct OutputProfile {
+    std::weak_ptr<StreamProfileInterface> input;  // expired once the address may name another profile
+    std::shared_ptr<StreamProfileInterface> profile;
+  };
+  std::map<std::pair<const StreamProfileInterface *, FrameFormat>, OutputProfile> profiles_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_STREAM_CONVERSION_H
@@ -21,10 +21,21 @@
 #include "se_common.h"
 #include "easylogging++.h"
 
+#include <algorithm>
 #include <utility>
 
 namespace libsmartereye2 {
 
+// building the log line is what costs, so skip it entirely unless DEBUG is going anywhere
+static bool debugLogging() {
+#if ELPP_DEBUG_LOG
+  static el::Logger *logger = el::Loggers::getLogger(ELPP_CURR_FILE_LOGGER_ID);
+  return logger->enabled(el::Level::Debug);
+#else
+  return false;
+#endif
+}
+
 Matcher::Matcher(std::vector<StreamId> streams_id)
     : streams_id_(std::move(streams_id)) {
 
@@ -72,32 +83,23 @@ IdentityMatcher::IdentityMatcher(StreamId stream_id, FrameId frame_id)
 }
 
 void IdentityMatcher::dispatch(FrameHolder f, SyncronizationEnvironment env) {
-  std::stringstream s;
-  s << name_ << "--> " << static_cast<int>(f->getStreamProfile()->frameId()) << " " << f->getFrameIndex() << ", " << std::fixed
-    << f->getFrameTimestamp() << "\n";
-  LOG(DEBUG) << s.str();
+  if (debugLogging()) {
+    LOG(DEBUG) << name_ << "--> " << static_cast<int>(f->getStreamProfile()->frameId()) << " "
+               << f->getFrameIndex() << ", " << std::fixed << f->getFrameTimestamp();
+  }
 
   sync(std::move(f), env);
 }
 
 CompositeMatcher::CompositeMatcher(const std::vector<std::shared_ptr<Matcher>> &matchers, std::string name) {
   for (auto &&matcher : matchers) {
-    for (auto &&stream : matcher->getStreams()) {
-      matcher->setCallback([&](FrameHolder f, SyncronizationEnvironment env) {
-        sync(std::move(f), env);
-      });
-      matchers_[stream] = matcher;
-      streams_id_.push_back(stream);
-    }
-    for (auto &&stream : matcher->getStreamsTypes()) {
-      streams_type_.push_back(stream);
-    }
+    addSlot(matcher);
   }
 
   name_ = createCompositeName(matchers, name);
 }
 
-std::string CompositeMatcher::frameToString(FrameHolder &frame_holder) {
+std::string CompositeMatcher::frameToString(const FrameHolder &frame_holder) {
   std::ostringstream s;
   auto composite = dynamic_cast<CompositeFrameData *>(frame_holder.frame);
   if (composite) {
@@ -129,97 +131,145 @@ std::string CompositeMatcher::createCompositeName(const std::vector<std::shared_
 }
 
 void CompositeMatcher::dispatch(FrameHolder frame_holder, SyncronizationEnvironment env) {
-  std::stringstream s;
-  s << "DISPATCH " << name_ << "--> " << frameToString(frame_holder) << "\n";
-  LOG(DEBUG) << s.str();
+  if (debugLogging()) {
+    LOG(DEBUG) << "DISPATCH " << name_ << "--> " << frameToString(frame_holder);
+  }
 
-  cleanInactiveStreams(frame_holder);
-  auto matcher = findMatcher(frame_holder);
-  updateLastArrived(frame_holder, matcher.get());
-  matcher->dispatch(std::move(frame_holder), env);
+  auto now = Environment::instance().getTimeService()->getTime();
+  cleanInactiveStreams(frame_holder, now);
+  auto slot = findSlot(frame_holder);
+  if (!slot) return;
+  updateLastArrived(frame_holder, *slot, now);
+  slot->matcher->dispatch(std::move(frame_holder), env);
 }
 
+// Emits every group of equal frames at the heads of the slots, oldest first, as long as each stream
+// missing from the group is either inactive or known not to have a matching frame on its way.
 void CompositeMatcher::sync(FrameHolder f, SyncronizationEnvironment env) {
-  Matcher::sync(f.clone(), env);
-}
+  auto arrived = findSlot(f);
+  if (!arrived) return;
+  arrived->frames.push(std::move(f));
+
+  for (;;) {
+    synced_.clear();
+    missing_.clear();
+
+    for (auto &slot : slots_) {
+      auto frame = slot->frames.front();
+      if (!frame) {
+        missing_.push_back(slot.get());
+      } else if (synced_.empty() || equal(*frame, *synced_[0]->frames.front())) {
+        synced_.push_back(slot.get());
+      } else if (lessThan(*frame, *synced_[0]->frames.front())) {
+        missing_.insert(missing_.end(), synced_.begin(), synced_.end());
+        synced_.clear();
+        synced_.push_back(slot.get());
+      } else {
+        missing_.push_back(slot.get());
+      }
+    }
+    if (synced_.empty()) break;
 
-std::string CompositeMatcher::framesToString(std::vector<Matcher *> matchers) {
-  return std::string();
-}
+    bool complete = true;
+    for (auto missing : missing_) {
+      if (!skipMissingStream(synced_, *missing)) {
+        complete = false;
+        break;
+      }
+    }
+    if (!complete) break;
 
-std::shared_ptr<Matcher> CompositeMatcher::findMatcher(const FrameHolder &frame_holder) {
-  std::shared_ptr<Matcher> matcher;
-  auto stream_id = frame_holder.frame->getStreamProfile()->uniqueId();
-  auto stream_type = frame_holder.frame->getStreamProfile()->frameId();
+    for (auto slot : synced_) {
+      updateNextExpected(*slot->frames.front(), *slot);
+    }
+
+    FrameHolder result;
+    if (synced_.size() == 1) {
+      result = synced_[0]->frames.pop();
+    } else {
+      // a set holds one frame per stream, as many as there are FrameId bits
+      FrameHolder frames[kFrameIdSlots];
+      size_t count = 0;
+      for (auto slot : synced_) {
+        auto frame = slot->frames.pop();
+        if (count < kFrameIdSlots) frames[count++] = std::move(frame);
+      }
+      result = FrameHolder(env.source->allocateCompositeFrame(frames, count));
+      if (!result) {
+        LOG(ERROR) << "Failed to allocate a composite frame in " << name_;
+        continue;
+      }
+    }
+    Matcher::sync(std::move(result), env);
+  }
+}
 
-  // TODO: Potential deadlock if getSensor() gets a hold of the last reference of that sensor
-  auto sensor = frame_holder.frame->getSensor().get();
-  auto dev_exist = false;
+CompositeMatcher::StreamSlot *CompositeMatcher::addSlot(std::shared_ptr<Matcher> matcher) {
+  matcher->setCallback([this](FrameHolder f, SyncronizationEnvironment env) {
+    sync(std::move(f), env);
+  });
 
-  if (sensor) {
-    const DeviceInterface *dev = nullptr;
-    try {
-      dev = sensor->getDevice().shared_from_this().get();
+  auto index = static_cast<int>(slots_.size());
+  for (auto stream : matcher->getStreams()) {
+    if (stream < 0) continue;
+    if (static_cast<size_t>(stream) >= slot_of_stream_.size()) {
+      slot_of_stream_.resize(stream + 1, -1);
     }
-    catch (const std::bad_weak_ptr &) {
-      LOG(WARNING) << "Device destroyed";
+    auto &previous = slot_of_stream_[stream];
+    if (previous >= 0) {
+      // the stream moved into a new group, the old slot keeps no frames and is never looked up again
+      slots_[previous]->matcher->setActive(false);
+      slots_[previous]->frames.clear();
     }
-    if (dev) {
-      dev_exist = true;
-      matcher = matchers_[stream_id];
-      if (!matcher) {
-        std::ostringstream ss;
-        for (auto const &it : matchers_)
-          ss << ' ' << it.first;
-        LOG(DEBUG) << "stream id " << stream_id << " was not found; trying to create, existing streams=" << ss.str();
-        matcher = dev->createMatcher(frame_holder);
-
-        matcher->setCallback(
-            [&](FrameHolder f, SyncronizationEnvironment env) {
-              sync(std::move(f), env);
-            });
-
-        for (auto stream : matcher->getStreams()) {
-          if (matchers_[stream]) {
-            frames_queue_.erase(matchers_[stream].get());
-          }
-          matchers_[stream] = matcher;
-          streams_id_.push_back(stream);
-        }
-        for (auto stream : matcher->getStreamsTypes()) {
-          streams_type_.push_back(stream);
-        }
+    previous = index;
+    streams_id_.push_back(stream);
+  }
+  for (auto stream : matcher->getStreamsTypes()) {
+    streams_type_.push_back(stream);
+  }
 
-        if (std::find(streams_type_.begin(), streams_type_.end(), stream_type) == streams_type_.end()) {
-          LOG(ERROR) << "Stream matcher not found! stream=" << static_cast<int>(stream_type);
-        }
-      } else if (!matcher->getActive()) {
-        matcher->setActive(true);
-        frames_queue_[matcher.get()].start();
-      }
+  slots_.emplace_back(new StreamSlot(std::move(matcher)));
+  synced_.reserve(slots_.size());
+  missing_.reserve(slots_.size());
+  return slots_.back().get();
+}
+
+CompositeMatcher::StreamSlot *CompositeMatcher::findSlot(const FrameHolder &frame_holder) {
+  auto profile = frame_holder.frame->getStreamProfile();
+  auto stream_id = profile->uniqueId();
+
+  if (stream_id >= 0 && static_cast<size_t>(stream_id) < slot_of_stream_.size() && slot_of_stream_[stream_id] >= 0) {
+    auto slot = slots_[slot_of_stream_[stream_id]].get();
+    if (!slot->matcher->getActive()) {
+      slot->matcher->setActive(true);
     }
-  } else {
-    LOG(DEBUG) << "sensor does not exist";
+    return slot;
+  }
+  if (stream_id < 0) {
+    LOG(ERROR) << "Frame without a valid stream id reached " << name_;
+    return nullptr;
   }
 
-  if (!dev_exist) {
-    matcher = matchers_[stream_id];
-    // We don't know what device this frame came from, so just store it under device NULL with ID matcher
-    if (!matcher) {
-      if (matchers_[stream_id]) {
-        frames_queue_.erase(matchers_[stream_id].get());
-      }
-      matchers_[stream_id] = std::make_shared<IdentityMatcher>(stream_id, stream_type);
-      streams_id_.push_back(stream_id);
-      streams_type_.push_back(stream_type);
-      matcher = matchers_[stream_id];
-
-      matcher->setCallback([&](FrameHolder f, SyncronizationEnvironment env) {
-        sync(std::move(f), env);
-      });
+  // nullptr for frames no sensor made
+  std::shared_ptr<Matcher> matcher;
+  auto sensor = frame_holder.frame->getSensor();
+  if (sensor) {
+    LOG(DEBUG) << "stream id " << stream_id << " was not found in " << name_ << "; trying to create";
+    matcher = sensor->getDevice().createMatcher(frame_holder);
+  }
+  if (matcher) {
+    const auto &streams = matcher->getStreams();
+    if (std::find(streams.begin(), streams.end(), stream_id) == streams.end()) {
+      // adding it would leave a slot behind for every frame of the stream
+      LOG(ERROR) << "Stream matcher not found! stream=" << static_cast<int>(profile->frameId());
+      matcher.reset();
     }
   }
-  return matcher;
+  // devices without a matcher of their own, and frames we don't know the device of, sync one by one
+  if (!matcher) {
+    matcher = std::make_shared<IdentityMatcher>(stream_id, profile->frameId());
+  }
+  return addSlot(matcher);
 }
 
 TimestampCompositeMatcher::TimestampCompositeMatcher(std::vector<std::shared_ptr<Matcher>> matchers)
@@ -228,98 +278,78 @@ TimestampCompositeMatcher::TimestampCompositeMatcher(std::vector<std::shared_ptr
 }
 
 bool TimestampCompositeMatcher::equal(const FrameHolder &a, const FrameHolder &b) {
-  auto a_fps = a.frame->getStreamProfile()->fps();
-  auto b_fps = b.frame->getStreamProfile()->fps();
-  int min_fps = (a_fps < b_fps ? a_fps : b_fps);
-
-  auto timestamp_pair = extractTimestamps(a, b);
-  return equivalent(timestamp_pair.first, timestamp_pair.second, min_fps);
+  auto a_fps = fps(a);
+  auto b_fps = fps(b);
+  return equivalent(a->getFrameTimestamp(), b->getFrameTimestamp(), a_fps < b_fps ? a_fps : b_fps);
 }
 
 bool TimestampCompositeMatcher::lessThan(const FrameHolder &a, const FrameHolder &b) {
   if (!a || !b) {
     return false;
   }
-
-  auto timestamp_pair = extractTimestamps(a, b);
-  return timestamp_pair.first < timestamp_pair.second;
+  return a->getFrameTimestamp() < b->getFrameTimestamp();
 }
 
-bool TimestampCompositeMatcher::skipMissingStream(std::vector<Matcher *> synced, Matcher *missing) {
-  if (!missing->getActive()) return true;
-
-  FrameHolder *synced_frame;
+bool TimestampCompositeMatcher::skipMissingStream(const std::vector<StreamSlot *> &synced, const StreamSlot &missing) {
+  if (!missing.matcher->getActive()) return true;
 
-  frames_queue_[synced[0]].peek(&synced_frame);
+  const FrameHolder &synced_frame = *synced[0]->frames.front();
+  auto timestamp = synced_frame->getFrameTimestamp();
+  auto synced_fps = fps(synced_frame);
 
-  auto next_expected = _next_expected[missing];
-
-  auto it = _next_expected_domain.find(missing);
-  if (it != _next_expected_domain.end()) {
-    if (it->second != (*synced_frame)->getFrameTimestampDomain()) {
-      return false;
-    }
+  if (missing.next_expected_domain != TimestampDomain::COUNT
+      && missing.next_expected_domain != synced_frame->getFrameTimestampDomain()) {
+    return false;
   }
-  auto gap = 1000.f / (float) fps(*synced_frame);
+  auto gap = 1000.f / static_cast<float>(synced_fps);
   //next expected of the missing stream didn't updated yet
-  if ((*synced_frame)->getFrameTimestamp() > next_expected
-      && abs((*synced_frame)->getFrameTimestamp() - next_expected) < gap * 10) {
-    LOG(DEBUG) << "next expected of the missing stream didn't updated yet";
+  if (timestamp > missing.next_expected && std::abs(timestamp - missing.next_expected) < gap * 10) {
     return false;
   }
 
-  return !equivalent((*synced_frame)->getFrameTimestamp(), next_expected, fps(*synced_frame));
+  return !equivalent(timestamp, missing.next_expected, synced_fps);
 }
 
-void TimestampCompositeMatcher::cleanInactiveStreams(const FrameHolder &frame_holder) {
+void TimestampCompositeMatcher::cleanInactiveStreams(const FrameHolder &frame_holder, double now) {
   if (frame_holder.isBlocking()) return;
 
-  std::vector<StreamId> deadmatcher_s;
-  double now = Environment::instance().getTimeService()->getTime();
-  for (const auto &matcher: matchers_) {
-    auto threshold = fps_[matcher.second.get()] ? (1000 / fps_[matcher.second.get()]) * 5
-                                                : 500; //if frame of a specific stream didn't arrive for time equivalence to 5 frames duration
+  for (auto &slot : slots_) {
+    if (!slot->matcher->getActive()) continue;
+    //if frame of a specific stream didn't arrive for time equivalence to 5 frames duration
     //this stream will be marked as "not active" in order to not stack the other streams
-    if (last_arrived_[matcher.second.get()] && (now - last_arrived_[matcher.second.get()]) > threshold) {
-      std::stringstream s;
-      s << "clean inactive stream in " << name_;
-      for (auto stream : matcher.second->getStreamsTypes()) {
-        s << static_cast<int>(stream) << " ";
+    auto threshold = slot->fps ? (1000. / slot->fps) * 5 : 500.;
+    if (slot->last_arrived && (now - slot->last_arrived) > threshold) {
+      if (debugLogging()) {
+        std::stringstream s;
+        s << "clean inactive stream in " << name_;
+        for (auto stream : slot->matcher->getStreamsTypes()) {
+          s << static_cast<int>(stream) << " ";
+        }
+        LOG(DEBUG) << s.str();
       }
-      LOG(DEBUG) << s.str();
 
-      deadmatcher_s.push_back(matcher.first);
-      matcher.second->setActive(false);
+      slot->matcher->setActive(false);
+      slot->frames.clear();
     }
   }
-
-  for (auto id: deadmatcher_s) {
-    frames_queue_[matchers_[id].get()].clear();
-    frames_queue_.erase(matchers_[id].get());
-  }
 }
 
-void TimestampCompositeMatcher::updateLastArrived(FrameHolder &frame_holder, Matcher *matcher) {
-  fps_[matcher] = frame_holder->getStreamProfile()->fps();
-  last_arrived_[matcher] = Environment::instance().getTimeService()->getTime();
+void TimestampCompositeMatcher::updateLastArrived(const FrameHolder &frame_holder, StreamSlot &slot, double now) {
+  slot.fps = fps(frame_holder);
+  slot.last_arrived = now;
 }
 
-void TimestampCompositeMatcher::updateNextExpected(const FrameHolder &frame_holder) {
-  auto matcher = findMatcher(frame_holder);
-  _next_expected[matcher.get()] = frame_holder.frame->getFrameIndex() + 1.;
+void TimestampCompositeMatcher::updateNextExpected(const FrameHolder &frame_holder, StreamSlot &slot) {
+  slot.next_expected = frame_holder->getFrameTimestamp() + 1000. / fps(frame_holder);
+  slot.next_expected_domain = frame_holder->getFrameTimestampDomain();
 }
 
 uint32_t TimestampCompositeMatcher::fps(const FrameHolder &frame_holder) {
-  uint32_t fps = 0;
-  LOG(DEBUG) << "fps " << fps << " " << frameToString(const_cast<FrameHolder &>(frame_holder));
-  return fps ? fps : frame_holder.frame->getStreamProfile()->fps();
-}
-
-std::pair<double, double> TimestampCompositeMatcher::extractTimestamps(const FrameHolder &a, const FrameHolder &b) {
-  return {a->getFrameTimestamp(), b->getFrameTimestamp()};
+  auto fps = frame_holder->getStreamProfile()->fps();
+  return fps ? static_cast<uint32_t>(fps) : 1u;
 }
 
-bool TimestampCompositeMatcher::equivalent(double a, double b, int fps) {
+bool TimestampCompositeMatcher::equivalent(double a, double b, uint32_t fps) {
   auto gap = 1000.f / static_cast<float>(fps);
   return std::abs(a - b) < (gap / 2.f);
 }
@@ -330,16 +360,17 @@ SyncerProcessUnit::SyncerProcessUnit(std::initializer_list<bool> enable_opts)
       enable_opts_(enable_opts.begin(), enable_opts.end()) {
 
   matcher_->setCallback([this](FrameHolder f, SyncronizationEnvironment env) {
-    std::stringstream ss;
-    ss << "SYNCED: ";
     auto composite = dynamic_cast<CompositeFrameData *>(f.frame);
-    for (int i = 0; i < composite->getFrameCount(); i++) {
-      auto matched = composite->getFrame(i);
-      ss << static_cast<int>(matched->getStreamProfile()->frameId()) << " " << matched->getFrameIndex() << ", " << std::fixed
-         << matched->getFrameTimestamp() << " ";
+    if (composite && debugLogging()) {
+      std::stringstream ss;
+      ss << "SYNCED: ";
+      for (int i = 0; i < composite->getFrameCount(); i++) {
+        auto matched = composite->getFrame(i);
+        ss << static_cast<int>(matched->getStreamProfile()->frameId()) << " " << matched->getFrameIndex() << ", "
+           << std::fixed << matched->getFrameTimestamp() << " ";
+      }
+      LOG(DEBUG) << ss.str();
     }
-
-    LOG(DEBUG) << (ss.str());
     env.matches.enqueue(std::move(f));
   });
 
@@ -358,15 +389,13 @@ SyncerProcessUnit::SyncerProcessUnit(std::initializer_list<bool> enable_opts)
       return;
     }
 
-    ConsumerFrameQueue<FrameHolder> matches;
-
     {
       std::lock_guard<std::mutex> lock(mutex_);
-      matcher_->dispatch(std::move(frame), {source, matches});
+      matcher_->dispatch(std::move(frame), {source, matches_});
     }
 
     FrameHolder holder;
-    while (matches.tryDequeue(&holder))
+    while (matches_.tryDequeue(&holder))
       this->getSource().frameReady(std::move(holder));
 
   };
@@ -122,52 +122,98 @@ class IdentityMatcher : public Matcher {
   void dispatch(FrameHolder f, SyncronizationEnvironment env) override;
 };
 
+// Frames of one stream waiting for their partners. Only used under the syncer's lock, the oldest
+// frame is dropped when a stream runs too far ahead of the others.
+class FrameRing {
+ public:
+  explicit FrameRing(size_t capacity) : frames_(new FrameHolder[capacity]), capacity_(capacity), head_(0), size_(0) {}
+
+  void push(FrameHolder &&frame) {
+    if (size_ == capacity_) pop();
+    frames_[(head_ + size_) % capacity_] = std::move(frame);
+    ++size_;
+  }
+
+  FrameHolder pop() {
+    FrameHolder frame = std::move(frames_[head_]);
+    head_ = (head_ + 1) % capacity_;
+    --size_;
+    return frame;
+  }
+
+  FrameHolder *front() { return size_ ? &frames_[head_] : nullptr; }
+  void clear() { while (size_) pop(); }
+  size_t size() const { return size_; }
+
+ private:
+  std::unique_ptr<FrameHolder[]> frames_;
+  size_t capacity_;
+  size_t head_;
+  size_t size_;
+};
+
 class CompositeMatcher : public Matcher {
  public:
   CompositeMatcher(const std::vector<std::shared_ptr<Matcher>> &matchers, std::string name);
 
-  virtual bool equal(const FrameHolder &a, const FrameHolder &b) = 0;
-  virtual bool lessThan(const FrameHolder &a, const FrameHolder &b) = 0;
-  virtual bool skipMissingStream(std::vector<Matcher *> synced, Matcher *missing) = 0;
-  virtual void cleanInactiveStreams(const FrameHolder &frame_holder) = 0;
-  virtual void updateLastArrived(FrameHolder &frame_holder, Matcher *matcher) = 0;
-
   void dispatch(FrameHolder frame_holder, SyncronizationEnvironment env) override;
   void sync(FrameHolder f, SyncronizationEnvironment env) override;
 
-  std::string framesToString(std::vector<Matcher *> matchers);
-  std::shared_ptr<Matcher> findMatcher(const FrameHolder &frame_holder);
+  static const size_t kStreamQueueSize = 16;
 
  protected:
-  virtual void updateNextExpected(const FrameHolder &f) = 0;
-  static std::string frameToString(FrameHolder &frame_holder);
+  // everything the matcher tracks about one child matcher, i.e. one stream or one synced group
+  struct StreamSlot {
+    explicit StreamSlot(std::shared_ptr<Matcher> matcher)
+        : matcher(std::move(matcher)), frames(kStreamQueueSize) {}
+
+    std::shared_ptr<Matcher> matcher;
+    FrameRing frames;
+    uint32_t fps = 0;
+    double last_arrived = 0;
+    double next_expected = 0;
+    TimestampDomain next_expected_domain = TimestampDomain::COUNT;  // COUNT until a frame was synced
+  };
+
+  virtual bool equal(const FrameHolder &a, const FrameHolder &b) = 0;
+  virtual bool lessThan(const FrameHolder &a, const FrameHolder &b) = 0;
+  virtual bool skipMissingStream(const std::vector<StreamSlot *> &synced, const StreamSlot &missing) = 0;
+  virtual void cleanInactiveStreams(const FrameHolder &frame_holder, double now) = 0;
+  virtual void updateLastArrived(const FrameHolder &frame_holder, StreamSlot &slot, double now) = 0;
+  virtual void updateNextExpected(const FrameHolder &frame_holder, StreamSlot &slot) = 0;
+
+  StreamSlot *findSlot(const FrameHolder &frame_holder);
+  StreamSlot *addSlot(std::shared_ptr<Matcher> matcher);
+
+  static std::string frameToString(const FrameHolder &frame_holder);
   static std::string createCompositeName(const std::vector<std::shared_ptr<Matcher>> &matchers,
                                          const std::string &name);
 
-  std::map<Matcher *, ConsumerFrameQueue<FrameHolder>> frames_queue_;
-  std::map<StreamId, std::shared_ptr<Matcher>> matchers_;
-  std::map<Matcher *, double> _next_expected;
-  std::map<Matcher *, TimestampDomain> _next_expected_domain;
+  // slots never move once created; slot_of_stream_ is indexed by the stream's unique id, -1 when unknown
+  std::vector<std::unique_ptr<StreamSlot>> slots_;
+  std::vector<int> slot_of_stream_;
+
+ private:
+  // scratch space of sync(), kept to avoid allocating per frame
+  std::vector<StreamSlot *> synced_;
+  std::vector<StreamSlot *> missing_;
 };
 
 class TimestampCompositeMatcher : public CompositeMatcher {
  public:
   explicit TimestampCompositeMatcher(std::vector<std::shared_ptr<Matcher>> matchers);
 
+ protected:
   bool equal(const FrameHolder &a, const FrameHolder &b) override;
   bool lessThan(const FrameHolder &a, const FrameHolder &b) override;
-  bool skipMissingStream(std::vector<Matcher *> synced, Matcher *missing) override;
-  void cleanInactiveStreams(const FrameHolder &frame_holder) override;
-  void updateLastArrived(FrameHolder &frame_holder, Matcher *matcher) override;
-  void updateNextExpected(const FrameHolder &frame_holder) override;
+  bool skipMissingStream(const std::vector<StreamSlot *> &synced, const StreamSlot &missing) override;
+  void cleanInactiveStreams(const FrameHolder &frame_holder, double now) override;
+  void updateLastArrived(const FrameHolder &frame_holder, StreamSlot &slot, double now) override;
+  void updateNextExpected(const FrameHolder &frame_holder, StreamSlot &slot) override;
 
  private:
   static uint32_t fps(const FrameHolder &frame_holder);
-  static std::pair<double, double> extractTimestamps(const FrameHolder &a, const FrameHolder &b);
-  static bool equivalent(double a, double b, int fps);
-
-  std::map<Matcher *, double> last_arrived_;
-  std::map<Matcher *, unsigned int> fps_;
+  static bool equivalent(double a, double b, uint32_t fps);
 };
 
 class SyncerProcessUnit : public ProcessingBlock {
@@ -187,6 +233,7 @@ class SyncerProcessUnit : public ProcessingBlock {
 
  private:
   std::unique_ptr<TimestampCompositeMatcher> matcher_;
+  ConsumerFrameQueue<FrameHolder> matches_;
   std::vector<bool> enable_opts_;
 };
 
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+
 #include "easylogging++.h"
 #include "synthetic_stream.h"
 #include "core/frame.h"
@@ -23,53 +25,125 @@ namespace libsmartereye2 {
 SyntheticSource::SyntheticSource(FrameSource &actual)
     : actual_source_(actual) {}
 
-FrameInterface *SyntheticSource::allocateVideoFrame(std::shared_ptr<StreamProfileInterface> stream,
+FrameInterface *SyntheticSource::allocateVideoFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                                     FrameInterface *original,
                                                     int new_bpp,
                                                     int new_width,
                                                     int new_height,
                                                     int new_stride,
                                                     SeExtension frame_type) {
-  return nullptr;
+  auto video = dynamic_cast<VideoFrameData *>(original);
+  if (!video) {
+    LOG(ERROR) << "allocateVideoFrame(...) failed. The original is not a video frame";
+    return nullptr;
+  }
+  if (frame_type != SeExtension::EXTENSION_VIDEO_FRAME && frame_type != SeExtension::EXTENSION_DEPTH_FRAME
+      && frame_type != SeExtension::EXTENSION_DISPARITY_FRAME) {
+    LOG(ERROR) << "allocateVideoFrame(...) failed. Not a video frame type";
+    return nullptr;
+  }
+
+  auto width = new_width ? new_width : video->width();
+  auto height = new_height ? new_height : video->height();
+  auto bpp = new_bpp ? new_bpp : video->bpp();
+  auto stride = new_stride ? new_stride : width * ((bpp + 7) / 8);
+
+  // the result keeps index, timestamps and metadata of the original
+  auto frame = actual_source_.alloc_frame(frame_type, static_cast<size_t>(stride) * height, video->extension(), true);
+  if (!frame) return nullptr;
+
+  auto result = static_cast<VideoFrameData *>(frame);
+  result->assign(width, height, stride, bpp);
+  result->inheritHandles(original);
+  if (stream) result->setStreamProfile(stream);
+  return frame;
+}
+
+FrameInterface *SyntheticSource::allocateVideoView(FrameInterface *original,
+                                                   int x,
+                                                   int y,
+                                                   int width,
+                                                   int height,
+                                                   SeExtension frame_type) {
+  auto video = dynamic_cast<VideoFrameData *>(original);
+  if (!video) {
+    LOG(ERROR) << "allocateVideoView(...) failed. The original is not a video frame";
+    return nullptr;
+  }
+  if (frame_type != SeExtension::EXTENSION_VIDEO_FRAME && frame_type != SeExtension::EXTENSION_DEPTH_FRAME
+      && frame_type != SeExtension::EXTENSION_DISPARITY_FRAME) {
+    LOG(ERROR) << "allocateVideoView(...) failed. Not a video frame type";
+    return nullptr;
+  }
+  if (video->bpp() <= 0 || video->bpp() % 8) {
+    LOG(ERROR) << "allocateVideoView(...) failed. Pixels of " << video->bpp() << " bits do not start on bytes";
+    return nullptr;
+  }
+  if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > video->width() || y + height > video->height()) {
+    LOG(ERROR) << "allocateVideoView(...) failed. " << width << "x" << height << " at (" << x << ", " << y
+               << ") is not inside the " << video->width() << "x" << video->height() << " frame";
+    return nullptr;
+  }
+
+  auto pixel_size = video->bpp() / 8;
+  auto stride = video->stride() ? video->stride() : video->width() * pixel_size;
+  auto offset = static_cast<size_t>(y) * stride + static_cast<size_t>(x) * pixel_size;
+  if (video->getFrameDataSize() < offset + static_cast<size_t>(stride) * (height - 1) + width * pixel_size) {
+    LOG(ERROR) << "allocateVideoView(...) failed. The original holds " << video->getFrameDataSize() << " bytes";
+    return nullptr;
+  }
+  // a full stride for every row where the original has the bytes, else the last row ends with its last pixel
+  auto size = std::min(static_cast<size_t>(stride) * height, video->getFrameDataSize() - offset);
+
+  auto frame = actual_source_.alloc_frame(frame_type, 0, video->extension(), false);
+  if (!frame) return nullptr;
+
+  auto result = static_cast<VideoFrameData *>(frame);
+  result->assign(width, height, stride, video->bpp());
+  result->inheritHandles(original);
+  original->acquire();
+  result->attachExternalData(video->getFrameData() + offset, size, [original]() { original->release(); });
+  return frame;
 }
 
-FrameInterface *SyntheticSource::allocateMotionFrame(std::shared_ptr<StreamProfileInterface> stream,
+FrameInterface *SyntheticSource::allocateMotionFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                                      FrameInterface *original,
                                                      SeExtension frame_type) {
   return nullptr;
 }
 
 FrameInterface *SyntheticSource::allocateCompositeFrame(std::vector<FrameHolder> holders) {
+  return allocateCompositeFrame(holders.data(), holders.size());
+}
+
+FrameInterface *SyntheticSource::allocateCompositeFrame(FrameHolder *holders, size_t count) {
   FrameExtension frame_ext{};
-  auto req_size = holders.size();
-  auto alloc_size = req_size * sizeof(FrameInterface*);
+  auto alloc_size = count * sizeof(FrameInterface*);
 
   auto frame_interface = actual_source_.alloc_frame(SeExtension::EXTENSION_COMPOSITE_FRAME, alloc_size, frame_ext, true);
   if (!frame_interface) return nullptr;
 
-  auto composite_frame = dynamic_cast<CompositeFrameData *>(frame_interface);
-  composite_frame->setFrameCount(holders.size());
-
-  for (auto &&f : holders) {
-    if (f.isBlocking()) {
-      frame_interface->setBlocking(true);
-    }
-  }
-
-  auto frames = composite_frame->getFrames();
-  for (int i = 0; i < req_size; i++) {
-    frames[i] = nullptr;
-    std::swap(frames[i], holders[i].frame);
-  }
-
+  static_cast<CompositeFrameData *>(frame_interface)->assign(holders, count);
   return frame_interface;
 }
 
-FrameInterface *SyntheticSource::allocatePoints(std::shared_ptr<StreamProfileInterface> stream,
+FrameInterface *SyntheticSource::allocatePoints(const std::shared_ptr<StreamProfileInterface> &stream,
                                                 FrameInterface *original,
+                                                size_t count,
                                                 SeExtension frame_type) {
-  // TODO
-  return nullptr;
+  auto original_data = dynamic_cast<FrameData *>(original);
+  if (!original_data) {
+    LOG(ERROR) << "allocatePoints(...) failed. The original is not a frame";
+    return nullptr;
+  }
+
+  auto size = count * (sizeof(Vertex) + sizeof(TextureCoordinate));
+  auto frame = actual_source_.alloc_frame(frame_type, size, original_data->extension(), true);
+  if (!frame) return nullptr;
+
+  frame->inheritHandles(original);
+  if (stream) frame->setStreamProfile(stream);
+  return frame;
 }
 
 void SyntheticSource::frameReady(FrameHolder result) {
@@ -31,11 +31,13 @@ namespace libsmartereye2 {
 class FrameSource;
 
 class SyntheticSourceInterface {
- public:
  public:
   virtual ~SyntheticSourceInterface() = default;
 
-  virtual FrameInterface *allocateVideoFrame(std::shared_ptr<StreamProfileInterface> stream,
+  // A frame of the original's size, bpp in bits and stride in bytes unless given, with the original's
+  // stream profile unless given.
+
+  virtual FrameInterface *allocateVideoFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                              FrameInterface *original,
                                              int new_bpp = 0,
                                              int new_width = 0,
@@ -43,14 +45,26 @@ class SyntheticSourceInterface {
                                              int new_stride = 0,
                                              SeExtension frame_type = SeExtension::EXTENSION_VIDEO_FRAME) = 0;
 
-  virtual FrameInterface *allocateMotionFrame(std::shared_ptr<StreamProfileInterface> stream,
+  // The width x height region at (x, y) of original, sharing its pixels and stride. The view holds a
+  // reference to original until it is released.
+  virtual FrameInterface *allocateVideoView(FrameInterface *original,
+                                            int x,
+                                            int y,
+                                            int width,
+                                            int height,
+                                            SeExtension frame_type = SeExtension::EXTENSION_VIDEO_FRAME) = 0;
+
+  virtual FrameInterface *allocateMotionFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                               FrameInterface *original,
                                               SeExtension frame_type = SeExtension::EXTENSION_MOTION_FRAME) = 0;
 
   virtual FrameInterface *allocateCompositeFrame(std::vector<FrameHolder> frames) = 0;
+  virtual FrameInterface *allocateCompositeFrame(FrameHolder *frames, size_t count) = 0;
 
-  virtual FrameInterface *allocatePoints(std::shared_ptr<StreamProfileInterface> stream,
+  // count vertices followed by their texture coordinates, profile and sensor those of original unless given
+  virtual FrameInterface *allocatePoints(const std::shared_ptr<StreamProfileInterface> &stream,
                                          FrameInterface *original,
+                                         size_t count,
                                          SeExtension frame_type = SeExtension::EXTENSION_POINTS) = 0;
 
   virtual void frameReady(FrameHolder result) = 0;
@@ -60,7 +74,7 @@ class SyntheticSource : public SyntheticSourceInterface {
  public:
   explicit SyntheticSource(FrameSource &actual);
 
-  FrameInterface *allocateVideoFrame(std::shared_ptr<StreamProfileInterface> stream,
+  FrameInterface *allocateVideoFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                      FrameInterface *original,
                                      int new_bpp = 0,
                                      int new_width = 0,
@@ -68,14 +82,23 @@ class SyntheticSource : public SyntheticSourceInterface {
                                      int new_stride = 0,
                                      SeExtension frame_type = SeExtension::EXTENSION_VIDEO_FRAME) override;
 
-  FrameInterface *allocateMotionFrame(std::shared_ptr<StreamProfileInterface> stream,
+  FrameInterface *allocateVideoView(FrameInterface *original,
+                                    int x,
+                                    int y,
+                                    int width,
+                                    int height,
+                                    SeExtension frame_type = SeExtension::EXTENSION_VIDEO_FRAME) override;
+
+  FrameInterface *allocateMotionFrame(const std::shared_ptr<StreamProfileInterface> &stream,
                                       FrameInterface *original,
                                       SeExtension frame_type = SeExtension::EXTENSION_MOTION_FRAME) override;
 
   FrameInterface *allocateCompositeFrame(std::vector<FrameHolder> holders) override;
+  FrameInterface *allocateCompositeFrame(FrameHolder *holders, size_t count) override;
 
-  FrameInterface *allocatePoints(std::shared_ptr<StreamProfileInterface> stream,
+  FrameInterface *allocatePoints(const std::shared_ptr<StreamProfileInterface> &stream,
                                  FrameInterface *original,
+                                 size_t count,
                                  SeExtension frame_type = SeExtension::EXTENSION_POINTS) override;
 
   void frameReady(FrameHolder result) override;
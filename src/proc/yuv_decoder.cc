@@ -0,0 +1,77 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "yuv_decoder.h"
+
+#include "color_convert.h"
+#include "core/frame_data.h"
+#include "streaming/stream_profile.h"
+#include "easylogging++.h"
+
+namespace libsmartereye2 {
+
+YuvDecoderUnit::YuvDecoderUnit()
+    : StreamConversionUnit("YUV Decoder"),
+      output_format_(static_cast<int>(FrameFormat::Color)) {
+  registerOption(OptionKey::OUTPUT_FORMAT, std::make_shared<RangeOption>(
+      OptionRange{static_cast<float>(FrameFormat::Gray), static_cast<float>(FrameFormat::RGBA), 1,
+                  static_cast<float>(FrameFormat::Color)},
+      "Format frames are converted into: Gray, Color (BGR), RGB or RGBA",
+      [this](float value) {
+        auto format = static_cast<FrameFormat>(static_cast<int>(value));
+        if (!canConvertColor(FrameFormat::YUV422, format)) {
+          throw std::runtime_error(toString() << "YUV Decoder cannot convert into format " << value);
+        }
+        output_format_ = static_cast<int>(format);
+      }));
+}
+
+FrameInterface *YuvDecoderUnit::convert(FrameInterface *frame, SyntheticSourceInterface *source) {
+  auto video = dynamic_cast<VideoFrameData *>(frame);
+  auto profile = frame ? frame->getStreamProfile() : nullptr;
+  if (!video || !profile) return nullptr;
+
+  auto output_format = static_cast<FrameFormat>(output_format_.load());
+  if (!canConvertColor(profile->format(), output_format)) return nullptr;
+
+  auto width = video->width();
+  auto height = video->height();
+  ColorConversion conversion{};
+  conversion.src = reinterpret_cast<const uint8_t *>(video->getFrameData());
+  conversion.src_stride = video->stride() ? video->stride() : colorRowSize(profile->format(), width);
+  conversion.src_format = profile->format();
+  conversion.dst_format = output_format;
+  conversion.width = width;
+  conversion.height = height;
+  if (width <= 0 || height <= 0 || video->getFrameDataSize() < colorSourceSize(conversion)) {
+    LOG(WARNING) << "YUV Decoder skipped a frame of stream " << static_cast<uint32_t>(profile->frameId())
+                 << ", " << video->getFrameDataSize() << " bytes do not hold " << width << "x" << height;
+    return nullptr;
+  }
+
+  auto pixel_size = colorPixelSize(output_format);
+  auto result = source->allocateVideoFrame(outputProfile(frame, output_format), frame, pixel_size * 8,
+                                           width, height, width * pixel_size);
+  if (!result) return nullptr;
+
+  conversion.dst = reinterpret_cast<uint8_t *>(static_cast<VideoFrameData *>(result)->data().data());
+  conversion.dst_stride = width * pixel_size;
+
+  forRows(width, height, [&conversion](int begin, int end) {
+    convertColorRows(conversion, begin, end);
+  });
+  return result;
+}
+
+}  // namespace libsmartereye2
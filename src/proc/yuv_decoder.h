@@ -0,0 +1,39 @@
+// Copyright 2020 Smarter Eye Co.,Ltd. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSMARTEREYE2_YUV_DECODER_H
+#define LIBSMARTEREYE2_YUV_DECODER_H
+
+#include <atomic>
+
+#include "stream_conversion.h"
+
+namespace libsmartereye2 {
+
+// Converts YUV422, YUV422Planar and RGB565 frames into RGB, BGR (FrameFormat::Color), RGBA or Gray,
+// frames of other formats pass through.
+class YuvDecoderUnit : public StreamConversionUnit {
+ public:
+  YuvDecoderUnit();
+
+ protected:
+  FrameInterface *convert(FrameInterface *frame, SyntheticSourceInterface *source) override;
+
+ private:
+  std::atomic<int> output_format_;
+};
+
+}  // namespace libsmartereye2
+
+#endif //LIBSMARTEREYE2_YUV_DECODER_H
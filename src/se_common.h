@@ -55,7 +55,7 @@ class OsTimeService : public TimeService {
  public:
   double getTime() const override {
     return std::chrono::duration<double, std::milli>(
-        std::chrono::system_clock::now().time_since_epoch()
+        std::chrono::steady_clock::now().time_since_epoch()
     ).count();
   }
 };
@@ -91,6 +91,18 @@ std::vector<StreamProfile> Sensor::getActiveStreams() const {
   return results;
 }
 
+void Sensor::setBackpressure(FrameId stream, BackpressurePolicy policy, uint32_t queue_size) const {
+  sensor_->sensor->setBackpressure(stream, policy, queue_size);
+}
+
+std::vector<StreamStatistics> Sensor::getStreamStatistics() const {
+  return sensor_->sensor->getStreamStatistics();
+}
+
+ClockSyncStatistics Sensor::getClockSyncStatistics() const {
+  return sensor_->sensor->getClockSyncStatistics();
+}
+
 }  // namespace se2
 
 namespace libsmartereye2 {
@@ -26,6 +26,7 @@
 #include "core/options.h"
 #include "core/info.h"
 #include "core/frame_source.h"
+#include "streaming/stream_types.hpp"
 #include "device/backend.h"
 
 namespace libsmartereye2 {
@@ -67,6 +68,10 @@ class SensorInterface : public virtual OptionsInterface, public virtual InfoInte
   virtual DeviceInterface &getDevice() = 0;
   virtual Intrinsics getIntrinsics() const = 0;
   virtual Extrinsics getExtrinsics() const = 0;
+
+  virtual void setBackpressure(FrameId stream, BackpressurePolicy policy, uint32_t queue_size) = 0;
+  virtual std::vector<StreamStatistics> getStreamStatistics() const = 0;
+  virtual ClockSyncStatistics getClockSyncStatistics() const = 0;
 };
 
 class SensorBase : public virtual SensorInterface, public virtual OptionsContainer, public virtual InfoContainer,
@@ -87,6 +92,11 @@ class SensorBase : public virtual SensorInterface, public virtual OptionsContain
   DeviceInterface &getDevice() override;
   Intrinsics getIntrinsics() const override { return intrinsics_; }
   Extrinsics getExtrinsics() const override { return extrinsics_; }
+  void setBackpressure(FrameId, BackpressurePolicy, uint32_t) override {
+    throw std::runtime_error("setBackpressure(...) failed. Sensor has no callback queues!");
+  }
+  std::vector<StreamStatistics> getStreamStatistics() const override { return {}; }
+  ClockSyncStatistics getClockSyncStatistics() const override { return {}; }
 
   virtual bool isOpened() const { return is_opened_; }
 
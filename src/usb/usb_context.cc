@@ -15,6 +15,7 @@
 #include "usb_context.h"
 
 #include <cassert>
+#include "concurrency/thread_placement.h"
 #include "easylogging++.h"
 
 namespace libsmartereye2 {
@@ -47,6 +48,7 @@ void UsbContext::startEventHandler() {
       kill_hendler_thread_num_ = 0;
     }
     event_handler_thread_ = std::thread([this]() {
+      ThreadPlacement::Scope placement(ThreadRole::USB_EVENTS, "se2-usb-events");
       while (kill_hendler_thread_num_ != 0) {
         libusb_handle_events_completed(usb_context_, &kill_hendler_thread_num_);
       }